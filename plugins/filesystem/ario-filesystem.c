@@ -67,6 +67,7 @@ static gboolean ario_filesystem_filetree_row_expanded_cb (GtkTreeView *tree_view
 static void ario_filesystem_cursor_moved_cb (GtkTreeView *tree_view,
                                              ArioFilesystem *filesystem);
 static void ario_filesystem_fill_filesystem (ArioFilesystem *filesystem);
+static void ario_filesystem_stream_stop (ArioFilesystem *filesystem);
 
 struct ArioFilesystemPrivate
 {
@@ -81,6 +82,13 @@ struct ArioFilesystemPrivate
         gboolean empty;
 
         GtkWidget *menu;
+
+        /* Content of selected folder being retrieved */
+        ArioServerStream *stream;
+        GtkTreeRowReference *stream_row;
+        gchar *stream_dir;
+        gboolean stream_expand;
+        gboolean expanding;
 };
 
 /* Actions on directories */
@@ -267,6 +275,9 @@ ario_filesystem_shutdown (ArioSource *source)
         int pos;
         guint i;
 
+        /* Stop retrieving folder content */
+        ario_filesystem_stream_stop (filesystem);
+
         /* Save hpaned position */
         pos = gtk_paned_get_position (GTK_PANED (filesystem->priv->paned));
         if (pos > 0)
@@ -397,6 +408,10 @@ ario_filesystem_filetree_row_expanded_cb (GtkTreeView *tree_view,
                                           ArioFilesystem *filesystem)
 {
         ARIO_LOG_FUNCTION_START;
+        /* Row is expanded again while its content is being retrieved */
+        if (filesystem->priv->expanding)
+                return FALSE;
+
         ario_filesystem_cursor_moved_cb (tree_view,
                                          filesystem);
 
@@ -420,24 +435,106 @@ ario_filesystem_filetree_row_activated_cb (GtkTreeView *tree_view,
         }
 }
 
+static void
+ario_filesystem_stream_stop (ArioFilesystem *filesystem)
+{
+        ARIO_LOG_FUNCTION_START;
+        ario_server_stream_cancel (filesystem->priv->stream);
+        filesystem->priv->stream = NULL;
+
+        gtk_tree_row_reference_free (filesystem->priv->stream_row);
+        filesystem->priv->stream_row = NULL;
+
+        g_free (filesystem->priv->stream_dir);
+        filesystem->priv->stream_dir = NULL;
+}
+
+static void
+ario_filesystem_stream_cb (ArioServerFileList *batch,
+                           gboolean finished,
+                           ArioFilesystem *filesystem)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkTreeIter iter, child, fake_child, song_iter;
+        ArioSonglist *songlist = ARIO_SONGLIST (filesystem->priv->songs);
+        GtkListStore *liststore = ario_songlist_get_liststore (songlist);
+        GtkTreeSelection *selection = ario_songlist_get_selection (songlist);
+        GtkTreePath *treepath;
+        gchar *dir = filesystem->priv->stream_dir;
+        gchar *path, *display_path;
+        gboolean was_empty;
+        GSList *tmp;
+
+        if (finished) {
+                filesystem->priv->stream = NULL;
+                ario_filesystem_stream_stop (filesystem);
+                return;
+        }
+
+        /* Folder may have been removed from the tree in the meantime */
+        treepath = gtk_tree_row_reference_get_path (filesystem->priv->stream_row);
+        if (!treepath)
+                return;
+
+        if (gtk_tree_model_get_iter (GTK_TREE_MODEL (filesystem->priv->model), &iter, treepath)) {
+                /* For each directory */
+                for (tmp = batch->directories; tmp; tmp = g_slist_next (tmp)) {
+                        path = tmp->data;
+                        /* Append directory to folder tree */
+                        gtk_tree_store_append (filesystem->priv->model, &child, &iter);
+                        if (!strcmp (dir, ROOT)) {
+                                display_path = path;
+                        } else {
+                                /* Do no display parent hierarchy in tree path */
+                                display_path = path + strlen (dir) + 1;
+                        }
+
+                        /* Set tree values */
+                        gtk_tree_store_set (filesystem->priv->model, &child,
+                                            FILETREE_ICON_COLUMN, "folder",
+                                            FILETREE_ICONSIZE_COLUMN, 1,
+                                            FILETREE_NAME_COLUMN, display_path,
+                                            FILETREE_DIR_COLUMN, path, -1);
+
+                        /* Append fake child to allow expand */
+                        gtk_tree_store_append(GTK_TREE_STORE (filesystem->priv->model), &fake_child, &child);
+                }
+
+                /* Re-expand row as soon as it has children again */
+                if (filesystem->priv->stream_expand && batch->directories) {
+                        filesystem->priv->stream_expand = FALSE;
+                        filesystem->priv->expanding = TRUE;
+                        gtk_tree_view_expand_row (GTK_TREE_VIEW (filesystem->priv->tree), treepath, FALSE);
+                        filesystem->priv->expanding = FALSE;
+                }
+        }
+        gtk_tree_path_free (treepath);
+
+        /* Append songs to songs list */
+        was_empty = !gtk_tree_model_get_iter_first (GTK_TREE_MODEL (liststore), &song_iter);
+        ario_songlist_append_songs (songlist, batch->songs);
+
+        /* Select first song */
+        if (was_empty && gtk_tree_model_get_iter_first (GTK_TREE_MODEL (liststore), &song_iter)) {
+                gtk_tree_selection_unselect_all (selection);
+                gtk_tree_selection_select_iter (selection, &song_iter);
+        }
+}
+
 static void
 ario_filesystem_cursor_moved_cb (GtkTreeView *tree_view,
                                  ArioFilesystem *filesystem)
 {
         ARIO_LOG_FUNCTION_START;
-        GtkTreeIter iter, child, fake_child, song_iter;
+        GtkTreeIter iter, child;
         GtkTreeModel *model = GTK_TREE_MODEL (filesystem->priv->model);
         ArioSonglist *songlist = ARIO_SONGLIST (filesystem->priv->songs);
         GtkListStore *liststore = ario_songlist_get_liststore (songlist);
-        GtkTreeSelection *selection = ario_songlist_get_selection (songlist);
         gchar *dir;
-        gchar *title;
-        GSList *tmp;
-        ArioServerFileList *files;
-        ArioServerSong *song;
-        gchar *path, *display_path;
         GtkTreePath *treepath;
-        gboolean was_expanded;
+
+        /* Abort retrieval of the previously selected folder */
+        ario_filesystem_stream_stop (filesystem);
 
         /* Do nothing if no folder is selected */
         if (!gtk_tree_selection_get_selected (filesystem->priv->selection,
@@ -449,7 +546,7 @@ ario_filesystem_cursor_moved_cb (GtkTreeView *tree_view,
         treepath = gtk_tree_model_get_path (GTK_TREE_MODEL (filesystem->priv->model), &iter);
 
         /* Remember if row was expanded or not */
-        was_expanded = gtk_tree_view_row_expanded (tree_view, treepath);
+        filesystem->priv->stream_expand = gtk_tree_view_row_expanded (tree_view, treepath);
 
         /* Remove all childs */
         if (gtk_tree_model_iter_children (GTK_TREE_MODEL (filesystem->priv->model),
@@ -463,60 +560,17 @@ ario_filesystem_cursor_moved_cb (GtkTreeView *tree_view,
 
         /* Get path of selected dir */
         gtk_tree_model_get (GTK_TREE_MODEL (filesystem->priv->model), &iter, FILETREE_DIR_COLUMN, &dir, -1);
-        g_return_if_fail (dir);
-
-        /* Get files/directories in path */
-        files = ario_server_list_files (dir, FALSE);
-
-        /* For each directory */
-        for (tmp = files->directories; tmp; tmp = g_slist_next (tmp)) {
-                path = tmp->data;
-                /* Append directory to folder tree */
-                gtk_tree_store_append (filesystem->priv->model, &child, &iter);
-                if (!strcmp (dir, ROOT)) {
-                        display_path = path;
-                } else {
-                        /* Do no display parent hierarchy in tree path */
-                        display_path = path + strlen (dir) + 1;
-                }
-
-                /* Set tree values */
-                gtk_tree_store_set (filesystem->priv->model, &child,
-                                    FILETREE_ICON_COLUMN, "folder",
-                                    FILETREE_ICONSIZE_COLUMN, 1,
-                                    FILETREE_NAME_COLUMN, display_path,
-                                    FILETREE_DIR_COLUMN, path, -1);
-
-                /* Append fake child to allow expand */
-                gtk_tree_store_append(GTK_TREE_STORE (filesystem->priv->model), &fake_child, &child);
-        }
-
-        /* For each file */
-        for (tmp = files->songs; tmp; tmp = g_slist_next (tmp)) {
-                song = tmp->data;
-
-                /* Append song to songs list */
-                gtk_list_store_append (liststore, &song_iter);
-
-                title = ario_util_format_title (song);
-                gtk_list_store_set (liststore, &song_iter,
-                                    SONGS_TITLE_COLUMN, title,
-                                    SONGS_ARTIST_COLUMN, song->artist,
-                                    SONGS_ALBUM_COLUMN, song->album,
-                                    SONGS_FILENAME_COLUMN, song->file,
-                                    -1);
+        if (!dir) {
+                gtk_tree_path_free (treepath);
+                return;
         }
-        ario_server_free_file_list (files);
-        g_free (dir);
-
-        /* Select first song */
-        gtk_tree_selection_unselect_all (selection);
-        if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (liststore), &song_iter))
-                gtk_tree_selection_select_iter (selection, &song_iter);
 
-        /* Re-expand row if needed */
-        if (was_expanded)
-                gtk_tree_view_expand_row (tree_view, treepath, FALSE);
+        /* Get files/directories in path, they are added to the tree and the list as they arrive */
+        filesystem->priv->stream_row = gtk_tree_row_reference_new (GTK_TREE_MODEL (filesystem->priv->model), treepath);
+        filesystem->priv->stream_dir = dir;
+        filesystem->priv->stream = ario_server_list_files_stream (dir, FALSE,
+                                                                  (ArioServerStreamFunc) ario_filesystem_stream_cb,
+                                                                  filesystem);
         gtk_tree_path_free (treepath);
 }
 
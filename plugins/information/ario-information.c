@@ -380,7 +380,6 @@ ario_information_fill_album (ArioInformation *information)
         ArioServerCriteria *criteria = NULL;
         GSList *tmp;
         ArioServerAlbum *album;
-        gchar *cover_path;
         GdkPixbuf *pixbuf;
         GtkWidget *image;
         int nb = 0;
@@ -431,9 +430,7 @@ ario_information_fill_album (ArioInformation *information)
                         continue;
 
                 /* Get albums cover */
-                cover_path = ario_cover_make_cover_path (album->artist, album->album, SMALL_COVER);
-                pixbuf = gdk_pixbuf_new_from_file_at_size (cover_path, COVER_SIZE, COVER_SIZE, NULL);
-                g_free (cover_path);
+                pixbuf = ario_cover_get_pixbuf (album->artist, album->album, SMALL_COVER, COVER_SIZE);
                 if (pixbuf) {
                         /* Cover found: create widgets to add cover art */
                         event_box = gtk_event_box_new ();
@@ -0,0 +1,510 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Tests of the cover download: a local HTTP server replaces the Last.fm
+ * web services and serves canned album informations and images, and
+ * covers are searched with ArioCoverDownloader like the cover download
+ * window does. Run with 'make check' in src/.
+ */
+
+#include <config.h>
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ario-conf.h"
+#include "covers/ario-cover.h"
+#include "covers/ario-cover-downloader.h"
+#include "servers/ario-server.h"
+#include "ario-util.h"
+
+/* Maximum time to wait for a search */
+#define TEST_TIMEOUT 30
+
+/* Last.fm requests must be spaced by at least 200ms. Requests are
+ * timed by the server so some jitter is allowed */
+#define TEST_REQUEST_INTERVAL (G_USEC_PER_SEC / 5)
+#define TEST_REQUEST_SLACK (G_USEC_PER_SEC / 20)
+
+/* Width of the images served: the first large image of an album and
+ * the next one, that must never be downloaded */
+#define FIRST_SIZE 64
+#define SECOND_SIZE 96
+
+/* Albums whose name starts with this prefix have no information */
+#define MISSING_PREFIX "Missing"
+
+#define ARTIST "Artist"
+
+static gchar *config_home;
+static GSocketService *service;
+static gint stub_port;
+
+static GBytes *first_image;
+static GBytes *second_image;
+
+/* Requests received by the server */
+static GMutex requests_mutex;
+/* Paths of all the requests */
+static GPtrArray *requests;
+/* Time of the album information requests */
+static GArray *info_times;
+
+typedef struct
+{
+        gint nb_progress;
+        gboolean cancel;
+        gboolean done;
+} ArioCoverTestRun;
+
+static GBytes *
+ario_cover_test_make_image (const gint size)
+{
+        GdkPixbuf *pixbuf;
+        GError *error = NULL;
+        gchar *buffer;
+        gsize length;
+        guchar *pixels;
+        gint i;
+
+        /* Noise is not compressed: the image is big enough to be a
+         * valid cover */
+        pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, size, size);
+        pixels = gdk_pixbuf_get_pixels (pixbuf);
+        for (i = 0; i < gdk_pixbuf_get_rowstride (pixbuf) * size; ++i)
+                pixels[i] = g_test_rand_int_range (0, 256);
+
+        gdk_pixbuf_save_to_buffer (pixbuf, &buffer, &length, "png", &error, NULL);
+        g_assert_no_error (error);
+        g_assert (ario_cover_size_is_valid (length));
+        g_object_unref (pixbuf);
+
+        return g_bytes_new_take (buffer, length);
+}
+
+static gchar *
+ario_cover_test_make_info (const gchar *path)
+{
+        const gchar *album;
+
+        album = strstr (path, "&album=");
+        if (!album || g_str_has_prefix (album + strlen ("&album="), MISSING_PREFIX))
+                return g_strdup ("<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                                 "<lfm status=\"failed\"><error code=\"6\">Album not found</error></lfm>");
+
+        /* Only the first large image must be downloaded */
+        return g_strdup_printf ("<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                                "<lfm status=\"ok\"><album>"
+                                "<image size=\"small\">http://127.0.0.1:%d/small.png</image>"
+                                "<image size=\"large\">http://127.0.0.1:%d/first.png</image>"
+                                "<image size=\"large\">http://127.0.0.1:%d/second.png</image>"
+                                "</album></lfm>",
+                                stub_port, stub_port, stub_port);
+}
+
+static gboolean
+ario_cover_test_stub_run_cb (GThreadedSocketService *service,
+                             GSocketConnection *connection,
+                             GObject *source_object,
+                             gpointer data)
+{
+        GDataInputStream *input;
+        GOutputStream *output;
+        gchar *line, *header;
+        gchar **request = NULL;
+        const gchar *path = "";
+        gint64 now = g_get_monotonic_time ();
+        gint code = 200;
+        gchar *info = NULL;
+        gconstpointer body = NULL;
+        gsize length = 0;
+
+        input = g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+        g_filter_input_stream_set_close_base_stream (G_FILTER_INPUT_STREAM (input), FALSE);
+
+        /* "GET path HTTP/1.1" followed by headers up to an empty line */
+        line = g_data_input_stream_read_line (input, NULL, NULL, NULL);
+        if (line) {
+                request = g_strsplit (g_strstrip (line), " ", 3);
+                if (g_strv_length (request) == 3)
+                        path = request[1];
+        }
+        while ((header = g_data_input_stream_read_line (input, NULL, NULL, NULL))
+               && *g_strstrip (header))
+                g_free (header);
+        g_free (header);
+
+        g_mutex_lock (&requests_mutex);
+        g_ptr_array_add (requests, g_strdup (path));
+        if (g_str_has_prefix (path, "/2.0/"))
+                g_array_append_val (info_times, now);
+        g_mutex_unlock (&requests_mutex);
+
+        if (g_str_has_prefix (path, "/2.0/")) {
+                info = ario_cover_test_make_info (path);
+                body = info;
+                length = strlen (info);
+        } else if (!strcmp (path, "/first.png")) {
+                body = g_bytes_get_data (first_image, &length);
+        } else if (!strcmp (path, "/second.png")) {
+                body = g_bytes_get_data (second_image, &length);
+        } else {
+                code = 404;
+        }
+
+        output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+        header = g_strdup_printf ("HTTP/1.1 %d %s\r\n"
+                                  "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+                                  "Connection: close\r\n"
+                                  "\r\n",
+                                  code, code == 200 ? "OK" : "Not Found", length);
+        g_output_stream_write_all (output, header, strlen (header), NULL, NULL, NULL);
+        if (length)
+                g_output_stream_write_all (output, body, length, NULL, NULL, NULL);
+
+        g_free (header);
+        g_free (info);
+        g_strfreev (request);
+        g_free (line);
+        g_object_unref (input);
+
+        return TRUE;
+}
+
+static void
+ario_cover_test_start_stub (void)
+{
+        GSocketAddress *address, *effective_address;
+        GError *error = NULL;
+        gchar *root;
+
+        first_image = ario_cover_test_make_image (FIRST_SIZE);
+        second_image = ario_cover_test_make_image (SECOND_SIZE);
+        requests = g_ptr_array_new_with_free_func (g_free);
+        info_times = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+        service = g_threaded_socket_service_new (-1);
+        address = g_inet_socket_address_new_from_string ("127.0.0.1", 0);
+        g_socket_listener_add_address (G_SOCKET_LISTENER (service), address,
+                                       G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP,
+                                       NULL, &effective_address, &error);
+        g_assert_no_error (error);
+        stub_port = g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (effective_address));
+        g_object_unref (effective_address);
+        g_object_unref (address);
+
+        g_signal_connect (service, "run", G_CALLBACK (ario_cover_test_stub_run_cb), NULL);
+        g_socket_service_start (service);
+
+        /* Last.fm requests are sent to the local server */
+        root = g_strdup_printf ("http://127.0.0.1:%d/2.0/", stub_port);
+        g_setenv ("ARIO_LASTFM_ROOT", root, TRUE);
+        g_setenv ("no_proxy", "127.0.0.1", TRUE);
+        g_free (root);
+}
+
+static gint
+ario_cover_test_count_requests (const gchar *path)
+{
+        guint i;
+        gint count = 0;
+
+        g_mutex_lock (&requests_mutex);
+        for (i = 0; i < requests->len; ++i) {
+                if (!strcmp (g_ptr_array_index (requests, i), path))
+                        ++count;
+        }
+        g_mutex_unlock (&requests_mutex);
+
+        return count;
+}
+
+static GSList *
+ario_cover_test_make_albums (const gchar *first_album, ...)
+{
+        GSList *albums = NULL;
+        ArioServerAlbum *server_album;
+        const gchar *album;
+        va_list args;
+
+        va_start (args, first_album);
+        for (album = first_album; album; album = va_arg (args, const gchar *)) {
+                server_album = (ArioServerAlbum *) g_malloc0 (sizeof (ArioServerAlbum));
+                server_album->artist = g_strdup (ARTIST);
+                server_album->album = g_strdup (album);
+                albums = g_slist_append (albums, server_album);
+        }
+        va_end (args);
+
+        return albums;
+}
+
+static void
+ario_cover_test_free_albums (GSList *albums)
+{
+        g_slist_foreach (albums, (GFunc) ario_server_free_album, NULL);
+        g_slist_free (albums);
+}
+
+static void
+ario_cover_test_progress_cb (ArioCoverDownloader *downloader,
+                             const gchar *artist,
+                             const gchar *album,
+                             ArioCoverTestRun *run)
+{
+        g_assert (!run->done);
+        ++run->nb_progress;
+        if (run->cancel)
+                ario_cover_downloader_cancel (downloader);
+}
+
+static void
+ario_cover_test_done_cb (ArioCoverDownloader *downloader,
+                         ArioCoverTestRun *run)
+{
+        g_assert (!run->done);
+        run->done = TRUE;
+}
+
+static gboolean
+ario_cover_test_timeout_cb (gboolean *timeout)
+{
+        *timeout = TRUE;
+        return FALSE;
+}
+
+/* Search the covers of albums and run the main loop until the end of
+ * the search. The downloader must be freed by the caller */
+static ArioCoverDownloader *
+ario_cover_test_run (const GSList *albums,
+                     const gint jobs,
+                     ArioCoverTestRun *run)
+{
+        ArioCoverDownloader *downloader;
+        gboolean timeout = FALSE;
+        guint timeout_id;
+
+        downloader = ario_cover_downloader_new (albums,
+                                                GET_COVERS,
+                                                jobs,
+                                                (ArioCoverDownloaderProgressFunc) ario_cover_test_progress_cb,
+                                                (ArioCoverDownloaderDoneFunc) ario_cover_test_done_cb,
+                                                run);
+
+        timeout_id = g_timeout_add_seconds (TEST_TIMEOUT, (GSourceFunc) ario_cover_test_timeout_cb, &timeout);
+        while (!run->done && !timeout)
+                g_main_context_iteration (NULL, TRUE);
+        if (!timeout)
+                g_source_remove (timeout_id);
+
+        g_assert (run->done);
+        g_assert_cmpint (ario_cover_downloader_get_nb_covers (downloader), ==, g_slist_length ((GSList *) albums));
+
+        return downloader;
+}
+
+static void
+ario_cover_test_first_cover (void)
+{
+        ArioCoverTestRun run = { 0 };
+        ArioCoverDownloader *downloader;
+        GSList *albums;
+        gchar *path;
+        gint width = 0, height = 0;
+
+        albums = ario_cover_test_make_albums ("First", NULL);
+        downloader = ario_cover_test_run (albums, 1, &run);
+
+        g_assert_cmpint (ario_cover_downloader_get_nb_found (downloader), ==, 1);
+        g_assert_cmpint (ario_cover_downloader_get_nb_not_found (downloader), ==, 0);
+        g_assert_cmpint (ario_cover_downloader_get_nb_already_exist (downloader), ==, 0);
+        g_assert_cmpint (run.nb_progress, ==, 1);
+
+        /* The first large image is saved and the other ones are not
+         * downloaded */
+        g_assert_cmpint (ario_cover_test_count_requests ("/first.png"), ==, 1);
+        g_assert_cmpint (ario_cover_test_count_requests ("/second.png"), ==, 0);
+        g_assert_cmpint (ario_cover_test_count_requests ("/small.png"), ==, 0);
+
+        g_assert (ario_cover_cover_exists (ARTIST, "First"));
+        path = ario_cover_make_cover_path (ARTIST, "First", NORMAL_COVER);
+        g_assert (gdk_pixbuf_get_file_info (path, &width, &height));
+        g_assert_cmpint (width, ==, FIRST_SIZE);
+        g_free (path);
+
+        ario_cover_downloader_free (downloader);
+        ario_cover_test_free_albums (albums);
+}
+
+static void
+ario_cover_test_counts (void)
+{
+        ArioCoverTestRun run = { 0 };
+        ArioCoverDownloader *downloader;
+        ArioServerAlbum *server_album;
+        GSList *albums;
+
+        /* The cover of "First" has been saved by the previous test */
+        albums = ario_cover_test_make_albums ("First", MISSING_PREFIX "Counts", "Counts", NULL);
+        /* Albums without artist are skipped */
+        server_album = (ArioServerAlbum *) g_malloc0 (sizeof (ArioServerAlbum));
+        server_album->album = g_strdup ("No artist");
+        albums = g_slist_append (albums, server_album);
+
+        downloader = ario_cover_test_run (albums, 2, &run);
+
+        g_assert_cmpint (ario_cover_downloader_get_nb_found (downloader), ==, 1);
+        g_assert_cmpint (ario_cover_downloader_get_nb_not_found (downloader), ==, 1);
+        g_assert_cmpint (ario_cover_downloader_get_nb_already_exist (downloader), ==, 1);
+        g_assert_cmpint (run.nb_progress, ==, 3);
+
+        g_assert (ario_cover_cover_exists (ARTIST, "Counts"));
+        g_assert (!ario_cover_cover_exists (ARTIST, MISSING_PREFIX "Counts"));
+        /* The existing cover is not downloaded again */
+        g_assert_cmpint (ario_cover_test_count_requests ("/first.png"), ==, 2);
+
+        ario_cover_downloader_free (downloader);
+        ario_cover_test_free_albums (albums);
+}
+
+static void
+ario_cover_test_cancel (void)
+{
+        ArioCoverTestRun run = { 0 };
+        ArioCoverDownloader *downloader;
+        GSList *albums;
+        gint nb_done;
+
+        /* One album at a time, cancelled as soon as the first one starts */
+        albums = ario_cover_test_make_albums ("Cancel0", "Cancel1", "Cancel2", "Cancel3",
+                                              "Cancel4", "Cancel5", "Cancel6", "Cancel7", NULL);
+        run.cancel = TRUE;
+        downloader = ario_cover_test_run (albums, 1, &run);
+
+        nb_done = ario_cover_downloader_get_nb_found (downloader)
+                + ario_cover_downloader_get_nb_not_found (downloader)
+                + ario_cover_downloader_get_nb_already_exist (downloader);
+
+        /* Albums started before the cancellation are completed */
+        g_assert_cmpint (nb_done, >=, 1);
+        g_assert_cmpint (nb_done, <, g_slist_length (albums));
+        g_assert_cmpint (run.nb_progress, ==, nb_done);
+        g_assert (!ario_cover_cover_exists (ARTIST, "Cancel7"));
+
+        ario_cover_downloader_free (downloader);
+        ario_cover_test_free_albums (albums);
+}
+
+static gint
+ario_cover_test_compare_times (const gint64 *a,
+                               const gint64 *b)
+{
+        return (*a > *b) - (*a < *b);
+}
+
+static void
+ario_cover_test_rate_limit (void)
+{
+        ArioCoverTestRun run = { 0 };
+        ArioCoverDownloader *downloader;
+        GSList *albums;
+        guint i;
+
+        g_mutex_lock (&requests_mutex);
+        g_array_set_size (info_times, 0);
+        g_mutex_unlock (&requests_mutex);
+
+        /* All the albums are searched at the same time */
+        albums = ario_cover_test_make_albums ("Rate0", "Rate1", "Rate2",
+                                              MISSING_PREFIX "Rate3", MISSING_PREFIX "Rate4", "Rate5", NULL);
+        downloader = ario_cover_test_run (albums, g_slist_length (albums), &run);
+
+        g_assert_cmpint (ario_cover_downloader_get_nb_found (downloader), ==, 4);
+        g_assert_cmpint (ario_cover_downloader_get_nb_not_found (downloader), ==, 2);
+
+        /* Album informations are never requested more than 5 times
+         * per second */
+        g_mutex_lock (&requests_mutex);
+        g_assert_cmpint (info_times->len, ==, g_slist_length (albums));
+        g_array_sort (info_times, (GCompareFunc) ario_cover_test_compare_times);
+        for (i = 1; i < info_times->len; ++i)
+                g_assert_cmpint (g_array_index (info_times, gint64, i) - g_array_index (info_times, gint64, i - 1),
+                                 >=, TEST_REQUEST_INTERVAL - TEST_REQUEST_SLACK);
+        g_mutex_unlock (&requests_mutex);
+
+        ario_cover_downloader_free (downloader);
+        ario_cover_test_free_albums (albums);
+}
+
+static void
+ario_cover_test_remove_dir (const gchar *path)
+{
+        GDir *dir;
+        const gchar *name;
+        gchar *child;
+
+        dir = g_dir_open (path, 0, NULL);
+        if (dir) {
+                while ((name = g_dir_read_name (dir))) {
+                        child = g_build_filename (path, name, NULL);
+                        if (g_file_test (child, G_FILE_TEST_IS_DIR))
+                                ario_cover_test_remove_dir (child);
+                        else
+                                g_unlink (child);
+                        g_free (child);
+                }
+                g_dir_close (dir);
+        }
+        g_rmdir (path);
+}
+
+int
+main (int argc, char *argv[])
+{
+        GError *error = NULL;
+        gint status;
+
+        g_test_init (&argc, &argv, NULL);
+
+        /* Covers and downloads are kept in a private configuration
+         * directory */
+        config_home = g_dir_make_tmp ("ario-test-XXXXXX", &error);
+        g_assert_no_error (error);
+        g_setenv ("XDG_CONFIG_HOME", config_home, TRUE);
+
+        ario_conf_init ();
+        ario_cover_test_start_stub ();
+
+        /* Tests share the saved covers and run in order */
+        g_test_add_func ("/covers/first-cover", ario_cover_test_first_cover);
+        g_test_add_func ("/covers/counts", ario_cover_test_counts);
+        g_test_add_func ("/covers/cancel", ario_cover_test_cancel);
+        g_test_add_func ("/covers/rate-limit", ario_cover_test_rate_limit);
+        status = g_test_run ();
+
+        g_socket_service_stop (service);
+        g_socket_listener_close (G_SOCKET_LISTENER (service));
+        g_object_unref (service);
+        ario_cover_test_remove_dir (config_home);
+        g_free (config_home);
+
+        return status;
+}
@@ -0,0 +1,1740 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * ario-fake-mpd is a development tool: a local server speaking the
+ * subset of the MPD protocol used by Ario, with a synthetic library of
+ * configurable size. Responses can be delayed and throttled to look like
+ * a slow or remote server, and a script of commands can change the
+ * server state while Ario is connected. Everything is deterministic so
+ * that runs can be compared.
+ *
+ * It is not built by default: use 'make ario-fake-mpd' in src/. It is
+ * also used by the tests of 'make check'.
+ */
+
+#include <gio/gio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FAKE_MPD_PROTOCOL_VERSION "0.21.0"
+
+/* Error codes of the protocol */
+#define ACK_OK 0
+#define ACK_ERROR_ARG 2
+#define ACK_ERROR_UNKNOWN 5
+#define ACK_ERROR_NO_EXIST 50
+
+/* Subsystems of the idle command */
+enum
+{
+        IDLE_DATABASE = 1 << 0,
+        IDLE_UPDATE = 1 << 1,
+        IDLE_STORED_PLAYLIST = 1 << 2,
+        IDLE_PLAYLIST = 1 << 3,
+        IDLE_PLAYER = 1 << 4,
+        IDLE_MIXER = 1 << 5,
+        IDLE_OUTPUT = 1 << 6,
+        IDLE_OPTIONS = 1 << 7
+};
+
+static const gchar *idle_names[] = {
+        "database",
+        "update",
+        "stored_playlist",
+        "playlist",
+        "player",
+        "mixer",
+        "output",
+        "options",
+        NULL
+};
+
+enum
+{
+        STATE_STOP,
+        STATE_PLAY,
+        STATE_PAUSE
+};
+
+typedef struct
+{
+        gchar *file;
+        gchar *directory;
+        const gchar *artist;
+        const gchar *album;
+        gchar *title;
+        gchar *track;
+        gchar *date;
+        const gchar *genre;
+        gint time;
+} FakeSong;
+
+/* Entry of the queue: song, queue id and playlist version of the last
+ * change of this position (used by plchanges) */
+typedef struct
+{
+        guint song;
+        guint id;
+        guint version;
+} FakeEntry;
+
+typedef struct
+{
+        GSocketConnection *connection;
+        GDataInputStream *input;
+        GOutputStream *output;
+
+        /* Idle events not yet reported to this client */
+        guint pending_idle;
+} FakeClient;
+
+typedef gint (*FakeCommandFunc) (gchar **argv,
+                                 GString *out);
+
+typedef struct
+{
+        const gchar *name;
+        FakeCommandFunc func;
+        gint min_args;
+        gint max_args;
+} FakeCommand;
+
+/* Server state, protected by mutex */
+static struct
+{
+        GMutex mutex;
+
+        GPtrArray *songs;
+        GHashTable *files;
+        GStringChunk *strings;
+        gint artists;
+        gint albums;
+        glong db_playtime;
+
+        GArray *queue;
+        guint version;
+        guint next_id;
+
+        gint state;
+        gint current_id;
+        gint64 elapsed;
+        gint64 started;
+
+        gint volume;
+        gboolean random;
+        gboolean repeat;
+        gboolean consume;
+        gboolean single;
+        gint crossfade;
+        gboolean output_enabled;
+        guint update_id;
+        gboolean updating;
+
+        gint64 start_time;
+        GSList *clients;
+} fake;
+
+/* Options */
+static gint port = 6600;
+static gint nb_artists = 100;
+static gint nb_albums = 5;
+static gint nb_songs = 12;
+static gint latency = 0;
+static gint bandwidth = 0;
+static gchar *script = NULL;
+static gboolean loop_script = FALSE;
+
+static const gchar *
+ario_fake_mpd_intern (const gchar *value)
+{
+        return g_string_chunk_insert_const (fake.strings, value);
+}
+
+static void
+ario_fake_mpd_generate_library (void)
+{
+        FakeSong *song;
+        gint artist, album, track;
+        gchar *artist_name, *album_name;
+
+        fake.songs = g_ptr_array_new ();
+        fake.files = g_hash_table_new (g_str_hash, g_str_equal);
+        fake.strings = g_string_chunk_new (4096);
+        fake.artists = nb_artists;
+        fake.albums = nb_artists * nb_albums;
+
+        /* Songs are sorted by path, like in the database of MPD */
+        for (artist = 0; artist < nb_artists; ++artist) {
+                artist_name = g_strdup_printf ("Artist %04d", artist);
+                for (album = 0; album < nb_albums; ++album) {
+                        album_name = g_strdup_printf ("Album %05d", artist * nb_albums + album);
+                        for (track = 0; track < nb_songs; ++track) {
+                                song = g_new0 (FakeSong, 1);
+                                song->artist = ario_fake_mpd_intern (artist_name);
+                                song->album = ario_fake_mpd_intern (album_name);
+                                song->directory = g_strdup_printf ("%s/%s", artist_name, album_name);
+                                song->file = g_strdup_printf ("%s/%02d - Title %02d.ogg",
+                                                              song->directory, track + 1, track + 1);
+                                song->title = g_strdup_printf ("Title %02d", track + 1);
+                                song->track = g_strdup_printf ("%d", track + 1);
+                                song->date = g_strdup_printf ("%d", 1960 + (artist + album) % 60);
+                                song->genre = ario_fake_mpd_intern (artist % 2 ? "Rock" : "Jazz");
+                                song->time = 120 + (artist * 7 + album * 13 + track * 31) % 240;
+                                fake.db_playtime += song->time;
+
+                                g_ptr_array_add (fake.songs, song);
+                                g_hash_table_insert (fake.files, song->file, GUINT_TO_POINTER (fake.songs->len));
+                        }
+                        g_free (album_name);
+                }
+                g_free (artist_name);
+        }
+}
+
+static FakeSong *
+ario_fake_mpd_get_song (const guint index)
+{
+        return g_ptr_array_index (fake.songs, index);
+}
+
+static const gchar *
+ario_fake_mpd_song_tag (const FakeSong *song,
+                        const gchar *tag)
+{
+        if (!g_ascii_strcasecmp (tag, "artist")
+            || !g_ascii_strcasecmp (tag, "albumartist"))
+                return song->artist;
+        else if (!g_ascii_strcasecmp (tag, "album"))
+                return song->album;
+        else if (!g_ascii_strcasecmp (tag, "title"))
+                return song->title;
+        else if (!g_ascii_strcasecmp (tag, "track"))
+                return song->track;
+        else if (!g_ascii_strcasecmp (tag, "date"))
+                return song->date;
+        else if (!g_ascii_strcasecmp (tag, "genre"))
+                return song->genre;
+        else if (!g_ascii_strcasecmp (tag, "file"))
+                return song->file;
+        else
+                return NULL;
+}
+
+/* Name of a tag as printed by MPD */
+static const gchar *
+ario_fake_mpd_tag_name (const gchar *tag)
+{
+        const gchar *names[] = { "Artist", "AlbumArtist", "Album", "Title", "Track", "Date", "Genre", "file", NULL };
+        gint i;
+
+        for (i = 0; names[i]; ++i) {
+                if (!g_ascii_strcasecmp (tag, names[i]))
+                        return names[i];
+        }
+        return tag;
+}
+
+static void
+ario_fake_mpd_print_song (GString *out,
+                          const FakeSong *song)
+{
+        g_string_append_printf (out,
+                                "file: %s\n"
+                                "Last-Modified: 2020-01-01T00:00:00Z\n"
+                                "Artist: %s\n"
+                                "AlbumArtist: %s\n"
+                                "Album: %s\n"
+                                "Title: %s\n"
+                                "Track: %s\n"
+                                "Date: %s\n"
+                                "Genre: %s\n"
+                                "Time: %d\n"
+                                "duration: %d.000\n",
+                                song->file, song->artist, song->artist, song->album,
+                                song->title, song->track, song->date, song->genre,
+                                song->time, song->time);
+}
+
+static void
+ario_fake_mpd_print_entry (GString *out,
+                           const guint pos)
+{
+        FakeEntry *entry = &g_array_index (fake.queue, FakeEntry, pos);
+
+        ario_fake_mpd_print_song (out, ario_fake_mpd_get_song (entry->song));
+        g_string_append_printf (out, "Pos: %u\nId: %u\n", pos, entry->id);
+}
+
+static void
+ario_fake_mpd_emit (const guint events)
+{
+        GSList *tmp;
+        FakeClient *client;
+
+        for (tmp = fake.clients; tmp; tmp = g_slist_next (tmp)) {
+                client = tmp->data;
+                client->pending_idle |= events;
+        }
+}
+
+static gboolean
+ario_fake_mpd_parse_int (const gchar *arg,
+                         gint *value)
+{
+        gchar *end;
+        glong ret;
+
+        ret = strtol (arg, &end, 10);
+        if (end == arg || *end)
+                return FALSE;
+        *value = ret;
+        return TRUE;
+}
+
+static gboolean
+ario_fake_mpd_parse_bool (const gchar *arg,
+                          gboolean *value)
+{
+        if (!strcmp (arg, "0"))
+                *value = FALSE;
+        else if (!strcmp (arg, "1"))
+                *value = TRUE;
+        else
+                return FALSE;
+        return TRUE;
+}
+
+/* Parse a position or a START:END range of the queue */
+static gboolean
+ario_fake_mpd_parse_range (const gchar *arg,
+                           gint *start,
+                           gint *end)
+{
+        gchar **parts;
+        gboolean ret;
+
+        if (!strchr (arg, ':')) {
+                if (!ario_fake_mpd_parse_int (arg, start))
+                        return FALSE;
+                *end = *start + 1;
+                return *start >= 0 && *start < (gint) fake.queue->len;
+        }
+
+        parts = g_strsplit (arg, ":", 2);
+        ret = ario_fake_mpd_parse_int (parts[0], start);
+        if (!*parts[1])
+                *end = fake.queue->len;
+        else
+                ret = ret && ario_fake_mpd_parse_int (parts[1], end);
+        g_strfreev (parts);
+
+        if (ret && *end > (gint) fake.queue->len)
+                *end = fake.queue->len;
+        return ret && *start >= 0 && *start <= *end;
+}
+
+static gint
+ario_fake_mpd_find_id (const gint id)
+{
+        guint i;
+
+        for (i = 0; i < fake.queue->len; ++i) {
+                if ((gint) g_array_index (fake.queue, FakeEntry, i).id == id)
+                        return i;
+        }
+        return -1;
+}
+
+/* Positions from start to end of the queue changed in a new version */
+static void
+ario_fake_mpd_queue_changed (const guint start,
+                             const guint end)
+{
+        guint i;
+
+        ++fake.version;
+        for (i = start; i < end && i < fake.queue->len; ++i)
+                g_array_index (fake.queue, FakeEntry, i).version = fake.version;
+        ario_fake_mpd_emit (IDLE_PLAYLIST);
+}
+
+static guint
+ario_fake_mpd_queue_insert (const guint song,
+                            gint pos)
+{
+        FakeEntry entry;
+
+        if (pos < 0 || pos > (gint) fake.queue->len)
+                pos = fake.queue->len;
+
+        entry.song = song;
+        entry.id = fake.next_id++;
+        entry.version = 0;
+        g_array_insert_val (fake.queue, pos, entry);
+        ario_fake_mpd_queue_changed (pos, fake.queue->len);
+
+        return entry.id;
+}
+
+static void
+ario_fake_mpd_queue_delete (const guint start,
+                            const guint end)
+{
+        gint current = ario_fake_mpd_find_id (fake.current_id);
+
+        if (current >= (gint) start && current < (gint) end) {
+                fake.state = STATE_STOP;
+                fake.current_id = -1;
+                ario_fake_mpd_emit (IDLE_PLAYER);
+        }
+
+        g_array_remove_range (fake.queue, start, end - start);
+        ario_fake_mpd_queue_changed (start, fake.queue->len);
+}
+
+/* Elapsed time in milliseconds of the current song */
+static gint64
+ario_fake_mpd_get_elapsed (void)
+{
+        if (fake.state == STATE_PLAY)
+                return fake.elapsed + (g_get_monotonic_time () - fake.started) / 1000;
+        return fake.elapsed;
+}
+
+static void
+ario_fake_mpd_play_pos (const gint pos)
+{
+        if (pos < 0 || pos >= (gint) fake.queue->len) {
+                fake.state = STATE_STOP;
+                fake.current_id = -1;
+        } else {
+                fake.state = STATE_PLAY;
+                fake.current_id = g_array_index (fake.queue, FakeEntry, pos).id;
+        }
+        fake.elapsed = 0;
+        fake.started = g_get_monotonic_time ();
+        ario_fake_mpd_emit (IDLE_PLAYER);
+}
+
+static void
+ario_fake_mpd_seek (const gint time)
+{
+        fake.elapsed = (gint64) time * 1000;
+        fake.started = g_get_monotonic_time ();
+        ario_fake_mpd_emit (IDLE_PLAYER);
+}
+
+static void
+ario_fake_mpd_next (void)
+{
+        gint pos = ario_fake_mpd_find_id (fake.current_id);
+
+        if (fake.random && fake.queue->len > 0)
+                pos = g_random_int_range (0, fake.queue->len);
+        else if (!fake.single)
+                ++pos;
+
+        if (fake.consume && fake.current_id >= 0) {
+                ario_fake_mpd_queue_delete (ario_fake_mpd_find_id (fake.current_id),
+                                            ario_fake_mpd_find_id (fake.current_id) + 1);
+                if (!fake.random && !fake.single)
+                        --pos;
+        }
+
+        if (pos >= (gint) fake.queue->len && fake.repeat)
+                pos = 0;
+        ario_fake_mpd_play_pos (pos);
+}
+
+static gboolean
+ario_fake_mpd_player_cb (gpointer data)
+{
+        gint pos;
+
+        /* Go to the next song at the end of the current one */
+        g_mutex_lock (&fake.mutex);
+        pos = ario_fake_mpd_find_id (fake.current_id);
+        if (fake.state == STATE_PLAY && pos >= 0
+            && ario_fake_mpd_get_elapsed () >= ario_fake_mpd_get_song (g_array_index (fake.queue, FakeEntry, pos).song)->time * 1000)
+                ario_fake_mpd_next ();
+        g_mutex_unlock (&fake.mutex);
+
+        return TRUE;
+}
+
+static gboolean
+ario_fake_mpd_update_done_cb (gpointer data)
+{
+        g_mutex_lock (&fake.mutex);
+        fake.updating = FALSE;
+        ario_fake_mpd_emit (IDLE_DATABASE | IDLE_UPDATE);
+        g_mutex_unlock (&fake.mutex);
+
+        return FALSE;
+}
+
+/* Filters of find and search: tag/value pairs. Filter expressions of
+ * recent MPD versions are not supported */
+static gboolean
+ario_fake_mpd_match (const FakeSong *song,
+                     gchar **filters,
+                     const gboolean exact)
+{
+        const gchar *value;
+        gchar *lower;
+        gboolean ret = FALSE;
+        gint i;
+
+        if (!g_ascii_strcasecmp (filters[0], "base"))
+                return g_str_has_prefix (song->file, filters[1])
+                        && (!*filters[1] || song->file[strlen (filters[1])] == '/');
+
+        if (!g_ascii_strcasecmp (filters[0], "any")) {
+                const gchar *tags[] = { "artist", "album", "title", "genre", "date", "file", NULL };
+
+                for (i = 0; tags[i] && !ret; ++i) {
+                        const gchar *any[] = { tags[i], filters[1] };
+                        ret = ario_fake_mpd_match (song, (gchar **) any, exact);
+                }
+                return ret;
+        }
+
+        value = ario_fake_mpd_song_tag (song, filters[0]);
+        if (!value)
+                value = "";
+        if (exact)
+                return !strcmp (value, filters[1]);
+
+        lower = g_ascii_strdown (value, -1);
+        ret = strstr (lower, filters[1]) != NULL;
+        g_free (lower);
+
+        return ret;
+}
+
+/* Call func on the songs matching the pairs of filters */
+static gint
+ario_fake_mpd_search (gchar **filters,
+                      const gboolean exact,
+                      void (*func) (guint, gpointer),
+                      gpointer data)
+{
+        gchar **lowered;
+        guint i, j, n = g_strv_length (filters);
+        guint start = 0, end = G_MAXUINT, found = 0;
+        gboolean match;
+
+        /* 'window START:END' only keeps a range of the matching songs */
+        if (n >= 2 && !g_ascii_strcasecmp (filters[n - 2], "window")) {
+                if (sscanf (filters[n - 1], "%u:%u", &start, &end) < 1 || start > end)
+                        return ACK_ERROR_ARG;
+                n -= 2;
+        }
+
+        if (n == 0 || n % 2 || *filters[0] == '(')
+                return ACK_ERROR_ARG;
+
+        lowered = g_new0 (gchar *, n + 1);
+        for (j = 0; j < n; ++j)
+                lowered[j] = (j % 2 && !exact) ? g_ascii_strdown (filters[j], -1) : g_strdup (filters[j]);
+
+        for (i = 0; i < fake.songs->len && found < end; ++i) {
+                match = TRUE;
+                for (j = 0; j < n && match; j += 2)
+                        match = ario_fake_mpd_match (ario_fake_mpd_get_song (i), lowered + j, exact);
+                if (match && found++ >= start)
+                        func (i, data);
+        }
+        g_strfreev (lowered);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_ok (gchar **argv,
+                      GString *out)
+{
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_status (gchar **argv,
+                          GString *out)
+{
+        const gchar *states[] = { "stop", "play", "pause" };
+        gint pos = ario_fake_mpd_find_id (fake.current_id);
+        gint64 elapsed;
+
+        g_string_append_printf (out,
+                                "volume: %d\n"
+                                "repeat: %d\n"
+                                "random: %d\n"
+                                "single: %d\n"
+                                "consume: %d\n"
+                                "playlist: %u\n"
+                                "playlistlength: %u\n"
+                                "xfade: %d\n"
+                                "state: %s\n",
+                                fake.volume, fake.repeat, fake.random, fake.single, fake.consume,
+                                fake.version, fake.queue->len, fake.crossfade, states[fake.state]);
+
+        if (pos >= 0 && fake.state != STATE_STOP) {
+                elapsed = ario_fake_mpd_get_elapsed ();
+                g_string_append_printf (out,
+                                        "song: %d\n"
+                                        "songid: %d\n"
+                                        "time: %d:%d\n"
+                                        "elapsed: %d.%03d\n"
+                                        "bitrate: 192\n"
+                                        "audio: 44100:16:2\n",
+                                        pos, fake.current_id,
+                                        (gint) (elapsed / 1000),
+                                        ario_fake_mpd_get_song (g_array_index (fake.queue, FakeEntry, pos).song)->time,
+                                        (gint) (elapsed / 1000), (gint) (elapsed % 1000));
+        }
+
+        if (fake.updating)
+                g_string_append_printf (out, "updating_db: %u\n", fake.update_id);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_stats (gchar **argv,
+                         GString *out)
+{
+        g_string_append_printf (out,
+                                "artists: %d\n"
+                                "albums: %d\n"
+                                "songs: %u\n"
+                                "uptime: %d\n"
+                                "playtime: %d\n"
+                                "db_playtime: %ld\n"
+                                "db_update: 1577836800\n",
+                                fake.artists, fake.albums, fake.songs->len,
+                                (gint) ((g_get_monotonic_time () - fake.start_time) / G_USEC_PER_SEC),
+                                (gint) ((g_get_monotonic_time () - fake.start_time) / G_USEC_PER_SEC),
+                                fake.db_playtime);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_currentsong (gchar **argv,
+                               GString *out)
+{
+        gint pos = ario_fake_mpd_find_id (fake.current_id);
+
+        if (pos >= 0)
+                ario_fake_mpd_print_entry (out, pos);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_plchanges (gchar **argv,
+                             GString *out)
+{
+        gint version, i;
+        gint start = 0, end = fake.queue->len;
+        FakeEntry *entry;
+
+        if (!ario_fake_mpd_parse_int (argv[1], &version))
+                return ACK_ERROR_ARG;
+        if (argv[2] && !ario_fake_mpd_parse_range (argv[2], &start, &end))
+                return ACK_ERROR_ARG;
+
+        for (i = start; i < end; ++i) {
+                entry = &g_array_index (fake.queue, FakeEntry, i);
+                if ((gint) entry->version <= version)
+                        continue;
+                if (!strcmp (argv[0], "plchangesposid"))
+                        g_string_append_printf (out, "cpos: %d\nId: %u\n", i, entry->id);
+                else
+                        ario_fake_mpd_print_entry (out, i);
+        }
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_playlistinfo (gchar **argv,
+                                GString *out)
+{
+        gint start = 0, end = fake.queue->len, i;
+
+        if (argv[1] && !ario_fake_mpd_parse_range (argv[1], &start, &end))
+                return ACK_ERROR_ARG;
+
+        for (i = start; i < end; ++i)
+                ario_fake_mpd_print_entry (out, i);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_playlistid (gchar **argv,
+                              GString *out)
+{
+        gint id, pos;
+        guint i;
+
+        if (!argv[1]) {
+                for (i = 0; i < fake.queue->len; ++i)
+                        ario_fake_mpd_print_entry (out, i);
+                return ACK_OK;
+        }
+
+        if (!ario_fake_mpd_parse_int (argv[1], &id))
+                return ACK_ERROR_ARG;
+        pos = ario_fake_mpd_find_id (id);
+        if (pos < 0)
+                return ACK_ERROR_NO_EXIST;
+        ario_fake_mpd_print_entry (out, pos);
+
+        return ACK_OK;
+}
+
+/* lsinfo, listall and listallinfo: songs are sorted by path, so
+ * directories are printed when the path of the songs changes */
+static gint
+ario_fake_mpd_cmd_list_directory (gchar **argv,
+                                  GString *out)
+{
+        const gchar *path = argv[1] ? argv[1] : "";
+        gboolean recursive = strcmp (argv[0], "lsinfo") != 0;
+        gboolean info = strcmp (argv[0], "listall") != 0;
+        gsize path_len = strlen (path);
+        gchar *last_directory = g_strdup ("");
+        gchar *directory, *relative, *slash;
+        FakeSong *song;
+        guint i;
+
+        if (!strcmp (path, "/"))
+                path_len = 0;
+
+        for (i = 0; i < fake.songs->len; ++i) {
+                song = ario_fake_mpd_get_song (i);
+                if (path_len && (strncmp (song->file, path, path_len) || song->file[path_len] != '/'))
+                        continue;
+                relative = song->file + (path_len ? path_len + 1 : 0);
+
+                slash = strchr (relative, '/');
+                if (!slash) {
+                        if (info)
+                                ario_fake_mpd_print_song (out, song);
+                        else
+                                g_string_append_printf (out, "file: %s\n", song->file);
+                        continue;
+                }
+
+                if (!recursive) {
+                        /* Direct sub-directory only */
+                        directory = g_strndup (song->file, slash - song->file);
+                        if (strcmp (directory, last_directory))
+                                g_string_append_printf (out, "directory: %s\n", directory);
+                        g_free (last_directory);
+                        last_directory = directory;
+                        continue;
+                }
+
+                /* Every directory between path and the song */
+                for (; slash; slash = strchr (slash + 1, '/')) {
+                        directory = g_strndup (song->file, slash - song->file);
+                        if (!g_str_has_prefix (last_directory, directory)
+                            || (last_directory[strlen (directory)] != '/' && last_directory[strlen (directory)] != '\0'))
+                                g_string_append_printf (out, "directory: %s\n", directory);
+                        g_free (directory);
+                }
+                g_free (last_directory);
+                last_directory = g_strdup (song->directory);
+
+                if (info)
+                        ario_fake_mpd_print_song (out, song);
+                else
+                        g_string_append_printf (out, "file: %s\n", song->file);
+        }
+        g_free (last_directory);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_compare_tuples (gconstpointer a,
+                              gconstpointer b)
+{
+        gchar **tuple_a = *(gchar ***) a;
+        gchar **tuple_b = *(gchar ***) b;
+        gint i, ret;
+
+        for (i = 0; tuple_a[i]; ++i) {
+                ret = strcmp (tuple_a[i], tuple_b[i]);
+                if (ret)
+                        return ret;
+        }
+        return 0;
+}
+
+typedef struct
+{
+        gchar **tags;
+        GHashTable *seen;
+        GPtrArray *tuples;
+} FakeListData;
+
+static void
+ario_fake_mpd_list_foreach (guint index,
+                            gpointer user_data)
+{
+        FakeListData *data = user_data;
+        FakeSong *song = ario_fake_mpd_get_song (index);
+        GString *key = g_string_new (NULL);
+        gchar **tuple;
+        const gchar *value;
+        guint i, n = g_strv_length (data->tags);
+
+        tuple = g_new0 (gchar *, n + 1);
+        for (i = 0; i < n; ++i) {
+                value = ario_fake_mpd_song_tag (song, data->tags[i]);
+                tuple[i] = (gchar *) (value ? value : "");
+                g_string_append (key, tuple[i]);
+                g_string_append_c (key, '\n');
+        }
+
+        if (g_hash_table_contains (data->seen, key->str)) {
+                g_free (tuple);
+                g_string_free (key, TRUE);
+                return;
+        }
+        g_hash_table_add (data->seen, g_string_free (key, FALSE));
+        g_ptr_array_add (data->tuples, tuple);
+}
+
+static gint
+ario_fake_mpd_cmd_list (gchar **argv,
+                        GString *out)
+{
+        FakeListData data;
+        GPtrArray *filters = g_ptr_array_new ();
+        GPtrArray *tags = g_ptr_array_new ();
+        gchar **tuple, **previous = NULL;
+        gchar **all_filters;
+        gboolean changed;
+        guint i, j;
+        gint ret;
+
+        /* Groups first, then the listed tag */
+        for (i = 2; argv[i]; ++i) {
+                if (!g_ascii_strcasecmp (argv[i], "group") && argv[i + 1]) {
+                        g_ptr_array_add (tags, argv[++i]);
+                } else if (argv[i + 1]) {
+                        g_ptr_array_add (filters, argv[i]);
+                        g_ptr_array_add (filters, argv[++i]);
+                } else {
+                        /* 'list album ARTIST' of old protocol versions */
+                        g_ptr_array_add (filters, "artist");
+                        g_ptr_array_add (filters, argv[i]);
+                }
+        }
+        g_ptr_array_add (tags, argv[1]);
+        g_ptr_array_add (tags, NULL);
+        g_ptr_array_add (filters, NULL);
+
+        data.tags = (gchar **) tags->pdata;
+        data.seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        data.tuples = g_ptr_array_new_with_free_func (g_free);
+
+        all_filters = (gchar **) filters->pdata;
+        if (!all_filters[0]) {
+                for (i = 0; i < fake.songs->len; ++i)
+                        ario_fake_mpd_list_foreach (i, &data);
+                ret = ACK_OK;
+        } else {
+                ret = ario_fake_mpd_search (all_filters, TRUE, ario_fake_mpd_list_foreach, &data);
+        }
+
+        g_ptr_array_sort (data.tuples, ario_fake_mpd_compare_tuples);
+
+        /* Group values are only printed when they change */
+        for (i = 0; i < data.tuples->len; ++i) {
+                tuple = g_ptr_array_index (data.tuples, i);
+                changed = previous == NULL;
+                for (j = 0; data.tags[j]; ++j) {
+                        changed = changed || strcmp (tuple[j], previous[j]);
+                        if (changed || !data.tags[j + 1])
+                                g_string_append_printf (out, "%s: %s\n", ario_fake_mpd_tag_name (data.tags[j]), tuple[j]);
+                }
+                previous = tuple;
+        }
+
+        g_ptr_array_free (data.tuples, TRUE);
+        g_hash_table_destroy (data.seen);
+        g_ptr_array_free (filters, TRUE);
+        g_ptr_array_free (tags, TRUE);
+
+        return ret;
+}
+
+static void
+ario_fake_mpd_print_foreach (guint index,
+                             gpointer out)
+{
+        ario_fake_mpd_print_song (out, ario_fake_mpd_get_song (index));
+}
+
+static void
+ario_fake_mpd_add_foreach (guint index,
+                           gpointer data)
+{
+        ario_fake_mpd_queue_insert (index, -1);
+}
+
+static gint
+ario_fake_mpd_cmd_search (gchar **argv,
+                          GString *out)
+{
+        gboolean exact = g_str_has_prefix (argv[0], "find");
+
+        if (g_str_has_suffix (argv[0], "add"))
+                return ario_fake_mpd_search (argv + 1, exact, ario_fake_mpd_add_foreach, NULL);
+        return ario_fake_mpd_search (argv + 1, exact, ario_fake_mpd_print_foreach, out);
+}
+
+static gint
+ario_fake_mpd_cmd_add (gchar **argv,
+                       GString *out)
+{
+        guint index, i;
+        gint pos = -1;
+        gsize len;
+
+        index = GPOINTER_TO_UINT (g_hash_table_lookup (fake.files, argv[1]));
+        if (!strcmp (argv[0], "addid")) {
+                if (!index)
+                        return ACK_ERROR_NO_EXIST;
+                if (argv[2] && !ario_fake_mpd_parse_int (argv[2], &pos))
+                        return ACK_ERROR_ARG;
+                g_string_append_printf (out, "Id: %u\n", ario_fake_mpd_queue_insert (index - 1, pos));
+                return ACK_OK;
+        }
+
+        if (index) {
+                ario_fake_mpd_queue_insert (index - 1, -1);
+                return ACK_OK;
+        }
+
+        /* Add a directory */
+        len = strlen (argv[1]);
+        index = fake.queue->len;
+        for (i = 0; i < fake.songs->len; ++i) {
+                if (!len
+                    || (g_str_has_prefix (ario_fake_mpd_get_song (i)->file, argv[1])
+                        && ario_fake_mpd_get_song (i)->file[len] == '/'))
+                        ario_fake_mpd_queue_insert (i, -1);
+        }
+
+        return index == fake.queue->len ? ACK_ERROR_NO_EXIST : ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_delete (gchar **argv,
+                          GString *out)
+{
+        gint start, end;
+
+        if (!strcmp (argv[0], "deleteid")) {
+                if (!ario_fake_mpd_parse_int (argv[1], &start))
+                        return ACK_ERROR_ARG;
+                start = ario_fake_mpd_find_id (start);
+                if (start < 0)
+                        return ACK_ERROR_NO_EXIST;
+                end = start + 1;
+        } else if (!ario_fake_mpd_parse_range (argv[1], &start, &end)) {
+                return ACK_ERROR_ARG;
+        }
+
+        if (start < end)
+                ario_fake_mpd_queue_delete (start, end);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_move (gchar **argv,
+                        GString *out)
+{
+        FakeEntry *entries;
+        gint start, end, to, n;
+
+        if (!strcmp (argv[0], "moveid")) {
+                if (!ario_fake_mpd_parse_int (argv[1], &start))
+                        return ACK_ERROR_ARG;
+                start = ario_fake_mpd_find_id (start);
+                if (start < 0)
+                        return ACK_ERROR_NO_EXIST;
+                end = start + 1;
+        } else if (!ario_fake_mpd_parse_range (argv[1], &start, &end)) {
+                return ACK_ERROR_ARG;
+        }
+
+        n = end - start;
+        if (!ario_fake_mpd_parse_int (argv[2], &to)
+            || to < 0 || to + n > (gint) fake.queue->len)
+                return ACK_ERROR_ARG;
+
+        entries = g_new (FakeEntry, n);
+        memcpy (entries, &g_array_index (fake.queue, FakeEntry, start), n * sizeof (FakeEntry));
+        g_array_remove_range (fake.queue, start, n);
+        g_array_insert_vals (fake.queue, to, entries, n);
+        g_free (entries);
+        ario_fake_mpd_queue_changed (MIN (start, to), MAX (end, to + n));
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_clear (gchar **argv,
+                         GString *out)
+{
+        ario_fake_mpd_queue_delete (0, fake.queue->len);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_shuffle (gchar **argv,
+                           GString *out)
+{
+        FakeEntry tmp;
+        guint i, j;
+
+        for (i = fake.queue->len; i > 1; --i) {
+                j = g_random_int_range (0, i);
+                tmp = g_array_index (fake.queue, FakeEntry, i - 1);
+                g_array_index (fake.queue, FakeEntry, i - 1) = g_array_index (fake.queue, FakeEntry, j);
+                g_array_index (fake.queue, FakeEntry, j) = tmp;
+        }
+        ario_fake_mpd_queue_changed (0, fake.queue->len);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_play (gchar **argv,
+                        GString *out)
+{
+        gint pos = -1;
+
+        if (argv[1] && !ario_fake_mpd_parse_int (argv[1], &pos))
+                return ACK_ERROR_ARG;
+
+        if (!strcmp (argv[0], "playid") && pos >= 0) {
+                pos = ario_fake_mpd_find_id (pos);
+                if (pos < 0)
+                        return ACK_ERROR_NO_EXIST;
+        } else if (pos >= (gint) fake.queue->len) {
+                return ACK_ERROR_ARG;
+        }
+
+        /* Resume or play the first song */
+        if (pos < 0) {
+                if (fake.state == STATE_PAUSE) {
+                        fake.state = STATE_PLAY;
+                        fake.started = g_get_monotonic_time ();
+                        ario_fake_mpd_emit (IDLE_PLAYER);
+                        return ACK_OK;
+                }
+                pos = MAX (ario_fake_mpd_find_id (fake.current_id), 0);
+        }
+        ario_fake_mpd_play_pos (pos);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_pause (gchar **argv,
+                         GString *out)
+{
+        gboolean pause = fake.state == STATE_PLAY;
+
+        if (argv[1] && !ario_fake_mpd_parse_bool (argv[1], &pause))
+                return ACK_ERROR_ARG;
+
+        if (pause && fake.state == STATE_PLAY) {
+                fake.elapsed = ario_fake_mpd_get_elapsed ();
+                fake.state = STATE_PAUSE;
+        } else if (!pause && fake.state == STATE_PAUSE) {
+                fake.started = g_get_monotonic_time ();
+                fake.state = STATE_PLAY;
+        }
+        ario_fake_mpd_emit (IDLE_PLAYER);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_stop (gchar **argv,
+                        GString *out)
+{
+        fake.state = STATE_STOP;
+        fake.elapsed = 0;
+        ario_fake_mpd_emit (IDLE_PLAYER);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_next (gchar **argv,
+                        GString *out)
+{
+        gint pos = ario_fake_mpd_find_id (fake.current_id);
+
+        if (fake.state == STATE_STOP)
+                return ACK_OK;
+
+        if (!strcmp (argv[0], "previous"))
+                ario_fake_mpd_play_pos (MAX (pos - 1, 0));
+        else
+                ario_fake_mpd_next ();
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_seek (gchar **argv,
+                        GString *out)
+{
+        gint pos, time;
+        gdouble value;
+
+        if (!strcmp (argv[0], "seekcur")) {
+                value = g_ascii_strtod (argv[1], NULL);
+                if (fake.current_id < 0)
+                        return ACK_ERROR_NO_EXIST;
+                ario_fake_mpd_seek (value);
+                return ACK_OK;
+        }
+
+        if (!ario_fake_mpd_parse_int (argv[1], &pos))
+                return ACK_ERROR_ARG;
+        if (!strcmp (argv[0], "seekid"))
+                pos = ario_fake_mpd_find_id (pos);
+        if (pos < 0 || pos >= (gint) fake.queue->len)
+                return ACK_ERROR_NO_EXIST;
+
+        time = g_ascii_strtod (argv[2], NULL);
+        if (g_array_index (fake.queue, FakeEntry, pos).id != (guint) fake.current_id)
+                ario_fake_mpd_play_pos (pos);
+        ario_fake_mpd_seek (time);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_setvol (gchar **argv,
+                          GString *out)
+{
+        gint volume;
+
+        if (!ario_fake_mpd_parse_int (argv[1], &volume)
+            || volume < 0 || volume > 100)
+                return ACK_ERROR_ARG;
+
+        fake.volume = volume;
+        ario_fake_mpd_emit (IDLE_MIXER);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_option (gchar **argv,
+                          GString *out)
+{
+        gboolean *option;
+        gboolean value;
+
+        if (!strcmp (argv[0], "crossfade")) {
+                if (!ario_fake_mpd_parse_int (argv[1], &fake.crossfade))
+                        return ACK_ERROR_ARG;
+                ario_fake_mpd_emit (IDLE_OPTIONS);
+                return ACK_OK;
+        }
+
+        if (!strcmp (argv[0], "random"))
+                option = &fake.random;
+        else if (!strcmp (argv[0], "repeat"))
+                option = &fake.repeat;
+        else if (!strcmp (argv[0], "consume"))
+                option = &fake.consume;
+        else
+                option = &fake.single;
+
+        if (!ario_fake_mpd_parse_bool (argv[1], &value))
+                return ACK_ERROR_ARG;
+        *option = value;
+        ario_fake_mpd_emit (IDLE_OPTIONS);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_outputs (gchar **argv,
+                           GString *out)
+{
+        g_string_append_printf (out,
+                                "outputid: 0\n"
+                                "outputname: Fake output\n"
+                                "outputenabled: %d\n",
+                                fake.output_enabled);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_enableoutput (gchar **argv,
+                                GString *out)
+{
+        if (strcmp (argv[1], "0"))
+                return ACK_ERROR_NO_EXIST;
+
+        fake.output_enabled = !strcmp (argv[0], "enableoutput");
+        ario_fake_mpd_emit (IDLE_OUTPUT);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_update (gchar **argv,
+                          GString *out)
+{
+        /* The synthetic library never changes but clients are notified
+         * as if it had been read again */
+        if (!fake.updating) {
+                fake.updating = TRUE;
+                ++fake.update_id;
+                ario_fake_mpd_emit (IDLE_UPDATE);
+                g_timeout_add (200, ario_fake_mpd_update_done_cb, NULL);
+        }
+        g_string_append_printf (out, "updating_db: %u\n", fake.update_id);
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_tagtypes (gchar **argv,
+                            GString *out)
+{
+        /* 'tagtypes clear' and others are accepted and ignored */
+        if (!argv[1])
+                g_string_append (out,
+                                 "tagtype: Artist\n"
+                                 "tagtype: AlbumArtist\n"
+                                 "tagtype: Album\n"
+                                 "tagtype: Title\n"
+                                 "tagtype: Track\n"
+                                 "tagtype: Date\n"
+                                 "tagtype: Genre\n");
+
+        return ACK_OK;
+}
+
+static gint
+ario_fake_mpd_cmd_commands (gchar **argv,
+                            GString *out);
+
+static const FakeCommand commands[] = {
+        { "add", ario_fake_mpd_cmd_add, 1, 1 },
+        { "addid", ario_fake_mpd_cmd_add, 1, 2 },
+        { "clear", ario_fake_mpd_cmd_clear, 0, 0 },
+        { "commands", ario_fake_mpd_cmd_commands, 0, 0 },
+        { "consume", ario_fake_mpd_cmd_option, 1, 1 },
+        { "crossfade", ario_fake_mpd_cmd_option, 1, 1 },
+        { "currentsong", ario_fake_mpd_cmd_currentsong, 0, 0 },
+        { "delete", ario_fake_mpd_cmd_delete, 1, 1 },
+        { "deleteid", ario_fake_mpd_cmd_delete, 1, 1 },
+        { "disableoutput", ario_fake_mpd_cmd_enableoutput, 1, 1 },
+        { "enableoutput", ario_fake_mpd_cmd_enableoutput, 1, 1 },
+        { "find", ario_fake_mpd_cmd_search, 1, -1 },
+        { "findadd", ario_fake_mpd_cmd_search, 1, -1 },
+        { "list", ario_fake_mpd_cmd_list, 1, -1 },
+        { "listall", ario_fake_mpd_cmd_list_directory, 0, 1 },
+        { "listallinfo", ario_fake_mpd_cmd_list_directory, 0, 1 },
+        { "listplaylists", ario_fake_mpd_cmd_ok, 0, 0 },
+        { "lsinfo", ario_fake_mpd_cmd_list_directory, 0, 1 },
+        { "move", ario_fake_mpd_cmd_move, 2, 2 },
+        { "moveid", ario_fake_mpd_cmd_move, 2, 2 },
+        { "next", ario_fake_mpd_cmd_next, 0, 0 },
+        { "notcommands", ario_fake_mpd_cmd_ok, 0, 0 },
+        { "outputs", ario_fake_mpd_cmd_outputs, 0, 0 },
+        { "password", ario_fake_mpd_cmd_ok, 1, 1 },
+        { "pause", ario_fake_mpd_cmd_pause, 0, 1 },
+        { "ping", ario_fake_mpd_cmd_ok, 0, 0 },
+        { "play", ario_fake_mpd_cmd_play, 0, 1 },
+        { "playid", ario_fake_mpd_cmd_play, 0, 1 },
+        { "playlistid", ario_fake_mpd_cmd_playlistid, 0, 1 },
+        { "playlistinfo", ario_fake_mpd_cmd_playlistinfo, 0, 1 },
+        { "plchanges", ario_fake_mpd_cmd_plchanges, 1, 2 },
+        { "plchangesposid", ario_fake_mpd_cmd_plchanges, 1, 2 },
+        { "previous", ario_fake_mpd_cmd_next, 0, 0 },
+        { "random", ario_fake_mpd_cmd_option, 1, 1 },
+        { "repeat", ario_fake_mpd_cmd_option, 1, 1 },
+        { "search", ario_fake_mpd_cmd_search, 1, -1 },
+        { "searchadd", ario_fake_mpd_cmd_search, 1, -1 },
+        { "seek", ario_fake_mpd_cmd_seek, 2, 2 },
+        { "seekcur", ario_fake_mpd_cmd_seek, 1, 1 },
+        { "seekid", ario_fake_mpd_cmd_seek, 2, 2 },
+        { "setvol", ario_fake_mpd_cmd_setvol, 1, 1 },
+        { "shuffle", ario_fake_mpd_cmd_shuffle, 0, 1 },
+        { "single", ario_fake_mpd_cmd_option, 1, 1 },
+        { "stats", ario_fake_mpd_cmd_stats, 0, 0 },
+        { "status", ario_fake_mpd_cmd_status, 0, 0 },
+        { "stop", ario_fake_mpd_cmd_stop, 0, 0 },
+        { "tagtypes", ario_fake_mpd_cmd_tagtypes, 0, -1 },
+        { "update", ario_fake_mpd_cmd_update, 0, 1 },
+        { NULL, NULL, 0, 0 }
+};
+
+static gint
+ario_fake_mpd_cmd_commands (gchar **argv,
+                            GString *out)
+{
+        const FakeCommand *command;
+
+        for (command = commands; command->name; ++command)
+                g_string_append_printf (out, "command: %s\n", command->name);
+        g_string_append (out,
+                         "command: close\n"
+                         "command: command_list_begin\n"
+                         "command: command_list_ok_begin\n"
+                         "command: idle\n"
+                         "command: noidle\n");
+
+        return ACK_OK;
+}
+
+static const FakeCommand *
+ario_fake_mpd_find_command (const gchar *name)
+{
+        const FakeCommand *command;
+
+        for (command = commands; command->name; ++command) {
+                if (!strcmp (command->name, name))
+                        return command;
+        }
+        return NULL;
+}
+
+/* Split a command line in arguments, unquoting quoted ones. Returns NULL
+ * on syntax error */
+static gchar **
+ario_fake_mpd_split (const gchar *line)
+{
+        GPtrArray *argv = g_ptr_array_new ();
+        GString *arg;
+        const gchar *tmp = line;
+
+        while (*tmp) {
+                if (*tmp == ' ' || *tmp == '\t') {
+                        ++tmp;
+                        continue;
+                }
+
+                arg = g_string_new (NULL);
+                if (*tmp == '"') {
+                        for (++tmp; *tmp && *tmp != '"'; ++tmp) {
+                                if (*tmp == '\\' && tmp[1])
+                                        ++tmp;
+                                g_string_append_c (arg, *tmp);
+                        }
+                        if (*tmp != '"') {
+                                g_string_free (arg, TRUE);
+                                g_ptr_array_add (argv, NULL);
+                                g_strfreev ((gchar **) g_ptr_array_free (argv, FALSE));
+                                return NULL;
+                        }
+                        ++tmp;
+                } else {
+                        for (; *tmp && *tmp != ' ' && *tmp != '\t'; ++tmp)
+                                g_string_append_c (arg, *tmp);
+                }
+                g_ptr_array_add (argv, g_string_free (arg, FALSE));
+        }
+        g_ptr_array_add (argv, NULL);
+
+        return (gchar **) g_ptr_array_free (argv, FALSE);
+}
+
+/* Execute one command with the state locked */
+static gint
+ario_fake_mpd_execute (gchar **argv,
+                       GString *out)
+{
+        const FakeCommand *command;
+        gint argc = g_strv_length (argv) - 1;
+
+        command = ario_fake_mpd_find_command (argv[0]);
+        if (!command)
+                return ACK_ERROR_UNKNOWN;
+        if (argc < command->min_args
+            || (command->max_args >= 0 && argc > command->max_args))
+                return ACK_ERROR_ARG;
+
+        return command->func (argv, out);
+}
+
+static void
+ario_fake_mpd_ack (GString *out,
+                   const gint error,
+                   const gint index,
+                   const gchar *command)
+{
+        const gchar *message;
+
+        switch (error) {
+        case ACK_ERROR_UNKNOWN:
+                message = "unknown command";
+                break;
+        case ACK_ERROR_NO_EXIST:
+                message = "No such song";
+                break;
+        default:
+                message = "wrong arguments";
+                break;
+        }
+
+        g_string_append_printf (out, "ACK [%d@%d] {%s} %s\n",
+                                error, index, command ? command : "", message);
+}
+
+/* Execute a command list (or a single command) and append its response */
+static void
+ario_fake_mpd_execute_list (GPtrArray *lines,
+                            const gboolean list_ok,
+                            GString *out)
+{
+        gchar **argv;
+        gint error = ACK_OK;
+        guint i;
+
+        g_mutex_lock (&fake.mutex);
+        for (i = 0; i < lines->len && error == ACK_OK; ++i) {
+                argv = ario_fake_mpd_split (g_ptr_array_index (lines, i));
+                if (!argv || !argv[0]) {
+                        error = ACK_ERROR_ARG;
+                        ario_fake_mpd_ack (out, error, i, NULL);
+                } else {
+                        error = ario_fake_mpd_execute (argv, out);
+                        if (error != ACK_OK)
+                                ario_fake_mpd_ack (out, error, i, argv[0]);
+                        else if (list_ok)
+                                g_string_append (out, "list_OK\n");
+                }
+                g_strfreev (argv);
+        }
+        g_mutex_unlock (&fake.mutex);
+
+        if (error == ACK_OK)
+                g_string_append (out, "OK\n");
+}
+
+/* Send a response, with the latency and bandwidth of the options */
+static gboolean
+ario_fake_mpd_write (FakeClient *client,
+                     GString *out)
+{
+        gsize written = 0, chunk;
+
+        if (latency > 0)
+                g_usleep (latency * 1000);
+
+        /* Chunks of 1/10 second of bandwidth */
+        chunk = bandwidth > 0 ? (gsize) MAX (bandwidth / 10, 1) : out->len;
+        while (written < out->len) {
+                chunk = MIN (chunk, out->len - written);
+                if (!g_output_stream_write_all (client->output, out->str + written, chunk,
+                                                NULL, NULL, NULL))
+                        return FALSE;
+                written += chunk;
+                if (bandwidth > 0 && written < out->len)
+                        g_usleep ((gulong) chunk * G_USEC_PER_SEC / bandwidth);
+        }
+
+        return TRUE;
+}
+
+/* Wait for an event of mask or for noidle. Returns FALSE if the
+ * connection is closed */
+static gboolean
+ario_fake_mpd_idle (FakeClient *client,
+                    const guint mask,
+                    GString *out)
+{
+        GSocket *socket = g_socket_connection_get_socket (client->connection);
+        guint events = 0;
+        gchar *line;
+        gint i;
+
+        for (;;) {
+                g_mutex_lock (&fake.mutex);
+                events = client->pending_idle & mask;
+                client->pending_idle &= ~mask;
+                g_mutex_unlock (&fake.mutex);
+                if (events)
+                        break;
+
+                if (g_buffered_input_stream_get_available (G_BUFFERED_INPUT_STREAM (client->input)) == 0
+                    && !g_socket_condition_timed_wait (socket, G_IO_IN, 50000, NULL, NULL))
+                        continue;
+
+                line = g_data_input_stream_read_line (client->input, NULL, NULL, NULL);
+                if (!line)
+                        return FALSE;
+                g_strchomp (line);
+                if (strcmp (line, "noidle")) {
+                        g_free (line);
+                        return FALSE;
+                }
+                g_free (line);
+                break;
+        }
+
+        for (i = 0; idle_names[i]; ++i) {
+                if (events & (1 << i))
+                        g_string_append_printf (out, "changed: %s\n", idle_names[i]);
+        }
+        g_string_append (out, "OK\n");
+
+        return TRUE;
+}
+
+static guint
+ario_fake_mpd_parse_idle (gchar **argv)
+{
+        guint mask = 0;
+        gint i, j;
+
+        if (!argv[1])
+                return ~0;
+
+        for (i = 1; argv[i]; ++i) {
+                for (j = 0; idle_names[j]; ++j) {
+                        if (!strcmp (argv[i], idle_names[j]))
+                                mask |= 1 << j;
+                }
+        }
+        return mask;
+}
+
+static gboolean
+ario_fake_mpd_client_run (GThreadedSocketService *service,
+                          GSocketConnection *connection,
+                          GObject *source_object,
+                          gpointer data)
+{
+        FakeClient client;
+        GPtrArray *lines = g_ptr_array_new_with_free_func (g_free);
+        gboolean in_list = FALSE, list_ok = FALSE;
+        GString *out = g_string_new ("OK MPD " FAKE_MPD_PROTOCOL_VERSION "\n");
+        gchar *line;
+        gchar **argv;
+        gboolean ret;
+
+        client.connection = connection;
+        client.input = g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+        g_data_input_stream_set_newline_type (client.input, G_DATA_STREAM_NEWLINE_TYPE_LF);
+        client.output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+        client.pending_idle = 0;
+
+        g_mutex_lock (&fake.mutex);
+        fake.clients = g_slist_prepend (fake.clients, &client);
+        g_mutex_unlock (&fake.mutex);
+
+        ret = ario_fake_mpd_write (&client, out);
+        while (ret) {
+                line = g_data_input_stream_read_line (client.input, NULL, NULL, NULL);
+                if (!line)
+                        break;
+                g_strchomp (line);
+                g_string_truncate (out, 0);
+
+                if (in_list) {
+                        if (strcmp (line, "command_list_end")) {
+                                g_ptr_array_add (lines, line);
+                                continue;
+                        }
+                        g_free (line);
+                        in_list = FALSE;
+                        ario_fake_mpd_execute_list (lines, list_ok, out);
+                        g_ptr_array_set_size (lines, 0);
+                        ret = ario_fake_mpd_write (&client, out);
+                        continue;
+                }
+
+                if (!strcmp (line, "command_list_begin")
+                    || !strcmp (line, "command_list_ok_begin")) {
+                        list_ok = !strcmp (line, "command_list_ok_begin");
+                        in_list = TRUE;
+                        g_free (line);
+                        continue;
+                }
+
+                argv = ario_fake_mpd_split (line);
+                if (argv && argv[0] && !strcmp (argv[0], "close")) {
+                        g_strfreev (argv);
+                        g_free (line);
+                        break;
+                } else if (argv && argv[0] && !strcmp (argv[0], "idle")) {
+                        ret = ario_fake_mpd_idle (&client, ario_fake_mpd_parse_idle (argv), out)
+                                && ario_fake_mpd_write (&client, out);
+                } else if (argv && argv[0] && !strcmp (argv[0], "noidle")) {
+                        /* noidle outside of idle is ignored */
+                } else {
+                        g_ptr_array_add (lines, line);
+                        line = NULL;
+                        ario_fake_mpd_execute_list (lines, FALSE, out);
+                        g_ptr_array_set_size (lines, 0);
+                        ret = ario_fake_mpd_write (&client, out);
+                }
+                g_strfreev (argv);
+                g_free (line);
+        }
+
+        g_mutex_lock (&fake.mutex);
+        fake.clients = g_slist_remove (fake.clients, &client);
+        g_mutex_unlock (&fake.mutex);
+
+        g_object_unref (client.input);
+        g_ptr_array_free (lines, TRUE);
+        g_string_free (out, TRUE);
+
+        return TRUE;
+}
+
+/* The script is a list of commands of the protocol executed as if they
+ * came from a client, and of 'sleep MILLISECONDS' lines */
+static gpointer
+ario_fake_mpd_script_thread (gpointer data)
+{
+        gchar **script_lines = data;
+        GPtrArray *lines = g_ptr_array_new ();
+        GString *out = g_string_new (NULL);
+        gchar *line;
+        gint i, ms;
+
+        do {
+                for (i = 0; script_lines[i]; ++i) {
+                        line = g_strstrip (script_lines[i]);
+                        if (!*line || *line == '#')
+                                continue;
+
+                        if (g_str_has_prefix (line, "sleep ")
+                            && ario_fake_mpd_parse_int (line + strlen ("sleep "), &ms)) {
+                                g_usleep ((gulong) ms * 1000);
+                                continue;
+                        }
+
+                        g_ptr_array_add (lines, line);
+                        g_string_truncate (out, 0);
+                        ario_fake_mpd_execute_list (lines, FALSE, out);
+                        g_ptr_array_set_size (lines, 0);
+                        if (strstr (out->str, "ACK ["))
+                                g_printerr ("script: %s: %s", line, out->str);
+                }
+        } while (loop_script);
+
+        g_ptr_array_free (lines, TRUE);
+        g_string_free (out, TRUE);
+        g_strfreev (script_lines);
+
+        return NULL;
+}
+
+int
+main (int argc, char *argv[])
+{
+        GOptionContext *context;
+        GSocketService *service;
+        GMainLoop *loop;
+        GError *error = NULL;
+        gchar *contents;
+
+        const GOptionEntry options []  = {
+                { "port", 'p', 0, G_OPTION_ARG_INT, &port, "Port to listen on, 0 for any free port (default: 6600)", "PORT" },
+                { "artists", 0, 0, G_OPTION_ARG_INT, &nb_artists, "Number of artists of the library (default: 100)", "N" },
+                { "albums", 0, 0, G_OPTION_ARG_INT, &nb_albums, "Number of albums of each artist (default: 5)", "N" },
+                { "songs", 0, 0, G_OPTION_ARG_INT, &nb_songs, "Number of songs of each album (default: 12)", "N" },
+                { "latency", 'l', 0, G_OPTION_ARG_INT, &latency, "Delay before each response", "MILLISECONDS" },
+                { "bandwidth", 'b', 0, G_OPTION_ARG_INT, &bandwidth, "Limit of the output of each connection", "BYTES_PER_SECOND" },
+                { "script", 's', 0, G_OPTION_ARG_FILENAME, &script, "Commands to execute after start", "FILE" },
+                { "loop", 0, 0, G_OPTION_ARG_NONE, &loop_script, "Execute the script forever", NULL },
+                { NULL, 0, 0, 0, NULL, NULL, NULL }
+        };
+
+        context = g_option_context_new (NULL);
+        g_option_context_set_summary (context, "Fake MPD server with a synthetic library, for the development of Ario");
+        g_option_context_add_main_entries (context, options, NULL);
+        if (!g_option_context_parse (context, &argc, &argv, &error)) {
+                g_printerr ("option parsing failed: %s\n", error->message);
+                return 1;
+        }
+        g_option_context_free (context);
+
+        g_mutex_init (&fake.mutex);
+        fake.queue = g_array_new (FALSE, FALSE, sizeof (FakeEntry));
+        fake.version = 1;
+        fake.current_id = -1;
+        fake.volume = 50;
+        fake.output_enabled = TRUE;
+        fake.start_time = g_get_monotonic_time ();
+        ario_fake_mpd_generate_library ();
+
+        /* Port 0 picks a free port, which is printed below */
+        service = g_threaded_socket_service_new (-1);
+        if (port == 0)
+                port = g_socket_listener_add_any_inet_port (G_SOCKET_LISTENER (service), NULL, &error);
+        else if (!g_socket_listener_add_inet_port (G_SOCKET_LISTENER (service), port, NULL, &error))
+                port = 0;
+        if (!port) {
+                g_printerr ("cannot listen: %s\n", error->message);
+                return 1;
+        }
+        g_signal_connect (service, "run", G_CALLBACK (ario_fake_mpd_client_run), NULL);
+        g_socket_service_start (service);
+
+        if (script) {
+                if (!g_file_get_contents (script, &contents, NULL, &error)) {
+                        g_printerr ("cannot read script: %s\n", error->message);
+                        return 1;
+                }
+                g_thread_unref (g_thread_new ("script", ario_fake_mpd_script_thread,
+                                              g_strsplit (contents, "\n", -1)));
+                g_free (contents);
+        }
+
+        g_timeout_add (500, ario_fake_mpd_player_cb, NULL);
+
+        g_print ("Listening on port %d with %u songs\n", port, fake.songs->len);
+        fflush (stdout);
+        loop = g_main_loop_new (NULL, FALSE);
+        g_main_loop_run (loop);
+
+        return 0;
+}
@@ -32,6 +32,7 @@
 #include "ario-util.h"
 #include "ario-debug.h"
 #include "ario-profiles.h"
+#include "covers/ario-cover-pack.h"
 
 #ifdef WIN32
 #include <windows.h>
@@ -58,9 +59,12 @@ main (int argc, char *argv[])
         /* Parse options */
         GOptionContext *context;
         gchar *profile = NULL;
+        gboolean pack_covers = FALSE;
+        gint nb_covers;
         const GOptionEntry options []  = {
                 { "minimized", 'm', 0, G_OPTION_ARG_NONE, &minimized, N_("Start minimized window"), NULL },
                 { "profile", 'p', 0, G_OPTION_ARG_STRING, &profile, N_("Start with specific profile"), NULL },
+                { "pack-covers", 0, 0, G_OPTION_ARG_NONE, &pack_covers, N_("Move cover files in a single cover pack and exit"), NULL },
                 { NULL, 0, 0, 0, NULL, NULL, NULL }
         };
 
@@ -95,6 +99,19 @@ main (int argc, char *argv[])
         textdomain (GETTEXT_PACKAGE);
 #endif
 
+        /* Import covers in the cover pack and exit */
+        if (pack_covers) {
+                nb_covers = ario_cover_pack_import (&error);
+                if (nb_covers < 0) {
+                        g_printerr ("%s\n", error->message);
+                        g_error_free (error);
+                        exit (1);
+                }
+                g_print (_("%d covers in the cover pack\n"), nb_covers);
+                ario_conf_shutdown ();
+                return 0;
+        }
+
         /* Register Ario icons */
         ario_util_init_icons ();
 
@@ -0,0 +1,168 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Benchmark of the implementations of ario_util_strstr_folded on a
+ * synthetic playlist: every needle is searched in every row, like the
+ * playlist filter does, with the scalar, SSE2 and AVX2 implementations.
+ * All of them must find the same matches. It is not built by default:
+ * use 'make ario-search-bench' in src/.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include "ario-util.h"
+
+#define NB_ROWS 100000
+#define NB_ROUNDS 5
+
+static const gchar *words[] = {
+        "love", "night", "blue", "Dreams", "ÉTÉ", "Straße", "café", "ÅNGSTRÖM",
+        "Über", "rock", "Jazz", "Live", "remastered", "version", "mix", "Ñandú",
+        "город", "ΣΟΦΙΑ", "東京", "the", "of", "and", "(feat.", "-", "/", "01", "1999"
+};
+
+static const gchar *needles[] = {
+        "lo", "é", "the", "night", "strasse", "été", "город", "σοφια", "東京",
+        "blue dreams", "remastered version", "café über", "1999 - live", "zz",
+        "not in any row", "x"
+};
+
+typedef struct
+{
+        const gchar *name;
+        ArioUtilSearchImpl impl;
+} ArioSearchBenchImpl;
+
+static const ArioSearchBenchImpl impls[] = {
+        { "scalar", ARIO_UTIL_SEARCH_SCALAR },
+        { "sse2", ARIO_UTIL_SEARCH_SSE2 },
+        { "avx2", ARIO_UTIL_SEARCH_AVX2 }
+};
+
+/* Rows of random length made of random words, casefolded like those of
+ * the playlist model */
+static GPtrArray *
+ario_search_bench_make_corpus (void)
+{
+        GPtrArray *rows;
+        GString *row;
+        GRand *rand;
+        gint i, nb_words;
+
+        rand = g_rand_new_with_seed (42);
+        rows = g_ptr_array_new_with_free_func (g_free);
+        row = g_string_new (NULL);
+        for (i = 0; i < NB_ROWS; ++i) {
+                g_string_truncate (row, 0);
+                for (nb_words = g_rand_int_range (rand, 1, 30); nb_words > 0; --nb_words) {
+                        g_string_append (row, words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))]);
+                        g_string_append_c (row, ' ');
+                }
+                g_ptr_array_add (rows, ario_util_casefold (row->str));
+        }
+        g_string_free (row, TRUE);
+        g_rand_free (rand);
+
+        return rows;
+}
+
+/* Offset of the match in each row for each needle, -1 if none */
+static gint *
+ario_search_bench_run (GPtrArray *rows,
+                       gchar **folded_needles,
+                       gdouble *seconds)
+{
+        gint *offsets;
+        const char *row, *match;
+        gsize *lengths, needle_len;
+        GTimer *timer;
+        guint i, j, round;
+
+        lengths = g_new (gsize, rows->len);
+        for (i = 0; i < rows->len; ++i)
+                lengths[i] = strlen (g_ptr_array_index (rows, i));
+
+        offsets = g_new (gint, rows->len * G_N_ELEMENTS (needles));
+        timer = g_timer_new ();
+        for (round = 0; round < NB_ROUNDS; ++round) {
+                for (j = 0; j < G_N_ELEMENTS (needles); ++j) {
+                        needle_len = strlen (folded_needles[j]);
+                        for (i = 0; i < rows->len; ++i) {
+                                row = g_ptr_array_index (rows, i);
+                                match = ario_util_strstr_folded (row, lengths[i], folded_needles[j], needle_len);
+                                offsets[j * rows->len + i] = match ? match - row : -1;
+                        }
+                }
+        }
+        *seconds = g_timer_elapsed (timer, NULL) / NB_ROUNDS;
+        g_timer_destroy (timer);
+        g_free (lengths);
+
+        return offsets;
+}
+
+int
+main (int argc, char *argv[])
+{
+        GPtrArray *rows;
+        gchar **folded_needles;
+        gint *reference = NULL, *offsets;
+        gdouble seconds, reference_seconds = 0;
+        guint i, k, matches = 0;
+        gint status = 0;
+
+        rows = ario_search_bench_make_corpus ();
+        folded_needles = g_new0 (gchar *, G_N_ELEMENTS (needles) + 1);
+        for (i = 0; i < G_N_ELEMENTS (needles); ++i)
+                folded_needles[i] = ario_util_casefold (needles[i]);
+
+        for (i = 0; i < G_N_ELEMENTS (impls); ++i) {
+                if (!ario_util_set_search_impl (impls[i].impl)) {
+                        g_print ("%-8s not supported\n", impls[i].name);
+                        continue;
+                }
+
+                offsets = ario_search_bench_run (rows, folded_needles, &seconds);
+                if (!reference) {
+                        /* The scalar implementation is the reference */
+                        reference = offsets;
+                        reference_seconds = seconds;
+                        for (k = 0; k < rows->len * G_N_ELEMENTS (needles); ++k)
+                                matches += (reference[k] >= 0);
+                        g_print ("%-8s %8.2f ms  %u matches\n", impls[i].name, seconds * 1000, matches);
+                        continue;
+                }
+
+                if (memcmp (offsets, reference, rows->len * G_N_ELEMENTS (needles) * sizeof (gint))) {
+                        g_printerr ("%s results differ from scalar results\n", impls[i].name);
+                        status = 1;
+                } else {
+                        g_print ("%-8s %8.2f ms  x%.2f\n", impls[i].name, seconds * 1000, reference_seconds / seconds);
+                }
+                g_free (offsets);
+        }
+
+        g_free (reference);
+        g_strfreev (folded_needles);
+        g_ptr_array_free (rows, TRUE);
+
+        return status;
+}
@@ -0,0 +1,522 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Tests of the server layer: ario-fake-mpd is started on a free port and
+ * the playlist is edited through the ArioServer API, like the playlist
+ * view does. Queue actions merged by ario_server_queue_optimize are
+ * compared with the same actions applied one by one. Run with
+ * 'make check' in src/.
+ */
+
+#include <config.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ario-conf.h"
+#include "servers/ario-server.h"
+#include "ario-util.h"
+
+/* Maximum time to wait for the server */
+#define TEST_TIMEOUT 10
+
+#define SONG_A "Artist 0000/Album 00000/01 - Title 01.ogg"
+#define SONG_B "Artist 0000/Album 00001/02 - Title 02.ogg"
+#define SONG_C "Artist 0001/Album 00002/03 - Title 03.ogg"
+#define SONG_D "Artist 0001/Album 00003/01 - Title 01.ogg"
+#define SONG_E "Artist 0001/Album 00003/02 - Title 02.ogg"
+
+static GPid fake_pid;
+static gint fake_port;
+static gchar *config_home;
+
+/* Copy of the server playlist, kept up to date from the playlist
+ * changes like in the playlist view */
+static GPtrArray *files;
+static gint64 playlist_id = -1;
+/* Positions returned by the playlist changes since the last reset */
+static GHashTable *changed;
+
+static void
+ario_server_test_playlist_changed_cb (ArioServer *server,
+                                      gpointer data)
+{
+        GSList *songs, *tmp;
+        ArioServerSong *song;
+        gint length;
+
+        songs = ario_server_get_playlist_changes (playlist_id);
+        playlist_id = ario_server_get_current_playlist_id ();
+        length = ario_server_get_current_playlist_length ();
+
+        for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
+                song = tmp->data;
+                g_assert_cmpint (song->pos, >=, 0);
+                if ((guint) song->pos >= files->len)
+                        g_ptr_array_set_size (files, song->pos + 1);
+                g_free (g_ptr_array_index (files, song->pos));
+                g_ptr_array_index (files, song->pos) = g_strdup (song->file);
+                g_hash_table_add (changed, GINT_TO_POINTER (song->pos));
+        }
+        g_slist_foreach (songs, (GFunc) ario_server_free_song, NULL);
+        g_slist_free (songs);
+
+        if (length >= 0 && (guint) length < files->len)
+                g_ptr_array_set_size (files, length);
+}
+
+static gboolean
+ario_server_test_timeout_cb (gboolean *timeout)
+{
+        *timeout = TRUE;
+        return FALSE;
+}
+
+/* Run the main loop until the copy of the playlist matches the expected
+ * songs and the server has no pending changes */
+static void
+ario_server_test_wait_playlist (const gchar * const *expected)
+{
+        gboolean timeout = FALSE;
+        guint timeout_id, i;
+        gboolean equal = FALSE;
+
+        timeout_id = g_timeout_add_seconds (TEST_TIMEOUT, (GSourceFunc) ario_server_test_timeout_cb, &timeout);
+        while (!timeout) {
+                g_main_context_iteration (NULL, TRUE);
+                if (ario_server_is_committing ())
+                        continue;
+
+                equal = (g_strv_length ((gchar **) expected) == files->len);
+                for (i = 0; equal && i < files->len; ++i)
+                        equal = !g_strcmp0 (expected[i], g_ptr_array_index (files, i));
+                if (equal)
+                        break;
+        }
+        if (!timeout)
+                g_source_remove (timeout_id);
+
+        g_assert (equal);
+        g_assert_cmpint (ario_server_get_current_playlist_length (), ==, files->len);
+}
+
+static void
+ario_server_test_queue_add (void)
+{
+        const gchar *expected[] = { SONG_A, SONG_B, SONG_C, SONG_D, NULL };
+
+        ario_server_queue_add (SONG_A);
+        ario_server_queue_add (SONG_B);
+        ario_server_queue_add (SONG_C);
+        ario_server_queue_add (SONG_D);
+        ario_server_queue_commit ();
+        ario_server_test_wait_playlist (expected);
+}
+
+static void
+ario_server_test_queue_move (void)
+{
+        const gchar *expected[] = { SONG_A, SONG_C, SONG_B, SONG_D, NULL };
+
+        /* Only the two moved positions are part of the changes */
+        g_hash_table_remove_all (changed);
+        ario_server_queue_move (1, 2);
+        ario_server_queue_commit ();
+        ario_server_test_wait_playlist (expected);
+
+        g_assert_cmpuint (g_hash_table_size (changed), ==, 2);
+        g_assert (g_hash_table_contains (changed, GINT_TO_POINTER (1)));
+        g_assert (g_hash_table_contains (changed, GINT_TO_POINTER (2)));
+}
+
+static void
+ario_server_test_queue_delete (void)
+{
+        const gchar *expected[] = { SONG_C, SONG_D, NULL };
+
+        /* Each deletion is applied to the playlist left by the previous
+         * ones, like those of the playlist view */
+        g_hash_table_remove_all (changed);
+        ario_server_queue_delete_pos (0);
+        ario_server_queue_delete_pos (1);
+        ario_server_queue_commit ();
+        ario_server_test_wait_playlist (expected);
+
+        /* Both remaining songs have moved */
+        g_assert_cmpuint (g_hash_table_size (changed), ==, 2);
+}
+
+static void
+ario_server_test_idle (void)
+{
+        const gchar *expected[] = { SONG_C, SONG_D, SONG_E, NULL };
+        GSocketClient *client;
+        GSocketConnection *connection;
+        GDataInputStream *input;
+        GOutputStream *output;
+        GError *error = NULL;
+        gchar *line;
+
+        /* Another client changes the playlist: ario must notice it without
+         * sending any command itself */
+        client = g_socket_client_new ();
+        connection = g_socket_client_connect_to_host (client, "localhost", fake_port, NULL, &error);
+        g_assert_no_error (error);
+        input = g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+        output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+
+        line = g_data_input_stream_read_line (input, NULL, NULL, &error);
+        g_assert_no_error (error);
+        g_assert (g_str_has_prefix (line, "OK MPD "));
+        g_free (line);
+
+        g_output_stream_write_all (output, "add \"" SONG_E "\"\n", strlen ("add \"" SONG_E "\"\n"), NULL, NULL, &error);
+        g_assert_no_error (error);
+        line = g_data_input_stream_read_line (input, NULL, NULL, &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (line, ==, "OK");
+        g_free (line);
+
+        g_hash_table_remove_all (changed);
+        ario_server_test_wait_playlist (expected);
+
+        /* Only the new song is part of the changes */
+        g_assert_cmpuint (g_hash_table_size (changed), ==, 1);
+        g_assert (g_hash_table_contains (changed, GINT_TO_POINTER (2)));
+
+        g_object_unref (input);
+        g_object_unref (connection);
+        g_object_unref (client);
+}
+
+/* Move the rows [start, end) so that the first one is at position to,
+ * like the move command of MPD */
+static void
+ario_server_test_move_rows (GArray *rows,
+                            const gint start,
+                            const gint end,
+                            const gint to)
+{
+        GArray *moved;
+
+        moved = g_array_new (FALSE, FALSE, sizeof (gint));
+        g_array_append_vals (moved, &g_array_index (rows, gint, start), end - start);
+        g_array_remove_range (rows, start, end - start);
+        g_array_insert_vals (rows, to, moved->data, moved->len);
+        g_array_free (moved, TRUE);
+}
+
+/* Apply a queue action to a playlist of song numbers */
+static void
+ario_server_test_apply (GArray *rows,
+                        const ArioServerQueueAction *queue_action)
+{
+        gint song;
+
+        switch (queue_action->type) {
+        case ARIO_SERVER_ACTION_ADD:
+                song = atoi (queue_action->path);
+                g_array_append_val (rows, song);
+                break;
+        case ARIO_SERVER_ACTION_ADD_AT:
+                song = atoi (queue_action->uri);
+                g_assert_cmpint (queue_action->at, <=, rows->len);
+                g_array_insert_val (rows, queue_action->at, song);
+                break;
+        case ARIO_SERVER_ACTION_DELETE_POS:
+                if (queue_action->pos >= 0) {
+                        g_assert_cmpint (queue_action->pos, <, rows->len);
+                        g_array_remove_index (rows, queue_action->pos);
+                }
+                break;
+        case ARIO_SERVER_ACTION_DELETE_RANGE:
+                g_assert_cmpint (queue_action->start, <, queue_action->end);
+                g_assert_cmpint (queue_action->end, <=, rows->len);
+                g_array_remove_range (rows, queue_action->start, queue_action->end - queue_action->start);
+                break;
+        case ARIO_SERVER_ACTION_MOVE:
+                if (queue_action->old_pos >= 0) {
+                        g_assert_cmpint (queue_action->old_pos, <, rows->len);
+                        g_assert_cmpint (queue_action->new_pos, <, rows->len);
+                        ario_server_test_move_rows (rows, queue_action->old_pos, queue_action->old_pos + 1, queue_action->new_pos);
+                }
+                break;
+        case ARIO_SERVER_ACTION_MOVE_RANGE:
+                g_assert_cmpint (queue_action->start, <, queue_action->end);
+                g_assert_cmpint (queue_action->end, <=, rows->len);
+                g_assert_cmpint (queue_action->to + queue_action->end - queue_action->start, <=, rows->len);
+                ario_server_test_move_rows (rows, queue_action->start, queue_action->end, queue_action->to);
+                break;
+        default:
+                g_assert_not_reached ();
+        }
+}
+
+static void
+ario_server_test_append_action (ArioServerListBuilder *builder,
+                                const ArioServerActionType type,
+                                const gint a,
+                                const gint b)
+{
+        ArioServerQueueAction *queue_action = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
+
+        queue_action->type = type;
+        if (type == ARIO_SERVER_ACTION_ADD) {
+                queue_action->path = g_strdup_printf ("%d", a);
+        } else if (type == ARIO_SERVER_ACTION_DELETE_POS) {
+                queue_action->pos = a;
+        } else {
+                queue_action->old_pos = a;
+                queue_action->new_pos = b;
+        }
+        ario_server_list_builder_append (builder, queue_action);
+}
+
+/* Random sequence of edits like those of the playlist view: additions,
+ * runs of deletions, rows dragged together and single moves */
+static GSList *
+ario_server_test_random_queue (gint length)
+{
+        ArioServerListBuilder builder = { NULL, NULL };
+        gint nb_actions, song = 1000, start, count, to, i;
+
+        for (nb_actions = g_test_rand_int_range (1, 30); nb_actions > 0; --nb_actions) {
+                switch (g_test_rand_int_range (0, 4)) {
+                case 0:
+                        /* Song added, maybe dropped at a position */
+                        ario_server_test_append_action (&builder, ARIO_SERVER_ACTION_ADD, song++, 0);
+                        if (g_test_rand_bit ())
+                                ario_server_test_append_action (&builder, ARIO_SERVER_ACTION_MOVE,
+                                                                length, g_test_rand_int_range (0, length + 1));
+                        ++length;
+                        break;
+                case 1:
+                        /* Selected rows deleted, -1 for unknown rows */
+                        for (count = g_test_rand_int_range (1, 6); count > 0 && length > 0; --count) {
+                                if (g_test_rand_int_range (0, 10)) {
+                                        ario_server_test_append_action (&builder, ARIO_SERVER_ACTION_DELETE_POS,
+                                                                        g_test_rand_int_range (0, length), 0);
+                                        --length;
+                                } else {
+                                        ario_server_test_append_action (&builder, ARIO_SERVER_ACTION_DELETE_POS, -1, 0);
+                                }
+                        }
+                        break;
+                case 2:
+                        /* Rows next to each other dragged up or down */
+                        if (length < 2)
+                                break;
+                        count = g_test_rand_int_range (1, length);
+                        start = g_test_rand_int_range (0, length - count + 1);
+                        to = g_test_rand_int_range (0, length - count + 1);
+                        for (i = 0; i < count; ++i) {
+                                if (to < start)
+                                        ario_server_test_append_action (&builder, ARIO_SERVER_ACTION_MOVE,
+                                                                        start + i, to + i);
+                                else
+                                        ario_server_test_append_action (&builder, ARIO_SERVER_ACTION_MOVE,
+                                                                        start, to + count - 1);
+                        }
+                        break;
+                default:
+                        /* Any row moved, -1 for an unknown row */
+                        if (length == 0)
+                                break;
+                        ario_server_test_append_action (&builder, ARIO_SERVER_ACTION_MOVE,
+                                                        g_test_rand_int_range (-1, length),
+                                                        g_test_rand_int_range (0, length));
+                        break;
+                }
+        }
+
+        return ario_server_list_builder_steal (&builder);
+}
+
+static void
+ario_server_test_queue_optimize (void)
+{
+        GArray *naive, *merged;
+        GSList *queue, *optimized, *tmp;
+        ArioServerQueueAction *queue_action, *copy;
+        guint nb_actions;
+        gint length, i, iteration;
+
+        for (iteration = 0; iteration < 5000; ++iteration) {
+                length = g_test_rand_int_range (0, 20);
+                naive = g_array_new (FALSE, FALSE, sizeof (gint));
+                for (i = 0; i < length; ++i)
+                        g_array_append_val (naive, i);
+                merged = g_array_new (FALSE, FALSE, sizeof (gint));
+                g_array_append_vals (merged, naive->data, naive->len);
+
+                /* Apply the actions one by one, and a copy of them once
+                 * merged by the optimizer */
+                queue = ario_server_test_random_queue (length);
+                optimized = NULL;
+                for (tmp = queue; tmp; tmp = g_slist_next (tmp)) {
+                        queue_action = tmp->data;
+                        ario_server_test_apply (naive, queue_action);
+
+                        copy = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
+                        *copy = *queue_action;
+                        if (copy->type == ARIO_SERVER_ACTION_ADD)
+                                copy->path = g_strdup (queue_action->path);
+                        optimized = g_slist_prepend (optimized, copy);
+                }
+                optimized = g_slist_reverse (optimized);
+                nb_actions = g_slist_length (queue);
+
+                /* The length of the playlist is not always known */
+                optimized = ario_server_queue_optimize (optimized, g_test_rand_bit () ? length : -1);
+                for (tmp = optimized; tmp; tmp = g_slist_next (tmp))
+                        ario_server_test_apply (merged, tmp->data);
+
+                g_assert_cmpuint (g_slist_length (optimized), <=, nb_actions);
+                g_assert_cmpuint (merged->len, ==, naive->len);
+                for (i = 0; i < (gint) naive->len; ++i)
+                        g_assert_cmpint (g_array_index (merged, gint, i), ==, g_array_index (naive, gint, i));
+
+                ario_server_queue_free (queue);
+                ario_server_queue_free (optimized);
+                g_array_free (naive, TRUE);
+                g_array_free (merged, TRUE);
+        }
+}
+
+static void
+ario_server_test_start_fake_mpd (void)
+{
+        gchar *argv[] = { FAKE_MPD_PATH, "--port", "0", "--artists", "2", "--albums", "2", "--songs", "3", NULL };
+        GIOChannel *channel;
+        GError *error = NULL;
+        gchar *line;
+        gint out;
+
+        g_spawn_async_with_pipes (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+                                  NULL, NULL, &fake_pid, NULL, &out, NULL, &error);
+        g_assert_no_error (error);
+
+        /* The server prints the port it listens on once it is ready */
+        channel = g_io_channel_unix_new (out);
+        g_io_channel_read_line (channel, &line, NULL, NULL, &error);
+        g_assert_no_error (error);
+        g_assert (line && sscanf (line, "Listening on port %d", &fake_port) == 1);
+        g_free (line);
+        g_io_channel_unref (channel);
+}
+
+static void
+ario_server_test_write_profile (void)
+{
+        GError *error = NULL;
+        gchar *dir, *filename, *contents;
+
+        /* Profiles and options are read from a private configuration
+         * directory */
+        config_home = g_dir_make_tmp ("ario-test-XXXXXX", &error);
+        g_assert_no_error (error);
+        g_setenv ("XDG_CONFIG_HOME", config_home, TRUE);
+
+        dir = g_build_filename (ario_util_config_dir (), "profiles", NULL);
+        g_mkdir_with_parents (dir, 0700);
+        filename = g_build_filename (dir, "profiles.xml", NULL);
+        contents = g_strdup_printf ("<?xml version=\"1.0\"?>\n"
+                                    "<ario-profiles>\n"
+                                    "  <profile host=\"localhost\" port=\"%d\" current=\"true\">Test</profile>\n"
+                                    "</ario-profiles>\n", fake_port);
+        g_file_set_contents (filename, contents, -1, &error);
+        g_assert_no_error (error);
+
+        g_free (contents);
+        g_free (filename);
+        g_free (dir);
+}
+
+static void
+ario_server_test_remove_dir (const gchar *path)
+{
+        GDir *dir;
+        const gchar *name;
+        gchar *child;
+
+        dir = g_dir_open (path, 0, NULL);
+        if (dir) {
+                while ((name = g_dir_read_name (dir))) {
+                        child = g_build_filename (path, name, NULL);
+                        if (g_file_test (child, G_FILE_TEST_IS_DIR))
+                                ario_server_test_remove_dir (child);
+                        else
+                                g_unlink (child);
+                        g_free (child);
+                }
+                g_dir_close (dir);
+        }
+        g_rmdir (path);
+}
+
+int
+main (int argc, char *argv[])
+{
+        gboolean timeout = FALSE;
+        guint timeout_id;
+        gint status;
+
+        g_test_init (&argc, &argv, NULL);
+
+        ario_server_test_start_fake_mpd ();
+        ario_server_test_write_profile ();
+
+        ario_conf_init ();
+        /* There is no display to show the connection dialogs */
+        ario_server_set_headless (TRUE);
+        files = g_ptr_array_new_with_free_func (g_free);
+        changed = g_hash_table_new (g_direct_hash, g_direct_equal);
+        g_signal_connect (ario_server_get_instance (), "playlist_changed",
+                          G_CALLBACK (ario_server_test_playlist_changed_cb), NULL);
+
+        /* Connection is made in the background */
+        ario_server_connect ();
+        timeout_id = g_timeout_add_seconds (TEST_TIMEOUT, (GSourceFunc) ario_server_test_timeout_cb, &timeout);
+        while (!ario_server_is_connected () && !timeout)
+                g_main_context_iteration (NULL, TRUE);
+        if (!timeout)
+                g_source_remove (timeout_id);
+        g_assert (ario_server_is_connected ());
+
+        g_test_add_func ("/server/queue-optimize", ario_server_test_queue_optimize);
+
+        /* Tests share the playlist of the server and run in order */
+        g_test_add_func ("/server/queue-add", ario_server_test_queue_add);
+        g_test_add_func ("/server/queue-move", ario_server_test_queue_move);
+        g_test_add_func ("/server/queue-delete", ario_server_test_queue_delete);
+        g_test_add_func ("/server/idle", ario_server_test_idle);
+        status = g_test_run ();
+
+        ario_server_disconnect ();
+        ario_server_shutdown ();
+        kill (fake_pid, SIGTERM);
+        g_spawn_close_pid (fake_pid);
+        ario_server_test_remove_dir (config_home);
+        g_free (config_home);
+
+        return status;
+}
@@ -23,13 +23,17 @@
 #include <gtk/gtk.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <ctype.h>
 #include <string.h>
 #include <curl/curl.h>
 #include <glib/gi18n.h>
 #ifdef WIN32
 #include <windows.h>
 #endif
+/* Vectorized search is selected at run time on x86 */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ARIO_UTIL_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
 
 #include "ario-debug.h"
 #include "covers/ario-cover.h"
@@ -279,10 +283,21 @@ ario_util_copy_file (const char *src_uri,
 typedef struct _download_struct{
         char *data;
         int size;
+        /* Allocated size of data */
+        int allocated;
 } download_struct;
 
+/* Validators of a downloaded file, used to revalidate cached files */
+typedef struct
+{
+        gchar *etag;
+        gchar *last_modified;
+} ArioUtilHttpValidators;
+
 /* Limit downloaded file to 5MB */
 #define MAX_SIZE 5*1024*1024
+/* First allocation of download buffers */
+#define MIN_ALLOCATED_SIZE 4096
 
 static size_t
 ario_util_write_data(void *buffer,
@@ -291,58 +306,148 @@ ario_util_write_data(void *buffer,
                      download_struct *download_data)
 {
         ARIO_LOG_FUNCTION_START;
+        int needed;
 
         if (!size || !nmemb)
                 return 0;
 
-        if (download_data->data == NULL)
+        if (download_data->data == NULL) {
                 download_data->size = 0;
+                download_data->allocated = 0;
+        }
 
-        /* Increase buffer size if needed */
-        download_data->data = g_realloc (download_data->data,
-                                         (gulong)(size*nmemb+download_data->size) + 1);
+        /* Increase buffer size if needed: the buffer is doubled so that
+         * large files are not copied for each received chunk */
+        needed = download_data->size + size*nmemb + 1;
+        if (needed > download_data->allocated) {
+                download_data->allocated = MAX (MAX (needed, 2 * download_data->allocated), MIN_ALLOCATED_SIZE);
+                download_data->data = g_realloc (download_data->data, download_data->allocated);
+        }
 
         /* Append received data to buffer */
-        memset (&(download_data->data)[download_data->size], '\0', (size*nmemb)+1);
         memcpy (&(download_data->data)[download_data->size], buffer, size*nmemb);
 
         /* Increase size */
         download_data->size += size*nmemb;
+        download_data->data[download_data->size] = '\0';
         if (download_data->size >= MAX_SIZE)
                 return 0;
 
         return size*nmemb;
 }
 
-void
-ario_util_download_file (const char *uri,
-                         const char *post_data,
-                         const int post_size,
-                         const struct curl_slist *headers,
-                         int* size,
-                         char** data)
+static size_t
+ario_util_write_header (char *buffer,
+                        size_t size,
+                        size_t nitems,
+                        ArioUtilHttpValidators *validators)
+{
+        gchar *line;
+
+        line = g_strstrip (g_strndup (buffer, size*nitems));
+
+        if (g_str_has_prefix (line, "HTTP/")) {
+                /* New response (after a redirection) */
+                g_free (validators->etag);
+                g_free (validators->last_modified);
+                validators->etag = NULL;
+                validators->last_modified = NULL;
+        } else if (!g_ascii_strncasecmp (line, "ETag:", 5)) {
+                g_free (validators->etag);
+                validators->etag = g_strdup (g_strstrip (line + 5));
+        } else if (!g_ascii_strncasecmp (line, "Last-Modified:", 14)) {
+                g_free (validators->last_modified);
+                validators->last_modified = g_strdup (g_strstrip (line + 14));
+        }
+        g_free (line);
+
+        return size*nitems;
+}
+
+/* Connections, DNS entries and TLS sessions are shared by all requests */
+static CURLSH *curl_share = NULL;
+static GMutex curl_share_mutexes[CURL_LOCK_DATA_LAST];
+/* Each thread keeps its own easy handle between requests */
+static GPrivate curl_handle = G_PRIVATE_INIT ((GDestroyNotify) curl_easy_cleanup);
+
+static void
+ario_util_curl_lock (CURL *handle,
+                     curl_lock_data data,
+                     curl_lock_access access,
+                     void *userptr)
+{
+        g_mutex_lock (&curl_share_mutexes[data]);
+}
+
+static void
+ario_util_curl_unlock (CURL *handle,
+                       curl_lock_data data,
+                       void *userptr)
+{
+        g_mutex_unlock (&curl_share_mutexes[data]);
+}
+
+static CURL *
+ario_util_get_curl_handle (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        CURL *curl;
+
+        if (g_once_init_enter (&curl_share)) {
+                CURLSH *share = curl_share_init ();
+                curl_share_setopt (share, CURLSHOPT_LOCKFUNC, ario_util_curl_lock);
+                curl_share_setopt (share, CURLSHOPT_UNLOCKFUNC, ario_util_curl_unlock);
+                curl_share_setopt (share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+                curl_share_setopt (share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+                curl_share_setopt (share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+                g_once_init_leave (&curl_share, share);
+        }
+
+        /* Reuse the handle of this thread to keep its connections alive */
+        curl = g_private_get (&curl_handle);
+        if (curl) {
+                curl_easy_reset (curl);
+        } else {
+                curl = curl_easy_init ();
+                if (!curl)
+                        return NULL;
+                g_private_set (&curl_handle, curl);
+        }
+
+        curl_easy_setopt (curl, CURLOPT_SHARE, curl_share);
+
+        return curl;
+}
+
+/* Returns the HTTP response code or 0 if the request failed */
+static long
+ario_util_perform_request (const char *uri,
+                           const char *post_data,
+                           const int post_size,
+                           const struct curl_slist *headers,
+                           download_struct *download_data,
+                           ArioUtilHttpValidators *validators)
 {
         ARIO_LOG_FUNCTION_START;
         ARIO_LOG_DBG ("Download:%s", uri);
-        download_struct download_data;
         const gchar* address;
         int port;
+        long code = 0;
 
-        /* Initialize curl */
-        CURL* curl = curl_easy_init ();
+        CURL* curl = ario_util_get_curl_handle ();
         if (!curl)
-                return;
-
-        *size = 0;
-        *data = NULL;
+                return 0;
 
-        download_data.size = 0;
-        download_data.data = NULL;
+        download_data->size = 0;
+        download_data->allocated = 0;
+        download_data->data = NULL;
 
         /* set uri */
         curl_easy_setopt (curl, CURLOPT_URL, uri);
         /* set callback data */
-        curl_easy_setopt (curl, CURLOPT_WRITEDATA, &download_data);
+        curl_easy_setopt (curl, CURLOPT_WRITEDATA, download_data);
         /* set callback function */
         curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, (curl_write_callback)ario_util_write_data);
         /* set timeout */
@@ -352,6 +457,12 @@ ario_util_download_file (const char *uri,
         /* set NO SIGNAL */
         curl_easy_setopt (curl, CURLOPT_NOSIGNAL, TRUE);
 
+        /* Collect validators of the response */
+        if (validators) {
+                curl_easy_setopt (curl, CURLOPT_HEADERDATA, validators);
+                curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, (curl_write_callback)ario_util_write_header);
+        }
+
         /* Use a proxy if one is configured */
         if (ario_conf_get_boolean (PREF_USE_PROXY, PREF_USE_PROXY_DEFAULT)) {
                 address = ario_conf_get_string (PREF_PROXY_ADDRESS, PREF_PROXY_ADDRESS_DEFAULT);
@@ -376,12 +487,206 @@ ario_util_download_file (const char *uri,
         }
 
         /* Performs the request */
-        curl_easy_perform (curl);
+        if (curl_easy_perform (curl) == CURLE_OK)
+                curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &code);
+
+        return code;
+}
+
+void
+ario_util_download_file (const char *uri,
+                         const char *post_data,
+                         const int post_size,
+                         const struct curl_slist *headers,
+                         int* size,
+                         char** data)
+{
+        ARIO_LOG_FUNCTION_START;
+        download_struct download_data;
+
+        ario_util_perform_request (uri, post_data, post_size, headers,
+                                   &download_data, NULL);
 
         *size = download_data.size;
         *data = download_data.data;
+}
 
-        curl_easy_cleanup (curl);
+static const char *
+ario_util_http_cache_dir (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        static char *cache_dir = NULL;
+
+        if (g_once_init_enter (&cache_dir)) {
+                char *dir = g_build_filename (ario_util_config_dir (),
+                                              "http-cache",
+                                              NULL);
+                if (!ario_file_test (dir, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_DIR))
+                        ario_util_mkdir (dir);
+                g_once_init_leave (&cache_dir, dir);
+        }
+
+        return cache_dir;
+}
+
+static void
+ario_util_http_cache_store (const char *info_path,
+                            const char *uri,
+                            const ArioUtilHttpValidators *validators)
+{
+        ARIO_LOG_FUNCTION_START;
+        GKeyFile *info;
+        gchar *info_data;
+        gsize info_size;
+
+        info = g_key_file_new ();
+        g_key_file_set_string (info, "cache", "uri", uri);
+        g_key_file_set_int64 (info, "cache", "time", g_get_real_time () / G_USEC_PER_SEC);
+        if (validators->etag)
+                g_key_file_set_string (info, "cache", "etag", validators->etag);
+        if (validators->last_modified)
+                g_key_file_set_string (info, "cache", "last_modified", validators->last_modified);
+
+        info_data = g_key_file_to_data (info, &info_size, NULL);
+        ario_file_set_contents (info_path, info_data, info_size, NULL);
+        g_free (info_data);
+        g_key_file_free (info);
+}
+
+static void
+ario_util_http_cache_get_paths (const char *uri,
+                                gchar **data_path,
+                                gchar **info_path)
+{
+        gchar *hash, *filename;
+
+        /* Cached files are named after a hash of their uri */
+        hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+        filename = g_strconcat (hash, ".data", NULL);
+        *data_path = g_build_filename (ario_util_http_cache_dir (), filename, NULL);
+        g_free (filename);
+        filename = g_strconcat (hash, ".info", NULL);
+        *info_path = g_build_filename (ario_util_http_cache_dir (), filename, NULL);
+        g_free (filename);
+        g_free (hash);
+}
+
+gboolean
+ario_util_download_file_is_cached (const char *uri,
+                                   const int ttl)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *data_path, *info_path;
+        gchar *info_data;
+        gsize info_size;
+        GKeyFile *info;
+        gboolean ret = FALSE;
+
+        ario_util_http_cache_get_paths (uri, &data_path, &info_path);
+
+        if (ario_file_get_contents (info_path, &info_data, &info_size, NULL)) {
+                info = g_key_file_new ();
+                if (g_key_file_load_from_data (info, info_data, info_size, G_KEY_FILE_NONE, NULL))
+                        ret = (g_get_real_time () / G_USEC_PER_SEC
+                               - g_key_file_get_int64 (info, "cache", "time", NULL) < ttl)
+                                && ario_util_uri_exists (data_path);
+                g_key_file_free (info);
+                g_free (info_data);
+        }
+        g_free (data_path);
+        g_free (info_path);
+
+        return ret;
+}
+
+void
+ario_util_download_file_cached (const char *uri,
+                                const int ttl,
+                                int* size,
+                                char** data)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *data_path, *info_path;
+        gchar *info_data;
+        gsize info_size;
+        gchar *cached_data = NULL;
+        gsize cached_size = 0;
+        GKeyFile *info;
+        ArioUtilHttpValidators validators = { NULL, NULL };
+        ArioUtilHttpValidators cached_validators = { NULL, NULL };
+        struct curl_slist *headers = NULL;
+        gchar *header;
+        download_struct download_data;
+        long code;
+
+        *size = 0;
+        *data = NULL;
+
+        ario_util_http_cache_get_paths (uri, &data_path, &info_path);
+
+        info = g_key_file_new ();
+        if (ario_file_get_contents (info_path, &info_data, &info_size, NULL)) {
+                if (g_key_file_load_from_data (info, info_data, info_size, G_KEY_FILE_NONE, NULL)
+                    && ario_file_get_contents (data_path, &cached_data, &cached_size, NULL)) {
+                        /* Cached file is recent enough: no need to use network */
+                        if (g_get_real_time () / G_USEC_PER_SEC
+                            - g_key_file_get_int64 (info, "cache", "time", NULL) < ttl) {
+                                *size = cached_size;
+                                *data = cached_data;
+                                g_free (info_data);
+                                g_key_file_free (info);
+                                g_free (data_path);
+                                g_free (info_path);
+                                return;
+                        }
+
+                        /* Ask the server whether the cached file is still valid */
+                        cached_validators.etag = g_key_file_get_string (info, "cache", "etag", NULL);
+                        if (cached_validators.etag) {
+                                header = g_strconcat ("If-None-Match: ", cached_validators.etag, NULL);
+                                headers = curl_slist_append (headers, header);
+                                g_free (header);
+                        }
+                        cached_validators.last_modified = g_key_file_get_string (info, "cache", "last_modified", NULL);
+                        if (cached_validators.last_modified) {
+                                header = g_strconcat ("If-Modified-Since: ", cached_validators.last_modified, NULL);
+                                headers = curl_slist_append (headers, header);
+                                g_free (header);
+                        }
+                }
+                g_free (info_data);
+        }
+        g_key_file_free (info);
+
+        code = ario_util_perform_request (uri, NULL, 0, headers,
+                                          &download_data, &validators);
+        curl_slist_free_all (headers);
+
+        if (cached_data && (code == 304 || code == 0)) {
+                /* Cached file is still valid, or the server can not be
+                 * reached: use the cached file */
+                g_free (download_data.data);
+                *size = cached_size;
+                *data = cached_data;
+                if (code == 304)
+                        ario_util_http_cache_store (info_path, uri, &cached_validators);
+        } else {
+                /* Keep successful responses for next requests */
+                if (code == 200 && download_data.size > 0
+                    && ario_file_set_contents (data_path, download_data.data, download_data.size, NULL))
+                        ario_util_http_cache_store (info_path, uri, &validators);
+
+                g_free (cached_data);
+                *size = download_data.size;
+                *data = download_data.data;
+        }
+
+        g_free (validators.etag);
+        g_free (validators.last_modified);
+        g_free (cached_validators.etag);
+        g_free (cached_validators.last_modified);
+        g_free (data_path);
+        g_free (info_path);
 }
 
 void
@@ -501,7 +806,7 @@ ario_util_format_keyword_for_lastfm (const char *keyword)
 #define DRAG_COVER_STEP 0.15
 
 static GdkPixbuf *
-ario_util_get_dnd_pixbuf_from_cover_paths (GSList *covers)
+ario_util_get_dnd_pixbuf_from_covers (GSList *covers)
 {
         ARIO_LOG_FUNCTION_START;
         GSList *tmp;
@@ -515,7 +820,7 @@ ario_util_get_dnd_pixbuf_from_cover_paths (GSList *covers)
                 pixbuf = NULL;
         } else if (len == 1) {
                 /* Only one cover, the icon is made of this cover */
-                pixbuf = gdk_pixbuf_new_from_file_at_size (covers->data, DRAG_SIZE, DRAG_SIZE, NULL);
+                pixbuf = g_object_ref (covers->data);
         } else {
                 /* Several covers */
 
@@ -527,19 +832,15 @@ ario_util_get_dnd_pixbuf_from_cover_paths (GSList *covers)
                 gdk_pixbuf_fill (pixbuf, 0);
 
                 for (tmp = covers; tmp; tmp = g_slist_next (tmp)) {
-                        /* Integrate cover in pixbuf */
-                        cover = gdk_pixbuf_new_from_file_at_size (tmp->data, (int) (scale*DRAG_SIZE), (int) (scale*DRAG_SIZE), NULL);
-                        if (!cover)
-                                continue;
-
+                        /* Integrate scaled cover in pixbuf */
+                        cover = tmp->data;
                         gdk_pixbuf_composite (cover, pixbuf,
                                               (int) (i*DRAG_COVER_STEP*DRAG_SIZE), (int) (i*DRAG_COVER_STEP*DRAG_SIZE),
-                                              (int) (scale*DRAG_SIZE), (int) (scale*DRAG_SIZE),
+                                              (int) (scale*gdk_pixbuf_get_width (cover)), (int) (scale*gdk_pixbuf_get_height (cover)),
                                               (int) (i*DRAG_COVER_STEP*DRAG_SIZE), (int) (i*DRAG_COVER_STEP*DRAG_SIZE),
-                                              1.0, 1.0,
+                                              scale, scale,
                                               GDK_INTERP_HYPER,
                                               255);
-                        g_object_unref (cover);
                         ++i;
                 }
         }
@@ -553,10 +854,9 @@ ario_util_get_dnd_pixbuf_from_albums (const GSList *albums)
         ARIO_LOG_FUNCTION_START;
         const GSList *tmp;
         GSList *covers = NULL;
-        gchar *cover_path;
         ArioServerAlbum *ario_server_album;
         int len = 0;
-        GdkPixbuf *pixbuf;
+        GdkPixbuf *pixbuf, *cover;
 
         if (!albums)
                 return NULL;
@@ -565,19 +865,17 @@ ario_util_get_dnd_pixbuf_from_albums (const GSList *albums)
         for (tmp = albums; tmp && len < MAX_COVERS_IN_DRAG; tmp = g_slist_next (tmp)) {
                 ario_server_album = tmp->data;
 
-                cover_path = ario_cover_make_cover_path (ario_server_album->artist, ario_server_album->album, SMALL_COVER);
-                if (ario_util_uri_exists (cover_path)) {
-                        covers = g_slist_append (covers, cover_path);
+                cover = ario_cover_get_pixbuf (ario_server_album->artist, ario_server_album->album, SMALL_COVER, DRAG_SIZE);
+                if (cover) {
+                        covers = g_slist_append (covers, cover);
                         ++len;
-                } else {
-                        g_free (cover_path);
                 }
         }
 
         /* Get the icon from covers */
-        pixbuf = ario_util_get_dnd_pixbuf_from_cover_paths (covers);
+        pixbuf = ario_util_get_dnd_pixbuf_from_covers (covers);
 
-        g_slist_foreach (covers, (GFunc) g_free, NULL);
+        g_slist_foreach (covers, (GFunc) g_object_unref, NULL);
         g_slist_free (covers);
 
         return pixbuf;
@@ -592,8 +890,7 @@ ario_util_get_dnd_pixbuf (const GSList *criterias)
         int len = 0;
         ArioServerCriteria *criteria;
         GSList *albums, *album_tmp;
-        GdkPixbuf *pixbuf;
-        gchar *cover_path;
+        GdkPixbuf *pixbuf, *cover;
         GSList *covers = NULL;
 
         if (!criterias)
@@ -609,12 +906,10 @@ ario_util_get_dnd_pixbuf (const GSList *criterias)
                 /* Get covers of albums */
                 for (album_tmp = albums; album_tmp && len < MAX_COVERS_IN_DRAG; album_tmp = g_slist_next (album_tmp)) {
                         server_album = album_tmp->data;
-                        cover_path = ario_cover_make_cover_path (server_album->artist, server_album->album, SMALL_COVER);
-                        if (ario_util_uri_exists (cover_path)) {
-                                covers = g_slist_append (covers, cover_path);
+                        cover = ario_cover_get_pixbuf (server_album->artist, server_album->album, SMALL_COVER, DRAG_SIZE);
+                        if (cover) {
+                                covers = g_slist_append (covers, cover);
                                 ++len;
-                        } else {
-                                g_free (cover_path);
                         }
                 }
                 g_slist_foreach (albums, (GFunc) ario_server_free_album, NULL);
@@ -622,9 +917,9 @@ ario_util_get_dnd_pixbuf (const GSList *criterias)
         }
 
         /* Get the icon from covers */
-        pixbuf = ario_util_get_dnd_pixbuf_from_cover_paths (covers);
+        pixbuf = ario_util_get_dnd_pixbuf_from_covers (covers);
 
-        g_slist_foreach (covers, (GFunc) g_free, NULL);
+        g_slist_foreach (covers, (GFunc) g_object_unref, NULL);
         g_slist_free (covers);
 
         return pixbuf;
@@ -740,30 +1035,205 @@ ario_util_stristr (const char *haystack,
                    const char *needle)
 {
         ARIO_LOG_FUNCTION_START;
+        gchar *lower_haystack, *lower_needle;
+        const char *match;
 
         if (!needle || !*needle)
                 return haystack;
 
-        for (; *haystack; ++haystack) {
-                if (toupper(*haystack) == toupper(*needle)) {
-                        /*
-                         * Matched starting char -- loop through remaining chars.
-                         */
-                        const char *h, *n;
-
-                        for (h = haystack, n = needle; *h && *n; ++h, ++n) {
-                                if (toupper(*h) != toupper(*n)) {
-                                        break;
-                                }
-                        }
-                        /* matched all of 'needle' to null termination */
-                        if (!*n) {
-                                /* return the start of the match */
-                                return haystack;
-                        }
+        /* ASCII lowercase keeps the offsets of haystack: the match is
+         * found in the lowercase copies and returned in haystack */
+        lower_haystack = g_ascii_strdown (haystack, -1);
+        lower_needle = g_ascii_strdown (needle, -1);
+        match = ario_util_strstr_folded (lower_haystack, strlen (lower_haystack),
+                                         lower_needle, strlen (lower_needle));
+        if (match)
+                match = haystack + (match - lower_haystack);
+        g_free (lower_haystack);
+        g_free (lower_needle);
+
+        return match;
+}
+
+/* Search in casefolded strings: the first and last bytes of the needle
+ * are compared with 16 or 32 positions of the haystack at once, and the
+ * needle is only compared completely at positions where both match */
+typedef const char * (*ArioUtilSearchFunc) (const char *haystack,
+                                            gsize haystack_len,
+                                            const char *needle,
+                                            gsize needle_len);
+
+static const char *
+ario_util_strstr_folded_scalar (const char *haystack,
+                                gsize haystack_len,
+                                const char *needle,
+                                gsize needle_len)
+{
+        const char *tmp = haystack;
+        const char *end;
+
+        if (haystack_len < needle_len)
+                return NULL;
+
+        end = haystack + haystack_len - needle_len;
+        while (tmp <= end) {
+                tmp = memchr (tmp, needle[0], end - tmp + 1);
+                if (!tmp)
+                        return NULL;
+                if (!memcmp (tmp + 1, needle + 1, needle_len - 1))
+                        return tmp;
+                ++tmp;
+        }
+
+        return NULL;
+}
+
+#ifdef ARIO_UTIL_X86_DISPATCH
+__attribute__ ((target ("sse2")))
+static const char *
+ario_util_strstr_folded_sse2 (const char *haystack,
+                              gsize haystack_len,
+                              const char *needle,
+                              gsize needle_len)
+{
+        const __m128i first = _mm_set1_epi8 (needle[0]);
+        const __m128i last = _mm_set1_epi8 (needle[needle_len - 1]);
+        __m128i block_first, block_last;
+        unsigned int mask;
+        gsize i;
+        int bit;
+
+        for (i = 0; i + needle_len - 1 + 16 <= haystack_len; i += 16) {
+                block_first = _mm_loadu_si128 ((const __m128i *) (haystack + i));
+                block_last = _mm_loadu_si128 ((const __m128i *) (haystack + i + needle_len - 1));
+                mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (first, block_first),
+                                                         _mm_cmpeq_epi8 (last, block_last)));
+                while (mask) {
+                        bit = __builtin_ctz (mask);
+                        if (!memcmp (haystack + i + bit + 1, needle + 1, needle_len - 2))
+                                return haystack + i + bit;
+                        mask &= mask - 1;
+                }
+        }
+
+        /* Last positions */
+        return ario_util_strstr_folded_scalar (haystack + i, haystack_len - i, needle, needle_len);
+}
+
+__attribute__ ((target ("avx2")))
+static const char *
+ario_util_strstr_folded_avx2 (const char *haystack,
+                              gsize haystack_len,
+                              const char *needle,
+                              gsize needle_len)
+{
+        const __m256i first = _mm256_set1_epi8 (needle[0]);
+        const __m256i last = _mm256_set1_epi8 (needle[needle_len - 1]);
+        __m256i block_first, block_last;
+        unsigned int mask;
+        gsize i;
+        int bit;
+
+        for (i = 0; i + needle_len - 1 + 32 <= haystack_len; i += 32) {
+                block_first = _mm256_loadu_si256 ((const __m256i *) (haystack + i));
+                block_last = _mm256_loadu_si256 ((const __m256i *) (haystack + i + needle_len - 1));
+                mask = _mm256_movemask_epi8 (_mm256_and_si256 (_mm256_cmpeq_epi8 (first, block_first),
+                                                               _mm256_cmpeq_epi8 (last, block_last)));
+                while (mask) {
+                        bit = __builtin_ctz (mask);
+                        if (!memcmp (haystack + i + bit + 1, needle + 1, needle_len - 2))
+                                return haystack + i + bit;
+                        mask &= mask - 1;
                 }
         }
-        return 0;
+
+        /* Last positions */
+        return ario_util_strstr_folded_scalar (haystack + i, haystack_len - i, needle, needle_len);
+}
+#endif
+
+static ArioUtilSearchFunc search_func = ario_util_strstr_folded_scalar;
+
+static ArioUtilSearchFunc
+ario_util_get_search_func (void)
+{
+        static gsize initialized = 0;
+
+        /* Choose the fastest implementation supported by the CPU */
+        if (g_once_init_enter (&initialized)) {
+#ifdef ARIO_UTIL_X86_DISPATCH
+                __builtin_cpu_init ();
+                if (__builtin_cpu_supports ("avx2"))
+                        search_func = ario_util_strstr_folded_avx2;
+                else if (__builtin_cpu_supports ("sse2"))
+                        search_func = ario_util_strstr_folded_sse2;
+#endif
+                g_once_init_leave (&initialized, 1);
+        }
+
+        return search_func;
+}
+
+gboolean
+ario_util_set_search_impl (const ArioUtilSearchImpl impl)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Make sure the automatic choice does not override this one */
+        ario_util_get_search_func ();
+
+        switch (impl) {
+        case ARIO_UTIL_SEARCH_SCALAR:
+                search_func = ario_util_strstr_folded_scalar;
+                return TRUE;
+#ifdef ARIO_UTIL_X86_DISPATCH
+        case ARIO_UTIL_SEARCH_SSE2:
+                if (!__builtin_cpu_supports ("sse2"))
+                        return FALSE;
+                search_func = ario_util_strstr_folded_sse2;
+                return TRUE;
+        case ARIO_UTIL_SEARCH_AVX2:
+                if (!__builtin_cpu_supports ("avx2"))
+                        return FALSE;
+                search_func = ario_util_strstr_folded_avx2;
+                return TRUE;
+#endif
+        default:
+                return FALSE;
+        }
+}
+
+const char *
+ario_util_strstr_folded (const char *haystack,
+                         const gsize haystack_len,
+                         const char *needle,
+                         const gsize needle_len)
+{
+        if (needle_len == 0)
+                return haystack;
+
+        if (needle_len > haystack_len)
+                return NULL;
+
+        if (needle_len == 1)
+                return memchr (haystack, needle[0], haystack_len);
+
+        return ario_util_get_search_func () (haystack, haystack_len, needle, needle_len);
+}
+
+gchar *
+ario_util_casefold (const char *string)
+{
+        gchar *normalized, *folded;
+
+        /* Composed characters and their decomposed forms are equal */
+        normalized = g_utf8_normalize (string, -1, G_NORMALIZE_ALL_COMPOSE);
+        if (!normalized)
+                return g_strdup ("");
+
+        folded = g_utf8_casefold (normalized, -1);
+        g_free (normalized);
+
+        return folded;
 }
 
 GSList *
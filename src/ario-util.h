@@ -153,6 +153,34 @@ void                    ario_util_download_file              (const char *uri,
                                                               const struct curl_slist *headers,
                                                               int* size,
                                                               char** data);
+/**
+ * Download a file on internet, keeping a copy on disk. The copy is
+ * used without network access for ttl seconds, then revalidated with
+ * the server (ETag and Last-Modified headers). The copy is also used
+ * if the server can not be reached.
+ *
+ * @param uri The uri of the file to download
+ * @param ttl Number of seconds during which the copy is used as is
+ * @param size A pointer to a int that will contain the size of the downloaded data
+ * @param data Newly allocated data containing the downloaded file
+ */
+G_MODULE_EXPORT
+void                    ario_util_download_file_cached       (const char *uri,
+                                                              const int ttl,
+                                                              int* size,
+                                                              char** data);
+/**
+ * Check whether ario_util_download_file_cached would use the copy on
+ * disk without network access
+ *
+ * @param uri The uri of the file to download
+ * @param ttl Number of seconds during which the copy is used as is
+ *
+ * @return TRUE if a recent enough copy of the file is on disk
+ */
+G_MODULE_EXPORT
+gboolean                ario_util_download_file_is_cached    (const char *uri,
+                                                              const int ttl);
 /**
  * Replace string 'old' by string 'new' in 'string'
  *
@@ -273,17 +301,68 @@ gboolean                ario_file_test                       (const gchar *filen
                                                               GFileTest test);
 
 /**
- * Case insensitive strstr (locate a substring in a string)
+ * Case insensitive strstr (locate a substring in a string). Only ASCII
+ * letters are compared without case: kept for plugins, use
+ * ario_util_casefold and ario_util_strstr_folded instead.
  *
  * @param haystack The string to do the location
  * @param needle String to locate
  *
- * @return
+ * @return The start of the first match in haystack, or NULL
  */
 G_MODULE_EXPORT
 const char *            ario_util_stristr                    (const char *haystack,
                                                               const char *needle);
 
+/**
+ * Casefold and normalize a UTF-8 string so that it can be searched
+ * with ario_util_strstr_folded
+ *
+ * @param string The UTF-8 string to casefold
+ *
+ * @return A newly allocated casefolded string
+ */
+G_MODULE_EXPORT
+gchar *                 ario_util_casefold                   (const char *string);
+
+/**
+ * Locate a substring in a string. Both strings must have been
+ * casefolded with ario_util_casefold to get a case insensitive and
+ * Unicode aware search. A vectorized implementation is used if the
+ * CPU supports it.
+ *
+ * @param haystack The casefolded string to do the location
+ * @param haystack_len The length of haystack in bytes
+ * @param needle The casefolded string to locate
+ * @param needle_len The length of needle in bytes
+ *
+ * @return The start of the first match in haystack, or NULL
+ */
+G_MODULE_EXPORT
+const char *            ario_util_strstr_folded              (const char *haystack,
+                                                              const gsize haystack_len,
+                                                              const char *needle,
+                                                              const gsize needle_len);
+
+/* Implementations of ario_util_strstr_folded */
+typedef enum
+{
+        ARIO_UTIL_SEARCH_SCALAR,
+        ARIO_UTIL_SEARCH_SSE2,
+        ARIO_UTIL_SEARCH_AVX2
+} ArioUtilSearchImpl;
+
+/**
+ * Force the implementation used by ario_util_strstr_folded instead of
+ * the fastest one supported by the CPU, to compare them
+ *
+ * @param impl The implementation to use
+ *
+ * @return FALSE if impl is not supported by the CPU or the build
+ */
+G_MODULE_EXPORT
+gboolean                ario_util_set_search_impl            (const ArioUtilSearchImpl impl);
+
 /**
  * Randomize a GSList
  *
@@ -0,0 +1,304 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "covers/ario-cover-downloader.h"
+#include "covers/ario-cover.h"
+#include "covers/ario-cover-manager.h"
+#include "servers/ario-server.h"
+#include "ario-debug.h"
+
+/* Maximum number of albums searched at the same time */
+#define MAX_DOWNLOAD_JOBS 16
+
+struct ArioCoverDownloader
+{
+        GSList *albums;
+        ArioCoverDownloaderOperation operation;
+        gint jobs;
+
+        /* Counters are updated by the jobs */
+        gint nb_covers;
+        gint nb_already_exist;
+        gint nb_found;
+        gint nb_not_found;
+
+        gint cancelled;
+
+        /* Only used in the main loop */
+        gboolean finished;
+        gboolean freed;
+
+        ArioCoverDownloaderProgressFunc progress;
+        ArioCoverDownloaderDoneFunc done;
+        gpointer data;
+};
+
+typedef struct
+{
+        ArioCoverDownloader *downloader;
+        gchar *artist;
+        gchar *album;
+} ArioCoverDownloaderIdleData;
+
+static void
+ario_cover_downloader_destroy (ArioCoverDownloader *downloader)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_slist_foreach (downloader->albums, (GFunc) ario_server_free_album, NULL);
+        g_slist_free (downloader->albums);
+        g_free (downloader);
+}
+
+static gboolean
+ario_cover_downloader_progress_idle (ArioCoverDownloaderIdleData *data)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (!data->downloader->freed && data->downloader->progress)
+                data->downloader->progress (data->downloader,
+                                            data->artist,
+                                            data->album,
+                                            data->downloader->data);
+
+        g_free (data->artist);
+        g_free (data->album);
+        g_free (data);
+
+        return FALSE;
+}
+
+static gboolean
+ario_cover_downloader_done_idle (ArioCoverDownloader *downloader)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* This is the last callback of the search: the downloader can
+         * now be freed */
+        if (downloader->freed) {
+                ario_cover_downloader_destroy (downloader);
+                return FALSE;
+        }
+
+        downloader->finished = TRUE;
+        if (downloader->done)
+                downloader->done (downloader, downloader->data);
+
+        return FALSE;
+}
+
+static void
+ario_cover_downloader_get_cover (ArioCoverDownloader *downloader,
+                                 const char *artist,
+                                 const char *album,
+                                 const char *path)
+{
+        ARIO_LOG_FUNCTION_START;
+        GArray *size;
+        GSList *data = NULL;
+        gboolean ret;
+
+        size = g_array_new (TRUE, TRUE, sizeof (int));
+
+        /* If a cover is found, it is loaded in data(0) */
+        ret = ario_cover_manager_get_covers (ario_cover_manager_get_instance (),
+                                             artist,
+                                             album,
+                                             path,
+                                             &size,
+                                             &data,
+                                             GET_FIRST_COVER);
+
+        /* If the cover is not too big and not too small (blank image), we save it */
+        if (ret && ario_cover_size_is_valid (g_array_index (size, int, 0))) {
+                ret = ario_cover_save_cover (artist,
+                                             album,
+                                             g_slist_nth_data (data, 0),
+                                             g_array_index (size, int, 0),
+                                             OVERWRITE_MODE_SKIP);
+
+                if (ret)
+                        g_atomic_int_inc (&downloader->nb_found);
+                else
+                        g_atomic_int_inc (&downloader->nb_not_found);
+        } else {
+                g_atomic_int_inc (&downloader->nb_not_found);
+        }
+
+        g_array_free (size, TRUE);
+        g_slist_foreach (data, (GFunc) g_free, NULL);
+        g_slist_free (data);
+}
+
+static void
+ario_cover_downloader_album_job (ArioServerAlbum *server_album,
+                                 ArioCoverDownloader *downloader)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverDownloaderIdleData *data;
+
+        /* The search has been cancelled : we skip remaining albums */
+        if (g_atomic_int_get (&downloader->cancelled))
+                return;
+
+        if (!server_album->album || !server_album->artist)
+                return;
+
+        /* We notify the progress */
+        data = (ArioCoverDownloaderIdleData *) g_malloc0 (sizeof (ArioCoverDownloaderIdleData));
+        data->downloader = downloader;
+        data->artist = g_strdup (server_album->artist);
+        data->album = g_strdup (server_album->album);
+        g_idle_add ((GSourceFunc) ario_cover_downloader_progress_idle, data);
+
+        switch (downloader->operation) {
+        case GET_COVERS:
+                if (ario_cover_cover_exists (server_album->artist, server_album->album))
+                        /* The cover already exists, we do nothing */
+                        g_atomic_int_inc (&downloader->nb_already_exist);
+                else
+                        /* We search for the cover */
+                        ario_cover_downloader_get_cover (downloader,
+                                                         server_album->artist,
+                                                         server_album->album,
+                                                         server_album->path);
+                break;
+
+        case REMOVE_COVERS:
+                /* We remove the cover from the ~/.config/ario/covers/ directory */
+                ario_cover_remove_cover (server_album->artist, server_album->album);
+                break;
+
+        default:
+                break;
+        }
+}
+
+static gpointer
+ario_cover_downloader_thread (ArioCoverDownloader *downloader)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *tmp;
+        GThreadPool *pool;
+
+        /* Covers of several albums are searched at the same time: most
+         * of the time is spent waiting for the network */
+        pool = g_thread_pool_new ((GFunc) ario_cover_downloader_album_job,
+                                  downloader,
+                                  downloader->jobs,
+                                  FALSE,
+                                  NULL);
+
+        for (tmp = downloader->albums; tmp; tmp = g_slist_next (tmp)) {
+                if (g_atomic_int_get (&downloader->cancelled))
+                        break;
+                g_thread_pool_push (pool, tmp->data, NULL);
+        }
+
+        /* Wait for the end of the search */
+        g_thread_pool_free (pool, FALSE, TRUE);
+
+        /* The downloader must not be used after this call: it can be
+         * freed in the main loop */
+        g_idle_add ((GSourceFunc) ario_cover_downloader_done_idle, downloader);
+
+        return NULL;
+}
+
+ArioCoverDownloader *
+ario_cover_downloader_new (const GSList *albums,
+                           const ArioCoverDownloaderOperation operation,
+                           const gint jobs,
+                           ArioCoverDownloaderProgressFunc progress,
+                           ArioCoverDownloaderDoneFunc done,
+                           gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverDownloader *downloader;
+        const GSList *tmp;
+
+        downloader = (ArioCoverDownloader *) g_malloc0 (sizeof (ArioCoverDownloader));
+
+        /* Copy the list of albums */
+        for (tmp = albums; tmp; tmp = g_slist_next (tmp))
+                downloader->albums = g_slist_prepend (downloader->albums, ario_server_copy_album (tmp->data));
+        downloader->albums = g_slist_reverse (downloader->albums);
+        downloader->nb_covers = g_slist_length (downloader->albums);
+
+        downloader->operation = operation;
+        downloader->jobs = CLAMP (jobs, 1, MAX_DOWNLOAD_JOBS);
+        downloader->progress = progress;
+        downloader->done = done;
+        downloader->data = data;
+
+        g_thread_unref (g_thread_new ("coverdl",
+                                      (GThreadFunc) ario_cover_downloader_thread,
+                                      downloader));
+
+        return downloader;
+}
+
+void
+ario_cover_downloader_cancel (ArioCoverDownloader *downloader)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (downloader)
+                g_atomic_int_set (&downloader->cancelled, TRUE);
+}
+
+void
+ario_cover_downloader_free (ArioCoverDownloader *downloader)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (!downloader)
+                return;
+
+        if (downloader->finished) {
+                ario_cover_downloader_destroy (downloader);
+        } else {
+                /* The downloader is freed by the last callback of the search */
+                ario_cover_downloader_cancel (downloader);
+                downloader->freed = TRUE;
+        }
+}
+
+gint
+ario_cover_downloader_get_nb_covers (ArioCoverDownloader *downloader)
+{
+        ARIO_LOG_FUNCTION_START;
+        return downloader->nb_covers;
+}
+
+gint
+ario_cover_downloader_get_nb_found (ArioCoverDownloader *downloader)
+{
+        ARIO_LOG_FUNCTION_START;
+        return g_atomic_int_get (&downloader->nb_found);
+}
+
+gint
+ario_cover_downloader_get_nb_not_found (ArioCoverDownloader *downloader)
+{
+        ARIO_LOG_FUNCTION_START;
+        return g_atomic_int_get (&downloader->nb_not_found);
+}
+
+gint
+ario_cover_downloader_get_nb_already_exist (ArioCoverDownloader *downloader)
+{
+        ARIO_LOG_FUNCTION_START;
+        return g_atomic_int_get (&downloader->nb_already_exist);
+}
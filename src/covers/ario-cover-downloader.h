@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ARIO_COVER_DOWNLOADER_H
+#define __ARIO_COVER_DOWNLOADER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * ArioCoverDownloader searches for the covers of a list of albums
+ * with a pool of threads, without any window. Progress and end of
+ * the search are notified in the main loop.
+ */
+typedef struct ArioCoverDownloader ArioCoverDownloader;
+
+typedef enum
+{
+        GET_COVERS,
+        REMOVE_COVERS
+} ArioCoverDownloaderOperation;
+
+/* Called in the main loop when the search for the cover of an album starts */
+typedef void            (*ArioCoverDownloaderProgressFunc)            (ArioCoverDownloader *downloader,
+                                                                       const gchar *artist,
+                                                                       const gchar *album,
+                                                                       gpointer data);
+
+/* Called in the main loop once all the albums are done or skipped */
+typedef void            (*ArioCoverDownloaderDoneFunc)                (ArioCoverDownloader *downloader,
+                                                                       gpointer data);
+
+/* The search starts at once, with up to jobs albums at the same time */
+ArioCoverDownloader *   ario_cover_downloader_new                     (const GSList *albums,
+                                                                       const ArioCoverDownloaderOperation operation,
+                                                                       const gint jobs,
+                                                                       ArioCoverDownloaderProgressFunc progress,
+                                                                       ArioCoverDownloaderDoneFunc done,
+                                                                       gpointer data);
+
+/* Albums not searched yet are skipped, done is still called */
+void                    ario_cover_downloader_cancel                  (ArioCoverDownloader *downloader);
+
+/* Does not wait: the search is cancelled and no more callback is called */
+void                    ario_cover_downloader_free                    (ArioCoverDownloader *downloader);
+
+gint                    ario_cover_downloader_get_nb_covers           (ArioCoverDownloader *downloader);
+
+gint                    ario_cover_downloader_get_nb_found            (ArioCoverDownloader *downloader);
+
+gint                    ario_cover_downloader_get_nb_not_found        (ArioCoverDownloader *downloader);
+
+gint                    ario_cover_downloader_get_nb_already_exist    (ArioCoverDownloader *downloader);
+
+G_END_DECLS
+
+#endif /* __ARIO_COVER_DOWNLOADER_H */
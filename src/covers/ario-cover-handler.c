@@ -42,6 +42,7 @@ static void ario_cover_handler_state_changed_cb (ArioServer *server,
 enum
 {
         COVER_CHANGED,
+        ALBUM_COVER_CHANGED,
         LAST_SIGNAL
 };
 static guint ario_cover_handler_signals[LAST_SIGNAL] = { 0 };
@@ -55,6 +56,9 @@ struct ArioCoverHandlerPrivate
 
         GdkPixbuf *pixbuf;
         GdkPixbuf *large_pixbuf;
+
+        /* Whether the cover of current album is shown (playing or paused) */
+        gboolean shown;
 };
 
 typedef struct ArioCoverHandlerData
@@ -85,6 +89,18 @@ ario_cover_handler_class_init (ArioCoverHandlerClass *klass)
                               g_cclosure_marshal_VOID__VOID,
                               G_TYPE_NONE,
                               0);
+
+        ario_cover_handler_signals[ALBUM_COVER_CHANGED] =
+                g_signal_new ("album_cover_changed",
+                              G_OBJECT_CLASS_TYPE (object_class),
+                              G_SIGNAL_RUN_LAST,
+                              G_STRUCT_OFFSET (ArioCoverHandlerClass, album_cover_changed),
+                              NULL, NULL,
+                              NULL,
+                              G_TYPE_NONE,
+                              2,
+                              G_TYPE_STRING,
+                              G_TYPE_STRING);
 }
 
 static void
@@ -150,16 +166,6 @@ ario_cover_handler_finalize (GObject *object)
         G_OBJECT_CLASS (ario_cover_handler_parent_class)->finalize (object);
 }
 
-static gboolean
-ario_cover_handler_cover_changed (ArioCoverHandler *cover_handler)
-{
-        ARIO_LOG_FUNCTION_START;
-
-        g_signal_emit (G_OBJECT (cover_handler), ario_cover_handler_signals[COVER_CHANGED], 0);
-
-        return FALSE;
-}
-
 static void
 ario_cover_handler_free_data (ArioCoverHandlerData *data)
 {
@@ -201,16 +207,13 @@ ario_cover_handler_get_covers (ArioCoverHandler *cover_handler)
 
                 /* If the cover is not too big and not too small (blank image), we save it */
                 if (ret && ario_cover_size_is_valid (g_array_index (size, int, 0))) {
-                        ret = ario_cover_save_cover (data->artist,
-                                                     data->album,
-                                                     g_slist_nth_data (covers, 0),
-                                                     g_array_index (size, int, 0),
-                                                     OVERWRITE_MODE_SKIP);
-
-                        if (ret) {
-                                ario_cover_handler_load_pixbuf (cover_handler, FALSE);
-                                g_idle_add ((GSourceFunc) ario_cover_handler_cover_changed, cover_handler);
-                        }
+                        /* The saved cover is then loaded by album_cover_changed
+                         * handler in main loop */
+                        ario_cover_save_cover (data->artist,
+                                               data->album,
+                                               g_slist_nth_data (covers, 0),
+                                               g_array_index (size, int, 0),
+                                               OVERWRITE_MODE_SKIP);
                 }
                 ario_cover_handler_free_data (data);
 
@@ -228,7 +231,6 @@ ario_cover_handler_load_pixbuf (ArioCoverHandler *cover_handler,
                                 gboolean should_get)
 {
         ARIO_LOG_FUNCTION_START;
-        gchar *large_cover_path;
         ArioCoverHandlerData *data;
         gchar *artist = ario_server_get_current_artist ();
         gchar *album = ario_server_get_current_album ();
@@ -253,19 +255,16 @@ ario_cover_handler_load_pixbuf (ArioCoverHandler *cover_handler,
                 cover_handler->priv->cover_path = NULL;
         }
 
+        cover_handler->priv->shown = FALSE;
+
         switch (ario_server_get_current_state ()) {
         case ARIO_STATE_PLAY:
         case ARIO_STATE_PAUSE:
+                cover_handler->priv->shown = TRUE;
                 cover_handler->priv->cover_path = ario_cover_make_cover_path (artist, album, SMALL_COVER);
-                large_cover_path = ario_cover_make_cover_path (artist, album, NORMAL_COVER);
-                if (cover_handler->priv->cover_path && large_cover_path) {
-                        cover_handler->priv->pixbuf = gdk_pixbuf_new_from_file_at_size (cover_handler->priv->cover_path, COVER_SIZE, COVER_SIZE, NULL);
-                        cover_handler->priv->large_pixbuf = gdk_pixbuf_new_from_file_at_size (large_cover_path, 2*COVER_SIZE, 2*COVER_SIZE, NULL);
-                        if (!cover_handler->priv->cover_path) {
-                                g_free (cover_handler->priv->cover_path);
-                                cover_handler->priv->cover_path = NULL;
-                        }
-                        g_free (large_cover_path);
+                if (cover_handler->priv->cover_path) {
+                        cover_handler->priv->pixbuf = ario_cover_get_pixbuf (artist, album, SMALL_COVER, COVER_SIZE);
+                        cover_handler->priv->large_pixbuf = ario_cover_get_pixbuf (artist, album, NORMAL_COVER, 2*COVER_SIZE);
                         if (!cover_handler->priv->pixbuf
                             && should_get
                             && ario_conf_get_boolean (PREF_AUTOMATIC_GET_COVER, PREF_AUTOMATIC_GET_COVER_DEFAULT)) {
@@ -305,6 +304,12 @@ ario_cover_handler_state_changed_cb (ArioServer *server,
                                      ArioCoverHandler *cover_handler)
 {
         ARIO_LOG_FUNCTION_START;
+        int state = ario_server_get_current_state ();
+
+        /* Switching between play and pause does not change the cover */
+        if (cover_handler->priv->shown == (state == ARIO_STATE_PLAY || state == ARIO_STATE_PAUSE))
+                return;
+
         ario_cover_handler_load_pixbuf(cover_handler, TRUE);
         g_signal_emit (G_OBJECT (cover_handler), ario_cover_handler_signals[COVER_CHANGED], 0);
 }
@@ -344,3 +349,47 @@ ario_cover_handler_get_cover_path (void)
         ARIO_LOG_FUNCTION_START;
         return instance->priv->cover_path;
 }
+
+static gboolean
+ario_cover_handler_album_cover_changed_idle (ArioCoverHandlerData *data)
+{
+        ARIO_LOG_FUNCTION_START;
+        const gchar *artist = ario_server_get_current_artist ();
+        const gchar *album = ario_server_get_current_album ();
+
+        if (!artist)
+                artist = ARIO_SERVER_UNKNOWN;
+        if (!album)
+                album = ARIO_SERVER_UNKNOWN;
+
+        g_signal_emit (G_OBJECT (instance), ario_cover_handler_signals[ALBUM_COVER_CHANGED], 0,
+                       data->artist, data->album);
+
+        /* Reload the current cover if it is the changed one */
+        if (instance->priv->shown
+            && !strcmp (artist, data->artist)
+            && !strcmp (album, data->album)) {
+                ario_cover_handler_load_pixbuf (instance, FALSE);
+                g_signal_emit (G_OBJECT (instance), ario_cover_handler_signals[COVER_CHANGED], 0);
+        }
+
+        ario_cover_handler_free_data (data);
+
+        return FALSE;
+}
+
+void
+ario_cover_handler_album_cover_changed (const gchar *artist,
+                                        const gchar *album)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverHandlerData *data;
+
+        if (!instance || !artist || !album)
+                return;
+
+        data = (ArioCoverHandlerData *) g_malloc0 (sizeof (ArioCoverHandlerData));
+        data->artist = g_strdup (artist);
+        data->album = g_strdup (album);
+        g_idle_add ((GSourceFunc) ario_cover_handler_album_cover_changed_idle, data);
+}
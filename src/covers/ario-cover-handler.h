@@ -46,6 +46,10 @@ typedef struct
 
         /* Signals */
         void (*cover_changed)            (ArioCoverHandler *cover_handler);
+
+        void (*album_cover_changed)      (ArioCoverHandler *cover_handler,
+                                          const gchar *artist,
+                                          const gchar *album);
 } ArioCoverHandlerClass;
 
 GType              ario_cover_handler_get_type         (void) G_GNUC_CONST;
@@ -62,6 +66,11 @@ gchar *            ario_cover_handler_get_cover_path   (void);
 G_MODULE_EXPORT
 GdkPixbuf *        ario_cover_handler_get_large_cover  (void);
 
+/* Emit album_cover_changed in main loop. Can be called from any thread */
+G_MODULE_EXPORT
+void               ario_cover_handler_album_cover_changed (const gchar *artist,
+                                                           const gchar *album);
+
 G_END_DECLS
 
 #endif /* __ARIO_COVER_HANDLER_H */
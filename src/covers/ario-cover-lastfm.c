@@ -32,7 +32,12 @@
 #include "ario-debug.h"
 
 #define LASTFM_API_KEY "93bea35d40c4a58e034d14eb85e840c2"
-#define LASTFM_URI  "http://ws.audioscrobbler.com/2.0/?api_key=%s&artist=%s&album=%s&method=album.getinfo"
+#define LASTFM_ROOT "http://ws.audioscrobbler.com/2.0/"
+#define LASTFM_URI  "%s?api_key=%s&artist=%s&album=%s&method=album.getinfo"
+/* Last.fm web services must not be called more than 5 times per second */
+#define LASTFM_REQUEST_INTERVAL (G_USEC_PER_SEC / 5)
+/* Album informations are kept on disk for a week */
+#define LASTFM_CACHE_TTL (7 * 24 * 3600)
 
 #define COVER_SMALL "small"
 #define COVER_MEDIUM "medium"
@@ -52,6 +57,10 @@ gboolean ario_cover_lastfm_get_covers (ArioCoverProvider *cover_provider,
                                        GSList **file_contents,
                                        ArioCoverProviderOperation operation);
 
+/* Covers can be searched by several threads at the same time */
+static GMutex request_mutex;
+static gint64 next_request_time = 0;
+
 G_DEFINE_TYPE (ArioCoverLastfm, ario_cover_lastfm, ARIO_TYPE_COVER_PROVIDER)
 
 static gchar *
@@ -179,6 +188,7 @@ ario_cover_lastfm_make_xml_uri (const char *artist,
         char *xml_uri;
         char *formated_artist;
         char *formated_album;
+        const char *root;
 
         if (!album || !artist)
                 return NULL;
@@ -193,8 +203,13 @@ ario_cover_lastfm_make_xml_uri (const char *artist,
         formated_artist = ario_util_format_keyword_for_lastfm (artist);
         formated_album = ario_util_format_keyword_for_lastfm (album);
 
+        /* The web services root can be replaced by a local server for tests */
+        root = g_getenv ("ARIO_LASTFM_ROOT");
+        if (!root)
+                root = LASTFM_ROOT;
+
         /* We make the xml uri with all the parameters */
-        xml_uri = g_strdup_printf (LASTFM_URI, LASTFM_API_KEY,
+        xml_uri = g_strdup_printf (LASTFM_URI, root, LASTFM_API_KEY,
                                    formated_artist, formated_album);
 
         g_free (formated_artist);
@@ -203,6 +218,24 @@ ario_cover_lastfm_make_xml_uri (const char *artist,
         return xml_uri;
 }
 
+static void
+ario_cover_lastfm_wait_request (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        gint64 now, wait = 0;
+
+        /* Book the next free slot and wait for it outside of the lock */
+        g_mutex_lock (&request_mutex);
+        now = g_get_monotonic_time ();
+        if (next_request_time > now)
+                wait = next_request_time - now;
+        next_request_time = MAX (now, next_request_time) + LASTFM_REQUEST_INTERVAL;
+        g_mutex_unlock (&request_mutex);
+
+        if (wait)
+                g_usleep (wait);
+}
+
 gboolean
 ario_cover_lastfm_get_covers (ArioCoverProvider *cover_provider,
                               const char *artist,
@@ -230,10 +263,12 @@ ario_cover_lastfm_get_covers (ArioCoverProvider *cover_provider,
                 return FALSE;
 
         /* We load the xml file in xml_data */
-        ario_util_download_file (xml_uri,
-                                 NULL, 0, NULL,
-                                 &xml_size,
-                                 &xml_data);
+        if (!ario_util_download_file_is_cached (xml_uri, LASTFM_CACHE_TTL))
+                ario_cover_lastfm_wait_request ();
+        ario_util_download_file_cached (xml_uri,
+                                        LASTFM_CACHE_TTL,
+                                        &xml_size,
+                                        &xml_data);
         g_free (xml_uri);
 
         if (xml_size == 0) {
@@ -0,0 +1,765 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "covers/ario-cover-pack.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include "ario-util.h"
+#include "ario-debug.h"
+
+/*
+ * Pack file format:
+ *   "ARIOPACK" + version (guint32)
+ *   records: key length (guint32), data length (guint32),
+ *            check (guint32), key, data
+ * Integers are little endian. A record with no data removes the
+ * cover. The check covers the record header and key so that a record
+ * partially written (crash during a save) ends the pack.
+ */
+#define PACK_FILENAME "covers.pack"
+#define PACK_MAGIC "ARIOPACK"
+#define PACK_MAGIC_LEN 8
+#define PACK_VERSION 1
+#define PACK_HEADER_SIZE (PACK_MAGIC_LEN + 4)
+#define PACK_RECORD_HEADER_SIZE 12
+
+/*
+ * Index file format, saved next to the pack so that the pack is not
+ * read on startup:
+ *   "ARIOPIDX" + version (guint32)
+ *   end of the indexed records (guint64), offset of the last indexed
+ *   record (guint64), check of this record (guint32), dead space
+ *   (guint64), number of entries (guint32)
+ *   entries: key length (guint32), data offset (guint64),
+ *            data length (guint32), key
+ * Records appended after the indexed ones are read from the pack.
+ */
+#define INDEX_FILENAME "covers.pack.index"
+#define INDEX_MAGIC "ARIOPIDX"
+#define INDEX_VERSION 1
+#define INDEX_HEADER_SIZE (PACK_MAGIC_LEN + 36)
+#define INDEX_ENTRY_HEADER_SIZE 16
+/* The index is saved again once this size of records is not in it */
+#define INDEX_SAVE_SIZE (4 * 1024 * 1024)
+
+/* Replaced and removed covers are dropped from the pack once they take
+ * more than a quarter of it */
+#define PACK_COMPACT_MIN_DEAD (1024 * 1024)
+#define PACK_COMPACT_RATIO 4
+
+/* Position of a cover in the pack */
+typedef struct ArioCoverPackEntry
+{
+        gsize offset;
+        gsize size;
+} ArioCoverPackEntry;
+
+/* Covers are read by threads and saved by the cover handler thread */
+static GMutex pack_mutex;
+static gboolean pack_loaded = FALSE;
+/* NULL if there is no pack */
+static GMappedFile *pack_file = NULL;
+/* key -> ArioCoverPackEntry */
+static GHashTable *pack_index = NULL;
+/* End of the last valid record */
+static gsize pack_end = 0;
+/* Offset of the last valid record (0 if there is none) */
+static gsize pack_last = 0;
+/* End of the records in the saved index */
+static gsize pack_indexed_end = 0;
+/* Size of the replaced and removed records */
+static gsize pack_dead = 0;
+
+static gchar *
+ario_cover_pack_get_path (void)
+{
+        return g_build_filename (ario_util_config_dir (), "covers", PACK_FILENAME, NULL);
+}
+
+static gchar *
+ario_cover_pack_get_index_path (void)
+{
+        return g_build_filename (ario_util_config_dir (), "covers", INDEX_FILENAME, NULL);
+}
+
+static guint32
+ario_cover_pack_read_uint32 (const gchar *data)
+{
+        guint32 value;
+
+        memcpy (&value, data, sizeof (guint32));
+        return GUINT32_FROM_LE (value);
+}
+
+static guint64
+ario_cover_pack_read_uint64 (const gchar *data)
+{
+        guint64 value;
+
+        memcpy (&value, data, sizeof (guint64));
+        return GUINT64_FROM_LE (value);
+}
+
+static void
+ario_cover_pack_append_uint32 (GByteArray *array,
+                               const guint32 value)
+{
+        guint32 le_value = GUINT32_TO_LE (value);
+
+        g_byte_array_append (array, (const guint8 *) &le_value, sizeof (guint32));
+}
+
+static void
+ario_cover_pack_append_uint64 (GByteArray *array,
+                               const guint64 value)
+{
+        guint64 le_value = GUINT64_TO_LE (value);
+
+        g_byte_array_append (array, (const guint8 *) &le_value, sizeof (guint64));
+}
+
+static guint32
+ario_cover_pack_check (const guint32 key_len,
+                       const guint32 data_len,
+                       const gchar *key)
+{
+        guint32 hash = 2166136261u;
+        guint32 i;
+
+        /* FNV-1a hash of the record header and key */
+        hash = (hash ^ key_len) * 16777619u;
+        hash = (hash ^ data_len) * 16777619u;
+        for (i = 0; i < key_len; ++i)
+                hash = (hash ^ (guchar) key[i]) * 16777619u;
+
+        return hash;
+}
+
+static GHashTable *
+ario_cover_pack_index_new (void)
+{
+        return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+/* Fill index with the covers of a mapped pack, from the record at offset
+ * (0 for the whole pack), and update pack_last and pack_dead. Returns the
+ * end of the last valid record or 0 if the file is not a pack */
+static gsize
+ario_cover_pack_index_load (GMappedFile *file,
+                            GHashTable *index,
+                            gsize offset)
+{
+        ARIO_LOG_FUNCTION_START;
+        const gchar *contents = g_mapped_file_get_contents (file);
+        gsize length = g_mapped_file_get_length (file);
+        guint32 key_len, data_len;
+        ArioCoverPackEntry *entry, *previous;
+        gchar *key;
+
+        if (length < PACK_HEADER_SIZE
+            || memcmp (contents, PACK_MAGIC, PACK_MAGIC_LEN)
+            || ario_cover_pack_read_uint32 (contents + PACK_MAGIC_LEN) != PACK_VERSION)
+                return 0;
+
+        offset = MAX (offset, PACK_HEADER_SIZE);
+        while (length - offset >= PACK_RECORD_HEADER_SIZE) {
+                key_len = ario_cover_pack_read_uint32 (contents + offset);
+                data_len = ario_cover_pack_read_uint32 (contents + offset + 4);
+
+                /* Stop at the first truncated or corrupted record */
+                if (key_len == 0
+                    || key_len > length - offset - PACK_RECORD_HEADER_SIZE
+                    || data_len > length - offset - PACK_RECORD_HEADER_SIZE - key_len
+                    || ario_cover_pack_read_uint32 (contents + offset + 8)
+                       != ario_cover_pack_check (key_len, data_len, contents + offset + PACK_RECORD_HEADER_SIZE))
+                        break;
+
+                /* Last record of a key replaces the previous ones, which
+                 * become dead space like the removal records */
+                key = g_strndup (contents + offset + PACK_RECORD_HEADER_SIZE, key_len);
+                previous = g_hash_table_lookup (index, key);
+                if (previous)
+                        pack_dead += PACK_RECORD_HEADER_SIZE + key_len + previous->size;
+
+                if (data_len) {
+                        entry = (ArioCoverPackEntry *) g_malloc0 (sizeof (ArioCoverPackEntry));
+                        entry->offset = offset + PACK_RECORD_HEADER_SIZE + key_len;
+                        entry->size = data_len;
+                        g_hash_table_replace (index, key, entry);
+                } else {
+                        pack_dead += PACK_RECORD_HEADER_SIZE + key_len;
+                        g_hash_table_remove (index, key);
+                        g_free (key);
+                }
+
+                pack_last = offset;
+                offset += PACK_RECORD_HEADER_SIZE + key_len + data_len;
+        }
+
+        return offset;
+}
+
+/* Fill index with the saved index of a mapped pack, and set pack_last and
+ * pack_dead. Returns the end of the indexed records or 0 if there is no
+ * valid saved index for this pack */
+static gsize
+ario_cover_pack_index_read (GMappedFile *file,
+                            GHashTable *index)
+{
+        ARIO_LOG_FUNCTION_START;
+        const gchar *contents = g_mapped_file_get_contents (file);
+        gsize length = g_mapped_file_get_length (file);
+        gchar *path, *path_fse;
+        gchar *data = NULL;
+        gsize data_len, pos;
+        guint64 end, last, offset;
+        guint32 check, count, key_len, size, i;
+        ArioCoverPackEntry *entry;
+        gsize ret = 0;
+
+        path = ario_cover_pack_get_index_path ();
+        path_fse = g_filename_from_utf8 (path, -1, NULL, NULL, NULL);
+        if (!path_fse
+            || !g_file_get_contents (path_fse, &data, &data_len, NULL)
+            || data_len < INDEX_HEADER_SIZE
+            || memcmp (data, INDEX_MAGIC, PACK_MAGIC_LEN)
+            || ario_cover_pack_read_uint32 (data + PACK_MAGIC_LEN) != INDEX_VERSION)
+                goto out;
+
+        end = ario_cover_pack_read_uint64 (data + PACK_MAGIC_LEN + 4);
+        last = ario_cover_pack_read_uint64 (data + PACK_MAGIC_LEN + 12);
+        check = ario_cover_pack_read_uint32 (data + PACK_MAGIC_LEN + 20);
+        count = ario_cover_pack_read_uint32 (data + PACK_MAGIC_LEN + 32);
+
+        /* The index is only used for the pack it was saved for: the
+         * last indexed record must be the same */
+        if (end < PACK_HEADER_SIZE || end > length)
+                goto out;
+        if (last) {
+                if (last < PACK_HEADER_SIZE
+                    || last > end - PACK_RECORD_HEADER_SIZE
+                    || ario_cover_pack_read_uint32 (contents + last + 8) != check)
+                        goto out;
+        } else if (end != PACK_HEADER_SIZE) {
+                goto out;
+        }
+
+        pos = INDEX_HEADER_SIZE;
+        for (i = 0; i < count; ++i) {
+                if (data_len - pos < INDEX_ENTRY_HEADER_SIZE)
+                        break;
+                key_len = ario_cover_pack_read_uint32 (data + pos);
+                offset = ario_cover_pack_read_uint64 (data + pos + 4);
+                size = ario_cover_pack_read_uint32 (data + pos + 12);
+                pos += INDEX_ENTRY_HEADER_SIZE;
+
+                if (key_len == 0
+                    || key_len > data_len - pos
+                    || offset > end
+                    || size > end - offset)
+                        break;
+
+                entry = (ArioCoverPackEntry *) g_malloc0 (sizeof (ArioCoverPackEntry));
+                entry->offset = offset;
+                entry->size = size;
+                g_hash_table_replace (index, g_strndup (data + pos, key_len), entry);
+                pos += key_len;
+        }
+
+        if (i < count) {
+                ARIO_LOG_ERROR ("%s is not a valid cover index", path);
+                g_hash_table_remove_all (index);
+                goto out;
+        }
+
+        pack_last = last;
+        pack_dead = ario_cover_pack_read_uint64 (data + PACK_MAGIC_LEN + 24);
+        ret = end;
+
+out:
+        g_free (data);
+        g_free (path_fse);
+        g_free (path);
+
+        return ret;
+}
+
+/* Must be called with pack_mutex locked */
+static void
+ario_cover_pack_index_save (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        const gchar *contents = g_mapped_file_get_contents (pack_file);
+        GByteArray *array;
+        GHashTableIter iter;
+        const gchar *key;
+        ArioCoverPackEntry *entry;
+        gchar *path, *path_fse;
+        guint32 key_len;
+
+        array = g_byte_array_new ();
+        g_byte_array_append (array, (const guint8 *) INDEX_MAGIC, PACK_MAGIC_LEN);
+        ario_cover_pack_append_uint32 (array, INDEX_VERSION);
+        ario_cover_pack_append_uint64 (array, pack_end);
+        ario_cover_pack_append_uint64 (array, pack_last);
+        ario_cover_pack_append_uint32 (array, pack_last ? ario_cover_pack_read_uint32 (contents + pack_last + 8) : 0);
+        ario_cover_pack_append_uint64 (array, pack_dead);
+        ario_cover_pack_append_uint32 (array, g_hash_table_size (pack_index));
+
+        g_hash_table_iter_init (&iter, pack_index);
+        while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &entry)) {
+                key_len = strlen (key);
+                ario_cover_pack_append_uint32 (array, key_len);
+                ario_cover_pack_append_uint64 (array, entry->offset);
+                ario_cover_pack_append_uint32 (array, entry->size);
+                g_byte_array_append (array, (const guint8 *) key, key_len);
+        }
+
+        /* The index is replaced atomically */
+        path = ario_cover_pack_get_index_path ();
+        path_fse = g_filename_from_utf8 (path, -1, NULL, NULL, NULL);
+        if (path_fse && g_file_set_contents (path_fse, (const gchar *) array->data, array->len, NULL))
+                pack_indexed_end = pack_end;
+        else
+                ARIO_LOG_ERROR ("Unable to write cover index in %s", path);
+
+        g_free (path_fse);
+        g_free (path);
+        g_byte_array_free (array, TRUE);
+}
+
+static GMappedFile *
+ario_cover_pack_map (const gchar *path)
+{
+        ARIO_LOG_FUNCTION_START;
+        GMappedFile *file;
+        gchar *path_fse;
+
+        path_fse = g_filename_from_utf8 (path, -1, NULL, NULL, NULL);
+        if (!path_fse)
+                return NULL;
+
+        file = g_mapped_file_new (path_fse, FALSE, NULL);
+        g_free (path_fse);
+
+        return file;
+}
+
+static void
+ario_cover_pack_unload (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (pack_file) {
+                g_mapped_file_unref (pack_file);
+                pack_file = NULL;
+        }
+        if (pack_index) {
+                g_hash_table_destroy (pack_index);
+                pack_index = NULL;
+        }
+        pack_end = 0;
+        pack_last = 0;
+        pack_indexed_end = 0;
+        pack_dead = 0;
+        pack_loaded = FALSE;
+}
+
+/* Must be called with pack_mutex locked */
+static void
+ario_cover_pack_load (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *path;
+
+        if (pack_loaded)
+                return;
+        pack_loaded = TRUE;
+
+        path = ario_cover_pack_get_path ();
+        if (ario_util_uri_exists (path)) {
+                pack_file = ario_cover_pack_map (path);
+                if (pack_file) {
+                        pack_index = ario_cover_pack_index_new ();
+                        /* Only the records appended after the saved
+                         * index are read from the pack */
+                        pack_indexed_end = ario_cover_pack_index_read (pack_file, pack_index);
+                        pack_end = ario_cover_pack_index_load (pack_file, pack_index, pack_indexed_end);
+                        if (!pack_end) {
+                                ARIO_LOG_ERROR ("%s is not a valid cover pack", path);
+                                ario_cover_pack_unload ();
+                                pack_loaded = TRUE;
+                        } else if (pack_end != pack_indexed_end) {
+                                ario_cover_pack_index_save ();
+                        }
+                }
+        }
+        g_free (path);
+}
+
+gboolean
+ario_cover_pack_is_enabled (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        gboolean ret;
+
+        g_mutex_lock (&pack_mutex);
+        ario_cover_pack_load ();
+        ret = (pack_index != NULL);
+        g_mutex_unlock (&pack_mutex);
+
+        return ret;
+}
+
+gboolean
+ario_cover_pack_contains (const gchar *key)
+{
+        ARIO_LOG_FUNCTION_START;
+        gboolean ret;
+
+        g_mutex_lock (&pack_mutex);
+        ario_cover_pack_load ();
+        ret = pack_index && g_hash_table_contains (pack_index, key);
+        g_mutex_unlock (&pack_mutex);
+
+        return ret;
+}
+
+GBytes *
+ario_cover_pack_lookup (const gchar *key)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverPackEntry *entry;
+        GBytes *bytes = NULL;
+
+        g_mutex_lock (&pack_mutex);
+        ario_cover_pack_load ();
+        if (pack_index) {
+                entry = g_hash_table_lookup (pack_index, key);
+                /* Data stays valid as long as the mapping is referenced */
+                if (entry)
+                        bytes = g_bytes_new_with_free_func (g_mapped_file_get_contents (pack_file) + entry->offset,
+                                                            entry->size,
+                                                            (GDestroyNotify) g_mapped_file_unref,
+                                                            g_mapped_file_ref (pack_file));
+        }
+        g_mutex_unlock (&pack_mutex);
+
+        return bytes;
+}
+
+static gboolean
+ario_cover_pack_write_record (FILE *file,
+                              const gchar *key,
+                              const gchar *data,
+                              const gsize size)
+{
+        guint32 header[3];
+        guint32 key_len = strlen (key);
+
+        header[0] = GUINT32_TO_LE (key_len);
+        header[1] = GUINT32_TO_LE ((guint32) size);
+        header[2] = GUINT32_TO_LE (ario_cover_pack_check (key_len, size, key));
+
+        return fwrite (header, PACK_RECORD_HEADER_SIZE, 1, file) == 1
+                && fwrite (key, key_len, 1, file) == 1
+                && (!size || fwrite (data, size, 1, file) == 1);
+}
+
+static gboolean
+ario_cover_pack_write_header (FILE *file)
+{
+        guint32 version = GUINT32_TO_LE (PACK_VERSION);
+
+        return fwrite (PACK_MAGIC, PACK_MAGIC_LEN, 1, file) == 1
+                && fwrite (&version, sizeof (guint32), 1, file) == 1;
+}
+
+static FILE *
+ario_cover_pack_open (const gchar *path,
+                      const gchar *mode)
+{
+        FILE *file;
+        gchar *path_fse;
+
+        path_fse = g_filename_from_utf8 (path, -1, NULL, NULL, NULL);
+        if (!path_fse)
+                return NULL;
+
+        file = g_fopen (path_fse, mode);
+        g_free (path_fse);
+
+        return file;
+}
+
+/* Copy the covers of the pack which are not in written yet */
+static gboolean
+ario_cover_pack_write_live_records (FILE *file,
+                                    GHashTable *written)
+{
+        ARIO_LOG_FUNCTION_START;
+        GHashTableIter iter;
+        const gchar *key;
+        ArioCoverPackEntry *entry;
+        gboolean ok = TRUE;
+
+        if (!pack_index)
+                return TRUE;
+
+        g_hash_table_iter_init (&iter, pack_index);
+        while (ok && g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &entry)) {
+                if (g_hash_table_contains (written, key))
+                        continue;
+                ok = ario_cover_pack_write_record (file, key,
+                                                   g_mapped_file_get_contents (pack_file) + entry->offset,
+                                                   entry->size);
+                if (ok)
+                        g_hash_table_add (written, g_strdup (key));
+        }
+
+        return ok;
+}
+
+/* Replace the pack by the one written in tmp_path. The pack is loaded
+ * again in any case, and a new index is saved for it */
+static gboolean
+ario_cover_pack_replace (const gchar *tmp_path,
+                         const gchar *path)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *path_fse, *tmp_path_fse, *index_path;
+        gboolean ret;
+
+        /* The saved index does not match the new pack */
+        index_path = ario_cover_pack_get_index_path ();
+        ario_util_unlink_uri (index_path);
+        g_free (index_path);
+
+        ario_cover_pack_unload ();
+        path_fse = g_filename_from_utf8 (path, -1, NULL, NULL, NULL);
+        tmp_path_fse = g_filename_from_utf8 (tmp_path, -1, NULL, NULL, NULL);
+        ret = path_fse && tmp_path_fse && g_rename (tmp_path_fse, path_fse) == 0;
+        g_free (path_fse);
+        g_free (tmp_path_fse);
+
+        ario_cover_pack_load ();
+
+        return ret;
+}
+
+/* Must be called with pack_mutex locked */
+static void
+ario_cover_pack_compact (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *path, *tmp_path;
+        GHashTable *written;
+        FILE *file;
+        gboolean ok = FALSE;
+
+        path = ario_cover_pack_get_path ();
+        tmp_path = g_strconcat (path, ".tmp", NULL);
+
+        file = ario_cover_pack_open (tmp_path, "wb");
+        if (file) {
+                written = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+                ok = ario_cover_pack_write_header (file)
+                        && ario_cover_pack_write_live_records (file, written);
+                ok = (fclose (file) == 0) && ok;
+                g_hash_table_destroy (written);
+
+                ok = ok && ario_cover_pack_replace (tmp_path, path);
+        }
+
+        if (!ok) {
+                ARIO_LOG_ERROR ("Unable to compact cover pack %s", path);
+                ario_util_unlink_uri (tmp_path);
+        }
+
+        g_free (tmp_path);
+        g_free (path);
+}
+
+gboolean
+ario_cover_pack_write (const gchar *key,
+                       const gchar *data,
+                       const gsize size)
+{
+        ARIO_LOG_FUNCTION_START;
+        FILE *file;
+        GMappedFile *mapped_file = NULL;
+        gchar *path;
+        gboolean ret = FALSE;
+
+        if (data && size == 0)
+                return FALSE;
+
+        g_mutex_lock (&pack_mutex);
+        ario_cover_pack_load ();
+        if (!pack_index) {
+                g_mutex_unlock (&pack_mutex);
+                return FALSE;
+        }
+
+        /* Records are only appended, after the last valid one */
+        path = ario_cover_pack_get_path ();
+        file = ario_cover_pack_open (path, "r+b");
+        if (file) {
+                ret = fseek (file, pack_end, SEEK_SET) == 0
+                        && ario_cover_pack_write_record (file, key, data, data ? size : 0);
+                ret = (fclose (file) == 0) && ret;
+        }
+
+        /* Map the pack again to see the new record and only add this
+         * record to the index. Covers returned before keep the previous
+         * mapping */
+        if (ret)
+                mapped_file = ario_cover_pack_map (path);
+        if (mapped_file) {
+                g_mapped_file_unref (pack_file);
+                pack_file = mapped_file;
+                pack_end = ario_cover_pack_index_load (pack_file, pack_index, pack_end);
+                if (!pack_end)
+                        ario_cover_pack_unload ();
+                else if (pack_dead > PACK_COMPACT_MIN_DEAD
+                         && pack_dead > pack_end / PACK_COMPACT_RATIO)
+                        ario_cover_pack_compact ();
+                else if (pack_end - pack_indexed_end > INDEX_SAVE_SIZE)
+                        ario_cover_pack_index_save ();
+        } else if (ret) {
+                /* The pack is read again on next use */
+                ario_cover_pack_unload ();
+        } else {
+                ARIO_LOG_ERROR ("Unable to write cover in %s", path);
+        }
+        g_free (path);
+        g_mutex_unlock (&pack_mutex);
+
+        return ret;
+}
+
+static gboolean
+ario_cover_pack_import_file (FILE *file,
+                             const gchar *key,
+                             const gchar *path)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *contents;
+        gsize length;
+        gboolean ret;
+
+        if (!ario_file_get_contents (path, &contents, &length, NULL))
+                return FALSE;
+
+        ret = length > 0 && ario_cover_pack_write_record (file, key, contents, length);
+        g_free (contents);
+
+        return ret;
+}
+
+gint
+ario_cover_pack_import (GError **error)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *covers_dir, *path, *tmp_path, *file_path;
+        gchar *dir_fse;
+        const gchar *name;
+        gchar *key;
+        GDir *dir;
+        FILE *file;
+        GHashTable *written;
+        GSList *imported = NULL, *tmp;
+        gboolean ok;
+        gint nb = -1;
+
+        covers_dir = g_build_filename (ario_util_config_dir (), "covers", NULL);
+        path = ario_cover_pack_get_path ();
+        tmp_path = g_strconcat (path, ".tmp", NULL);
+
+        g_mutex_lock (&pack_mutex);
+        ario_cover_pack_load ();
+
+        file = ario_cover_pack_open (tmp_path, "wb");
+        if (!file) {
+                g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                             "Could not write to file `%s'", tmp_path);
+                goto out;
+        }
+
+        written = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        ok = ario_cover_pack_write_header (file);
+
+        /* Cover files are newer than the covers of the pack */
+        dir_fse = g_filename_from_utf8 (covers_dir, -1, NULL, NULL, NULL);
+        dir = dir_fse ? g_dir_open (dir_fse, 0, NULL) : NULL;
+        g_free (dir_fse);
+        if (dir) {
+                while (ok && (name = g_dir_read_name (dir))) {
+                        if (!g_str_has_suffix (name, ".jpg"))
+                                continue;
+
+                        key = g_filename_to_utf8 (name, -1, NULL, NULL, NULL);
+                        if (!key)
+                                continue;
+
+                        file_path = g_build_filename (covers_dir, key, NULL);
+                        if (ario_cover_pack_import_file (file, key, file_path)) {
+                                g_hash_table_add (written, key);
+                                imported = g_slist_prepend (imported, file_path);
+                        } else {
+                                g_free (key);
+                                g_free (file_path);
+                        }
+                }
+                g_dir_close (dir);
+        }
+
+        /* Keep the covers of the previous pack, without the removed or
+         * replaced ones */
+        ok = ok && ario_cover_pack_write_live_records (file, written);
+
+        ok = (fclose (file) == 0) && ok;
+        nb = g_hash_table_size (written);
+        g_hash_table_destroy (written);
+
+        /* Replace the previous pack */
+        ok = ok && ario_cover_pack_replace (tmp_path, path);
+
+        if (ok) {
+                /* Cover files are now in the pack */
+                g_slist_foreach (imported, (GFunc) ario_util_unlink_uri, NULL);
+        } else {
+                ario_util_unlink_uri (tmp_path);
+                g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                             "Could not write to file `%s'", path);
+                nb = -1;
+        }
+
+        g_slist_foreach (imported, (GFunc) g_free, NULL);
+        g_slist_free (imported);
+
+out:
+        g_mutex_unlock (&pack_mutex);
+        g_free (tmp_path);
+        g_free (path);
+        g_free (covers_dir);
+
+        return nb;
+}
@@ -0,0 +1,61 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ARIO_COVER_PACK_H
+#define __ARIO_COVER_PACK_H
+
+#include <glib.h>
+#include <gmodule.h>
+
+G_BEGIN_DECLS
+
+/*
+ * The cover pack is an optional store replacing the cover files of
+ * ~/.config/ario/covers by a single append-only file. Each record
+ * associates a key (the name the cover file would have) to the JPEG
+ * data of the cover. The file is mapped in memory and indexed in a
+ * hash table when it is first used, so lookups do not need any
+ * system call. The index is saved next to the pack: only the records
+ * appended after it are read on first use. Replaced and removed covers
+ * are dropped automatically once they take a quarter of the pack. The
+ * pack is used only if it exists: it is created by
+ * ario_cover_pack_import.
+ */
+
+gboolean                ario_cover_pack_is_enabled      (void);
+
+gboolean                ario_cover_pack_contains        (const gchar *key);
+
+/* Returns the data of the cover or NULL if there is none */
+GBytes *                ario_cover_pack_lookup          (const gchar *key);
+
+/* Append a cover to the pack, or remove it if data is NULL */
+gboolean                ario_cover_pack_write           (const gchar *key,
+                                                         const gchar *data,
+                                                         const gsize size);
+
+/* Move all the cover files in the pack (creating it if needed) and
+ * drop removed or replaced covers from it. Returns the number of
+ * covers in the pack or -1 on error */
+G_MODULE_EXPORT
+gint                    ario_cover_pack_import          (GError **error);
+
+G_END_DECLS
+
+#endif /* __ARIO_COVER_PACK_H */
@@ -24,16 +24,47 @@
 #include <glib/gi18n.h>
 #include "ario-util.h"
 #include "ario-debug.h"
+#include "covers/ario-cover-handler.h"
+#include "covers/ario-cover-pack.h"
+
+/* Maximum memory used by decoded covers kept in memory */
+#define CACHE_MAX_SIZE (32 * 1024 * 1024)
+/* Memory accounted for a cover that does not exist */
+#define CACHE_MISSING_SIZE 64
 
 static void ario_cover_create_ario_cover_dir (void);
+static void ario_cover_cache_remove (const gchar *artist,
+                                     const gchar *album);
 
-gchar *
-ario_cover_make_cover_path (const gchar *artist,
-                            const gchar *album,
-                            const ArioCoverHomeCoversSize ario_cover_size)
+/* Decoded cover kept in memory */
+typedef struct ArioCoverCacheEntry
+{
+        gchar *key;
+
+        /* NULL if there is no cover */
+        GdkPixbuf *pixbuf;
+
+        gsize size;
+} ArioCoverCacheEntry;
+
+/* Covers are shared by all widgets and can be loaded by threads */
+static GMutex cache_mutex;
+/* key -> link in cache_lru */
+static GHashTable *cache_table = NULL;
+/* Most recently used entries first */
+static GQueue cache_lru = G_QUEUE_INIT;
+static gsize cache_size = 0;
+/* Incremented each time covers are removed from the cache: covers decoded
+ * before are not inserted as they may be outdated */
+static guint cache_generation = 0;
+
+/* Name of the cover file, also used as key in the cover pack */
+static gchar *
+ario_cover_make_cover_filename (const gchar *artist,
+                                const gchar *album,
+                                const ArioCoverHomeCoversSize ario_cover_size)
 {
         ARIO_LOG_FUNCTION_START;
-        char *ario_cover_path;
         char *filename;
 
         if (!artist || !album)
@@ -48,6 +79,22 @@ ario_cover_make_cover_path (const gchar *artist,
 
         ario_util_sanitize_filename (filename);
 
+        return filename;
+}
+
+gchar *
+ario_cover_make_cover_path (const gchar *artist,
+                            const gchar *album,
+                            const ArioCoverHomeCoversSize ario_cover_size)
+{
+        ARIO_LOG_FUNCTION_START;
+        char *ario_cover_path;
+        char *filename;
+
+        filename = ario_cover_make_cover_filename (artist, album, ario_cover_size);
+        if (!filename)
+                return NULL;
+
         /* The returned path is ~/.config/ario/covers/filename */
         ario_cover_path = g_build_filename (ario_util_config_dir (), "covers", filename, NULL);
         g_free (filename);
@@ -63,6 +110,19 @@ ario_cover_cover_exists (const gchar *artist,
         gchar *ario_cover_path, *small_ario_cover_path;
         gboolean result;
 
+        if (!artist || !album)
+                return FALSE;
+
+        /* Covers are in the pack: no need to check files */
+        if (ario_cover_pack_is_enabled ()) {
+                ario_cover_path = ario_cover_make_cover_filename (artist, album, NORMAL_COVER);
+                small_ario_cover_path = ario_cover_make_cover_filename (artist, album, SMALL_COVER);
+                result = (ario_cover_pack_contains (ario_cover_path) && ario_cover_pack_contains (small_ario_cover_path));
+                g_free (ario_cover_path);
+                g_free (small_ario_cover_path);
+                return result;
+        }
+
         /* The path for the normal cover */
         ario_cover_path = ario_cover_make_cover_path (artist,
                                                       album,
@@ -115,6 +175,21 @@ ario_cover_remove_cover (const gchar *artist,
         if (!ario_cover_cover_exists (artist, album))
                 return;
 
+        if (ario_cover_pack_is_enabled ()) {
+                /* Remove covers from the pack */
+                small_ario_cover_path = ario_cover_make_cover_filename (artist, album, SMALL_COVER);
+                ario_cover_pack_write (small_ario_cover_path, NULL, 0);
+                g_free (small_ario_cover_path);
+
+                ario_cover_path = ario_cover_make_cover_filename (artist, album, NORMAL_COVER);
+                ario_cover_pack_write (ario_cover_path, NULL, 0);
+                g_free (ario_cover_path);
+
+                ario_cover_cache_remove (artist, album);
+                ario_cover_handler_album_cover_changed (artist, album);
+                return;
+        }
+
         /* Delete the small cover*/
         small_ario_cover_path = ario_cover_make_cover_path (artist, album, SMALL_COVER);
         if (ario_util_uri_exists (small_ario_cover_path))
@@ -126,6 +201,9 @@ ario_cover_remove_cover (const gchar *artist,
         if (ario_util_uri_exists (ario_cover_path))
                 ario_util_unlink_uri (ario_cover_path);
         g_free (ario_cover_path);
+
+        ario_cover_cache_remove (artist, album);
+        ario_cover_handler_album_cover_changed (artist, album);
 }
 
 static gboolean
@@ -170,6 +248,37 @@ ario_cover_can_overwrite_cover (const gchar *artist,
         return TRUE;
 }
 
+static gboolean
+ario_cover_save_cover_in_pack (const gchar *artist,
+                               const gchar *album,
+                               GdkPixbuf *pixbuf,
+                               GdkPixbuf *small_pixbuf)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *key, *small_key;
+        gchar *data = NULL, *small_data = NULL;
+        gsize size, small_size;
+        gboolean ret = FALSE;
+
+        key = ario_cover_make_cover_filename (artist, album, NORMAL_COVER);
+        small_key = ario_cover_make_cover_filename (artist, album, SMALL_COVER);
+
+        if (gdk_pixbuf_save_to_buffer (pixbuf, &data, &size, "jpeg", NULL, NULL)
+            && gdk_pixbuf_save_to_buffer (small_pixbuf, &small_data, &small_size, "jpeg", NULL, "quality", "95", NULL)) {
+                /* The small cover is written last: the cover exists only
+                 * once both are in the pack */
+                ret = ario_cover_pack_write (key, data, size)
+                        && ario_cover_pack_write (small_key, small_data, small_size);
+        }
+
+        g_free (data);
+        g_free (small_data);
+        g_free (key);
+        g_free (small_key);
+
+        return ret;
+}
+
 gboolean
 ario_cover_save_cover (const gchar *artist,
                        const gchar *album,
@@ -235,20 +344,25 @@ ario_cover_save_cover (const gchar *artist,
                                                                 GDK_INTERP_BILINEAR);
                 }
 
-                path_fse = g_filename_from_utf8 (ario_cover_path, -1, NULL, NULL, NULL);
-                small_path_fse = g_filename_from_utf8 (small_ario_cover_path, -1, NULL, NULL, NULL);
-
-                /* We save the normal and the small covers */
-                if (path_fse && small_path_fse &&
-                    gdk_pixbuf_save (pixbuf, ario_cover_path, "jpeg", NULL, NULL) &&
-                    gdk_pixbuf_save (small_pixbuf, small_ario_cover_path, "jpeg", NULL, "quality", "95", NULL)) {
-                        /* If we succeed in the 2 operations, we return OK */
-                        ret = TRUE;
+                if (ario_cover_pack_is_enabled ()) {
+                        /* We append the normal and the small covers to the pack */
+                        ret = ario_cover_save_cover_in_pack (artist, album, pixbuf, small_pixbuf);
+                } else {
+                        path_fse = g_filename_from_utf8 (ario_cover_path, -1, NULL, NULL, NULL);
+                        small_path_fse = g_filename_from_utf8 (small_ario_cover_path, -1, NULL, NULL, NULL);
+
+                        /* We save the normal and the small covers */
+                        if (path_fse && small_path_fse &&
+                            gdk_pixbuf_save (pixbuf, ario_cover_path, "jpeg", NULL, NULL) &&
+                            gdk_pixbuf_save (small_pixbuf, small_ario_cover_path, "jpeg", NULL, "quality", "95", NULL)) {
+                                /* If we succeed in the 2 operations, we return OK */
+                                ret = TRUE;
+                        }
+
+                        g_free (small_path_fse);
+                        g_free (path_fse);
                 }
 
-                g_free (small_path_fse);
-                g_free (path_fse);
-
                 g_object_unref (G_OBJECT (pixbuf));
                 g_object_unref (G_OBJECT (small_pixbuf));
         }
@@ -256,5 +370,153 @@ ario_cover_save_cover (const gchar *artist,
         g_free (ario_cover_path);
         g_free (small_ario_cover_path);
 
+        if (ret) {
+                ario_cover_cache_remove (artist, album);
+                ario_cover_handler_album_cover_changed (artist, album);
+        }
+
         return ret;
 }
+
+static gchar *
+ario_cover_cache_make_key (const gchar *artist,
+                           const gchar *album,
+                           const ArioCoverHomeCoversSize ario_cover_size,
+                           const int pixels)
+{
+        return g_strdup_printf ("%s\t%s\t%d\t%d", artist, album, ario_cover_size, pixels);
+}
+
+static void
+ario_cover_cache_free_entry (ArioCoverCacheEntry *entry)
+{
+        g_free (entry->key);
+        if (entry->pixbuf)
+                g_object_unref (entry->pixbuf);
+        g_free (entry);
+}
+
+static void
+ario_cover_cache_remove_link (GList *link)
+{
+        ArioCoverCacheEntry *entry = link->data;
+
+        g_hash_table_remove (cache_table, entry->key);
+        g_queue_delete_link (&cache_lru, link);
+        cache_size -= entry->size;
+        ario_cover_cache_free_entry (entry);
+}
+
+static void
+ario_cover_cache_remove (const gchar *artist,
+                         const gchar *album)
+{
+        ARIO_LOG_FUNCTION_START;
+        GList *tmp, *next;
+        gchar *prefix;
+        ArioCoverCacheEntry *entry;
+
+        if (!artist || !album)
+                return;
+
+        /* Remove all sizes of the album cover */
+        prefix = g_strdup_printf ("%s\t%s\t", artist, album);
+        g_mutex_lock (&cache_mutex);
+        ++cache_generation;
+        for (tmp = cache_lru.head; tmp; tmp = next) {
+                next = g_list_next (tmp);
+                entry = tmp->data;
+                if (g_str_has_prefix (entry->key, prefix))
+                        ario_cover_cache_remove_link (tmp);
+        }
+        g_mutex_unlock (&cache_mutex);
+        g_free (prefix);
+}
+
+GdkPixbuf *
+ario_cover_get_pixbuf (const gchar *artist,
+                       const gchar *album,
+                       const ArioCoverHomeCoversSize ario_cover_size,
+                       const int pixels)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioCoverCacheEntry *entry;
+        GdkPixbuf *pixbuf = NULL;
+        GList *link;
+        gchar *key, *cover_path;
+        GBytes *bytes;
+        GInputStream *stream;
+        guint generation;
+
+        if (!artist || !album)
+                return NULL;
+
+        key = ario_cover_cache_make_key (artist, album, ario_cover_size, pixels);
+
+        g_mutex_lock (&cache_mutex);
+        if (!cache_table)
+                cache_table = g_hash_table_new (g_str_hash, g_str_equal);
+
+        link = g_hash_table_lookup (cache_table, key);
+        if (link) {
+                /* Cover is already decoded: move it at the head of the list */
+                g_queue_unlink (&cache_lru, link);
+                g_queue_push_head_link (&cache_lru, link);
+                entry = link->data;
+                if (entry->pixbuf)
+                        pixbuf = g_object_ref (entry->pixbuf);
+                g_mutex_unlock (&cache_mutex);
+                g_free (key);
+                return pixbuf;
+        }
+        generation = cache_generation;
+        g_mutex_unlock (&cache_mutex);
+
+        /* Decode the cover without blocking other users of the cache */
+        if (ario_cover_pack_is_enabled ()) {
+                cover_path = ario_cover_make_cover_filename (artist, album, ario_cover_size);
+                bytes = ario_cover_pack_lookup (cover_path);
+                if (bytes) {
+                        stream = g_memory_input_stream_new_from_bytes (bytes);
+                        pixbuf = gdk_pixbuf_new_from_stream_at_scale (stream, pixels, pixels, TRUE, NULL, NULL);
+                        g_object_unref (stream);
+                        g_bytes_unref (bytes);
+                }
+        } else {
+                cover_path = ario_cover_make_cover_path (artist, album, ario_cover_size);
+                if (ario_util_uri_exists (cover_path))
+                        pixbuf = gdk_pixbuf_new_from_file_at_size (cover_path, pixels, pixels, NULL);
+        }
+        g_free (cover_path);
+
+        g_mutex_lock (&cache_mutex);
+        /* The cover has changed while it was decoded: the next call
+         * decodes it again */
+        if (generation != cache_generation) {
+                g_mutex_unlock (&cache_mutex);
+                g_free (key);
+                return pixbuf;
+        }
+
+        entry = (ArioCoverCacheEntry *) g_malloc0 (sizeof (ArioCoverCacheEntry));
+        entry->key = key;
+        entry->pixbuf = pixbuf ? g_object_ref (pixbuf) : NULL;
+        entry->size = pixbuf ? gdk_pixbuf_get_byte_length (pixbuf) : CACHE_MISSING_SIZE;
+
+        /* Another thread may have loaded the same cover meanwhile */
+        link = g_hash_table_lookup (cache_table, key);
+        if (link)
+                ario_cover_cache_remove_link (link);
+
+        g_queue_push_head (&cache_lru, entry);
+        g_hash_table_insert (cache_table, entry->key, cache_lru.head);
+        cache_size += entry->size;
+
+        /* Drop least recently used covers */
+        while (cache_size > CACHE_MAX_SIZE
+               && cache_lru.tail != cache_lru.head)
+                ario_cover_cache_remove_link (cache_lru.tail);
+        g_mutex_unlock (&cache_mutex);
+
+        return pixbuf;
+}
@@ -25,6 +25,7 @@
 
 #include <glib.h>
 #include <gmodule.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
 
 G_BEGIN_DECLS
 
@@ -60,6 +61,15 @@ gchar*                       ario_cover_make_cover_path      (const gchar *artis
                                                               const gchar *album,
                                                               const ArioCoverHomeCoversSize ario_cover_size);
 
+/* Returns a new reference to the cover scaled to fit in pixels x pixels,
+ * or NULL if the album has no cover. Decoded covers are kept in a shared
+ * memory cache updated when covers are saved or removed. */
+G_MODULE_EXPORT
+GdkPixbuf*                   ario_cover_get_pixbuf           (const gchar *artist,
+                                                              const gchar *album,
+                                                              const ArioCoverHomeCoversSize ario_cover_size,
+                                                              const int pixels);
+
 G_END_DECLS
 
 #endif /* __ARIO_COVER_H */
@@ -47,6 +47,7 @@
 #  include <ws2tcpip.h>
 #  include <winsock.h>
 #else
+#  include <poll.h>
 #  include <netinet/in.h>
 #  include <arpa/inet.h>
 #  include <sys/socket.h>
@@ -89,6 +90,7 @@ static const char *const idle_names[] = {
 	"mixer",
 	"output",
 	"options",
+	"update",
 	NULL
 };
 
@@ -303,20 +305,135 @@ static char * mpd_sanitizeArg(const char * arg) {
 	return ret;
 }
 
-static mpd_ReturnElement * mpd_newReturnElement(const char * name, const char * value)
-{
-	mpd_ReturnElement * ret = malloc(sizeof(mpd_ReturnElement));
+/* wait until data can be read: returns 1 if it can, 0 on timeout and
+ * -1 on error */
+static int mpd_waitReadable(mpd_Connection * connection) {
+	int err;
+#ifdef WIN32
+	struct timeval tv;
+	fd_set fds;
+
+	do {
+		tv.tv_sec = connection->timeout.tv_sec;
+		tv.tv_usec = connection->timeout.tv_usec;
+		FD_ZERO(&fds);
+		FD_SET(connection->sock,&fds);
+		err = select(connection->sock+1,&fds,NULL,NULL,&tv);
+	} while(err<0 && SELECT_ERRNO_IGNORE);
+#else
+	struct pollfd pfd;
+	int timeout = connection->timeout.tv_sec * 1000 +
+	              connection->timeout.tv_usec / 1000;
+
+	pfd.fd = connection->sock;
+	pfd.events = POLLIN;
+	do {
+		err = poll(&pfd, 1, timeout);
+	} while(err<0 && SELECT_ERRNO_IGNORE);
+#endif
 
-	ret->name = strdup(name);
-	ret->value = strdup(value);
+	return err > 0 ? 1 : err;
+}
 
-	return ret;
+/* make room at the end of the buffer for the next read */
+static int mpd_prepareBuffer(mpd_Connection * connection) {
+	size_t pending = connection->buflen - connection->bufstart;
+	size_t size;
+	char * buffer;
+
+	/* everything has been parsed: start again at the beginning */
+	if(!pending) {
+		connection->buflen = 0;
+		connection->bufstart = 0;
+		connection->bufcheck = 0;
+		return 0;
+	}
+
+	/* drop the parsed lines once the end of the buffer is reached,
+	 * only the start of the current line has to be moved */
+	if(connection->bufstart > 0 &&
+	   connection->bufsize - connection->buflen < connection->bufsize / 4) {
+		memmove(connection->buffer,
+		        connection->buffer + connection->bufstart,
+		        pending);
+		connection->bufcheck -= connection->bufstart;
+		connection->buflen = pending;
+		connection->bufstart = 0;
+	}
+
+	if(connection->buflen < connection->bufsize) return 0;
+
+	/* the current line fills the whole buffer: make it bigger */
+	if(connection->bufsize >= MPD_BUFFER_MAX_LENGTH) return -1;
+	size = connection->bufsize * 2;
+	if(size > MPD_BUFFER_MAX_LENGTH) size = MPD_BUFFER_MAX_LENGTH;
+	buffer = realloc(connection->buffer, size);
+	if(!buffer) return -1;
+	connection->buffer = buffer;
+	connection->bufsize = size;
+
+	return 0;
 }
 
-static void mpd_freeReturnElement(mpd_ReturnElement * re) {
-	free(re->name);
-	free(re->value);
-	free(re);
+/* read the next line of the response, terminated in place in the buffer:
+ * it stays valid until the next call */
+static char * mpd_readLine(mpd_Connection * connection) {
+	char * line;
+	char * end;
+	int readed;
+	int err;
+#ifdef WIN32
+	int wait = 1;
+#else
+	int wait = 0;
+#endif
+
+	while(!(end = memchr(connection->buffer + connection->bufcheck, '\n',
+	                     connection->buflen - connection->bufcheck))) {
+		/* these bytes do not need to be scanned again */
+		connection->bufcheck = connection->buflen;
+
+		if(mpd_prepareBuffer(connection) < 0) {
+			strcpy(connection->errorStr,"buffer overrun");
+			connection->error = MPD_ERROR_1_BUFFEROVERRUN;
+			return NULL;
+		}
+
+		/* only wait when everything available has been read */
+		if(wait) {
+			err = mpd_waitReadable(connection);
+			if(err <= 0) {
+				strcpy(connection->errorStr,"connection timeout");
+				connection->error = MPD_ERROR_1_TIMEOUT;
+				return NULL;
+			}
+		}
+
+		readed = recv(connection->sock,
+		              connection->buffer + connection->buflen,
+		              connection->bufsize - connection->buflen,
+		              MSG_DONTWAIT);
+		if(readed > 0) {
+			connection->buflen += readed;
+			wait = 0;
+			continue;
+		}
+		if(readed<0 && SENDRECV_ERRNO_IGNORE) {
+			wait = 1;
+			continue;
+		}
+
+		strcpy(connection->errorStr,"connection closed");
+		connection->error = MPD_ERROR_1_CONNCLOSED;
+		return NULL;
+	}
+
+	*end = '\0';
+	line = connection->buffer + connection->bufstart;
+	connection->bufstart = end - connection->buffer + 1;
+	connection->bufcheck = connection->bufstart;
+
+	return line;
 }
 
 void mpd_setConnectionTimeout(mpd_Connection * connection, float timeout) {
@@ -361,16 +478,14 @@ static int mpd_parseWelcome(mpd_Connection * connection, const char * host, int
 }
 
 mpd_Connection * mpd_newConnection(const char * host, int port, float timeout) {
-	int err;
-	char * rt;
-	char * output =  NULL;
+	char * output;
 	mpd_Connection * connection = malloc(sizeof(mpd_Connection));
-	struct timeval tv;
-	fd_set fds;
-	strcpy(connection->buffer,"");
 	connection->sock = -1;
+	connection->buffer = malloc(MPD_BUFFER_INITIAL_LENGTH);
+	connection->bufsize = MPD_BUFFER_INITIAL_LENGTH;
 	connection->buflen = 0;
 	connection->bufstart = 0;
+	connection->bufcheck = 0;
 	strcpy(connection->errorStr,"");
 	connection->error = 0;
 	connection->doneProcessing = 0;
@@ -393,55 +508,16 @@ mpd_Connection * mpd_newConnection(const char * host, int port, float timeout) {
 	if (mpd_connect(connection, host, port, timeout) < 0)
 		return connection;
 
-	while(!(rt = strstr(connection->buffer,"\n"))) {
-		tv.tv_sec = connection->timeout.tv_sec;
-		tv.tv_usec = connection->timeout.tv_usec;
-		FD_ZERO(&fds);
-		FD_SET(connection->sock,&fds);
-		if((err = select(connection->sock+1,&fds,NULL,NULL,&tv)) == 1) {
-			int readed;
-			readed = recv(connection->sock,
-					&(connection->buffer[connection->buflen]),
-					MPD_BUFFER_MAX_LENGTH-connection->buflen,0);
-			if(readed<=0) {
-				snprintf(connection->errorStr,MPD_ERRORSTR_MAX_LENGTH,
-						"problems getting a response from"
-						" \"%s\" on port %i : %s",host,
-						port, strerror(errno));
-				connection->error = MPD_ERROR_1_NORESPONSE;
-				return connection;
-			}
-			connection->buflen+=readed;
-			connection->buffer[connection->buflen] = '\0';
-		}
-		else if(err<0) {
- 			if (SELECT_ERRNO_IGNORE)
-				continue;
-			snprintf(connection->errorStr,
-					MPD_ERRORSTR_MAX_LENGTH,
-					"problems connecting to \"%s\" on port"
-					" %i",host,port);
-			connection->error = MPD_ERROR_1_CONNPORT;
-			return connection;
-		}
-		else {
-			snprintf(connection->errorStr,MPD_ERRORSTR_MAX_LENGTH,
-					"timeout in attempting to get a response from"
-					" \"%s\" on port %i",host,port);
-			connection->error = MPD_ERROR_1_NORESPONSE;
-			return connection;
-		}
+	if(!(output = mpd_readLine(connection))) {
+		snprintf(connection->errorStr,MPD_ERRORSTR_MAX_LENGTH,
+				"problems getting a response from"
+				" \"%s\" on port %i",host,port);
+		connection->error = MPD_ERROR_1_NORESPONSE;
+		return connection;
 	}
 
-	*rt = '\0';
-	output = strdup(connection->buffer);
-	strcpy(connection->buffer,rt+1);
-	connection->buflen = strlen(connection->buffer);
-
 	if(mpd_parseWelcome(connection,host,port,output) == 0) connection->doneProcessing = 1;
 
-	free(output);
-
 	return connection;
 }
 
@@ -452,7 +528,7 @@ void mpd_clearError(mpd_Connection * connection) {
 
 void mpd_closeConnection(mpd_Connection * connection) {
 	closesocket(connection->sock);
-	if(connection->returnElement) free(connection->returnElement);
+	free(connection->buffer);
 	if(connection->request) free(connection->request);
 	free(connection);
 	WSACleanup();
@@ -516,18 +592,8 @@ static void mpd_executeCommand(mpd_Connection * connection, char * command) {
 
 static void mpd_getNextReturnElement(mpd_Connection * connection) {
 	char * output = NULL;
-	char * rt = NULL;
-	char * name = NULL;
-	char * value = NULL;
-	fd_set fds;
-	struct timeval tv;
 	char * tok = NULL;
-	int readed;
-	char * bufferCheck = NULL;
-	int err;
-	int pos;
 
-	if(connection->returnElement) mpd_freeReturnElement(connection->returnElement);
 	connection->returnElement = NULL;
 
 	if(connection->doneProcessing || (connection->listOks &&
@@ -538,63 +604,12 @@ static void mpd_getNextReturnElement(mpd_Connection * connection) {
 		return;
 	}
 
-	bufferCheck = connection->buffer+connection->bufstart;
-	while(connection->bufstart>=connection->buflen ||
-			!(rt = strchr(bufferCheck,'\n'))) {
-		if(connection->buflen>=MPD_BUFFER_MAX_LENGTH) {
-			memmove(connection->buffer,
-					connection->buffer+
-					connection->bufstart,
-					connection->buflen-
-					connection->bufstart+1);
-			connection->buflen-=connection->bufstart;
-			connection->bufstart = 0;
-		}
-		if(connection->buflen>=MPD_BUFFER_MAX_LENGTH) {
-			strcpy(connection->errorStr,"buffer overrun");
-			connection->error = MPD_ERROR_1_BUFFEROVERRUN;
-			connection->doneProcessing = 1;
-			connection->doneListOk = 0;
-			return;
-		}
-		bufferCheck = connection->buffer+connection->buflen;
-		tv.tv_sec = connection->timeout.tv_sec;
-		tv.tv_usec = connection->timeout.tv_usec;
-		FD_ZERO(&fds);
-		FD_SET(connection->sock,&fds);
-		if((err = select(connection->sock+1,&fds,NULL,NULL,&tv) == 1)) {
-			readed = recv(connection->sock,
-					connection->buffer+connection->buflen,
-					MPD_BUFFER_MAX_LENGTH-connection->buflen,
-					MSG_DONTWAIT);
-			if(readed<0 && SENDRECV_ERRNO_IGNORE) {
-				continue;
-			}
-			if(readed<=0) {
-				strcpy(connection->errorStr,"connection"
-				       " closed");
-				connection->error = MPD_ERROR_1_CONNCLOSED;
-				connection->doneProcessing = 1;
-				connection->doneListOk = 0;
-				return;
-			}
-			connection->buflen+=readed;
-			connection->buffer[connection->buflen] = '\0';
-		}
-		else if(err<0 && SELECT_ERRNO_IGNORE) continue;
-		else {
-			strcpy(connection->errorStr,"connection timeout");
-			connection->error = MPD_ERROR_1_TIMEOUT;
-			connection->doneProcessing = 1;
-			connection->doneListOk = 0;
-			return;
-		}
+	if(!(output = mpd_readLine(connection))) {
+		connection->doneProcessing = 1;
+		connection->doneListOk = 0;
+		return;
 	}
 
-	*rt = '\0';
-	output = connection->buffer+connection->bufstart;
-	connection->bufstart = rt - connection->buffer + 1;
-
 	if(strcmp(output,"OK")==0) {
 		if(connection->listOks > 0) {
 			strcpy(connection->errorStr, "expected more list_OK's");
@@ -624,7 +639,8 @@ static void mpd_getNextReturnElement(mpd_Connection * connection) {
 		char * needle;
 		int val;
 
-		strcpy(connection->errorStr, output);
+		snprintf(connection->errorStr,MPD_ERRORSTR_MAX_LENGTH,
+		         "%s",output);
 		connection->error = MPD_ERROR_1_ACK;
 		connection->errorCode = MPD_ACK_ERROR_UNK;
 		connection->errorAt = MPD_ERROR_1_AT_UNK;
@@ -644,17 +660,17 @@ static void mpd_getNextReturnElement(mpd_Connection * connection) {
 
 	tok = strchr(output, ':');
 	if (!tok) return;
-	pos = tok - output;
-	value = ++tok;
-	name = output;
-	name[pos] = '\0';
+	*tok = '\0';
 
-	if(value[0]==' ') {
-		connection->returnElement = mpd_newReturnElement(name,&(value[1]));
+	if(tok[1]==' ') {
+		/* no copy: the element points into the buffer */
+		connection->element.name = output;
+		connection->element.value = tok + 2;
+		connection->returnElement = &connection->element;
 	}
 	else {
 		snprintf(connection->errorStr,MPD_ERRORSTR_MAX_LENGTH,
-					"error parsing: %s:%s",name,value);
+					"error parsing: %s:%s",output,tok + 1);
 		connection->error = 1;
 	}
 }
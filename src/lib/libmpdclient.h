@@ -38,12 +38,15 @@
 #endif
 
 #include <sys/time.h>
+#include <stddef.h>
 #include <stdarg.h>
 #ifdef MPD_GLIB
 #include <glib.h>
 #endif
 
-#define MPD_BUFFER_MAX_LENGTH	50000
+/* initial size of the response buffer, it grows with long lines */
+#define MPD_BUFFER_INITIAL_LENGTH	65536
+#define MPD_BUFFER_MAX_LENGTH	4194304
 #define MPD_ERRORSTR_MAX_LENGTH	1000
 #define MPD_WELCOME_MESSAGE	"OK MPD "
 
@@ -129,8 +132,11 @@ enum {
 	/** options have changed: crossfade, random, repeat, ... */
 	IDLE_OPTIONS = 0x40,
 
+	/** a database update has started or finished */
+	IDLE_UPDATE = 0x80,
+
 	/** MPD closed the connection or the connection was lost */
-	IDLE_DISCONNECT = 0x80,
+	IDLE_DISCONNECT = 0x100,
 };
 
 /* mpd_Connection
@@ -148,14 +154,20 @@ typedef struct _mpd_Connection {
 	int error;
 	/* DON'T TOUCH any of the rest of this stuff */
 	int sock;
-	char buffer[MPD_BUFFER_MAX_LENGTH+1];
-	int buflen;
-	int bufstart;
+	char * buffer;
+	size_t bufsize;
+	size_t buflen;
+	size_t bufstart;
+	/* where to look for the end of the current line */
+	size_t bufcheck;
 	int doneProcessing;
 	int listOks;
 	int doneListOk;
 	int commandList;
 	mpd_ReturnElement * returnElement;
+	/* returnElement points here, name and value point into buffer
+	 * and are only valid until the next element is read */
+	mpd_ReturnElement element;
 	struct timeval timeout;
 	char *request;
 	int idle;
@@ -32,6 +32,8 @@
 #define LETRAS_URI "http://letras.mus.br/winamp.php?t=%s%%20-%%20%s"
 #define LETRAS_ARTIST_URI "http://letras.mus.br/winamp.php?t=%s"
 #define LETRAS_SONG_URI "http://letras.mus.br/winamp.php?t=%s"
+/* Lyrics do not change: they are kept on disk for a month */
+#define LETRAS_CACHE_TTL (30 * 24 * 3600)
 
 ArioLyrics* ario_lyrics_letras_get_lyrics (ArioLyricsProvider *lyrics_provider,
                                            const char *artist,
@@ -183,10 +185,10 @@ ario_lyrics_letras_get_lyrics (ArioLyricsProvider *lyrics_provider,
         g_free (conv_title);
 
         /* We load file */
-        ario_util_download_file (uri,
-                                 NULL, 0, NULL,
-                                 &size,
-                                 &data);
+        ario_util_download_file_cached (uri,
+                                        LETRAS_CACHE_TTL,
+                                        &size,
+                                        &data);
         g_free (uri);
 
         if (size == 0)
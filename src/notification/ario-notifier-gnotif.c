@@ -91,7 +91,7 @@ ario_notifier_gnotif_notify (ArioNotifier *notifier_parent)
                 g_free(body);
         }
         cover_path = ario_cover_handler_get_cover_path ();
-        if (cover_path) {
+        if (cover_path && ario_util_uri_exists (cover_path)) {
                 file = g_file_new_for_path (cover_path);
                 if (file) {
                         icon = g_file_icon_new (file);
@@ -101,6 +101,9 @@ ario_notifier_gnotif_notify (ArioNotifier *notifier_parent)
                         }
                         g_object_unref (file);
                 }
+        } else if (ario_cover_handler_get_cover ()) {
+                /* Cover is not a file when covers are in the pack */
+                g_notification_set_icon (notification, G_ICON (ario_cover_handler_get_cover ()));
         }
 
         g_application_send_notification (g_application_get_default (), "ario-song", notification);
@@ -38,6 +38,9 @@ struct ArioPlaylistManagerPrivate
         GSList *modes;
 };
 
+/* Pending check of the last song of the playlist */
+static guint last_song_idle = 0;
+
 G_DEFINE_TYPE_WITH_CODE (ArioPlaylistManager, ario_playlist_manager, G_TYPE_OBJECT, G_ADD_PRIVATE(ArioPlaylistManager))
 
 static void
@@ -53,24 +56,45 @@ ario_playlist_manager_init (ArioPlaylistManager *playlist_manager)
         playlist_manager->priv = ario_playlist_manager_get_instance_private (playlist_manager);
 }
 
+static gboolean
+ario_playlist_manager_last_song_idle (ArioPlaylist *playlist)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistMode *mode;
+        ArioServerSong *song = ario_server_get_current_song ();
+        ArioPlaylistStats stats;
+        const gchar *id = ario_conf_get_string (PREF_PLAYLIST_MODE, PREF_PLAYLIST_MODE_DEFAULT);
+
+        last_song_idle = 0;
+
+        /* No song left after the current one */
+        ario_playlist_get_stats (&stats);
+        if (song
+            && song->pos == stats.length - 1) {
+                mode = ario_playlist_manager_get_mode_from_id (ario_playlist_manager_get_instance (), id);
+                if (mode)
+                        ario_playlist_mode_last_song (mode, playlist);
+        }
+
+        return FALSE;
+}
+
 static void
 ario_playlist_manager_song_changed_cb (ArioServer *server,
                                        ArioPlaylist *playlist)
 {
         ARIO_LOG_FUNCTION_START;
         ArioPlaylistMode *mode;
-        ArioServerSong *song = ario_server_get_current_song ();
         const gchar *id = ario_conf_get_string (PREF_PLAYLIST_MODE, PREF_PLAYLIST_MODE_DEFAULT);
 
         mode = ario_playlist_manager_get_mode_from_id (ario_playlist_manager_get_instance (), id);
 
         ario_playlist_mode_next_song (mode, playlist);
 
-        if (song
-            && (song->pos == ario_server_get_current_playlist_length () - 1)) {
-                if (mode)
-                        ario_playlist_mode_last_song (mode, playlist);
-        }
+        /* Playlist statistics are updated by playlist_changed, emitted
+         * after song_changed */
+        if (!last_song_idle)
+                last_song_idle = g_idle_add ((GSourceFunc) ario_playlist_manager_last_song_idle, playlist);
 }
 
 ArioPlaylistManager *
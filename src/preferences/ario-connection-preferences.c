@@ -33,6 +33,8 @@
 #include "widgets/ario-connection-widget.h"
 
 static void ario_connection_preferences_sync_connection (ArioConnectionPreferences *connection_preferences);
+static void ario_connection_preferences_connectivity_changed_cb (ArioServer *server,
+                                                                 ArioConnectionPreferences *connection_preferences);
 G_MODULE_EXPORT void ario_connection_preferences_autoconnect_changed_cb (GtkWidget *widget,
                                                                          ArioConnectionPreferences *connection_preferences);
 G_MODULE_EXPORT void ario_connection_preferences_connect_cb (GtkWidget *widget,
@@ -112,6 +114,12 @@ ario_connection_preferences_new (void)
 
         ario_connection_preferences_sync_connection (connection_preferences);
 
+        /* Connections may succeed after a while */
+        g_signal_connect_object (ario_server_get_instance (),
+                                 "connectivity_changed",
+                                 G_CALLBACK (ario_connection_preferences_connectivity_changed_cb),
+                                 connection_preferences, 0);
+
         gtk_box_pack_start (GTK_BOX (connection_preferences), GTK_WIDGET (gtk_builder_get_object (builder, "vbox")), TRUE, TRUE, 0);
 
         g_object_unref (builder);
@@ -119,6 +127,14 @@ ario_connection_preferences_new (void)
         return GTK_WIDGET (connection_preferences);
 }
 
+static void
+ario_connection_preferences_connectivity_changed_cb (ArioServer *server,
+                                                     ArioConnectionPreferences *connection_preferences)
+{
+        ARIO_LOG_FUNCTION_START;
+        ario_connection_preferences_sync_connection (connection_preferences);
+}
+
 static void
 ario_connection_preferences_sync_connection (ArioConnectionPreferences *connection_preferences)
 {
@@ -32,6 +32,10 @@
 #define PREF_AUTOMATIC_GET_COVER                "automatic_get_cover"
 #define PREF_AUTOMATIC_GET_COVER_DEFAULT        TRUE
 
+/* Maximum number of albums for which covers are downloaded at the same time */
+#define PREF_COVER_DOWNLOAD_JOBS                "cover_download_jobs"
+#define PREF_COVER_DOWNLOAD_JOBS_DEFAULT        4
+
 /* Define if Ario must use a proxy for remote connections */
 #define PREF_USE_PROXY                          "use_proxy"
 #define PREF_USE_PROXY_DEFAULT                  FALSE
@@ -272,6 +276,10 @@
 #define PREF_PLAYLIST_POSITION                 "playlist-position"
 #define PREF_PLAYLIST_POSITION_DEFAULT         0
 
+/* Number of song informations requested from the server in a single command list */
+#define PREF_SONGS_INFO_BATCH                  "songs-info-batch"
+#define PREF_SONGS_INFO_BATCH_DEFAULT          100
+
 enum
 {
         TRAY_ICON_PLAY_PAUSE,
@@ -43,6 +43,10 @@
 #define RECONNECT_FACTOR 2
 /* Try to reconnect 5 times */
 #define RECONNECT_TENTATIVES 5
+/* Refresh the connection dialog every 0.2 second */
+#define CONNECT_PULSE_TIMEOUT 200
+/* Idle events handled by reading the status of the server */
+#define STATUS_EVENTS (IDLE_DATABASE | IDLE_UPDATE | IDLE_PLAYLIST | IDLE_PLAYER | IDLE_MIXER | IDLE_OPTIONS)
 
 static void ario_mpd_finalize (GObject *object);
 static gboolean ario_mpd_connect_to (ArioMpd *mpd,
@@ -65,6 +69,7 @@ static GSList * ario_mpd_get_songs_from_playlist (char *playlist);
 static GSList * ario_mpd_get_playlists (void);
 static GSList * ario_mpd_get_playlist_changes (gint64 playlist_id);
 static gboolean ario_mpd_update_status (void);
+static void ario_mpd_refresh_status (const unsigned events);
 static ArioServerSong * ario_mpd_get_current_song_on_server (void);
 static int ario_mpd_get_current_playlist_total_time (void);
 static unsigned long ario_mpd_get_last_update (void);
@@ -95,6 +100,7 @@ static ArioServerStats * ario_mpd_get_stats (void);
 static GList * ario_mpd_get_songs_info (GSList *paths);
 static ArioServerFileList * ario_mpd_list_files (const char *path,
                                                  gboolean recursive);
+static void ario_mpd_start_stream (ArioServerStream *stream);
 
 /* Private attributes */
 struct ArioMpdPrivate
@@ -110,8 +116,18 @@ struct ArioMpdPrivate
 
         gboolean is_updating;
 
+        /* Events received since last dispatch */
+        unsigned events;
+        guint dispatch_id;
+
         int elapsed;
         int reconnect_time;
+
+        /* Connection in progress in a thread */
+        GThread *connect_thread;
+        gboolean connect_aborted;
+        GtkWidget *connect_dialog;
+        guint pulse_id;
 };
 
 G_DEFINE_TYPE_WITH_CODE (ArioMpd, ario_mpd, TYPE_ARIO_SERVER_INTERFACE, G_ADD_PRIVATE(ArioMpd))
@@ -167,6 +183,7 @@ ario_mpd_class_init (ArioMpdClass *klass)
         server_class->get_stats = ario_mpd_get_stats;
         server_class->get_songs_info = ario_mpd_get_songs_info;
         server_class->list_files = ario_mpd_list_files;
+        server_class->start_stream = ario_mpd_start_stream;
 }
 
 static void
@@ -277,29 +294,55 @@ ario_mpd_launch_idle_timeout (void)
 }
 #endif
 
-static void
-ario_mpd_idle_cb (mpd_Connection *connection,
-                  unsigned flags,
-                  void *userdata)
+static gboolean
+ario_mpd_dispatch_events (gpointer not_used)
 {
         ARIO_LOG_FUNCTION_START;
+        unsigned events = instance->priv->events;
+
+        instance->priv->events = 0;
+        instance->priv->dispatch_id = 0;
 
-        /* Update MPD status */
-        /* TODO: Be more selective depending on flags */
-        if (flags & IDLE_DATABASE
-            || flags & IDLE_PLAYLIST
-            || flags & IDLE_PLAYER
-            || flags & IDLE_MIXER
-            || flags & IDLE_OPTIONS)
-                ario_mpd_update_status ();
+        /* Only read the parts of the status matching the events */
+        if (events & STATUS_EVENTS)
+                ario_mpd_refresh_status (events & STATUS_EVENTS);
 
         /* Stored playlists changed, update list */
-        if (flags & IDLE_STORED_PLAYLIST)
+        if (events & IDLE_STORED_PLAYLIST)
                 g_signal_emit_by_name (G_OBJECT (server_instance), "storedplaylists_changed");
 
+        /* Database changed, check the library cache against it */
+        if (events & IDLE_DATABASE)
+                ario_server_cache_check ();
+
+        return FALSE;
+}
+
+static void
+ario_mpd_queue_events (const unsigned events)
+{
+        ARIO_LOG_FUNCTION_START;
+
+        /* Events received before the main loop is idle are handled
+         * together: a burst of volume changes costs a single request */
+        instance->priv->events |= events;
+        if (!instance->priv->dispatch_id)
+                instance->priv->dispatch_id = g_idle_add ((GSourceFunc) ario_mpd_dispatch_events, NULL);
+}
+
+static void
+ario_mpd_idle_cb (mpd_Connection *connection,
+                  unsigned flags,
+                  void *userdata)
+{
+        ARIO_LOG_FUNCTION_START;
+
         /* Diconnected from MPD: check errors */
-        if (flags & IDLE_DISCONNECT)
+        if (flags & IDLE_DISCONNECT) {
                 ario_mpd_check_errors ();
+        } else {
+                ario_mpd_queue_events (flags);
+        }
 
         /* Restart idle */
         if (instance->priv->connection)
@@ -359,6 +402,65 @@ ario_mpd_connect_to (ArioMpd *mpd,
         return TRUE;
 }
 
+static gboolean
+ario_mpd_try_reconnect (gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ario_server_connect ();
+
+        return FALSE;
+}
+
+static gboolean
+ario_mpd_connect_done_cb (gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkWidget *dialog;
+        gboolean is_in_error = (instance->priv->reconnect_time > 0);
+
+        g_thread_join (instance->priv->connect_thread);
+        instance->priv->connect_thread = NULL;
+
+        if (instance->priv->pulse_id) {
+                g_source_remove (instance->priv->pulse_id);
+                instance->priv->pulse_id = 0;
+        }
+
+        if (instance->priv->connect_dialog) {
+                gtk_widget_destroy (instance->priv->connect_dialog);
+                instance->priv->connect_dialog = NULL;
+        }
+
+        instance->priv->support_empty_tags = FALSE;
+
+        if (instance->priv->connect_aborted) {
+                /* Disconnected while the thread was connecting */
+                instance->priv->connect_aborted = FALSE;
+                ario_mpd_disconnect ();
+        } else if (ario_server_is_connected ()) {
+                instance->priv->reconnect_time = 0;
+        } else if (!is_in_error) {
+                if (!ario_server_is_headless ()) {
+                        dialog = gtk_message_dialog_new (NULL, GTK_DIALOG_MODAL,
+                                                         GTK_MESSAGE_ERROR,
+                                                         GTK_BUTTONS_OK,
+                                                         _("Impossible to connect to server. Check the connection options."));
+                        g_signal_connect (dialog, "response", G_CALLBACK (gtk_widget_destroy), NULL);
+                        gtk_widget_show (dialog);
+                }
+                g_signal_emit_by_name (G_OBJECT (server_instance), "state_changed");
+        } else if (instance->priv->reconnect_time <= RECONNECT_TENTATIVES) {
+                /* Try to reconnect later */
+                ++instance->priv->reconnect_time;
+                g_timeout_add (RECONNECT_INIT_TIMEOUT * instance->priv->reconnect_time * RECONNECT_FACTOR,
+                               ario_mpd_try_reconnect, NULL);
+        }
+
+        ario_server_connect_finished ();
+
+        return FALSE;
+}
+
 static gpointer
 ario_mpd_connect_thread (ArioServer *server)
 {
@@ -379,70 +481,54 @@ ario_mpd_connect_thread (ArioServer *server)
         if (port == 0)
                 port = 6600;
 
-        if (!ario_mpd_connect_to (instance, hostname, port, timeout)) {
-                ario_mpd_disconnect ();
-        }
+        ario_mpd_connect_to (instance, hostname, port, timeout);
 
-        instance->priv->support_empty_tags = FALSE;
-        instance->parent.connecting = FALSE;
+        /* The rest is done by the main loop */
+        g_idle_add (ario_mpd_connect_done_cb, NULL);
 
         return NULL;
 }
 
+static gboolean
+ario_mpd_connect_pulse_cb (GtkProgressBar *bar)
+{
+        gtk_progress_bar_pulse (bar);
+
+        return TRUE;
+}
+
 static void
 ario_mpd_connect (void)
 {
         ARIO_LOG_FUNCTION_START;
-        GtkWidget *win = NULL, *vbox,*label, *bar;
-        GThread* thread;
-        GtkWidget *dialog;
-        gboolean is_in_error = (instance->priv->reconnect_time > 0);
-
-        thread = g_thread_new ("connect",
-                               (GThreadFunc) ario_mpd_connect_thread,
-                               instance);
-
-        if (!is_in_error) {
-                win = gtk_window_new (GTK_WINDOW_TOPLEVEL);
-                gtk_window_set_modal (GTK_WINDOW (win), TRUE);
+        GtkWidget *vbox, *label, *bar;
+
+        /* libmpd can only connect synchronously: the thread connects
+         * while the main loop goes on */
+        instance->priv->connect_thread = g_thread_new ("connect",
+                                                       (GThreadFunc) ario_mpd_connect_thread,
+                                                       instance);
+
+        /* No dialog when trying to reconnect */
+        if (instance->priv->reconnect_time == 0 && !ario_server_is_headless ()) {
+                instance->priv->connect_dialog = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+                gtk_window_set_modal (GTK_WINDOW (instance->priv->connect_dialog), TRUE);
                 vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
                 label = gtk_label_new (_("Connecting to server..."));
                 bar = gtk_progress_bar_new ();
 
-                gtk_container_add (GTK_CONTAINER (win), vbox);
+                gtk_container_add (GTK_CONTAINER (instance->priv->connect_dialog), vbox);
                 gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 6);
                 gtk_box_pack_start (GTK_BOX (vbox), bar, FALSE, FALSE, 6);
 
-                gtk_window_set_resizable (GTK_WINDOW (win), FALSE);
-                gtk_window_set_title (GTK_WINDOW (win), "Ario");
-                gtk_window_set_position (GTK_WINDOW (win), GTK_WIN_POS_CENTER);
-                gtk_widget_show_all (win);
+                gtk_window_set_resizable (GTK_WINDOW (instance->priv->connect_dialog), FALSE);
+                gtk_window_set_title (GTK_WINDOW (instance->priv->connect_dialog), "Ario");
+                gtk_window_set_position (GTK_WINDOW (instance->priv->connect_dialog), GTK_WIN_POS_CENTER);
+                gtk_widget_show_all (instance->priv->connect_dialog);
 
-                while (instance->parent.connecting) {
-                        gtk_progress_bar_pulse (GTK_PROGRESS_BAR (bar));
-                        while (gtk_events_pending ())
-                                gtk_main_iteration ();
-                        g_usleep (200000);
-                }
-        }
-
-        g_thread_join (thread);
-
-        if (ario_server_is_connected ()) {
-                instance->priv->reconnect_time = 0;
-        } else if (!is_in_error) {
-                dialog = gtk_message_dialog_new (NULL, GTK_DIALOG_MODAL,
-                                                 GTK_MESSAGE_ERROR,
-                                                 GTK_BUTTONS_OK,
-                                                 _("Impossible to connect to server. Check the connection options."));
-                if (gtk_dialog_run (GTK_DIALOG (dialog)) != GTK_RESPONSE_NONE)
-                        gtk_widget_destroy (dialog);
-                g_signal_emit_by_name (G_OBJECT (server_instance), "state_changed");
-        }
-
-        if (win) {
-                gtk_widget_hide (win);
-                gtk_widget_destroy (win);
+                instance->priv->pulse_id = g_timeout_add (CONNECT_PULSE_TIMEOUT,
+                                                          (GSourceFunc) ario_mpd_connect_pulse_cb,
+                                                          bar);
         }
 }
 
@@ -450,6 +536,12 @@ static void
 ario_mpd_disconnect (void)
 {
         ARIO_LOG_FUNCTION_START;
+        /* The connection will be closed once the thread is done */
+        if (instance->priv->connect_thread) {
+                instance->priv->connect_aborted = TRUE;
+                return;
+        }
+
         /* check if there is a connection */
         if (!instance->priv->connection)
                 return;
@@ -459,6 +551,12 @@ ario_mpd_disconnect (void)
         mpd_closeConnection (instance->priv->connection);
         instance->priv->connection = NULL;
 
+        if (instance->priv->dispatch_id) {
+                g_source_remove (instance->priv->dispatch_id);
+                instance->priv->dispatch_id = 0;
+        }
+        instance->priv->events = 0;
+
         if (instance->priv->timeout_id) {
                 g_source_remove (instance->priv->timeout_id);
                 instance->priv->timeout_id = 0;
@@ -486,23 +584,6 @@ ario_mpd_update_db (const gchar *path)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
 }
 
-static gboolean
-ario_mpd_try_reconnect (gpointer data)
-{
-        ARIO_LOG_FUNCTION_START;
-        ario_server_connect ();
-
-        if (!instance->priv->connection
-            && instance->priv->reconnect_time <= RECONNECT_TENTATIVES) {
-                /* Try to reconnect */
-                ++instance->priv->reconnect_time;
-                g_timeout_add (RECONNECT_INIT_TIMEOUT * instance->priv->reconnect_time * RECONNECT_FACTOR,
-                               ario_mpd_try_reconnect, NULL);
-        }
-
-        return FALSE;
-}
-
 static gboolean
 ario_mpd_check_errors (void)
 {
@@ -540,7 +621,7 @@ ario_mpd_list_tags (const ArioServerTag tag,
         ARIO_LOG_FUNCTION_START;
         gchar *value;
         const GSList *tmp;
-        GSList *values = NULL;
+        ArioServerListBuilder values_builder = { NULL, NULL };
         ArioServerAtomicCriteria *atomic_criteria;
 
         /* check if there is a connection */
@@ -560,10 +641,10 @@ ario_mpd_list_tags (const ArioServerTag tag,
 
         while ((value = mpd_getNextTag (instance->priv->connection, tag))) {
                 if (*value)
-                        values = g_slist_append (values, value);
+                        ario_server_list_builder_append (&values_builder, value);
                 else {
                         g_free (value);
-                        values = g_slist_append (values, g_strdup (ARIO_SERVER_UNKNOWN));
+                        ario_server_list_builder_append (&values_builder, g_strdup (ARIO_SERVER_UNKNOWN));
                         instance->priv->support_empty_tags = TRUE;
                 }
         }
@@ -571,7 +652,36 @@ ario_mpd_list_tags (const ArioServerTag tag,
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
 
-        return values;
+        return ario_server_list_builder_steal (&values_builder);
+}
+
+static void
+ario_mpd_intern_tag (char **tag)
+{
+        char *value = *tag;
+
+        *tag = (char *) ario_server_intern (value);
+        free (value);
+}
+
+static ArioServerSong *
+ario_mpd_steal_song (mpd_InfoEntity *entity)
+{
+        ARIO_LOG_FUNCTION_START;
+        mpd_Song *song = entity->info.song;
+
+        entity->info.song = NULL;
+
+        /* Repeated tags are shared between songs */
+        ario_mpd_intern_tag (&song->artist);
+        ario_mpd_intern_tag (&song->album);
+        ario_mpd_intern_tag (&song->album_artist);
+        ario_mpd_intern_tag (&song->date);
+        ario_mpd_intern_tag (&song->genre);
+        ario_mpd_intern_tag (&song->composer);
+        ario_mpd_intern_tag (&song->performer);
+
+        return (ArioServerSong *) song;
 }
 
 static gboolean
@@ -588,7 +698,7 @@ ario_mpd_get_albums (const ArioServerCriteria *criteria)
         ARIO_LOG_FUNCTION_START;
         GHashTable *albums;
         const GSList *tmp;
-        GList *values;
+        GList *values, *tmp_values;
         GSList *result = NULL;
         mpd_InfoEntity *entity = NULL;
         ArioServerAlbum *mpd_album;
@@ -675,8 +785,11 @@ ario_mpd_get_albums (const ArioServerCriteria *criteria)
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
 
-        for (values = g_hash_table_get_values (albums); values; values = g_list_next (values))
-                result = g_slist_append (result, values->data);
+        /* Albums order is not significant: prepend them */
+        values = g_hash_table_get_values (albums);
+        for (tmp_values = values; tmp_values; tmp_values = g_list_next (tmp_values))
+                result = g_slist_prepend (result, tmp_values->data);
+        g_list_free (values);
 
         /*
          * we don't need to free neither the keys nor the values since
@@ -687,49 +800,69 @@ ario_mpd_get_albums (const ArioServerCriteria *criteria)
         return result;
 }
 
-static GSList *
-ario_mpd_get_songs (const ArioServerCriteria *criteria,
-                    const gboolean exact)
+static gboolean
+ario_mpd_criteria_has_unknown_album (const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *songs = NULL;
-        mpd_InfoEntity *entity = NULL;
         const GSList *tmp;
-        gboolean is_album_unknown = FALSE;
         ArioServerAtomicCriteria *atomic_criteria;
 
-        /* check if there is a connection */
-        if (!instance->priv->connection)
-                return NULL;
-
         for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
                 atomic_criteria = tmp->data;
                 if (atomic_criteria->tag == ARIO_TAG_ALBUM
                     && !g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        is_album_unknown = TRUE;
+                        return TRUE;
         }
 
-        mpd_startSearch (instance->priv->connection, exact);
+        return FALSE;
+}
+
+static void
+ario_mpd_send_search (mpd_Connection *connection,
+                      const ArioServerCriteria *criteria,
+                      const gboolean exact)
+{
+        ARIO_LOG_FUNCTION_START;
+        const GSList *tmp;
+        ArioServerAtomicCriteria *atomic_criteria;
+
+        mpd_startSearch (connection, exact);
         for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
                 atomic_criteria = tmp->data;
                 if (instance->priv->support_empty_tags
                     && !g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        mpd_addConstraintSearch (instance->priv->connection,
+                        mpd_addConstraintSearch (connection,
                                                  atomic_criteria->tag,
                                                  "");
                 else if (atomic_criteria->tag != ARIO_TAG_ALBUM
                          || g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        mpd_addConstraintSearch (instance->priv->connection,
+                        mpd_addConstraintSearch (connection,
                                                  atomic_criteria->tag,
                                                  atomic_criteria->value);
         }
-        mpd_commitSearch (instance->priv->connection);
+        mpd_commitSearch (connection);
+}
+
+static GSList *
+ario_mpd_get_songs (const ArioServerCriteria *criteria,
+                    const gboolean exact)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerListBuilder songs_builder = { NULL, NULL };
+        mpd_InfoEntity *entity = NULL;
+        gboolean is_album_unknown;
+
+        /* check if there is a connection */
+        if (!instance->priv->connection)
+                return NULL;
+
+        is_album_unknown = ario_mpd_criteria_has_unknown_album (criteria);
+        ario_mpd_send_search (instance->priv->connection, criteria, exact);
 
         while ((entity = mpd_getNextInfoEntity (instance->priv->connection))) {
                 if (entity->type == MPD_INFO_ENTITY_TYPE_SONG && entity->info.song) {
                         if (instance->priv->support_empty_tags || !is_album_unknown || !entity->info.song->album) {
-                                songs = g_slist_append (songs, entity->info.song);
-                                entity->info.song = NULL;
+                                ario_server_list_builder_append (&songs_builder, ario_mpd_steal_song (entity));
                         }
                 }
                 mpd_freeInfoEntity (entity);
@@ -739,14 +872,14 @@ ario_mpd_get_songs (const ArioServerCriteria *criteria,
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
 
-        return songs;
+        return ario_server_list_builder_steal (&songs_builder);
 }
 
 static GSList *
 ario_mpd_get_songs_from_playlist (char *playlist)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *songs = NULL;
+        ArioServerListBuilder songs_builder = { NULL, NULL };
         mpd_InfoEntity *ent = NULL;
 
         /* check if there is a connection */
@@ -755,8 +888,7 @@ ario_mpd_get_songs_from_playlist (char *playlist)
 
         mpd_sendListPlaylistInfoCommand (instance->priv->connection, playlist);
         while ((ent = mpd_getNextInfoEntity (instance->priv->connection))) {
-                songs = g_slist_append (songs, ent->info.song);
-                ent->info.song = NULL;
+                ario_server_list_builder_append (&songs_builder, ario_mpd_steal_song (ent));
                 mpd_freeInfoEntity (ent);
         }
         mpd_finishCommand (instance->priv->connection);
@@ -764,14 +896,14 @@ ario_mpd_get_songs_from_playlist (char *playlist)
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
 
-        return songs;
+        return ario_server_list_builder_steal (&songs_builder);
 }
 
 static GSList *
 ario_mpd_get_playlists (void)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *playlists = NULL;
+        ArioServerListBuilder playlists_builder = { NULL, NULL };
         mpd_InfoEntity *ent = NULL;
 
         /* check if there is a connection */
@@ -782,7 +914,7 @@ ario_mpd_get_playlists (void)
 
         while ((ent = mpd_getNextInfoEntity (instance->priv->connection))) {
                 if (ent->type == MPD_INFO_ENTITY_TYPE_PLAYLISTFILE) {
-                        playlists = g_slist_append (playlists, g_strdup (ent->info.playlistFile->path));
+                        ario_server_list_builder_append (&playlists_builder, g_strdup (ent->info.playlistFile->path));
                 }
                 mpd_freeInfoEntity (ent);
         }
@@ -791,14 +923,14 @@ ario_mpd_get_playlists (void)
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
 
-        return playlists;
+        return ario_server_list_builder_steal (&playlists_builder);
 }
 
 static GSList *
 ario_mpd_get_playlist_changes (gint64 playlist_id)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *songs = NULL;
+        ArioServerListBuilder songs_builder = { NULL, NULL };
         mpd_InfoEntity *entity;
 
         /* check if there is a connection */
@@ -808,8 +940,7 @@ ario_mpd_get_playlist_changes (gint64 playlist_id)
         mpd_sendPlChangesCommand (instance->priv->connection, (long long) playlist_id);
         while ((entity = mpd_getNextInfoEntity (instance->priv->connection))) {
                 if (entity->info.song) {
-                        songs = g_slist_append (songs, entity->info.song);
-                        entity->info.song = NULL;
+                        ario_server_list_builder_append (&songs_builder, ario_mpd_steal_song (entity));
                 }
                 mpd_freeInfoEntity (entity);
         }
@@ -818,17 +949,22 @@ ario_mpd_get_playlist_changes (gint64 playlist_id)
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
 
-        return songs;
+        return ario_server_list_builder_steal (&songs_builder);
 }
 
-static gboolean
-ario_mpd_update_status (void)
+static void
+ario_mpd_refresh_status (const unsigned events)
 {
         // desactivated to make the logs more readable
         //ARIO_LOG_FUNCTION_START;
+        mpd_Status *status;
 
-        if (instance->priv->is_updating)
-                return !instance->priv->support_idle;
+        if (instance->priv->is_updating) {
+                /* Handle the events once the current update is done */
+                if (instance->priv->support_idle && instance->priv->connection)
+                        ario_mpd_queue_events (events);
+                return;
+        }
         instance->priv->is_updating = TRUE;
 
         /* check if there is a connection */
@@ -839,42 +975,57 @@ ario_mpd_update_status (void)
                         mpd_freeStatus (instance->priv->status);
                 mpd_sendStatusCommand (instance->priv->connection);
                 instance->priv->status = mpd_getStatus (instance->priv->connection);
+                status = instance->priv->status;
 
                 if (ario_mpd_check_errors ()) {
                         ario_server_interface_set_default (ARIO_SERVER_INTERFACE (instance));
-                } else if (instance->priv->status) {
-                        if (instance->parent.song_id != instance->priv->status->songid
-                            || instance->parent.playlist_id != (gint64) instance->priv->status->playlist)
-                                g_object_set (G_OBJECT (instance), "song_id", instance->priv->status->songid, NULL);
+                } else if (status) {
+                        /* Only update the values related to the events */
+                        if (events & (IDLE_PLAYER | IDLE_PLAYLIST)) {
+                                if (instance->parent.song_id != status->songid
+                                    || instance->parent.playlist_id != (gint64) status->playlist)
+                                        g_object_set (G_OBJECT (instance), "song_id", status->songid, NULL);
+                        }
 
-                        if ((gint) instance->parent.state != instance->priv->status->state)
-                                g_object_set (G_OBJECT (instance), "state", instance->priv->status->state, NULL);
+                        if (events & IDLE_PLAYER) {
+                                if ((gint) instance->parent.state != status->state)
+                                        g_object_set (G_OBJECT (instance), "state", status->state, NULL);
 
-                        if (instance->parent.volume != instance->priv->status->volume)
-                                g_object_set (G_OBJECT (instance), "volume", instance->priv->status->volume, NULL);
+                                if ((gint) instance->parent.elapsed != status->elapsedTime) {
+                                        g_object_set (G_OBJECT (instance), "elapsed", status->elapsedTime, NULL);
+                                        instance->priv->elapsed = status->elapsedTime;
+                                }
+                        }
 
-                        if ((gint) instance->parent.elapsed != instance->priv->status->elapsedTime) {
-                                g_object_set (G_OBJECT (instance), "elapsed", instance->priv->status->elapsedTime, NULL);
-                                instance->priv->elapsed = instance->priv->status->elapsedTime;
+                        if (events & IDLE_MIXER) {
+                                if (instance->parent.volume != status->volume)
+                                        g_object_set (G_OBJECT (instance), "volume", status->volume, NULL);
                         }
 
-                        if (instance->parent.playlist_id != (gint64) instance->priv->status->playlist) {
-                                g_object_set (G_OBJECT (instance), "playlist_id", (gint64) instance->priv->status->playlist, NULL);
-                                instance->parent.playlist_length = instance->priv->status->playlistLength;
+                        if (events & IDLE_PLAYLIST) {
+                                if (instance->parent.playlist_id != (gint64) status->playlist) {
+                                        g_object_set (G_OBJECT (instance), "playlist_id", (gint64) status->playlist, NULL);
+                                        instance->parent.playlist_length = status->playlistLength;
+                                }
                         }
 
-                        if (instance->parent.random != (gboolean) instance->priv->status->random)
-                                g_object_set (G_OBJECT (instance), "random", instance->priv->status->random, NULL);
+                        if (events & IDLE_OPTIONS) {
+                                if (instance->parent.random != (gboolean) status->random)
+                                        g_object_set (G_OBJECT (instance), "random", status->random, NULL);
 
-                        if (instance->parent.consume != (gboolean) instance->priv->status->consume)
-                                g_object_set (G_OBJECT (instance), "consume", instance->priv->status->consume, NULL);
+                                if (instance->parent.consume != (gboolean) status->consume)
+                                        g_object_set (G_OBJECT (instance), "consume", status->consume, NULL);
 
-                        if (instance->parent.repeat != (gboolean) instance->priv->status->repeat)
-                                g_object_set (G_OBJECT (instance), "repeat", instance->priv->status->repeat, NULL);
+                                if (instance->parent.repeat != (gboolean) status->repeat)
+                                        g_object_set (G_OBJECT (instance), "repeat", status->repeat, NULL);
 
-                        if ((gint) instance->parent.updatingdb != instance->priv->status->updatingDb)
-                                g_object_set (G_OBJECT (instance), "updatingdb", instance->priv->status->updatingDb, NULL);
-                        instance->parent.crossfade = instance->priv->status->crossfade;
+                                instance->parent.crossfade = status->crossfade;
+                        }
+
+                        if (events & (IDLE_UPDATE | IDLE_DATABASE)) {
+                                if ((gint) instance->parent.updatingdb != status->updatingDb)
+                                        g_object_set (G_OBJECT (instance), "updatingdb", status->updatingDb, NULL);
+                        }
                 }
         }
         ario_server_interface_emit (ARIO_SERVER_INTERFACE (instance), server_instance);
@@ -884,6 +1035,16 @@ ario_mpd_update_status (void)
         if (instance->priv->support_idle
             && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
+}
+
+static gboolean
+ario_mpd_update_status (void)
+{
+        // desactivated to make the logs more readable
+        //ARIO_LOG_FUNCTION_START;
+
+        /* Full update */
+        ario_mpd_refresh_status (STATUS_EVENTS);
 
         return !instance->priv->support_idle;
 }
@@ -898,8 +1059,7 @@ ario_mpd_get_current_song_on_server (void)
         mpd_sendCurrentSongCommand (instance->priv->connection);
         ent = mpd_getNextInfoEntity (instance->priv->connection);
         if (ent) {
-                song = (ArioServerSong *) ent->info.song;
-                ent->info.song = NULL;
+                song = ario_mpd_steal_song (ent);
                 mpd_freeInfoEntity (ent);
         }
         mpd_finishCommand (instance->priv->connection);
@@ -1165,7 +1325,7 @@ static void
 ario_mpd_queue_commit (void)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *temp;
+        GSList *temp, *queue;
         ArioServerQueueAction *queue_action;
 
         /* check if there is a connection */
@@ -1174,7 +1334,7 @@ ario_mpd_queue_commit (void)
 
         mpd_sendCommandListBegin(instance->priv->connection);
 
-        for (temp = instance->parent.queue; temp; temp = g_slist_next (temp)) {
+        for (temp = instance->parent.queue.head; temp; temp = g_slist_next (temp)) {
                 queue_action = (ArioServerQueueAction *) temp->data;
                 if (queue_action->type == ARIO_SERVER_ACTION_ADD) {
                         if (queue_action->path) {
@@ -1202,9 +1362,8 @@ ario_mpd_queue_commit (void)
         mpd_finishCommand (instance->priv->connection);
         ario_mpd_update_status ();
 
-        g_slist_foreach (instance->parent.queue, (GFunc) g_free, NULL);
-        g_slist_free (instance->parent.queue);
-        instance->parent.queue = NULL;
+        queue = ario_server_list_builder_steal (&instance->parent.queue);
+        ario_server_queue_free (queue);
 
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
@@ -1262,7 +1421,7 @@ static GSList *
 ario_mpd_get_outputs (void)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *outputs = NULL;
+        ArioServerListBuilder outputs_builder = { NULL, NULL };
         mpd_OutputEntity *output_ent;
 
         /* check if there is a connection */
@@ -1272,14 +1431,14 @@ ario_mpd_get_outputs (void)
         mpd_sendOutputsCommand (instance->priv->connection);
 
         while ((output_ent = mpd_getNextOutput (instance->priv->connection)))
-                outputs = g_slist_append (outputs, output_ent);
+                ario_server_list_builder_append (&outputs_builder, output_ent);
 
         mpd_finishCommand (instance->priv->connection);
 
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
 
-        return outputs;
+        return ario_server_list_builder_steal (&outputs_builder);
 }
 
 static void
@@ -1325,37 +1484,60 @@ static GList *
 ario_mpd_get_songs_info (GSList *paths)
 {
         ARIO_LOG_FUNCTION_START;
-        const gchar *path = NULL;
-        GSList *temp;
+        GSList *temp, *batch_start, *batch_end;
         GList *songs = NULL;
         mpd_InfoEntity *ent;
+        int batch_size, i;
 
         /* check if there is a connection */
         if (!instance->priv->connection)
                 return NULL;
 
-        for (temp = paths; temp; temp = g_slist_next (temp)) {
-                path = temp->data;
-
-                mpd_sendListallInfoCommand (instance->priv->connection, path);
-
-                ent = mpd_getNextInfoEntity (instance->priv->connection);
-
-                mpd_finishCommand (instance->priv->connection);
-                if (!ent)
-                        continue;
+        batch_size = MAX (1, ario_conf_get_integer (PREF_SONGS_INFO_BATCH, PREF_SONGS_INFO_BATCH_DEFAULT));
+
+        temp = paths;
+        while (temp) {
+                batch_start = temp;
+
+                /* Send a whole batch of requests before reading any response */
+                mpd_sendCommandListOkBegin (instance->priv->connection);
+                for (batch_end = batch_start, i = 0;
+                     batch_end && i < batch_size;
+                     batch_end = g_slist_next (batch_end), ++i)
+                        mpd_sendListallInfoCommand (instance->priv->connection, batch_end->data);
+                mpd_sendCommandListEnd (instance->priv->connection);
+
+                /* Read the responses in the same order */
+                for (temp = batch_start; temp != batch_end; temp = g_slist_next (temp)) {
+                        ent = mpd_getNextInfoEntity (instance->priv->connection);
+                        if (ent) {
+                                if (ent->type == MPD_INFO_ENTITY_TYPE_SONG && ent->info.song) {
+                                        songs = g_list_prepend (songs, ario_mpd_steal_song (ent));
+                                }
+                                mpd_freeInfoEntity (ent);
+                        }
 
-                songs = g_list_append (songs, ent->info.song);
-                ent->info.song = NULL;
+                        if (instance->priv->connection->error)
+                                break;
+                        mpd_nextListOkCommand (instance->priv->connection);
+                }
 
-                mpd_freeInfoEntity (ent);
-                ario_mpd_check_errors ();
+                if (instance->priv->connection->error == MPD_ERROR_1_ACK) {
+                        /* An unknown path aborts the rest of the list: skip it and send the following ones again */
+                        temp = (instance->priv->connection->errorAt >= 0) ?
+                                g_slist_nth (batch_start, instance->priv->connection->errorAt + 1) : batch_end;
+                        mpd_clearError (instance->priv->connection);
+                } else if (ario_mpd_check_errors ()) {
+                        break;
+                } else {
+                        mpd_finishCommand (instance->priv->connection);
+                }
         }
 
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
 
-        return songs;
+        return g_list_reverse (songs);
 }
 
 static ArioServerFileList *
@@ -1365,6 +1547,8 @@ ario_mpd_list_files (const char *path,
         ARIO_LOG_FUNCTION_START;
         mpd_InfoEntity *entity;
         ArioServerFileList *files = (ArioServerFileList *) g_malloc0 (sizeof (ArioServerFileList));
+        ArioServerListBuilder directories = { NULL, NULL };
+        ArioServerListBuilder songs = { NULL, NULL };
 
         /* check if there is a connection */
         if (!instance->priv->connection)
@@ -1377,15 +1561,16 @@ ario_mpd_list_files (const char *path,
 
         while ((entity = mpd_getNextInfoEntity (instance->priv->connection))) {
                 if (entity->type == MPD_INFO_ENTITY_TYPE_DIRECTORY) {
-                        files->directories = g_slist_append (files->directories, entity->info.directory->path);
+                        ario_server_list_builder_append (&directories, entity->info.directory->path);
                         entity->info.directory->path = NULL;
                 } else if (entity->type == MPD_INFO_ENTITY_TYPE_SONG) {
-                        files->songs = g_slist_append (files->songs, entity->info.song);
-                        entity->info.song = NULL;
+                        ario_server_list_builder_append (&songs, ario_mpd_steal_song (entity));
                 }
 
                 mpd_freeInfoEntity(entity);
         }
+        files->directories = ario_server_list_builder_steal (&directories);
+        files->songs = ario_server_list_builder_steal (&songs);
 
         if (instance->priv->support_idle && instance->priv->connection)
                 mpd_startIdle (instance->priv->connection, ario_mpd_idle_cb, NULL);
@@ -1393,3 +1578,102 @@ ario_mpd_list_files (const char *path,
         return files;
 }
 
+static mpd_Connection *
+ario_mpd_stream_connect (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioProfile *profile;
+        gchar *hostname;
+        int port;
+        mpd_Connection *connection;
+
+        profile = ario_profiles_get_current (ario_profiles_get ());
+        hostname = profile->host;
+        port = profile->port;
+
+        if (hostname == NULL)
+                hostname = "localhost";
+
+        if (port == 0)
+                port = 6600;
+
+        connection = mpd_newConnection (hostname, port, 5.0);
+        if (!connection)
+                return NULL;
+
+        if  (connection->error) {
+                ARIO_LOG_ERROR("%s", connection->errorStr);
+                mpd_closeConnection (connection);
+                return NULL;
+        }
+
+        if (profile->password) {
+                mpd_sendPasswordCommand (connection, profile->password);
+                mpd_finishCommand (connection);
+        }
+
+        return connection;
+}
+
+static gpointer
+ario_mpd_stream_thread (ArioServerStream *stream)
+{
+        ARIO_LOG_FUNCTION_START;
+        mpd_Connection *connection;
+        mpd_InfoEntity *entity;
+        gboolean is_album_unknown = FALSE;
+
+        /* Use a dedicated connection so that the main one stays available */
+        connection = ario_mpd_stream_connect ();
+        if (!connection) {
+                ario_server_stream_finish (stream);
+                return NULL;
+        }
+
+        if (stream->path) {
+                if (stream->recursive)
+                        mpd_sendListallCommand (connection, stream->path);
+                else
+                        mpd_sendLsInfoCommand (connection, stream->path);
+        } else {
+                is_album_unknown = ario_mpd_criteria_has_unknown_album (stream->criteria);
+                ario_mpd_send_search (connection, stream->criteria, stream->exact);
+        }
+
+        while (!ario_server_stream_is_cancelled (stream)
+               && (entity = mpd_getNextInfoEntity (connection))) {
+                if (entity->type == MPD_INFO_ENTITY_TYPE_DIRECTORY && stream->path) {
+                        ario_server_stream_push_directory (stream, entity->info.directory->path);
+                        entity->info.directory->path = NULL;
+                } else if (entity->type == MPD_INFO_ENTITY_TYPE_SONG && entity->info.song) {
+                        if (instance->priv->support_empty_tags || !is_album_unknown || !entity->info.song->album) {
+                                ario_server_stream_push_song (stream, ario_mpd_steal_song (entity));
+                        }
+                }
+
+                mpd_freeInfoEntity (entity);
+        }
+
+        /* Closing the connection drops the rest of a cancelled response */
+        mpd_closeConnection (connection);
+
+        ario_server_stream_finish (stream);
+
+        return NULL;
+}
+
+static void
+ario_mpd_start_stream (ArioServerStream *stream)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* check if there is a connection */
+        if (!instance->priv->connection) {
+                ario_server_stream_finish (stream);
+                return;
+        }
+
+        g_thread_unref (g_thread_new ("stream",
+                                      (GThreadFunc) ario_mpd_stream_thread,
+                                      stream));
+}
+
@@ -21,14 +21,18 @@
 #include "config.h"
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
+#include <string.h>
+#include <unistd.h>
 #include "servers/ario-server.h"
 #include "mpd/client.h"
+#include "mpd/async.h"
 
 #include "ario-debug.h"
 #include "ario-profiles.h"
 #include "ario-util.h"
 #include "preferences/ario-preferences.h"
 #include "lib/ario-conf.h"
+#include "servers/ario-server-worker.h"
 #include "lib/gtk-builder-helpers.h"
 #include "widgets/ario-playlist.h"
 
@@ -42,15 +46,26 @@
 #define RECONNECT_INIT_TIMEOUT 500
 /* Multiply reconnection timeout by 2 after each tentative */
 #define RECONNECT_FACTOR 2
+/* Servers close connections left unused for too long (60 seconds by
+ * default for MPD) */
+#define KEEPALIVE_TIMEOUT 30
+/* Maximum number of connections kept for queries run in threads */
+#define QUERY_CONNECTIONS_MAX 2
+/* Size in bytes of the command lists sent by background additions, well
+ * below the default max_command_list_size of MPD (2 MiB) */
+#define ENQUEUE_CHUNK_SIZE (256 * 1024)
 /* Reconnect timeout will never exceed 8 seconds */
 #define RECONNECT_MAXIMUM_TIMEOUT 8000
+/* Refresh the connection dialog every 0.2 second */
+#define CONNECT_PULSE_TIMEOUT 200
+/* Maximum length of the welcome line of the server */
+#define WELCOME_MAX_LENGTH 256
+/* Idle events handled by reading the status of the server */
+#define STATUS_EVENTS (MPD_IDLE_DATABASE | MPD_IDLE_UPDATE | MPD_IDLE_QUEUE | MPD_IDLE_PLAYER | MPD_IDLE_MIXER | MPD_IDLE_OPTIONS)
 
 static void ario_mpd_finalize (GObject *object);
-static gboolean ario_mpd_connect_to (ArioMpd *mpd,
-                                     gchar *hostname,
-                                     int port,
-                                     guint timeout);
 static void ario_mpd_connect (void);
+static void ario_mpd_connect_free (void);
 static void ario_mpd_disconnect (void);
 static void ario_mpd_update_db (const gchar *path);
 static gboolean ario_mpd_check_errors (void);
@@ -66,6 +81,7 @@ static GSList * ario_mpd_get_songs_from_playlist (char *playlist);
 static GSList * ario_mpd_get_playlists (void);
 static GSList * ario_mpd_get_playlist_changes (gint64 playlist_id);
 static gboolean ario_mpd_update_status (void);
+static void ario_mpd_refresh_status (const enum mpd_idle events);
 static ArioServerSong * ario_mpd_get_current_song_on_server (void);
 static int ario_mpd_get_current_playlist_total_time (void);
 static unsigned long ario_mpd_get_last_update (void);
@@ -96,12 +112,55 @@ static ArioServerStats * ario_mpd_get_stats (void);
 static GList * ario_mpd_get_songs_info (GSList *paths);
 static ArioServerFileList * ario_mpd_list_files (const char *path,
                                                  gboolean recursive);
+static void ario_mpd_start_stream (ArioServerStream *stream);
+static gboolean ario_mpd_enqueue (ArioServerEnqueue *enqueue);
 // Return TRUE on error
 static gboolean ario_mpd_command_preinvoke (void);
-static void ario_mpd_command_postinvoke (void);
 static void ario_mpd_idle_start (void);
+static gboolean ario_mpd_keepalive_cb (gpointer data);
+static struct mpd_connection * ario_mpd_open_connection (void);
+static void ario_mpd_connection_lost (void);
 static void ario_mpd_server_state_changed_cb (ArioServer *server,
                                               gpointer data);
+/* Steps of the connection to the server. Each step but the first
+ * one waits for the answer of the server to a command */
+typedef enum
+{
+        ARIO_MPD_CONNECT_NONE,
+        ARIO_MPD_CONNECT_SOCKET,
+        ARIO_MPD_CONNECT_WELCOME,
+        ARIO_MPD_CONNECT_PASSWORD,
+        ARIO_MPD_CONNECT_COMMANDS,
+        ARIO_MPD_CONNECT_TAGS,
+        ARIO_MPD_CONNECT_DONE
+} ArioMpdConnectStep;
+
+/* Player and playlist commands run by the worker */
+typedef enum
+{
+        ARIO_MPD_NEXT,
+        ARIO_MPD_PREVIOUS,
+        ARIO_MPD_PLAY,
+        ARIO_MPD_PLAY_POS,
+        ARIO_MPD_PAUSE,
+        ARIO_MPD_STOP,
+        ARIO_MPD_SEEK,
+        ARIO_MPD_VOLUME,
+        ARIO_MPD_CONSUME,
+        ARIO_MPD_RANDOM,
+        ARIO_MPD_REPEAT,
+        ARIO_MPD_CROSSFADE,
+        ARIO_MPD_CLEAR,
+        ARIO_MPD_SHUFFLE
+} ArioMpdCommand;
+
+typedef struct
+{
+        ArioMpdCommand command;
+        int value;
+        int song_id;
+} ArioMpdControl;
+
 /* Private attributes */
 struct ArioMpdPrivate
 {
@@ -109,18 +168,47 @@ struct ArioMpdPrivate
         struct mpd_connection *connection;
         ArioServerStats *stats;
 
+        /* Runs player commands without blocking the main loop */
+        ArioServerWorker *worker;
+
         guint timeout_id;
 
         gboolean support_empty_tags;
         gboolean support_idle;
+        gboolean support_album_group;
+        gboolean support_getvol;
         GSList * supported_tags;
 
         gboolean is_updating;
 
         int elapsed;
         int reconnect_time;
-        int idle;
-        int source_id;
+
+        /* Connection in progress, driven by the main loop */
+        ArioMpdConnectStep connect_step;
+        GCancellable *connect_cancellable;
+        GSocketConnection *connect_socket;
+        struct mpd_connection *connect_connection;
+        GString *welcome;
+        guint connect_source_id;
+        GtkWidget *connect_dialog;
+        guint pulse_id;
+
+        /* Connection waiting for server events, opened by a thread */
+        struct mpd_connection *idle_connection;
+        GCancellable *idle_cancellable;
+        GIOChannel *iochan;
+        guint source_id;
+        guint keepalive_id;
+
+        /* Events received since last dispatch */
+        enum mpd_idle events;
+        guint dispatch_id;
+
+        /* Connections kept for queries run in threads */
+        GMutex query_mutex;
+        GSList *query_connections;
+        gboolean query_open;
 
         gboolean supported[ARIO_TAG_COUNT];
 };
@@ -178,6 +266,8 @@ ario_mpd_class_init (ArioMpdClass *klass)
         server_class->get_stats = ario_mpd_get_stats;
         server_class->get_songs_info = ario_mpd_get_songs_info;
         server_class->list_files = ario_mpd_list_files;
+        server_class->start_stream = ario_mpd_start_stream;
+        server_class->enqueue = ario_mpd_enqueue;
 }
 
 static void
@@ -187,6 +277,7 @@ ario_mpd_init (ArioMpd *mpd)
         mpd->priv = ario_mpd_get_instance_private (mpd);
 
         mpd->priv->timeout_id = 0;
+        g_mutex_init (&mpd->priv->query_mutex);
 }
 
 static void
@@ -201,9 +292,16 @@ ario_mpd_finalize (GObject *object)
         mpd = ARIO_MPD (object);
         g_return_if_fail (mpd->priv != NULL);
 
-        /* Close connection to MPD */
+        /* Stop a connection in progress */
+        ario_mpd_connect_free ();
+
+        /* Close connections to MPD */
+        ario_server_worker_free (mpd->priv->worker);
         if (mpd->priv->connection)
                 mpd_connection_free (mpd->priv->connection);
+        g_slist_foreach (mpd->priv->query_connections, (GFunc) mpd_connection_free, NULL);
+        g_slist_free (mpd->priv->query_connections);
+        g_mutex_clear (&mpd->priv->query_mutex);
 
         /* Free a few data */
         if (mpd->priv->status)
@@ -239,30 +337,35 @@ ario_mpd_get_instance (ArioServer *server)
         return instance;
 }
 
+#ifdef ENABLE_MPDIDLE
+/* Read the answer to mpd_send_allowed_commands */
 static void
-ario_mpd_check_idle (ArioMpd *mpd)
+ario_mpd_check_idle (ArioMpd *mpd,
+                     struct mpd_connection *connection)
 {
         ARIO_LOG_FUNCTION_START;
-        mpd->priv->support_idle = FALSE;
-#ifdef ENABLE_MPDIDLE
         struct mpd_pair * pair;
 
+        mpd->priv->support_idle = FALSE;
+
         /* Get list of supported commands */
-        mpd_send_allowed_commands (mpd->priv->connection);
-        while ((pair = mpd_recv_pair_named (mpd->priv->connection, "command"))) {
+        while ((pair = mpd_recv_pair_named (connection, "command"))) {
                 /* Detect if idle command is supported */
                 if (!strcmp (pair->value, "idle"))
                         mpd->priv->support_idle = TRUE;
-                mpd_return_pair (mpd->priv->connection, pair);
+                mpd_return_pair (connection, pair);
         }
-#endif
 }
+#endif
 
+/* Read the answer to mpd_send_list_tag_types */
 static void
-ario_mpd_check_tags (ArioMpd *mpd)
+ario_mpd_check_tags (ArioMpd *mpd,
+                     struct mpd_connection *connection)
 {
         ARIO_LOG_FUNCTION_START;
         struct mpd_pair * pair;
+        ArioServerListBuilder supported_tags = { NULL, NULL };
         int i;
 
         /* Free list of supported tags */
@@ -275,12 +378,22 @@ ario_mpd_check_tags (ArioMpd *mpd)
         }
 
         /* Get list of supported tags */
-        mpd_send_list_tag_types (mpd->priv->connection);
-        while ((pair = mpd_recv_tag_type_pair (mpd->priv->connection))) {
+        while ((pair = mpd_recv_tag_type_pair (connection))) {
                 /* Add them to the list */
-                mpd->priv->supported_tags = g_slist_append (mpd->priv->supported_tags, g_strdup (pair->value));
-                mpd_return_pair (mpd->priv->connection, pair);
+                ario_server_list_builder_append (&supported_tags, g_strdup (pair->value));
+                mpd_return_pair (connection, pair);
         }
+        mpd->priv->supported_tags = ario_server_list_builder_steal (&supported_tags);
+
+        /* Albums can be listed by the server itself since MPD 0.21 */
+        mpd->priv->support_album_group = (mpd_connection_cmp_server_version (connection, 0, 21, 0) >= 0);
+
+        /* Volume can be read without the whole status since MPD 0.23 */
+#if LIBMPDCLIENT_CHECK_VERSION(2, 20, 0)
+        mpd->priv->support_getvol = (mpd_connection_cmp_server_version (connection, 0, 23, 0) >= 0);
+#else
+        mpd->priv->support_getvol = FALSE;
+#endif
 }
 
 static void
@@ -306,37 +419,50 @@ ario_mpd_update_elapsed (gpointer data)
 }
 
 static gboolean
-ario_mpd_emit_storedplaylist (gpointer not_used)
+ario_mpd_dispatch_events (gpointer not_used)
 {
-        g_signal_emit_by_name (G_OBJECT (server_instance), "storedplaylists_changed");
+        ARIO_LOG_FUNCTION_START;
+        enum mpd_idle events = instance->priv->events;
+
+        instance->priv->events = 0;
+        instance->priv->dispatch_id = 0;
+
+        /* Only read the parts of the status matching the events */
+        if (events & STATUS_EVENTS)
+                ario_mpd_refresh_status (events & STATUS_EVENTS);
+
+        /* Stored playlists changed, update list */
+        if (events & MPD_IDLE_STORED_PLAYLIST)
+                g_signal_emit_by_name (G_OBJECT (server_instance), "storedplaylists_changed");
+
+        /* Database changed, check the library cache against it */
+        if (events & MPD_IDLE_DATABASE)
+                ario_server_cache_check ();
 
-        /*
-         * We're being hooked into the main loop using g_idle_add and
-         * want to be called just once
-         */
         return FALSE;
 }
 
 static void
-ario_mpd_idle_read (void)
+ario_mpd_queue_events (const enum mpd_idle events)
 {
         ARIO_LOG_FUNCTION_START;
 
-        enum mpd_idle flags = mpd_recv_idle (instance->priv->connection, FALSE);
-        ario_mpd_check_errors ();
+        /* Events received before the main loop is idle are handled
+         * together: a burst of volume changes costs a single request */
+        instance->priv->events |= events;
+        if (!instance->priv->dispatch_id)
+                instance->priv->dispatch_id = g_idle_add ((GSourceFunc) ario_mpd_dispatch_events, NULL);
+}
 
-        /* Update MPD status */
-        /* TODO: Be more selective depending on flags */
-        if (flags & MPD_IDLE_DATABASE
-            || flags & MPD_IDLE_QUEUE
-            || flags & MPD_IDLE_PLAYER
-            || flags & MPD_IDLE_MIXER
-            || flags & MPD_IDLE_OPTIONS)
-                g_idle_add ((GSourceFunc) ario_mpd_update_status, NULL);
+static void
+ario_mpd_idle_read (void)
+{
+        ARIO_LOG_FUNCTION_START;
 
-        /* Stored playlists changed, update list */
-        if (flags & MPD_IDLE_STORED_PLAYLIST)
-                g_idle_add ((GSourceFunc) ario_mpd_emit_storedplaylist, NULL);
+        enum mpd_idle flags = mpd_recv_idle (instance->priv->idle_connection, FALSE);
+
+        if (flags)
+                ario_mpd_queue_events (flags);
 }
 
 static gboolean
@@ -345,152 +471,142 @@ ario_mpd_idle_read_cb (GIOChannel *iochan,
                        gpointer data)
 {
         ARIO_LOG_FUNCTION_START;
-        if (!instance->priv->idle) {
-                instance->priv->source_id = 0;
-                return FALSE;
-        }
-
         if (cond & G_IO_IN) {
-                instance->priv->idle = FALSE;
-                if (instance->priv->source_id) {
-                        g_source_remove (instance->priv->source_id);
-                        instance->priv->source_id = 0;
-                }
                 ario_mpd_idle_read ();
+
+                /* Wait for the next events */
+                if (mpd_connection_get_error (instance->priv->idle_connection) == MPD_ERROR_SUCCESS
+                    && mpd_send_idle (instance->priv->idle_connection))
+                        return TRUE;
         }
 
-        return TRUE;
+        /* Idle connection is broken: the server is probably gone */
+        ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (instance->priv->idle_connection));
+        instance->priv->source_id = 0;
+        ario_mpd_connection_lost ();
+
+        return FALSE;
 }
 
-static void
-ario_mpd_idle_start (void)
+typedef struct
 {
-        ARIO_LOG_FUNCTION_START;
-        static GIOChannel* iochan = NULL;
+        GCancellable *cancellable;
+        struct mpd_connection *connection;
+} ArioMpdIdleOpen;
 
-        if (!instance->priv->connection)
-                return;
+static gboolean
+ario_mpd_idle_opened_cb (ArioMpdIdleOpen *data)
+{
+        ARIO_LOG_FUNCTION_START;
 
-        if (!iochan) {
+        if (g_cancellable_is_cancelled (data->cancellable)) {
+                /* Disconnected in the meantime */
+                if (data->connection)
+                        mpd_connection_free (data->connection);
+        } else if (!data->connection) {
+                /* Without idle connection, poll the server */
+                instance->priv->support_idle = FALSE;
+                ario_mpd_launch_timeout ();
+        } else {
+                instance->priv->idle_connection = data->connection;
 #ifdef WIN32
-                iochan = g_io_channel_win32_new_socket (mpd_connection_get_fd (instance->priv->connection));
+                instance->priv->iochan = g_io_channel_win32_new_socket (mpd_connection_get_fd (instance->priv->idle_connection));
 #else
-                iochan = g_io_channel_unix_new (mpd_connection_get_fd (instance->priv->connection));
+                instance->priv->iochan = g_io_channel_unix_new (mpd_connection_get_fd (instance->priv->idle_connection));
 #endif
-        }
-
-        if (!instance->priv->idle) {
-                instance->priv->source_id = g_io_add_watch (iochan,
+                instance->priv->source_id = g_io_add_watch (instance->priv->iochan,
                                                             G_IO_IN | G_IO_ERR | G_IO_HUP,
                                                             ario_mpd_idle_read_cb,
                                                             NULL);
-                instance->priv->idle = TRUE;
-                mpd_send_idle (instance->priv->connection);
+                mpd_send_idle (instance->priv->idle_connection);
+
+                /* Catch up with the events sent before idle started */
+                g_idle_add ((GSourceFunc) ario_mpd_update_status, NULL);
+
+                /* Main connection is not polled anymore: keep it alive */
+                instance->priv->keepalive_id = g_timeout_add_seconds (KEEPALIVE_TIMEOUT,
+                                                                      (GSourceFunc) ario_mpd_keepalive_cb,
+                                                                      NULL);
         }
+
+        g_object_unref (data->cancellable);
+        g_free (data);
+
+        return FALSE;
 }
 
-static void
-ario_mpd_idle_stop (void)
+static gpointer
+ario_mpd_idle_open_thread (ArioMpdIdleOpen *data)
 {
         ARIO_LOG_FUNCTION_START;
-        if (instance->priv->source_id) {
-                g_source_remove (instance->priv->source_id);
-                instance->priv->source_id = 0;
-        }
+        data->connection = ario_mpd_open_connection ();
+        g_idle_add ((GSourceFunc) ario_mpd_idle_opened_cb, data);
 
-        if (instance->priv->idle) {
-                instance->priv->idle = FALSE;
-                mpd_send_noidle (instance->priv->connection);
-                ario_mpd_idle_read ();
-        }
+        return NULL;
 }
 
 static void
-ario_mpd_idle_init (void)
+ario_mpd_idle_start (void)
 {
+        ARIO_LOG_FUNCTION_START;
+        ArioMpdIdleOpen *data;
+
+        /* Idle has its own connection so that it never has to be
+         * interrupted to send a command. It is opened by a thread so
+         * that the main loop never waits for the server */
+        instance->priv->idle_cancellable = g_cancellable_new ();
+
+        data = (ArioMpdIdleOpen *) g_malloc0 (sizeof (ArioMpdIdleOpen));
+        data->cancellable = g_object_ref (instance->priv->idle_cancellable);
+        g_thread_unref (g_thread_new ("idle",
+                                      (GThreadFunc) ario_mpd_idle_open_thread,
+                                      data));
 }
 
 static void
 ario_mpd_idle_free (void)
 {
         ARIO_LOG_FUNCTION_START;
-        ario_mpd_idle_stop ();
+        if (instance->priv->idle_cancellable) {
+                g_cancellable_cancel (instance->priv->idle_cancellable);
+                g_object_unref (instance->priv->idle_cancellable);
+                instance->priv->idle_cancellable = NULL;
+        }
 
         if (instance->priv->source_id) {
                 g_source_remove (instance->priv->source_id);
                 instance->priv->source_id = 0;
         }
-}
-
-static gboolean
-ario_mpd_connect_to (ArioMpd *mpd,
-                     gchar *hostname,
-                     int port,
-                     guint timeout)
-{
-        ARIO_LOG_FUNCTION_START;
-        gchar *password;
-        struct mpd_connection *connection;
-
-        /* Connect to MPD */
-        connection = mpd_connection_new (hostname, port, timeout);
-        if (!connection)
-                return FALSE;
 
-        /* Check connection errors */
-        if  (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
-                ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (connection));
-                mpd_connection_clear_error (connection);
-                mpd_connection_free (connection);
-                return FALSE;
+        if (instance->priv->dispatch_id) {
+                g_source_remove (instance->priv->dispatch_id);
+                instance->priv->dispatch_id = 0;
         }
+        instance->priv->events = 0;
 
-        /* Send password if one is set in profile */
-        password = ario_profiles_get_current (ario_profiles_get ())->password;
-        if (password) {
-                mpd_run_password (connection, password);
+        if (instance->priv->iochan) {
+                g_io_channel_unref (instance->priv->iochan);
+                instance->priv->iochan = NULL;
         }
 
-        mpd->priv->connection = connection;
-
-        /* Check if idle is supported by MPD server */
-        ario_mpd_check_idle (mpd);
-
-        /* Check if idle is supported by MPD server */
-        ario_mpd_check_tags (mpd);
-
-        if (instance->priv->support_idle && instance->priv->connection) {
-                /* Initialise Idle mode */
-                ario_mpd_idle_init ();
-                ario_mpd_idle_start ();
-                g_idle_add ((GSourceFunc) ario_mpd_update_status, NULL);
-
-                /* Connect signal to launch timeout to update elapsed time */
-                g_signal_connect_object (ario_server_get_instance (),
-                                         "state_changed",
-                                         G_CALLBACK (ario_mpd_server_state_changed_cb),
-                                         NULL, 0);
-        } else {
-                /* Launch timeout for data retrieve from MPD */
-                ario_mpd_launch_timeout ();
+        if (instance->priv->idle_connection) {
+                mpd_connection_free (instance->priv->idle_connection);
+                instance->priv->idle_connection = NULL;
         }
-
-        return TRUE;
 }
 
-static gpointer
-ario_mpd_connect_thread (ArioServer *server)
+static struct mpd_connection *
+ario_mpd_open_connection (void)
 {
         ARIO_LOG_FUNCTION_START;
+        ArioProfile *profile;
         gchar *hostname;
         int port;
-        guint timeout;
-        ArioProfile *profile;
+        struct mpd_connection *connection;
 
         profile = ario_profiles_get_current (ario_profiles_get ());
         hostname = profile->host;
         port = profile->port;
-        timeout = profile->timeout;
 
         if (hostname == NULL)
                 hostname = "localhost";
@@ -498,229 +614,718 @@ ario_mpd_connect_thread (ArioServer *server)
         if (port == 0)
                 port = 6600;
 
-        if (!ario_mpd_connect_to (instance, hostname, port, timeout)) {
-                ario_mpd_disconnect ();
+        connection = mpd_connection_new (hostname, port, profile->timeout);
+        if (!connection)
+                return NULL;
+
+        if  (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
+                ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (connection));
+                mpd_connection_free (connection);
+                return NULL;
         }
 
-        instance->priv->support_empty_tags = FALSE;
-        instance->parent.connecting = FALSE;
+        if (profile->password)
+                mpd_run_password (connection, profile->password);
 
-        return NULL;
+        return connection;
 }
 
-static void
-ario_mpd_connect (void)
+static gboolean
+ario_mpd_worker_check (struct mpd_connection *connection)
 {
         ARIO_LOG_FUNCTION_START;
-        GtkBuilder *builder;
-        GtkWidget *win = NULL;
-        static GtkProgressBar *bar;
-        GThread* thread;
-        GtkWidget *dialog;
-        gboolean is_in_error = (instance->priv->reconnect_time > 0);
-
-        thread = g_thread_new ("connect",
-                               (GThreadFunc) ario_mpd_connect_thread,
-                               instance);
+        if (mpd_connection_get_error (connection) == MPD_ERROR_SUCCESS)
+                return TRUE;
 
-        if (!is_in_error) {
-                builder = gtk_builder_new ();
-                gtk_builder_add_from_file (builder, UI_PATH "connection-dialog.ui", NULL);
+        ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (connection));
 
-                win = GTK_WIDGET (gtk_builder_get_object (builder, "ario_connection_dialog"));
-                bar = GTK_PROGRESS_BAR (gtk_builder_get_object (builder, "connection_progressbar"));
+        /* Errors returned by the server only affect the failed command */
+        return mpd_connection_clear_error (connection);
+}
 
-                g_object_unref (builder);
+static gpointer
+ario_mpd_keepalive (struct mpd_connection *connection,
+                    gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        mpd_send_command (connection, "ping", NULL);
+        mpd_response_finish (connection);
 
-                gtk_widget_show_all (win);
+        return NULL;
+}
 
-                while (instance->parent.connecting) {
-                        gtk_progress_bar_pulse (bar);
-                        while (gtk_events_pending ())
-                                gtk_main_iteration ();
-                        g_usleep (200000);
-                }
+static gboolean
+ario_mpd_keepalive_cb (gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (!ario_mpd_command_preinvoke ()) {
+                ario_mpd_keepalive (instance->priv->connection, NULL);
+                ario_mpd_check_errors ();
         }
 
-        g_thread_join (thread);
+        return TRUE;
+}
 
-        if (ario_server_is_connected ()) {
-                instance->priv->reconnect_time = 0;
-        } else if (!is_in_error) {
-                dialog = gtk_message_dialog_new (NULL, GTK_DIALOG_MODAL,
-                                                 GTK_MESSAGE_ERROR,
-                                                 GTK_BUTTONS_OK,
-                                                 _("Impossible to connect to server. Check the connection options."));
-                if (gtk_dialog_run (GTK_DIALOG (dialog)) != GTK_RESPONSE_NONE)
-                        gtk_widget_destroy (dialog);
-                g_signal_emit_by_name (G_OBJECT (server_instance), "state_changed");
+static struct mpd_connection *
+ario_mpd_query_connection_get (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        struct mpd_connection *connection = NULL;
+
+        /* Reuse a connection kept by a previous query */
+        g_mutex_lock (&instance->priv->query_mutex);
+        if (instance->priv->query_connections) {
+                connection = instance->priv->query_connections->data;
+                instance->priv->query_connections = g_slist_delete_link (instance->priv->query_connections,
+                                                                         instance->priv->query_connections);
         }
+        g_mutex_unlock (&instance->priv->query_mutex);
 
-        if (win) {
-                gtk_widget_hide (win);
-                gtk_widget_destroy (win);
+        if (connection) {
+                /* Make sure the server did not close it in the meantime */
+                ario_mpd_keepalive (connection, NULL);
+                if (mpd_connection_get_error (connection) == MPD_ERROR_SUCCESS)
+                        return connection;
+                mpd_connection_free (connection);
         }
+
+        return ario_mpd_open_connection ();
 }
 
 static void
-ario_mpd_disconnect (void)
+ario_mpd_query_connection_release (struct mpd_connection *connection)
 {
         ARIO_LOG_FUNCTION_START;
-        /* check if there is a connection */
-        if (!instance->priv->connection)
-                return;
-
-        if (instance->priv->support_idle)
-                ario_mpd_idle_free ();
-
-        /*
-         * check if there is a connection again
-         *
-         * if the connection has been cut, a call to ario_mpd_idle_free
-         * might time out and cause ario_mpd_disconnect to be called a
-         * second time and free the connection and set the pointer
-         * to NULL, causing the first invocation of this function
-         * to segfault. Since the second invocation cleaned everything
-         * up, we can just return.
-         */
-        if (!instance->priv->connection)
-                return;
-
-        mpd_connection_free (instance->priv->connection);
-        instance->priv->connection = NULL;
-
-        if (instance->priv->timeout_id) {
-                g_source_remove (instance->priv->timeout_id);
-                instance->priv->timeout_id = 0;
+        /* Keep the connection for the next query if it is still usable */
+        if (mpd_connection_get_error (connection) == MPD_ERROR_SUCCESS) {
+                g_mutex_lock (&instance->priv->query_mutex);
+                if (instance->priv->query_open
+                    && g_slist_length (instance->priv->query_connections) < QUERY_CONNECTIONS_MAX) {
+                        instance->priv->query_connections = g_slist_prepend (instance->priv->query_connections,
+                                                                             connection);
+                        connection = NULL;
+                }
+                g_mutex_unlock (&instance->priv->query_mutex);
         }
 
-        ario_mpd_update_status ();
+        if (connection)
+                mpd_connection_free (connection);
 }
 
-static void
-ario_mpd_update_db (const gchar *path)
+/* Bulk queries of the main loop use a query connection, so that the
+ * main connection is never busy with a big transfer */
+static struct mpd_connection *
+ario_mpd_query_begin (void)
 {
         ARIO_LOG_FUNCTION_START;
-        /* check if there is a connection */
         if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_update (instance->priv->connection, NULL);
+                return NULL;
 
-        ario_mpd_command_postinvoke ();
+        return ario_mpd_query_connection_get ();
 }
 
-static gboolean
-ario_mpd_try_reconnect (gpointer data)
+static void
+ario_mpd_query_end (struct mpd_connection *connection)
 {
         ARIO_LOG_FUNCTION_START;
-        ario_server_connect ();
-
-        if (!instance->priv->connection) {
-                /* Try to reconnect */
-                if (RECONNECT_INIT_TIMEOUT * instance->priv->reconnect_time * RECONNECT_FACTOR < RECONNECT_MAXIMUM_TIMEOUT)
-                        ++instance->priv->reconnect_time;
-                g_timeout_add (RECONNECT_INIT_TIMEOUT * instance->priv->reconnect_time * RECONNECT_FACTOR,
-                               ario_mpd_try_reconnect, NULL);
-        }
+        if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS)
+                ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (connection));
 
-        return FALSE;
+        ario_mpd_query_connection_release (connection);
 }
 
-static gboolean
-ario_mpd_check_errors (void)
+static gpointer
+ario_mpd_query_open_thread (gpointer data)
 {
-        // desactivated to make the logs more readable
-        //ARIO_LOG_FUNCTION_START;
-        if (!instance->priv->connection)
-                return FALSE;
+        ARIO_LOG_FUNCTION_START;
+        struct mpd_connection *connection;
 
-        if  (mpd_connection_get_error (instance->priv->connection) != MPD_ERROR_SUCCESS) {
-                ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (instance->priv->connection));
-                mpd_connection_clear_error (instance->priv->connection);
-                ario_server_disconnect ();
+        /* Open a query connection before the first query needs it */
+        connection = ario_mpd_open_connection ();
+        if (connection)
+                ario_mpd_query_connection_release (connection);
 
-                /* Try to reconnect */
-                instance->priv->reconnect_time = 1;
-                g_timeout_add (RECONNECT_INIT_TIMEOUT * instance->priv->reconnect_time * RECONNECT_FACTOR,
-                               ario_mpd_try_reconnect, NULL);
-                return TRUE;
-        }
-        return FALSE;
+        return NULL;
 }
 
 static gboolean
-ario_mpd_is_connected (void)
+ario_mpd_connect_pulse_cb (GtkProgressBar *bar)
 {
-        // desactivated to make the logs more readable
-        //ARIO_LOG_FUNCTION_START;
-        return (instance->priv->connection != NULL);
+        gtk_progress_bar_pulse (bar);
+
+        return TRUE;
 }
 
-static ArioServerTag
-ario_mpd_filter_tag (const ArioServerTag tag)
+static void
+ario_mpd_connect_free (void)
 {
-        GSList *tmp;
-        if (instance->priv->supported[tag])
-        {
-                return tag;
+        ARIO_LOG_FUNCTION_START;
+        if (instance->priv->connect_source_id) {
+                g_source_remove (instance->priv->connect_source_id);
+                instance->priv->connect_source_id = 0;
         }
-        else
-        {
-                const gchar *tag_name = mpd_tag_name (tag);
-                for (tmp = instance->priv->supported_tags; tmp; tmp = g_slist_next (tmp)) {
-                        if (!ario_util_strcmp (tag_name, tmp->data)) {
-                                instance->priv->supported[tag] = TRUE;
-                                return tag;
-                        }
-                }
+
+        /* Stop resolving or connecting if it is still in progress */
+        if (instance->priv->connect_cancellable) {
+                g_cancellable_cancel (instance->priv->connect_cancellable);
+                g_object_unref (instance->priv->connect_cancellable);
+                instance->priv->connect_cancellable = NULL;
         }
 
-        return ARIO_TAG_ARTIST;
+        if (instance->priv->connect_connection) {
+                mpd_connection_free (instance->priv->connect_connection);
+                instance->priv->connect_connection = NULL;
+        }
+
+        if (instance->priv->connect_socket) {
+                g_object_unref (instance->priv->connect_socket);
+                instance->priv->connect_socket = NULL;
+        }
+
+        if (instance->priv->welcome) {
+                g_string_free (instance->priv->welcome, TRUE);
+                instance->priv->welcome = NULL;
+        }
+
+        if (instance->priv->pulse_id) {
+                g_source_remove (instance->priv->pulse_id);
+                instance->priv->pulse_id = 0;
+        }
+
+        if (instance->priv->connect_dialog) {
+                gtk_widget_destroy (instance->priv->connect_dialog);
+                instance->priv->connect_dialog = NULL;
+        }
+
+        instance->priv->connect_step = ARIO_MPD_CONNECT_NONE;
 }
 
-static GSList *
-ario_mpd_list_tags (const ArioServerTag server_tag,
-                    const ArioServerCriteria *criteria)
+static gboolean
+ario_mpd_try_reconnect (gpointer data)
 {
         ARIO_LOG_FUNCTION_START;
-        const GSList *tmp;
-        GSList *values = NULL;
-        ArioServerAtomicCriteria *atomic_criteria;
-        struct mpd_pair *pair;
-        ArioServerTag tag = ario_mpd_filter_tag(server_tag);
+        ario_server_connect ();
 
-        if (ario_mpd_command_preinvoke ())
-                return NULL;
+        return FALSE;
+}
+
+static void
+ario_mpd_connect_ready (struct mpd_connection *connection)
+{
+        ARIO_LOG_FUNCTION_START;
+        instance->priv->connection = connection;
+
+        /* Player commands have their own connection so that they never
+         * wait behind a big query */
+        instance->priv->worker = ario_server_worker_new ("control",
+                                                         (ArioServerWorkerConnectFunc) ario_mpd_open_connection,
+                                                         (ArioServerWorkerCheckFunc) ario_mpd_worker_check,
+                                                         (ArioServerWorkerCloseFunc) mpd_connection_free,
+                                                         (ArioServerWorkerFunc) ario_mpd_keepalive);
+
+        g_mutex_lock (&instance->priv->query_mutex);
+        instance->priv->query_open = TRUE;
+        g_mutex_unlock (&instance->priv->query_mutex);
+        g_thread_unref (g_thread_new ("query",
+                                      (GThreadFunc) ario_mpd_query_open_thread,
+                                      NULL));
+
+        if (instance->priv->support_idle) {
+                ario_mpd_idle_start ();
+
+                /* Connect signal to launch timeout to update elapsed time */
+                g_signal_connect_object (ario_server_get_instance (),
+                                         "state_changed",
+                                         G_CALLBACK (ario_mpd_server_state_changed_cb),
+                                         NULL, 0);
+        } else {
+                /* Launch timeout for data retrieve from MPD */
+                ario_mpd_launch_timeout ();
+        }
+
+        /* First status of the server */
+        ario_mpd_update_status ();
+}
+
+static void
+ario_mpd_connect_done (const gboolean success)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkWidget *dialog;
+        gboolean is_in_error = (instance->priv->reconnect_time > 0);
+
+        if (success) {
+                ario_mpd_connect_ready (instance->priv->connect_connection);
+                instance->priv->connect_connection = NULL;
+        }
+        ario_mpd_connect_free ();
+
+        instance->priv->support_empty_tags = FALSE;
+
+        if (success) {
+                instance->priv->reconnect_time = 0;
+        } else if (!is_in_error) {
+                if (!ario_server_is_headless ()) {
+                        dialog = gtk_message_dialog_new (NULL, GTK_DIALOG_MODAL,
+                                                         GTK_MESSAGE_ERROR,
+                                                         GTK_BUTTONS_OK,
+                                                         _("Impossible to connect to server. Check the connection options."));
+                        g_signal_connect (dialog, "response", G_CALLBACK (gtk_widget_destroy), NULL);
+                        gtk_widget_show (dialog);
+                }
+                g_signal_emit_by_name (G_OBJECT (server_instance), "state_changed");
+        } else {
+                /* Try to reconnect later */
+                if (RECONNECT_INIT_TIMEOUT * instance->priv->reconnect_time * RECONNECT_FACTOR < RECONNECT_MAXIMUM_TIMEOUT)
+                        ++instance->priv->reconnect_time;
+                g_timeout_add (RECONNECT_INIT_TIMEOUT * instance->priv->reconnect_time * RECONNECT_FACTOR,
+                               ario_mpd_try_reconnect, NULL);
+        }
+
+        ario_server_connect_finished ();
+}
+
+/* Returns TRUE once the whole welcome line of the server is read */
+static gboolean
+ario_mpd_connect_read_welcome (gboolean *error)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSocket *socket = g_socket_connection_get_socket (instance->priv->connect_socket);
+        gchar buffer[WELCOME_MAX_LENGTH];
+        gchar *end;
+        gssize length;
+        GError *tmp_error = NULL;
+
+        length = g_socket_receive (socket, buffer, sizeof (buffer), NULL, &tmp_error);
+        if (length <= 0) {
+                if (tmp_error && g_error_matches (tmp_error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                        g_error_free (tmp_error);
+                        return FALSE;
+                }
+                if (tmp_error) {
+                        ARIO_LOG_ERROR ("%s", tmp_error->message);
+                        g_error_free (tmp_error);
+                }
+                *error = TRUE;
+                return FALSE;
+        }
+
+        /* The server does not send anything else before a command */
+        g_string_append_len (instance->priv->welcome, buffer, length);
+        end = memchr (instance->priv->welcome->str, '\n', instance->priv->welcome->len);
+        if (!end) {
+                *error = (instance->priv->welcome->len >= WELCOME_MAX_LENGTH);
+                return FALSE;
+        }
+        g_string_truncate (instance->priv->welcome, end - instance->priv->welcome->str);
+
+        return TRUE;
+}
+
+/* Hand the connected socket over to libmpdclient */
+static gboolean
+ario_mpd_connect_handshake (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        struct mpd_async *async;
+        struct mpd_connection *connection;
+        int fd;
+
+        /* libmpdclient closes its socket: give it its own descriptor */
+        fd = dup (g_socket_get_fd (g_socket_connection_get_socket (instance->priv->connect_socket)));
+        if (fd < 0)
+                return FALSE;
+
+        async = mpd_async_new (fd);
+        if (!async) {
+                close (fd);
+                return FALSE;
+        }
+
+        /* Parses the welcome line and takes the ownership of async */
+        connection = mpd_connection_new_async (async, instance->priv->welcome->str);
+        if (!connection)
+                return FALSE;
+
+        if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
+                ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (connection));
+                mpd_connection_free (connection);
+                return FALSE;
+        }
+
+        mpd_connection_set_timeout (connection,
+                                    ario_profiles_get_current (ario_profiles_get ())->timeout);
+        instance->priv->connect_connection = connection;
+
+        return TRUE;
+}
+
+/* Send the command of the next step. Returns FALSE when there is no
+ * command left to send */
+static gboolean
+ario_mpd_connect_next_step (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        struct mpd_connection *connection = instance->priv->connect_connection;
+        const gchar *password = ario_profiles_get_current (ario_profiles_get ())->password;
+
+        while (instance->priv->connect_step < ARIO_MPD_CONNECT_DONE) {
+                ++instance->priv->connect_step;
+
+                switch (instance->priv->connect_step) {
+                case ARIO_MPD_CONNECT_PASSWORD:
+                        /* Send password if one is set in profile */
+                        if (password) {
+                                mpd_send_password (connection, password);
+                                return TRUE;
+                        }
+                        break;
+                case ARIO_MPD_CONNECT_COMMANDS:
+#ifdef ENABLE_MPDIDLE
+                        /* Check if idle is supported by MPD server */
+                        mpd_send_allowed_commands (connection);
+                        return TRUE;
+#else
+                        instance->priv->support_idle = FALSE;
+                        break;
+#endif
+                case ARIO_MPD_CONNECT_TAGS:
+                        /* Check which tags are supported by MPD server */
+                        mpd_send_list_tag_types (connection);
+                        return TRUE;
+                default:
+                        break;
+                }
+        }
+
+        return FALSE;
+}
+
+static gboolean
+ario_mpd_connect_step_cb (GSocket *socket,
+                          GIOCondition condition,
+                          gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        struct mpd_connection *connection = instance->priv->connect_connection;
+        gboolean error = FALSE;
+
+        if (!(condition & G_IO_IN)) {
+                ARIO_LOG_ERROR ("Connection closed by server");
+                ario_mpd_connect_done (FALSE);
+                return FALSE;
+        }
+
+        /* Read the answer of the server to the current step */
+        switch (instance->priv->connect_step) {
+        case ARIO_MPD_CONNECT_WELCOME:
+                if (!ario_mpd_connect_read_welcome (&error)) {
+                        if (error)
+                                break;
+                        /* Wait for the end of the line */
+                        return TRUE;
+                }
+                error = !ario_mpd_connect_handshake ();
+                break;
+        case ARIO_MPD_CONNECT_PASSWORD:
+                /* A wrong password only restricts the allowed commands */
+                if (!mpd_response_finish (connection)) {
+                        ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (connection));
+                        error = !mpd_connection_clear_error (connection);
+                }
+                break;
+#ifdef ENABLE_MPDIDLE
+        case ARIO_MPD_CONNECT_COMMANDS:
+                ario_mpd_check_idle (instance, connection);
+                error = (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS);
+                break;
+#endif
+        case ARIO_MPD_CONNECT_TAGS:
+                ario_mpd_check_tags (instance, connection);
+                error = (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS);
+                break;
+        default:
+                error = TRUE;
+                break;
+        }
+
+        if (error) {
+                if (instance->priv->connect_connection)
+                        ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (instance->priv->connect_connection));
+                ario_mpd_connect_done (FALSE);
+                return FALSE;
+        }
+
+        /* Wait for the answer to the next command */
+        if (ario_mpd_connect_next_step ())
+                return TRUE;
+
+        ario_mpd_connect_done (TRUE);
+        return FALSE;
+}
+
+static void
+ario_mpd_connect_socket_cb (GObject *client,
+                            GAsyncResult *result,
+                            gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSocketConnection *socket_connection;
+        GSource *source;
+        GError *error = NULL;
+
+        socket_connection = g_socket_client_connect_finish (G_SOCKET_CLIENT (client), result, &error);
+        if (!socket_connection) {
+                /* Nothing is left to free if ario has disconnected */
+                if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+                        ARIO_LOG_ERROR ("%s", error->message);
+                        ario_mpd_connect_done (FALSE);
+                }
+                g_error_free (error);
+                return;
+        }
+
+        /* Wait for the welcome line of the server, then for the answer
+         * to each command sent by the next steps */
+        instance->priv->connect_socket = socket_connection;
+        instance->priv->connect_step = ARIO_MPD_CONNECT_WELCOME;
+        instance->priv->welcome = g_string_new (NULL);
+
+        source = g_socket_create_source (g_socket_connection_get_socket (socket_connection),
+                                         G_IO_IN | G_IO_ERR | G_IO_HUP,
+                                         NULL);
+        g_source_set_callback (source, (GSourceFunc) ario_mpd_connect_step_cb, NULL, NULL);
+        instance->priv->connect_source_id = g_source_attach (source, NULL);
+        g_source_unref (source);
+}
+
+static void
+ario_mpd_connect (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkBuilder *builder;
+        GtkProgressBar *bar;
+        GSocketClient *client;
+        ArioProfile *profile;
+        gchar *hostname;
+        int port;
+#ifdef G_OS_UNIX
+        GSocketAddress *address;
+#endif
+
+        profile = ario_profiles_get_current (ario_profiles_get ());
+        hostname = profile->host;
+        port = profile->port;
+
+        if (hostname == NULL)
+                hostname = "localhost";
+
+        if (port == 0)
+                port = 6600;
+
+        /* The connection goes on in the main loop: each step is
+         * started when the previous one is over */
+        instance->priv->connect_step = ARIO_MPD_CONNECT_SOCKET;
+        instance->priv->connect_cancellable = g_cancellable_new ();
+
+        client = g_socket_client_new ();
+        g_socket_client_set_timeout (client, (profile->timeout + ONE_SECOND - 1) / ONE_SECOND);
+#ifdef G_OS_UNIX
+        if (*hostname == '/') {
+                /* Local socket */
+                address = g_unix_socket_address_new (hostname);
+                g_socket_client_connect_async (client,
+                                               G_SOCKET_CONNECTABLE (address),
+                                               instance->priv->connect_cancellable,
+                                               ario_mpd_connect_socket_cb,
+                                               NULL);
+                g_object_unref (address);
+        } else
+#endif
+        {
+                g_socket_client_connect_to_host_async (client,
+                                                       hostname, port,
+                                                       instance->priv->connect_cancellable,
+                                                       ario_mpd_connect_socket_cb,
+                                                       NULL);
+        }
+        g_object_unref (client);
+
+        /* No dialog when trying to reconnect */
+        if (instance->priv->reconnect_time == 0 && !ario_server_is_headless ()) {
+                builder = gtk_builder_new ();
+                gtk_builder_add_from_file (builder, UI_PATH "connection-dialog.ui", NULL);
+
+                instance->priv->connect_dialog = GTK_WIDGET (gtk_builder_get_object (builder, "ario_connection_dialog"));
+                bar = GTK_PROGRESS_BAR (gtk_builder_get_object (builder, "connection_progressbar"));
+
+                g_object_unref (builder);
+
+                gtk_widget_show_all (instance->priv->connect_dialog);
+                instance->priv->pulse_id = g_timeout_add (CONNECT_PULSE_TIMEOUT,
+                                                          (GSourceFunc) ario_mpd_connect_pulse_cb,
+                                                          bar);
+        }
+}
+
+static void
+ario_mpd_disconnect (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Abort a connection in progress */
+        if (instance->priv->connect_step != ARIO_MPD_CONNECT_NONE) {
+                ario_mpd_connect_free ();
+                instance->parent.connecting = FALSE;
+        }
+
+        /* check if there is a connection */
+        if (!instance->priv->connection)
+                return;
+
+        ario_mpd_idle_free ();
+
+        if (instance->priv->keepalive_id) {
+                g_source_remove (instance->priv->keepalive_id);
+                instance->priv->keepalive_id = 0;
+        }
+
+        /* Stop the worker once its pending commands are sent */
+        ario_server_worker_free (instance->priv->worker);
+        instance->priv->worker = NULL;
+        instance->parent.committing = 0;
+
+        /* Close connections kept for queries */
+        g_mutex_lock (&instance->priv->query_mutex);
+        instance->priv->query_open = FALSE;
+        g_slist_foreach (instance->priv->query_connections, (GFunc) mpd_connection_free, NULL);
+        g_slist_free (instance->priv->query_connections);
+        instance->priv->query_connections = NULL;
+        g_mutex_unlock (&instance->priv->query_mutex);
+
+        mpd_connection_free (instance->priv->connection);
+        instance->priv->connection = NULL;
+
+        if (instance->priv->timeout_id) {
+                g_source_remove (instance->priv->timeout_id);
+                instance->priv->timeout_id = 0;
+        }
+
+        ario_mpd_update_status ();
+}
+
+static void
+ario_mpd_update_db (const gchar *path)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* check if there is a connection */
+        if (ario_mpd_command_preinvoke ())
+                return;
+
+        mpd_run_update (instance->priv->connection, NULL);
+}
+
+static void
+ario_mpd_connection_lost (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        ario_server_disconnect ();
+
+        /* Try to reconnect */
+        instance->priv->reconnect_time = 1;
+        g_timeout_add (RECONNECT_INIT_TIMEOUT * instance->priv->reconnect_time * RECONNECT_FACTOR,
+                       ario_mpd_try_reconnect, NULL);
+}
+
+static gboolean
+ario_mpd_check_errors (void)
+{
+        // desactivated to make the logs more readable
+        //ARIO_LOG_FUNCTION_START;
+        if (!instance->priv->connection)
+                return FALSE;
+
+        if  (mpd_connection_get_error (instance->priv->connection) != MPD_ERROR_SUCCESS) {
+                ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (instance->priv->connection));
+                mpd_connection_clear_error (instance->priv->connection);
+                ario_mpd_connection_lost ();
+                return TRUE;
+        }
+        return FALSE;
+}
+
+static gboolean
+ario_mpd_is_connected (void)
+{
+        // desactivated to make the logs more readable
+        //ARIO_LOG_FUNCTION_START;
+        return (instance->priv->connection != NULL);
+}
+
+static ArioServerTag
+ario_mpd_filter_tag (const ArioServerTag tag)
+{
+        GSList *tmp;
+        if (instance->priv->supported[tag])
+        {
+                return tag;
+        }
+        else
+        {
+                const gchar *tag_name = mpd_tag_name (tag);
+                for (tmp = instance->priv->supported_tags; tmp; tmp = g_slist_next (tmp)) {
+                        if (!ario_util_strcmp (tag_name, tmp->data)) {
+                                instance->priv->supported[tag] = TRUE;
+                                return tag;
+                        }
+                }
+        }
+
+        return ARIO_TAG_ARTIST;
+}
 
-        mpd_search_db_tags (instance->priv->connection, tag);
+static GSList *
+ario_mpd_list_tags (const ArioServerTag server_tag,
+                    const ArioServerCriteria *criteria)
+{
+        ARIO_LOG_FUNCTION_START;
+        const GSList *tmp;
+        ArioServerListBuilder values_builder = { NULL, NULL };
+        ArioServerAtomicCriteria *atomic_criteria;
+        struct mpd_pair *pair;
+        ArioServerTag tag = ario_mpd_filter_tag(server_tag);
+        struct mpd_connection *connection;
+
+        connection = ario_mpd_query_begin ();
+        if (!connection)
+                return NULL;
+
+        mpd_search_db_tags (connection, tag);
         for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
                 atomic_criteria = tmp->data;
                 if (instance->priv->support_empty_tags
                     && !g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        mpd_search_add_tag_constraint (instance->priv->connection,
+                        mpd_search_add_tag_constraint (connection,
                                                        MPD_OPERATOR_DEFAULT,
                                                        ario_mpd_filter_tag (atomic_criteria->tag), "");
                 else
-                        mpd_search_add_tag_constraint (instance->priv->connection,
+                        mpd_search_add_tag_constraint (connection,
                                                        MPD_OPERATOR_DEFAULT,
                                                        ario_mpd_filter_tag (atomic_criteria->tag), atomic_criteria->value);
         }
-        mpd_search_commit (instance->priv->connection);
+        mpd_search_commit (connection);
 
-        while ((pair = mpd_recv_pair_tag (instance->priv->connection, tag))) {
+        while ((pair = mpd_recv_pair_tag (connection, tag))) {
                 if (*pair->value)
-                        values = g_slist_append (values, g_strdup(pair->value));
+                        ario_server_list_builder_append (&values_builder, g_strdup(pair->value));
                 else {
-                        values = g_slist_append (values, g_strdup (ARIO_SERVER_UNKNOWN));
+                        ario_server_list_builder_append (&values_builder, g_strdup (ARIO_SERVER_UNKNOWN));
                         instance->priv->support_empty_tags = TRUE;
                 }
-                mpd_return_pair (instance->priv->connection, pair);
+                mpd_return_pair (connection, pair);
         }
+        ario_mpd_query_end (connection);
 
-        ario_mpd_command_postinvoke ();
-
-        return values;
+        return ario_server_list_builder_steal (&values_builder);
 }
 
 static gboolean
@@ -731,46 +1336,190 @@ ario_mpd_album_is_present (GHashTable *albums,
         return g_hash_table_lookup (albums, album) != NULL;
 }
 
+static void
+ario_mpd_free_album (gpointer key,
+                     ArioServerAlbum *mpd_album,
+                     gpointer data)
+{
+        ario_server_free_album (mpd_album);
+}
+
+/* Grouped listings give no path: take the folder of the first song of
+ * each album, asked by batches in command lists */
+static void
+ario_mpd_list_albums_paths (struct mpd_connection *connection,
+                            GHashTable *albums)
+{
+        ARIO_LOG_FUNCTION_START;
+        GList *values, *tmp, *batch_start, *batch_end;
+        ArioServerAlbum *mpd_album;
+        struct mpd_song *song;
+        const char *uri;
+        int batch_size, i;
+        unsigned location;
+
+        batch_size = MAX (1, ario_conf_get_integer (PREF_SONGS_INFO_BATCH, PREF_SONGS_INFO_BATCH_DEFAULT));
+
+        values = g_hash_table_get_values (albums);
+        tmp = values;
+        while (tmp) {
+                batch_start = tmp;
+
+                /* Send a whole batch of requests before reading any response */
+                mpd_command_list_begin (connection, TRUE);
+                for (batch_end = batch_start, i = 0;
+                     batch_end && i < batch_size;
+                     batch_end = g_list_next (batch_end), ++i) {
+                        mpd_album = batch_end->data;
+                        mpd_send_command (connection,
+                                          "find", "album",
+                                          strcmp (mpd_album->album, ARIO_SERVER_UNKNOWN) ? mpd_album->album : "",
+                                          "window", "0:1",
+                                          NULL);
+                }
+                mpd_command_list_end (connection);
+
+                /* Read the responses in the same order */
+                for (tmp = batch_start; tmp != batch_end; tmp = g_list_next (tmp)) {
+                        mpd_album = tmp->data;
+                        while ((song = mpd_recv_song (connection))) {
+                                uri = mpd_song_get_uri (song);
+                                if (!mpd_album->path && uri)
+                                        mpd_album->path = g_path_get_dirname (uri);
+                                mpd_song_free (song);
+                        }
+
+                        if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS)
+                                break;
+                        mpd_response_next (connection);
+                }
+
+                if (mpd_connection_get_error (connection) == MPD_ERROR_SERVER) {
+                        /* A refused request aborts the rest of the list: skip it and send the following ones again */
+                        location = mpd_connection_get_server_error_location (connection);
+                        mpd_connection_clear_error (connection);
+                        tmp = g_list_nth (batch_start, location + 1);
+                } else if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
+                        break;
+                } else {
+                        mpd_response_finish (connection);
+                }
+        }
+        g_list_free (values);
+}
+
+static gboolean
+ario_mpd_list_albums (struct mpd_connection *connection,
+                      GHashTable *albums)
+{
+        ARIO_LOG_FUNCTION_START;
+        struct mpd_pair *pair;
+        gchar *artist = NULL;
+        gchar *date = NULL;
+        const char *album;
+        ArioServerAlbum *mpd_album;
+
+        /* Let the server group songs instead of sending all of them. The
+         * artist is the one of the songs, like when songs are scanned */
+        mpd_send_command (connection,
+                          "list", "album",
+                          "group", "artist",
+                          "group", "date",
+                          NULL);
+
+        /* Group values are only sent when they change */
+        while ((pair = mpd_recv_pair (connection))) {
+                if (!g_ascii_strcasecmp (pair->name, "Artist")) {
+                        g_free (artist);
+                        artist = g_strdup (pair->value);
+                } else if (!g_ascii_strcasecmp (pair->name, "Date")) {
+                        g_free (date);
+                        date = g_strdup (pair->value);
+                } else if (!g_ascii_strcasecmp (pair->name, "Album")) {
+                        album = *pair->value ? pair->value : ARIO_SERVER_UNKNOWN;
+                        if (!ario_mpd_album_is_present (albums, album)) {
+                                mpd_album = (ArioServerAlbum *) g_malloc (sizeof (ArioServerAlbum));
+                                mpd_album->album = g_strdup (album);
+                                if (artist && *artist)
+                                        mpd_album->artist = g_strdup (artist);
+                                else
+                                        mpd_album->artist = g_strdup (ARIO_SERVER_UNKNOWN);
+                                /* Path is asked once all albums are known */
+                                mpd_album->path = NULL;
+                                mpd_album->date = (date && *date) ? g_strdup (date) : NULL;
+
+                                g_hash_table_insert (albums, mpd_album->album, (gpointer) mpd_album);
+                        }
+                }
+                mpd_return_pair (connection, pair);
+        }
+        g_free (artist);
+        g_free (date);
+
+        /* Grouping has been refused: the server is too old */
+        if (mpd_connection_get_error (connection) == MPD_ERROR_SERVER) {
+                ARIO_LOG_ERROR("%s", mpd_connection_get_error_message (connection));
+                mpd_connection_clear_error (connection);
+                instance->priv->support_album_group = FALSE;
+
+                g_hash_table_foreach (albums, (GHFunc) ario_mpd_free_album, NULL);
+                g_hash_table_remove_all (albums);
+                return FALSE;
+        }
+        mpd_response_finish (connection);
+
+        ario_mpd_list_albums_paths (connection, albums);
+
+        return TRUE;
+}
+
 static GSList *
 ario_mpd_get_albums (const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
         GHashTable *albums;
         const GSList *tmp;
-        GList *values;
+        GList *values, *tmp_values;
         GSList *result = NULL;
         struct mpd_song *song;
         ArioServerAlbum *mpd_album;
         ArioServerAtomicCriteria *atomic_criteria;
+        gboolean listed = FALSE;
+        struct mpd_connection *connection;
 
-        if (ario_mpd_command_preinvoke ())
+        connection = ario_mpd_query_begin ();
+        if (!connection)
                 return NULL;
 
         albums = g_hash_table_new (g_str_hash, g_str_equal);
 
         if (!criteria) {
-                mpd_send_list_all_meta (instance->priv->connection, "/");
+                /* Avoid the transfer of the whole database when possible */
+                if (instance->priv->support_album_group)
+                        listed = ario_mpd_list_albums (connection, albums);
+                if (!listed)
+                        mpd_send_list_all_meta (connection, "/");
         } else {
-                mpd_search_db_songs (instance->priv->connection, TRUE);
+                mpd_search_db_songs (connection, TRUE);
                 for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
                         atomic_criteria = tmp->data;
 
                         if (instance->priv->support_empty_tags
                             && !g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                                mpd_search_add_tag_constraint (instance->priv->connection,
+                                mpd_search_add_tag_constraint (connection,
                                                                MPD_OPERATOR_DEFAULT,
                                                                ario_mpd_filter_tag (atomic_criteria->tag),
                                                                "");
                         else
-                                mpd_search_add_tag_constraint (instance->priv->connection,
+                                mpd_search_add_tag_constraint (connection,
                                                                MPD_OPERATOR_DEFAULT,
                                                                ario_mpd_filter_tag (atomic_criteria->tag),
                                                                atomic_criteria->value);
                 }
-                mpd_search_commit (instance->priv->connection);
+                mpd_search_commit (connection);
         }
 
-        while ((song = mpd_recv_song (instance->priv->connection))) {
+        while (!listed && (song = mpd_recv_song (connection))) {
                 const char *artist;
                 const char *album;
                 const char *file;
@@ -817,12 +1566,15 @@ ario_mpd_get_albums (const ArioServerCriteria *criteria)
 
                 mpd_song_free (song);
         }
-        mpd_response_finish (instance->priv->connection);
-
-        ario_mpd_command_postinvoke ();
+        if (!listed)
+                mpd_response_finish (connection);
+        ario_mpd_query_end (connection);
 
-        for (values = g_hash_table_get_values (albums); values; values = g_list_next (values))
-                result = g_slist_append (result, values->data);
+        /* Albums order is not significant: prepend them */
+        values = g_hash_table_get_values (albums);
+        for (tmp_values = values; tmp_values; tmp_values = g_list_next (tmp_values))
+                result = g_slist_prepend (result, tmp_values->data);
+        g_list_free (values);
 
         /*
          * we don't need to free neither the keys nor the values since
@@ -841,16 +1593,16 @@ ario_mpd_build_ario_song (const struct mpd_song *song)
 
         ario_song = (ArioServerSong *) g_malloc0 (sizeof (ArioServerSong));
         ario_song->file = g_strdup (mpd_song_get_uri (song));
-        ario_song->artist = g_strdup (mpd_song_get_tag (song, MPD_TAG_ARTIST, 0));
+        ario_song->artist = (char *) ario_server_intern (mpd_song_get_tag (song, MPD_TAG_ARTIST, 0));
         ario_song->title = g_strdup (mpd_song_get_tag (song, MPD_TAG_TITLE, 0));
-        ario_song->album = g_strdup (mpd_song_get_tag (song, MPD_TAG_ALBUM, 0));
-        ario_song->album_artist  = g_strdup (mpd_song_get_tag (song, MPD_TAG_ALBUM_ARTIST, 0));
+        ario_song->album = (char *) ario_server_intern (mpd_song_get_tag (song, MPD_TAG_ALBUM, 0));
+        ario_song->album_artist  = (char *) ario_server_intern (mpd_song_get_tag (song, MPD_TAG_ALBUM_ARTIST, 0));
         ario_song->track = g_strdup (mpd_song_get_tag (song, MPD_TAG_TRACK, 0));
         ario_song->name = g_strdup (mpd_song_get_tag (song, MPD_TAG_NAME, 0));
-        ario_song->date = g_strdup (mpd_song_get_tag (song, MPD_TAG_DATE, 0));
-        ario_song->genre = g_strdup (mpd_song_get_tag (song, MPD_TAG_GENRE, 0));
-        ario_song->composer = g_strdup (mpd_song_get_tag (song, MPD_TAG_COMPOSER, 0));
-        ario_song->performer = g_strdup (mpd_song_get_tag (song, MPD_TAG_PERFORMER, 0));
+        ario_song->date = (char *) ario_server_intern (mpd_song_get_tag (song, MPD_TAG_DATE, 0));
+        ario_song->genre = (char *) ario_server_intern (mpd_song_get_tag (song, MPD_TAG_GENRE, 0));
+        ario_song->composer = (char *) ario_server_intern (mpd_song_get_tag (song, MPD_TAG_COMPOSER, 0));
+        ario_song->performer = (char *) ario_server_intern (mpd_song_get_tag (song, MPD_TAG_PERFORMER, 0));
         ario_song->disc = g_strdup (mpd_song_get_tag (song, MPD_TAG_DISC, 0));
         ario_song->comment = g_strdup (mpd_song_get_tag (song, MPD_TAG_COMMENT, 0));
         ario_song->time = mpd_song_get_duration (song);
@@ -892,69 +1644,99 @@ ario_mpd_build_ario_output (struct mpd_output *output)
         return ario_output;
 }
 
-static GSList *
-ario_mpd_get_songs (const ArioServerCriteria *criteria,
-                    const gboolean exact)
+static gboolean
+ario_mpd_criteria_has_unknown_album (const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *songs = NULL;
-        struct mpd_song *song;
         const GSList *tmp;
-        gboolean is_album_unknown = FALSE;
         ArioServerAtomicCriteria *atomic_criteria;
 
-        if (ario_mpd_command_preinvoke ())
-                return NULL;
-
         for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
                 atomic_criteria = tmp->data;
                 if (atomic_criteria->tag == ARIO_TAG_ALBUM
                     && !g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        is_album_unknown = TRUE;
+                        return TRUE;
         }
 
-        mpd_search_db_songs (instance->priv->connection, exact);
+        return FALSE;
+}
+
+static void
+ario_mpd_search_add_constraints (struct mpd_connection *connection,
+                                 const ArioServerCriteria *criteria)
+{
+        ARIO_LOG_FUNCTION_START;
+        const GSList *tmp;
+        ArioServerAtomicCriteria *atomic_criteria;
+
         for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
                 atomic_criteria = tmp->data;
                 if (atomic_criteria->tag == ARIO_TAG_ANY)
-                        mpd_search_add_any_tag_constraint (instance->priv->connection,
+                        mpd_search_add_any_tag_constraint (connection,
                                                            MPD_OPERATOR_DEFAULT,
                                                            atomic_criteria->value);
                 else if (instance->priv->support_empty_tags
                          && !g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        mpd_search_add_tag_constraint (instance->priv->connection,
+                        mpd_search_add_tag_constraint (connection,
                                                        MPD_OPERATOR_DEFAULT,
                                                        ario_mpd_filter_tag (atomic_criteria->tag),
                                                        "");
                 else if (atomic_criteria->tag != ARIO_TAG_ALBUM
                          || g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
-                        mpd_search_add_tag_constraint (instance->priv->connection,
+                        mpd_search_add_tag_constraint (connection,
                                                        MPD_OPERATOR_DEFAULT,
                                                        ario_mpd_filter_tag (atomic_criteria->tag),
                                                        atomic_criteria->value);
         }
-        mpd_search_commit (instance->priv->connection);
+}
 
-        while ((song = mpd_recv_song (instance->priv->connection))) {
+static void
+ario_mpd_send_search (struct mpd_connection *connection,
+                      const ArioServerCriteria *criteria,
+                      const gboolean exact)
+{
+        ARIO_LOG_FUNCTION_START;
+        mpd_search_db_songs (connection, exact);
+        ario_mpd_search_add_constraints (connection, criteria);
+        mpd_search_commit (connection);
+}
+
+static GSList *
+ario_mpd_get_songs (const ArioServerCriteria *criteria,
+                    const gboolean exact)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerListBuilder songs_builder = { NULL, NULL };
+        struct mpd_song *song;
+        gboolean is_album_unknown;
+        struct mpd_connection *connection;
+
+        connection = ario_mpd_query_begin ();
+        if (!connection)
+                return NULL;
+
+        is_album_unknown = ario_mpd_criteria_has_unknown_album (criteria);
+        ario_mpd_send_search (connection, criteria, exact);
+
+        while ((song = mpd_recv_song (connection))) {
                 if (instance->priv->support_empty_tags
                     || !is_album_unknown
                     || !mpd_song_get_tag (song, MPD_TAG_ALBUM, 0)) {
-                        songs = g_slist_append (songs, ario_mpd_build_ario_song (song));
+                        ario_server_list_builder_append (&songs_builder, ario_mpd_build_ario_song (song));
                 }
                 mpd_song_free (song);
         }
-        mpd_response_finish (instance->priv->connection);
+        mpd_response_finish (connection);
+        ario_mpd_query_end (connection);
 
-        ario_mpd_command_postinvoke ();
-
-        return songs;
+        return ario_server_list_builder_steal (&songs_builder);
 }
 
 static GSList *
 ario_mpd_get_songs_from_playlist (char *playlist)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *songs = NULL;
+        ArioServerListBuilder songs_builder = { NULL, NULL };
         struct mpd_song *song;
 
         if (ario_mpd_command_preinvoke ())
@@ -962,21 +1744,19 @@ ario_mpd_get_songs_from_playlist (char *playlist)
 
         mpd_send_list_playlist_meta (instance->priv->connection, playlist);
         while ((song = mpd_recv_song (instance->priv->connection))) {
-                songs = g_slist_append (songs, ario_mpd_build_ario_song (song));
+                ario_server_list_builder_append (&songs_builder, ario_mpd_build_ario_song (song));
                 mpd_song_free (song);
         }
         mpd_response_finish (instance->priv->connection);
 
-        ario_mpd_command_postinvoke ();
-
-        return songs;
+        return ario_server_list_builder_steal (&songs_builder);
 }
 
 static GSList *
 ario_mpd_get_playlists (void)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *playlists = NULL;
+        ArioServerListBuilder playlists_builder = { NULL, NULL };
         struct mpd_entity *ent;
 
         if (ario_mpd_command_preinvoke ())
@@ -987,22 +1767,20 @@ ario_mpd_get_playlists (void)
         while ((ent = mpd_recv_entity (instance->priv->connection))) {
                 if (mpd_entity_get_type (ent) == MPD_ENTITY_TYPE_PLAYLIST) {
                         const struct mpd_playlist * playlist = mpd_entity_get_playlist (ent);
-                        playlists = g_slist_append (playlists, g_strdup (mpd_playlist_get_path (playlist)));
+                        ario_server_list_builder_append (&playlists_builder, g_strdup (mpd_playlist_get_path (playlist)));
                 }
                 mpd_entity_free (ent);
         }
         mpd_response_finish (instance->priv->connection);
 
-        ario_mpd_command_postinvoke ();
-
-        return playlists;
+        return ario_server_list_builder_steal (&playlists_builder);
 }
 
 static GSList *
 ario_mpd_get_playlist_changes (gint64 playlist_id)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *songs = NULL;
+        ArioServerListBuilder songs_builder = { NULL, NULL };
         struct mpd_song *song;
 
         if (ario_mpd_command_preinvoke ())
@@ -1010,79 +1788,130 @@ ario_mpd_get_playlist_changes (gint64 playlist_id)
 
         mpd_send_queue_changes_meta (instance->priv->connection, (unsigned) playlist_id);
         while ((song = mpd_recv_song (instance->priv->connection))) {
-                songs = g_slist_append (songs, ario_mpd_build_ario_song (song));
+                ario_server_list_builder_append (&songs_builder, ario_mpd_build_ario_song (song));
                 mpd_song_free (song);
         }
         mpd_response_finish (instance->priv->connection);
 
-        ario_mpd_command_postinvoke ();
-
-        return songs;
+        return ario_server_list_builder_steal (&songs_builder);
 }
 
-static gboolean
-ario_mpd_update_status (void)
+static void
+ario_mpd_refresh_status (const enum mpd_idle events)
 {
         // desactivated to make the logs more readable
         //ARIO_LOG_FUNCTION_START;
-        if (instance->priv->is_updating)
-                return !instance->priv->support_idle;
+        struct mpd_status *status;
+        int volume;
+
+        if (instance->priv->is_updating) {
+                /* Handle the events once the current update is done */
+                if (instance->priv->support_idle && instance->priv->connection)
+                        ario_mpd_queue_events (events);
+                return;
+        }
         instance->priv->is_updating = TRUE;
 
         /* check if there is a connection */
         if (ario_mpd_command_preinvoke ()) {
                 ario_server_interface_set_default (ARIO_SERVER_INTERFACE (instance));
+        } else if (events == MPD_IDLE_MIXER
+                   && instance->priv->support_getvol) {
+                /* Only the volume has changed */
+#if LIBMPDCLIENT_CHECK_VERSION(2, 20, 0)
+                volume = mpd_run_get_volume (instance->priv->connection);
+#else
+                volume = -1;
+#endif
+                if (ario_mpd_check_errors ())
+                        ario_server_interface_set_default (ARIO_SERVER_INTERFACE (instance));
+                else if (instance->parent.volume != volume)
+                        g_object_set (G_OBJECT (instance), "volume", volume, NULL);
         } else {
                 if (instance->priv->status)
                         mpd_status_free (instance->priv->status);
 
                 instance->priv->status = mpd_run_status (instance->priv->connection);
-                ario_mpd_command_postinvoke ();
+                status = instance->priv->status;
 
                 if (ario_mpd_check_errors ()) {
                         ario_server_interface_set_default (ARIO_SERVER_INTERFACE (instance));
-                } else if (instance->priv->status) {
-                        if (instance->parent.song_id != mpd_status_get_song_id (instance->priv->status)
-                            || instance->parent.playlist_id != (gint64) mpd_status_get_queue_version (instance->priv->status))
-                                g_object_set (G_OBJECT (instance), "song_id", mpd_status_get_song_id (instance->priv->status), NULL);
+                } else if (status) {
+                        /* Only update the values related to the events */
+                        if (events & (MPD_IDLE_PLAYER | MPD_IDLE_QUEUE)) {
+                                if (instance->parent.song_id != mpd_status_get_song_id (status)
+                                    || instance->parent.playlist_id != (gint64) mpd_status_get_queue_version (status))
+                                        g_object_set (G_OBJECT (instance), "song_id", mpd_status_get_song_id (status), NULL);
+                        }
 
-                        if (instance->parent.state != mpd_status_get_state (instance->priv->status))
-                                g_object_set (G_OBJECT (instance), "state", mpd_status_get_state (instance->priv->status), NULL);
+                        if (events & MPD_IDLE_PLAYER) {
+                                if (instance->parent.state != mpd_status_get_state (status))
+                                        g_object_set (G_OBJECT (instance), "state", mpd_status_get_state (status), NULL);
 
-                        if (instance->parent.volume != mpd_status_get_volume (instance->priv->status))
-                                g_object_set (G_OBJECT (instance), "volume", mpd_status_get_volume (instance->priv->status), NULL);
+                                if (instance->parent.elapsed != mpd_status_get_elapsed_time (status)) {
+                                        g_object_set (G_OBJECT (instance), "elapsed", mpd_status_get_elapsed_time (status), NULL);
+                                        instance->priv->elapsed = mpd_status_get_elapsed_time (status);
+                                }
+                        }
 
-                        if (instance->parent.elapsed != mpd_status_get_elapsed_time (instance->priv->status)) {
-                                g_object_set (G_OBJECT (instance), "elapsed", mpd_status_get_elapsed_time (instance->priv->status), NULL);
-                                instance->priv->elapsed = mpd_status_get_elapsed_time (instance->priv->status);
+                        if (events & MPD_IDLE_MIXER) {
+                                if (instance->parent.volume != mpd_status_get_volume (status))
+                                        g_object_set (G_OBJECT (instance), "volume", mpd_status_get_volume (status), NULL);
                         }
 
-                        if (instance->parent.playlist_id != (gint64) mpd_status_get_queue_version (instance->priv->status)) {
-                                g_object_set (G_OBJECT (instance), "playlist_id", (gint64) mpd_status_get_queue_version (instance->priv->status), NULL);
-                                instance->parent.playlist_length = mpd_status_get_queue_length (instance->priv->status);
+                        if (events & MPD_IDLE_QUEUE) {
+                                if (instance->parent.playlist_id != (gint64) mpd_status_get_queue_version (status)) {
+                                        g_object_set (G_OBJECT (instance), "playlist_id", (gint64) mpd_status_get_queue_version (status), NULL);
+                                        instance->parent.playlist_length = mpd_status_get_queue_length (status);
+                                }
                         }
 
-                        if (instance->parent.consume != mpd_status_get_consume (instance->priv->status))
-                                g_object_set (G_OBJECT (instance), "consume", mpd_status_get_consume (instance->priv->status), NULL);
+                        if (events & MPD_IDLE_OPTIONS) {
+                                if (instance->parent.consume != mpd_status_get_consume (status))
+                                        g_object_set (G_OBJECT (instance), "consume", mpd_status_get_consume (status), NULL);
 
-                        if (instance->parent.random != mpd_status_get_random (instance->priv->status))
-                                g_object_set (G_OBJECT (instance), "random", mpd_status_get_random (instance->priv->status), NULL);
+                                if (instance->parent.random != mpd_status_get_random (status))
+                                        g_object_set (G_OBJECT (instance), "random", mpd_status_get_random (status), NULL);
 
-                        if (instance->parent.repeat != mpd_status_get_repeat (instance->priv->status))
-                                g_object_set (G_OBJECT (instance), "repeat", mpd_status_get_repeat (instance->priv->status), NULL);
+                                if (instance->parent.repeat != mpd_status_get_repeat (status))
+                                        g_object_set (G_OBJECT (instance), "repeat", mpd_status_get_repeat (status), NULL);
 
-                        if (instance->parent.updatingdb != mpd_status_get_update_id (instance->priv->status))
-                                g_object_set (G_OBJECT (instance), "updatingdb", mpd_status_get_update_id (instance->priv->status), NULL);
-                        instance->parent.crossfade = mpd_status_get_crossfade (instance->priv->status);
+                                instance->parent.crossfade = mpd_status_get_crossfade (status);
+                        }
+
+                        if (events & (MPD_IDLE_UPDATE | MPD_IDLE_DATABASE)) {
+                                if (instance->parent.updatingdb != mpd_status_get_update_id (status))
+                                        g_object_set (G_OBJECT (instance), "updatingdb", mpd_status_get_update_id (status), NULL);
+                        }
                 }
         }
         ario_server_interface_emit (ARIO_SERVER_INTERFACE (instance), server_instance);
 
         instance->priv->is_updating = FALSE;
+}
+
+static gboolean
+ario_mpd_update_status (void)
+{
+        // desactivated to make the logs more readable
+        //ARIO_LOG_FUNCTION_START;
+
+        /* Full update */
+        ario_mpd_refresh_status (STATUS_EVENTS);
 
         return !instance->priv->support_idle;
 }
 
+static void
+ario_mpd_volume_set_cb (gpointer result,
+                        gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* In idle mode, the idle connection reports the new volume */
+        if (!instance->priv->support_idle)
+                ario_mpd_refresh_status (MPD_IDLE_MIXER);
+}
+
 static ArioServerSong *
 ario_mpd_get_current_song_on_server (void)
 {
@@ -1101,8 +1930,6 @@ ario_mpd_get_current_song_on_server (void)
         }
         mpd_response_finish (instance->priv->connection);
 
-        ario_mpd_command_postinvoke ();
-
         return ario_song;
 }
 
@@ -1131,250 +1958,317 @@ ario_mpd_get_last_update (void)
                 return 0;
 }
 
+static gpointer
+ario_mpd_run_control (struct mpd_connection *connection,
+                      ArioMpdControl *control)
+{
+        ARIO_LOG_FUNCTION_START;
+        switch (control->command) {
+        case ARIO_MPD_NEXT:
+                mpd_run_next (connection);
+                break;
+        case ARIO_MPD_PREVIOUS:
+                mpd_run_previous (connection);
+                break;
+        case ARIO_MPD_PLAY:
+                mpd_run_play (connection);
+                break;
+        case ARIO_MPD_PLAY_POS:
+                mpd_run_play_pos (connection, control->value);
+                break;
+        case ARIO_MPD_PAUSE:
+                mpd_run_pause (connection, TRUE);
+                break;
+        case ARIO_MPD_STOP:
+                mpd_run_stop (connection);
+                break;
+        case ARIO_MPD_SEEK:
+                mpd_run_seek_id (connection, control->song_id, control->value);
+                break;
+        case ARIO_MPD_VOLUME:
+                mpd_run_set_volume (connection, control->value);
+                break;
+        case ARIO_MPD_CONSUME:
+                mpd_run_consume (connection, control->value);
+                break;
+        case ARIO_MPD_RANDOM:
+                mpd_run_random (connection, control->value);
+                break;
+        case ARIO_MPD_REPEAT:
+                mpd_run_repeat (connection, control->value);
+                break;
+        case ARIO_MPD_CROSSFADE:
+                mpd_run_crossfade (connection, control->value);
+                break;
+        case ARIO_MPD_CLEAR:
+                mpd_run_clear (connection);
+                break;
+        case ARIO_MPD_SHUFFLE:
+                mpd_run_shuffle (connection);
+                break;
+        }
+
+        return NULL;
+}
+
+static void
+ario_mpd_push_control (const ArioMpdCommand command,
+                       const int value,
+                       ArioServerWorkerCallback callback)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioMpdControl *control;
+
+        /* check if there is a connection */
+        if (!instance->priv->worker)
+                return;
+
+        control = (ArioMpdControl *) g_malloc0 (sizeof (ArioMpdControl));
+        control->command = command;
+        control->value = value;
+        control->song_id = instance->priv->status ? mpd_status_get_song_id (instance->priv->status) : -1;
+
+        /* The command is sent by the worker thread, its effects are
+         * noticed like any other change on the server */
+        ario_server_worker_push (instance->priv->worker,
+                                 (ArioServerWorkerFunc) ario_mpd_run_control,
+                                 control, g_free,
+                                 callback, NULL);
+}
+
 static void
 ario_mpd_do_next (void)
 {
         ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_next (instance->priv->connection);
-
-        ario_mpd_command_postinvoke ();
+        ario_mpd_push_control (ARIO_MPD_NEXT, 0, NULL);
 }
 
 static void
 ario_mpd_do_prev (void)
 {
         ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_previous (instance->priv->connection);
-
-        ario_mpd_command_postinvoke ();
+        ario_mpd_push_control (ARIO_MPD_PREVIOUS, 0, NULL);
 }
 
 static void
 ario_mpd_do_play (void)
 {
         ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_play (instance->priv->connection);
-
-        ario_mpd_command_postinvoke ();
+        ario_mpd_push_control (ARIO_MPD_PLAY, 0, NULL);
 }
 
 static void
 ario_mpd_do_play_pos (gint id)
 {
         ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        /* send mpd the play command */
-        mpd_run_play_pos (instance->priv->connection, id);
-
-        ario_mpd_command_postinvoke ();
+        ario_mpd_push_control (ARIO_MPD_PLAY_POS, id, NULL);
 }
 
 static void
 ario_mpd_do_pause (void)
 {
         ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_pause (instance->priv->connection, TRUE);
-
-        ario_mpd_command_postinvoke ();
+        ario_mpd_push_control (ARIO_MPD_PAUSE, 0, NULL);
 }
 
 static void
 ario_mpd_do_stop (void)
 {
         ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_stop (instance->priv->connection);
-
-        ario_mpd_command_postinvoke ();
+        ario_mpd_push_control (ARIO_MPD_STOP, 0, NULL);
 }
 
 static void
 ario_mpd_set_current_elapsed (const gint elapsed)
 {
         ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_seek_id (instance->priv->connection, mpd_status_get_song_id (instance->priv->status), elapsed);
-
-        ario_mpd_command_postinvoke ();
+        ario_mpd_push_control (ARIO_MPD_SEEK, elapsed, NULL);
 }
 
 static void
 ario_mpd_set_current_volume (const gint volume)
 {
         ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_set_volume (instance->priv->connection, volume);
-        ario_mpd_command_postinvoke ();
-
-        ario_mpd_update_status ();
+        ario_mpd_push_control (ARIO_MPD_VOLUME, volume,
+                               ario_mpd_volume_set_cb);
 }
 
 static void
 ario_mpd_set_current_consume (const gboolean consume)
 {
         ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_consume (instance->priv->connection, consume);
-
-        ario_mpd_command_postinvoke ();
+        ario_mpd_push_control (ARIO_MPD_CONSUME, consume, NULL);
 }
 
 static void
 ario_mpd_set_current_random (const gboolean random)
 {
         ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_random (instance->priv->connection, random);
-
-        ario_mpd_command_postinvoke ();
+        ario_mpd_push_control (ARIO_MPD_RANDOM, random, NULL);
 }
 
 static void
 ario_mpd_set_current_repeat (const gboolean repeat)
 {
         ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_repeat (instance->priv->connection, repeat);
-
-        ario_mpd_command_postinvoke ();
+        ario_mpd_push_control (ARIO_MPD_REPEAT, repeat, NULL);
 }
 
 static void
 ario_mpd_set_crossfadetime (const int crossfadetime)
 {
         ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_crossfade (instance->priv->connection, crossfadetime);
-
-        ario_mpd_command_postinvoke ();
-}
-
-static void
-ario_mpd_clear (void)
-{
-        ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_clear (instance->priv->connection);
-        ario_mpd_command_postinvoke ();
-
-        ario_mpd_update_status ();
-}
-
-static void
-ario_mpd_shuffle (void)
-{
-        ARIO_LOG_FUNCTION_START;
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_run_shuffle (instance->priv->connection);
-        ario_mpd_command_postinvoke ();
-
-        ario_mpd_update_status ();
+        ario_mpd_push_control (ARIO_MPD_CROSSFADE, crossfadetime, NULL);
 }
 
-static void
-ario_mpd_queue_commit (void)
+static gpointer
+ario_mpd_run_queue (struct mpd_connection *connection,
+                    GSList *queue)
 {
         ARIO_LOG_FUNCTION_START;
         GSList *temp;
         ArioServerQueueAction *queue_action;
 
-        if (ario_mpd_command_preinvoke ())
-                return;
-
-        mpd_command_list_begin (instance->priv->connection, FALSE);
+        mpd_command_list_begin (connection, FALSE);
 
-        for (temp = instance->parent.queue; temp; temp = g_slist_next (temp)) {
+        for (temp = queue; temp; temp = g_slist_next (temp)) {
                 queue_action = (ArioServerQueueAction *) temp->data;
                 if (queue_action->type == ARIO_SERVER_ACTION_ADD) {
                         if (queue_action->path) {
-                                mpd_send_add (instance->priv->connection, queue_action->path);
+                                mpd_send_add (connection, queue_action->path);
                         }
                 } else if (queue_action->type == ARIO_SERVER_ACTION_DELETE_ID) {
                         if (queue_action->id >= 0) {
-                                mpd_send_delete_id (instance->priv->connection, queue_action->id);
+                                mpd_send_delete_id (connection, queue_action->id);
                         }
                 } else if (queue_action->type == ARIO_SERVER_ACTION_DELETE_POS) {
                         if (queue_action->pos >= 0) {
-                                mpd_send_delete (instance->priv->connection, queue_action->pos);
+                                mpd_send_delete (connection, queue_action->pos);
                         }
                 } else if (queue_action->type == ARIO_SERVER_ACTION_MOVE) {
                         if (queue_action->id >= 0) {
-                                mpd_send_move (instance->priv->connection, queue_action->old_pos, queue_action->new_pos);
+                                mpd_send_move (connection, queue_action->old_pos, queue_action->new_pos);
                         }
                 } else if (queue_action->type == ARIO_SERVER_ACTION_MOVEID) {
                         if (queue_action->id >= 0) {
-                                mpd_send_move_id (instance->priv->connection, queue_action->old_pos, queue_action->new_pos);
+                                mpd_send_move_id (connection, queue_action->old_pos, queue_action->new_pos);
                         }
+#if LIBMPDCLIENT_CHECK_VERSION(2, 3, 0)
+                } else if (queue_action->type == ARIO_SERVER_ACTION_DELETE_RANGE) {
+                        mpd_send_delete_range (connection, queue_action->start, queue_action->end);
+                } else if (queue_action->type == ARIO_SERVER_ACTION_MOVE_RANGE) {
+                        mpd_send_move_range (connection, queue_action->start, queue_action->end, queue_action->to);
+#endif
+                } else if (queue_action->type == ARIO_SERVER_ACTION_ADD_AT) {
+                        mpd_send_add_id_to (connection, queue_action->uri, queue_action->at);
                 }
         }
-        mpd_command_list_end (instance->priv->connection);
-        mpd_response_finish (instance->priv->connection);
+        mpd_command_list_end (connection);
+        mpd_response_finish (connection);
 
-        g_slist_foreach (instance->parent.queue, (GFunc) g_free, NULL);
-        g_slist_free (instance->parent.queue);
-        instance->parent.queue = NULL;
+        return NULL;
+}
+
+static void
+ario_mpd_free_queue (GSList *queue)
+{
+        ARIO_LOG_FUNCTION_START;
+        ario_server_queue_free (queue);
+}
 
-        ario_mpd_command_postinvoke ();
+static void
+ario_mpd_queue_committed_cb (gpointer result,
+                             gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (instance->parent.committing > 0)
+                --instance->parent.committing;
 
+        /* Views reconcile their local changes on playlist_changed, even
+         * when a failed command list left the playlist unchanged */
+        instance->parent.signals_to_emit |= SERVER_PLAYLIST_CHANGED_FLAG;
         ario_mpd_update_status ();
 }
 
+static void
+ario_mpd_clear (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Sent by the worker after the playlist changes already queued */
+        if (!instance->priv->worker)
+                return;
+
+        ++instance->parent.committing;
+        ario_mpd_push_control (ARIO_MPD_CLEAR, 0, ario_mpd_queue_committed_cb);
+}
+
+static void
+ario_mpd_shuffle (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (!instance->priv->worker)
+                return;
+
+        ++instance->parent.committing;
+        ario_mpd_push_control (ARIO_MPD_SHUFFLE, 0, ario_mpd_queue_committed_cb);
+}
+
+static void
+ario_mpd_queue_commit (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *queue;
+
+        /* check if there is a connection */
+        if (!instance->priv->worker)
+                return;
+
+        queue = ario_server_list_builder_steal (&instance->parent.queue);
+#if LIBMPDCLIENT_CHECK_VERSION(2, 3, 0)
+        /* Send ranges instead of one command per song */
+        queue = ario_server_queue_optimize (queue, instance->parent.playlist_length);
+#endif
+
+        /* The commands are sent by the worker thread so that the
+         * interface does not wait for the server */
+        ++instance->parent.committing;
+        ario_server_worker_push (instance->priv->worker,
+                                 (ArioServerWorkerFunc) ario_mpd_run_queue,
+                                 queue, (GDestroyNotify) ario_mpd_free_queue,
+                                 ario_mpd_queue_committed_cb, NULL);
+}
+
 static void
 ario_mpd_insert_at (const GSList *songs,
                     const gint pos)
 {
         ARIO_LOG_FUNCTION_START;
         const GSList *tmp;
+        ArioServerListBuilder queue = { NULL, NULL };
+        ArioServerQueueAction *queue_action;
         guint offset = 0;
 
-        if (ario_mpd_command_preinvoke ())
+        /* check if there is a connection */
+        if (!instance->priv->worker)
                 return;
 
-        mpd_command_list_begin (instance->priv->connection, FALSE);
-
         /* For each filename :*/
         for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
                 /* Add it in the playlist*/
-                mpd_send_add_id_to (instance->priv->connection, tmp->data, pos + offset + 1);
+                queue_action = (ArioServerQueueAction *) g_malloc0 (sizeof (ArioServerQueueAction));
+                queue_action->type = ARIO_SERVER_ACTION_ADD_AT;
+                queue_action->uri = g_strdup (tmp->data);
+                queue_action->at = pos + offset + 1;
+                ario_server_list_builder_append (&queue, queue_action);
                 ++offset;
         }
 
-        mpd_command_list_end (instance->priv->connection);
-        mpd_response_finish (instance->priv->connection);
-
-        ario_mpd_command_postinvoke ();
+        /* Sent like the other playlist changes to keep their order */
+        ++instance->parent.committing;
+        ario_server_worker_push (instance->priv->worker,
+                                 (ArioServerWorkerFunc) ario_mpd_run_queue,
+                                 ario_server_list_builder_steal (&queue), (GDestroyNotify) ario_mpd_free_queue,
+                                 ario_mpd_queue_committed_cb, NULL);
 }
 
 static int
@@ -1393,8 +2287,6 @@ ario_mpd_save_playlist (const char *name)
                 mpd_connection_clear_error (instance->priv->connection);
         }
 
-        ario_mpd_command_postinvoke ();
-
         return ret;
 }
 
@@ -1406,15 +2298,13 @@ ario_mpd_delete_playlist (const char *name)
                 return;
 
         mpd_run_rm (instance->priv->connection, name);
-
-        ario_mpd_command_postinvoke ();
 }
 
 static GSList *
 ario_mpd_get_outputs (void)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *outputs = NULL;
+        ArioServerListBuilder outputs_builder = { NULL, NULL };
         struct mpd_output *output_ent;
 
         if (ario_mpd_command_preinvoke ())
@@ -1423,15 +2313,13 @@ ario_mpd_get_outputs (void)
         mpd_send_outputs (instance->priv->connection);
 
         while ((output_ent = mpd_recv_output (instance->priv->connection))) {
-                outputs = g_slist_append (outputs, ario_mpd_build_ario_output (output_ent));
+                ario_server_list_builder_append (&outputs_builder, ario_mpd_build_ario_output (output_ent));
                 mpd_output_free (output_ent);
         }
 
         mpd_response_finish (instance->priv->connection);
 
-        ario_mpd_command_postinvoke ();
-
-        return outputs;
+        return ario_server_list_builder_steal (&outputs_builder);
 }
 
 static void
@@ -1448,8 +2336,6 @@ ario_mpd_enable_output (int id,
         } else {
                 mpd_run_disable_output (instance->priv->connection, id);
         }
-
-        ario_mpd_command_postinvoke ();
 }
 
 static ArioServerStats *
@@ -1471,8 +2357,6 @@ ario_mpd_get_stats (void)
 
         ario_mpd_check_errors ();
 
-        ario_mpd_command_postinvoke ();
-
         return instance->priv->stats;
 }
 
@@ -1480,34 +2364,58 @@ static GList *
 ario_mpd_get_songs_info (GSList *paths)
 {
         ARIO_LOG_FUNCTION_START;
-        const gchar *path = NULL;
-        GSList *temp;
+        GSList *temp, *batch_start, *batch_end;
         GList *songs = NULL;
         struct mpd_song *song;
+        int batch_size, i;
+        unsigned location;
+        struct mpd_connection *connection;
 
-        if (ario_mpd_command_preinvoke ())
+        connection = ario_mpd_query_begin ();
+        if (!connection)
                 return NULL;
 
-        for (temp = paths; temp; temp = g_slist_next (temp)) {
-                path = temp->data;
-
-                mpd_send_list_all_meta (instance->priv->connection, path);
-
-                song = mpd_recv_song (instance->priv->connection);
-
-                mpd_response_finish (instance->priv->connection);
-                if (!song)
-                        continue;
+        batch_size = MAX (1, ario_conf_get_integer (PREF_SONGS_INFO_BATCH, PREF_SONGS_INFO_BATCH_DEFAULT));
+
+        temp = paths;
+        while (temp) {
+                batch_start = temp;
+
+                /* Send a whole batch of requests before reading any response */
+                mpd_command_list_begin (connection, TRUE);
+                for (batch_end = batch_start, i = 0;
+                     batch_end && i < batch_size;
+                     batch_end = g_slist_next (batch_end), ++i)
+                        mpd_send_list_all_meta (connection, batch_end->data);
+                mpd_command_list_end (connection);
+
+                /* Read the responses in the same order */
+                for (temp = batch_start; temp != batch_end; temp = g_slist_next (temp)) {
+                        song = mpd_recv_song (connection);
+                        if (song) {
+                                songs = g_list_prepend (songs, ario_mpd_build_ario_song (song));
+                                mpd_song_free (song);
+                        }
 
-                songs = g_list_append (songs, ario_mpd_build_ario_song (song));
-                mpd_song_free (song);
+                        if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS)
+                                break;
+                        mpd_response_next (connection);
+                }
 
-                ario_mpd_check_errors ();
+                if (mpd_connection_get_error (connection) == MPD_ERROR_SERVER) {
+                        /* An unknown path aborts the rest of the list: skip it and send the following ones again */
+                        location = mpd_connection_get_server_error_location (connection);
+                        mpd_connection_clear_error (connection);
+                        temp = g_slist_nth (batch_start, location + 1);
+                } else if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
+                        break;
+                } else {
+                        mpd_response_finish (connection);
+                }
         }
+        ario_mpd_query_end (connection);
 
-        ario_mpd_command_postinvoke ();
-
-        return songs;
+        return g_list_reverse (songs);
 }
 
 static ArioServerFileList *
@@ -1517,59 +2425,284 @@ ario_mpd_list_files (const char *path,
         ARIO_LOG_FUNCTION_START;
         struct mpd_entity *entity;
         ArioServerFileList *files = (ArioServerFileList *) g_malloc0 (sizeof (ArioServerFileList));
+        ArioServerListBuilder directories = { NULL, NULL };
+        ArioServerListBuilder songs = { NULL, NULL };
+        struct mpd_connection *connection;
 
-        if (ario_mpd_command_preinvoke ())
+        connection = ario_mpd_query_begin ();
+        if (!connection)
                 return files;
 
         if (recursive)
-                mpd_send_list_all_meta (instance->priv->connection, path);
+                mpd_send_list_all_meta (connection, path);
         else
-                mpd_send_list_meta (instance->priv->connection, path);
+                mpd_send_list_meta (connection, path);
 
-        while ((entity = mpd_recv_entity (instance->priv->connection))) {
+        while ((entity = mpd_recv_entity (connection))) {
                 enum mpd_entity_type type = mpd_entity_get_type (entity);
                 if (type == MPD_ENTITY_TYPE_DIRECTORY) {
                         const struct mpd_directory * directory = mpd_entity_get_directory (entity);
-                        files->directories = g_slist_append (files->directories, g_strdup (mpd_directory_get_path (directory)));
+                        ario_server_list_builder_append (&directories, g_strdup (mpd_directory_get_path (directory)));
                 } else if (type == MPD_ENTITY_TYPE_SONG) {
                         const struct mpd_song * song = mpd_entity_get_song (entity);
-                        files->songs = g_slist_append (files->songs, ario_mpd_build_ario_song (song));
+                        ario_server_list_builder_append (&songs, ario_mpd_build_ario_song (song));
                 }
 
                 mpd_entity_free(entity);
         }
-
-        ario_mpd_command_postinvoke ();
+        mpd_response_finish (connection);
+        ario_mpd_query_end (connection);
+        files->directories = ario_server_list_builder_steal (&directories);
+        files->songs = ario_server_list_builder_steal (&songs);
 
         return files;
 }
 
-static gboolean
-ario_mpd_command_preinvoke (void)
+static gpointer
+ario_mpd_stream_thread (ArioServerStream *stream)
 {
         ARIO_LOG_FUNCTION_START;
-        /* check if there is a connection */
-        if (!instance->priv->connection)
-                return TRUE;
+        struct mpd_connection *connection;
+        struct mpd_entity *entity;
+        struct mpd_song *song;
+        gboolean is_album_unknown;
 
-        if (instance->priv->support_idle) {
-                ario_mpd_idle_stop ();
+        /* Use a query connection so that the main one stays available */
+        connection = ario_mpd_query_connection_get ();
+        if (!connection) {
+                ario_server_stream_finish (stream);
+                return NULL;
+        }
 
-                if (!instance->priv->connection)
-                        return TRUE;
+        if (stream->path) {
+                if (stream->recursive)
+                        mpd_send_list_all_meta (connection, stream->path);
+                else
+                        mpd_send_list_meta (connection, stream->path);
+
+                while (!ario_server_stream_is_cancelled (stream)
+                       && (entity = mpd_recv_entity (connection))) {
+                        enum mpd_entity_type type = mpd_entity_get_type (entity);
+                        if (type == MPD_ENTITY_TYPE_DIRECTORY) {
+                                const struct mpd_directory * directory = mpd_entity_get_directory (entity);
+                                ario_server_stream_push_directory (stream, g_strdup (mpd_directory_get_path (directory)));
+                        } else if (type == MPD_ENTITY_TYPE_SONG) {
+                                ario_server_stream_push_song (stream, ario_mpd_build_ario_song (mpd_entity_get_song (entity)));
+                        }
+
+                        mpd_entity_free (entity);
+                }
+        } else {
+                is_album_unknown = ario_mpd_criteria_has_unknown_album (stream->criteria);
+                ario_mpd_send_search (connection, stream->criteria, stream->exact);
+
+                while (!ario_server_stream_is_cancelled (stream)
+                       && (song = mpd_recv_song (connection))) {
+                        if (instance->priv->support_empty_tags
+                            || !is_album_unknown
+                            || !mpd_song_get_tag (song, MPD_TAG_ALBUM, 0)) {
+                                ario_server_stream_push_song (stream, ario_mpd_build_ario_song (song));
+                        }
+                        mpd_song_free (song);
+                }
         }
 
-        return FALSE;
+        if (ario_server_stream_is_cancelled (stream)) {
+                /* Closing the connection drops the rest of a cancelled response */
+                mpd_connection_free (connection);
+        } else {
+                mpd_response_finish (connection);
+                ario_mpd_query_connection_release (connection);
+        }
+
+        ario_server_stream_finish (stream);
+
+        return NULL;
 }
 
 static void
-ario_mpd_command_postinvoke (void)
+ario_mpd_start_stream (ArioServerStream *stream)
 {
         ARIO_LOG_FUNCTION_START;
+        /* check if there is a connection */
+        if (!instance->priv->connection) {
+                ario_server_stream_finish (stream);
+                return;
+        }
 
-        if (instance->priv->support_idle && instance->priv->connection) {
-                ario_mpd_idle_start ();
+        g_thread_unref (g_thread_new ("stream",
+                                      (GThreadFunc) ario_mpd_stream_thread,
+                                      stream));
+}
+
+static void
+ario_mpd_enqueue_songs (struct mpd_connection *connection,
+                        ArioServerEnqueue *enqueue,
+                        const GSList *songs,
+                        const gboolean progress)
+{
+        ARIO_LOG_FUNCTION_START;
+        const GSList *tmp = songs, *chunk;
+        gsize size;
+        gint count, added = 0;
+        unsigned location;
+
+        while (tmp && !ario_server_enqueue_is_cancelled (enqueue)) {
+                chunk = tmp;
+                size = 0;
+                count = 0;
+
+                /* Fill a command list up to the size accepted by the server */
+                mpd_command_list_begin (connection, FALSE);
+                for (; tmp && size < ENQUEUE_CHUNK_SIZE; tmp = g_slist_next (tmp)) {
+                        if (enqueue->pos >= 0)
+                                mpd_send_add_id_to (connection, tmp->data,
+                                                    enqueue->pos + added + count + 1);
+                        else
+                                mpd_send_add (connection, tmp->data);
+                        size += strlen (tmp->data) + 8;
+                        ++count;
+                }
+                mpd_command_list_end (connection);
+
+                if (!mpd_response_finish (connection)) {
+                        ARIO_LOG_ERROR ("%s", mpd_connection_get_error_message (connection));
+                        if (mpd_connection_get_error (connection) != MPD_ERROR_SERVER) {
+                                mpd_connection_clear_error (connection);
+                                return;
+                        }
+
+                        /* A missing song aborts the rest of the list: only
+                         * the songs before it were added. Skip it and send
+                         * the following ones again */
+                        location = mpd_connection_get_server_error_location (connection);
+                        if (!mpd_connection_clear_error (connection))
+                                return;
+                        if ((gint) location < count) {
+                                count = location;
+                                tmp = g_slist_nth ((GSList *) chunk, location + 1);
+                        }
+                }
+
+                added += count;
+                if (progress)
+                        ario_server_enqueue_progress (enqueue, count);
+        }
+}
+
+static void
+ario_mpd_enqueue_criteria (struct mpd_connection *connection,
+                           ArioServerEnqueue *enqueue,
+                           const ArioServerCriteria *criteria)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerListBuilder filenames_builder = { NULL, NULL };
+        GSList *filenames;
+        struct mpd_song *song;
+        gboolean is_album_unknown;
+
+        is_album_unknown = ario_mpd_criteria_has_unknown_album (criteria);
+#if LIBMPDCLIENT_CHECK_VERSION(2, 1, 0)
+        /* Let the server add the songs itself (findadd) unless songs
+         * without album must be filtered here */
+        if (instance->priv->support_empty_tags || !is_album_unknown) {
+                mpd_search_add_db_songs (connection, TRUE);
+                ario_mpd_search_add_constraints (connection, criteria);
+                mpd_search_commit (connection);
+                mpd_response_finish (connection);
+                return;
+        }
+#endif
+        ario_mpd_send_search (connection, criteria, TRUE);
+        while ((song = mpd_recv_song (connection))) {
+                if (instance->priv->support_empty_tags
+                    || !is_album_unknown
+                    || !mpd_song_get_tag (song, MPD_TAG_ALBUM, 0)) {
+                        ario_server_list_builder_append (&filenames_builder, g_strdup (mpd_song_get_uri (song)));
+                }
+                mpd_song_free (song);
+        }
+        mpd_response_finish (connection);
+        filenames = ario_server_list_builder_steal (&filenames_builder);
+
+        ario_mpd_enqueue_songs (connection, enqueue, filenames, FALSE);
+
+        g_slist_foreach (filenames, (GFunc) g_free, NULL);
+        g_slist_free (filenames);
+}
+
+static gpointer
+ario_mpd_enqueue_thread (ArioServerEnqueue *enqueue)
+{
+        ARIO_LOG_FUNCTION_START;
+        struct mpd_connection *connection;
+        const GSList *tmp;
+
+        /* Use a query connection so that the main one stays available */
+        connection = ario_mpd_query_connection_get ();
+        if (!connection) {
+                ario_server_enqueue_finish (enqueue);
+                return NULL;
+        }
+
+        if (enqueue->dir) {
+                /* The server adds the whole directory itself */
+                mpd_run_add (connection, enqueue->dir);
+        } else if (enqueue->criterias) {
+                for (tmp = enqueue->criterias; tmp && !ario_server_enqueue_is_cancelled (enqueue); tmp = g_slist_next (tmp)) {
+                        ario_mpd_enqueue_criteria (connection, enqueue, tmp->data);
+                        ario_server_enqueue_progress (enqueue, 1);
+
+                        /* An error on one criteria must not stop the others */
+                        if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
+                                ARIO_LOG_ERROR ("%s", mpd_connection_get_error_message (connection));
+                                if (!mpd_connection_clear_error (connection))
+                                        break;
+                        }
+                }
+        } else {
+                ario_mpd_enqueue_songs (connection, enqueue, enqueue->songs, TRUE);
+        }
+
+        if (mpd_connection_get_error (connection) != MPD_ERROR_SUCCESS) {
+                ARIO_LOG_ERROR ("%s", mpd_connection_get_error_message (connection));
+                mpd_connection_clear_error (connection);
+        }
+        ario_mpd_query_connection_release (connection);
+
+        ario_server_enqueue_finish (enqueue);
+
+        return NULL;
+}
+
+static gboolean
+ario_mpd_enqueue (ArioServerEnqueue *enqueue)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* check if there is a connection */
+        if (!instance->priv->connection) {
+                ario_server_enqueue_finish (enqueue);
+                return TRUE;
         }
+
+        /* Commands are sent from a thread so that the interface is never
+         * blocked, however big the addition is */
+        g_thread_unref (g_thread_new ("enqueue",
+                                      (GThreadFunc) ario_mpd_enqueue_thread,
+                                      enqueue));
+
+        return TRUE;
+}
+
+static gboolean
+ario_mpd_command_preinvoke (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* check if there is a connection */
+        if (!instance->priv->connection)
+                return TRUE;
+
+        return FALSE;
 }
 
 static void
@@ -0,0 +1,650 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "servers/ario-server-cache.h"
+#include <string.h>
+#include <glib/gi18n.h>
+#include "ario-util.h"
+#include "ario-profiles.h"
+#include "ario-debug.h"
+
+#define CACHE_MAGIC "ARIOLIB1"
+#define CACHE_VERSION 1
+
+/* Tags stored for each song, indexed by ArioServerTag */
+#define CACHE_TAGS (ARIO_TAG_FILENAME + 1)
+
+/* Offset of missing tags in the strings table */
+#define CACHE_NO_TAG 0
+
+/* Offset of values not present in the strings table */
+#define CACHE_NOT_FOUND G_MAXUINT32
+
+/*
+ * The cache file is made of:
+ *  - a header
+ *  - a table of songs, each tag being an offset in the strings table
+ *  - the offsets of all strings, which are sorted
+ *  - the strings table, starting with an empty string for missing tags
+ *
+ * As strings are sorted, comparing two offsets is the same as comparing
+ * two strings and a value is found with a binary search on offsets.
+ */
+typedef struct
+{
+        gchar magic[8];
+        guint32 version;
+        guint32 n_songs;
+        guint32 n_strings;
+        guint32 strings_size;
+        /* Tags set for at least one song */
+        guint32 tags_present;
+        guint32 reserved;
+        guint64 db_update;
+} ArioServerCacheHeader;
+
+typedef struct
+{
+        guint32 tags[CACHE_TAGS];
+        gint32 time;
+} ArioServerCacheSong;
+
+typedef struct
+{
+        ArioServerTag tag;
+        guint32 offset;
+} ArioServerCacheConstraint;
+
+typedef struct
+{
+        /* Interned values, NULL if the tag is missing */
+        const gchar *tags[CACHE_TAGS];
+        gint32 time;
+} ArioServerCacheBuildSong;
+
+/* Mapped cache file */
+static GMappedFile *cache_file = NULL;
+static const ArioServerCacheHeader *cache_header;
+static const ArioServerCacheSong *cache_songs;
+static const guint32 *cache_index;
+static const gchar *cache_strings;
+
+/* Cache being rebuilt */
+static ArioServerStream *build_stream = NULL;
+static GHashTable *build_strings;
+static GArray *build_songs;
+static guint32 build_tags_present;
+static unsigned long build_db_update;
+static int build_n_songs;
+
+static gchar *
+ario_server_cache_get_path (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioProfile *profile;
+        gchar *key;
+        gchar *checksum;
+        gchar *filename;
+        gchar *path;
+
+        /* One cache per server */
+        profile = ario_profiles_get_current (ario_profiles_get ());
+        key = g_strdup_printf ("%s:%d", profile->host ? profile->host : "localhost", profile->port);
+        checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, key, -1);
+        filename = g_strdup_printf ("%s.idx", checksum);
+        path = g_build_filename (ario_util_config_dir (), "library", filename, NULL);
+
+        g_free (filename);
+        g_free (checksum);
+        g_free (key);
+
+        return path;
+}
+
+static gboolean
+ario_server_cache_load (unsigned long db_update)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar *path;
+        GMappedFile *file;
+        const gchar *data;
+        const ArioServerCacheHeader *header;
+        const ArioServerCacheSong *songs;
+        const guint32 *index;
+        gsize size;
+        gsize songs_size;
+        gsize index_size;
+        guint32 i;
+        int tag;
+
+        path = ario_server_cache_get_path ();
+        file = g_mapped_file_new (path, FALSE, NULL);
+        g_free (path);
+        if (!file)
+                return FALSE;
+
+        data = g_mapped_file_get_contents (file);
+        size = g_mapped_file_get_length (file);
+        header = (const ArioServerCacheHeader *) data;
+
+        /* Check that the cache is up to date */
+        if (size < sizeof (ArioServerCacheHeader)
+            || memcmp (header->magic, CACHE_MAGIC, sizeof (header->magic))
+            || header->version != CACHE_VERSION
+            || header->db_update != db_update)
+                goto error;
+
+        songs_size = (gsize) header->n_songs * sizeof (ArioServerCacheSong);
+        index_size = (gsize) header->n_strings * sizeof (guint32);
+        if (size != sizeof (ArioServerCacheHeader) + songs_size + index_size + header->strings_size
+            || !header->strings_size)
+                goto error;
+
+        songs = (const ArioServerCacheSong *) (data + sizeof (ArioServerCacheHeader));
+        index = (const guint32 *) (data + sizeof (ArioServerCacheHeader) + songs_size);
+        data += sizeof (ArioServerCacheHeader) + songs_size + index_size;
+        if (data[header->strings_size - 1] != '\0')
+                goto error;
+
+        /* Make sure a corrupted file never makes us read outside of it */
+        for (i = 0; i < header->n_songs; ++i) {
+                for (tag = 0; tag < CACHE_TAGS; ++tag) {
+                        if (songs[i].tags[tag] >= header->strings_size)
+                                goto error;
+                }
+        }
+        for (i = 0; i < header->n_strings; ++i) {
+                if (index[i] >= header->strings_size)
+                        goto error;
+        }
+
+        cache_file = file;
+        cache_header = header;
+        cache_songs = songs;
+        cache_index = index;
+        cache_strings = data;
+
+        return TRUE;
+
+error:
+        g_mapped_file_unref (file);
+        return FALSE;
+}
+
+static gint
+ario_server_cache_compare_strings (gconstpointer a,
+                                   gconstpointer b)
+{
+        return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+static gboolean
+ario_server_cache_save (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerCacheHeader header;
+        ArioServerCacheSong cache_song;
+        ArioServerCacheBuildSong *build_song;
+        GPtrArray *strings;
+        GHashTable *offsets;
+        GHashTableIter iter;
+        gpointer key;
+        GString *strings_table;
+        GArray *index;
+        GString *data;
+        guint32 offset;
+        guint i;
+        int tag;
+        gchar *dir;
+        gchar *path;
+        GError *error = NULL;
+        gboolean ret;
+
+        /* Sort strings so that offsets compare like strings */
+        strings = g_ptr_array_sized_new (g_hash_table_size (build_strings));
+        g_hash_table_iter_init (&iter, build_strings);
+        while (g_hash_table_iter_next (&iter, &key, NULL))
+                g_ptr_array_add (strings, key);
+        g_ptr_array_sort (strings, ario_server_cache_compare_strings);
+
+        offsets = g_hash_table_new (g_direct_hash, g_direct_equal);
+        index = g_array_sized_new (FALSE, FALSE, sizeof (guint32), strings->len);
+        strings_table = g_string_new (NULL);
+        g_string_append_c (strings_table, '\0');
+        for (i = 0; i < strings->len; ++i) {
+                const gchar *value = g_ptr_array_index (strings, i);
+                offset = strings_table->len;
+                g_hash_table_insert (offsets, (gpointer) value, GUINT_TO_POINTER (offset));
+                g_array_append_val (index, offset);
+                g_string_append_len (strings_table, value, strlen (value) + 1);
+        }
+
+        memset (&header, 0, sizeof (ArioServerCacheHeader));
+        memcpy (header.magic, CACHE_MAGIC, sizeof (header.magic));
+        header.version = CACHE_VERSION;
+        header.n_songs = build_songs->len;
+        header.n_strings = strings->len;
+        header.strings_size = strings_table->len;
+        header.tags_present = build_tags_present;
+        header.db_update = build_db_update;
+
+        data = g_string_sized_new (sizeof (ArioServerCacheHeader)
+                                   + build_songs->len * sizeof (ArioServerCacheSong)
+                                   + index->len * sizeof (guint32)
+                                   + strings_table->len);
+        g_string_append_len (data, (const gchar *) &header, sizeof (ArioServerCacheHeader));
+        for (i = 0; i < build_songs->len; ++i) {
+                build_song = &g_array_index (build_songs, ArioServerCacheBuildSong, i);
+                for (tag = 0; tag < CACHE_TAGS; ++tag) {
+                        if (build_song->tags[tag])
+                                cache_song.tags[tag] = GPOINTER_TO_UINT (g_hash_table_lookup (offsets, build_song->tags[tag]));
+                        else
+                                cache_song.tags[tag] = CACHE_NO_TAG;
+                }
+                cache_song.time = build_song->time;
+                g_string_append_len (data, (const gchar *) &cache_song, sizeof (ArioServerCacheSong));
+        }
+        g_string_append_len (data, index->data, index->len * sizeof (guint32));
+        g_string_append_len (data, strings_table->str, strings_table->len);
+
+        /* Create the cache directory if needed */
+        dir = g_build_filename (ario_util_config_dir (), "library", NULL);
+        if (!ario_file_test (dir, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_DIR))
+                ario_util_mkdir (dir);
+        g_free (dir);
+
+        path = ario_server_cache_get_path ();
+        ret = g_file_set_contents (path, data->str, data->len, &error);
+        if (!ret) {
+                ARIO_LOG_ERROR ("Unable to save library cache: %s", error->message);
+                g_error_free (error);
+        }
+        g_free (path);
+
+        g_string_free (data, TRUE);
+        g_string_free (strings_table, TRUE);
+        g_array_free (index, TRUE);
+        g_hash_table_destroy (offsets);
+        g_ptr_array_free (strings, TRUE);
+
+        return ret;
+}
+
+static void
+ario_server_cache_build_free (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (build_songs) {
+                g_array_free (build_songs, TRUE);
+                build_songs = NULL;
+        }
+
+        if (build_strings) {
+                g_hash_table_destroy (build_strings);
+                build_strings = NULL;
+        }
+}
+
+static const gchar *
+ario_server_cache_intern (const gchar *value)
+{
+        gchar *interned;
+
+        /* Empty tags are stored like missing ones */
+        if (!value || !*value)
+                return NULL;
+
+        interned = g_hash_table_lookup (build_strings, value);
+        if (!interned) {
+                interned = g_strdup (value);
+                g_hash_table_add (build_strings, interned);
+        }
+
+        return interned;
+}
+
+static void
+ario_server_cache_build_cb (ArioServerFileList *batch,
+                            gboolean finished,
+                            gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *tmp;
+        ArioServerSong *song;
+        ArioServerCacheBuildSong build_song;
+        int tag;
+
+        if (finished) {
+                build_stream = NULL;
+
+                /* An interrupted listing must not be taken for the whole database */
+                if (build_songs->len == (guint) build_n_songs
+                    && ario_server_cache_save ())
+                        ario_server_cache_load (build_db_update);
+
+                ario_server_cache_build_free ();
+                return;
+        }
+
+        for (tmp = batch->songs; tmp; tmp = g_slist_next (tmp)) {
+                song = tmp->data;
+                for (tag = 0; tag < CACHE_TAGS; ++tag) {
+                        build_song.tags[tag] = ario_server_cache_intern (ario_server_song_get_tag (song, tag));
+                        if (build_song.tags[tag])
+                                build_tags_present |= 1 << tag;
+                }
+                build_song.time = song->time;
+                g_array_append_val (build_songs, build_song);
+        }
+}
+
+void
+ario_server_cache_update (const ArioServerStats *stats)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Cache is already up to date or being rebuilt */
+        if (stats
+            && ((cache_file && cache_header->db_update == stats->dbUpdateTime)
+                || (build_stream && build_db_update == stats->dbUpdateTime)))
+                return;
+
+        ario_server_cache_close ();
+
+        /* Without update time, the cache could never be invalidated */
+        if (!stats || !stats->dbUpdateTime)
+                return;
+
+        if (ario_server_cache_load (stats->dbUpdateTime))
+                return;
+
+        /* Rebuild the cache from the whole database, without blocking
+         * the interface in the meantime */
+        build_db_update = stats->dbUpdateTime;
+        build_n_songs = stats->numberOfSongs;
+        build_tags_present = 1 << ARIO_TAG_FILENAME;
+        build_strings = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        build_songs = g_array_new (FALSE, FALSE, sizeof (ArioServerCacheBuildSong));
+        build_stream = ario_server_list_files_stream ("/", TRUE,
+                                                      ario_server_cache_build_cb,
+                                                      NULL);
+}
+
+void
+ario_server_cache_close (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (build_stream) {
+                ario_server_stream_cancel (build_stream);
+                build_stream = NULL;
+                ario_server_cache_build_free ();
+        }
+
+        if (cache_file) {
+                g_mapped_file_unref (cache_file);
+                cache_file = NULL;
+        }
+}
+
+static const gchar *
+ario_server_cache_string (guint32 offset)
+{
+        if (offset == CACHE_NO_TAG)
+                return NULL;
+
+        return cache_strings + offset;
+}
+
+static gboolean
+ario_server_cache_has_tag (const ArioServerTag tag)
+{
+        return tag < CACHE_TAGS
+                && (cache_header->tags_present & (1 << tag));
+}
+
+static guint32
+ario_server_cache_lookup (const gchar *value)
+{
+        guint32 low = 0;
+        guint32 high = cache_header->n_strings;
+        guint32 middle;
+        int cmp;
+
+        /* Binary search in sorted strings */
+        while (low < high) {
+                middle = low + (high - low) / 2;
+                cmp = strcmp (cache_strings + cache_index[middle], value);
+                if (!cmp)
+                        return cache_index[middle];
+                else if (cmp < 0)
+                        low = middle + 1;
+                else
+                        high = middle;
+        }
+
+        return CACHE_NOT_FOUND;
+}
+
+static GArray *
+ario_server_cache_get_constraints (const ArioServerCriteria *criteria)
+{
+        ARIO_LOG_FUNCTION_START;
+        const GSList *tmp;
+        ArioServerAtomicCriteria *atomic_criteria;
+        ArioServerCacheConstraint constraint;
+        GArray *constraints;
+
+        if (!cache_file)
+                return NULL;
+
+        /* Criteria values are converted once to offsets so that songs
+         * are matched with integer comparisons */
+        constraints = g_array_new (FALSE, FALSE, sizeof (ArioServerCacheConstraint));
+        for (tmp = criteria; tmp; tmp = g_slist_next (tmp)) {
+                atomic_criteria = tmp->data;
+
+                /* Tags never set may not be supported by the server: let it decide */
+                if (!ario_server_cache_has_tag (atomic_criteria->tag)) {
+                        g_array_free (constraints, TRUE);
+                        return NULL;
+                }
+
+                constraint.tag = atomic_criteria->tag;
+                if (!g_utf8_collate (atomic_criteria->value, ARIO_SERVER_UNKNOWN))
+                        constraint.offset = CACHE_NO_TAG;
+                else
+                        constraint.offset = ario_server_cache_lookup (atomic_criteria->value);
+                g_array_append_val (constraints, constraint);
+        }
+
+        return constraints;
+}
+
+static gboolean
+ario_server_cache_match (const ArioServerCacheSong *song,
+                         GArray *constraints)
+{
+        ArioServerCacheConstraint *constraint;
+        guint i;
+
+        for (i = 0; i < constraints->len; ++i) {
+                constraint = &g_array_index (constraints, ArioServerCacheConstraint, i);
+                if (song->tags[constraint->tag] != constraint->offset)
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+static gint
+ario_server_cache_compare_offsets (gconstpointer a,
+                                   gconstpointer b)
+{
+        guint32 offset_a = GPOINTER_TO_UINT (a);
+        guint32 offset_b = GPOINTER_TO_UINT (b);
+
+        return (offset_a > offset_b) - (offset_a < offset_b);
+}
+
+gboolean
+ario_server_cache_list_tags (const ArioServerTag tag,
+                             const ArioServerCriteria *criteria,
+                             GSList **values)
+{
+        ARIO_LOG_FUNCTION_START;
+        GArray *constraints;
+        GHashTable *found;
+        GList *offsets, *tmp;
+        ArioServerListBuilder values_builder = { NULL, NULL };
+        const gchar *value;
+        guint32 i;
+
+        constraints = ario_server_cache_get_constraints (criteria);
+        if (!constraints)
+                return FALSE;
+
+        if (!ario_server_cache_has_tag (tag)) {
+                g_array_free (constraints, TRUE);
+                return FALSE;
+        }
+
+        found = g_hash_table_new (g_direct_hash, g_direct_equal);
+        for (i = 0; i < cache_header->n_songs; ++i) {
+                if (ario_server_cache_match (&cache_songs[i], constraints))
+                        g_hash_table_add (found, GUINT_TO_POINTER (cache_songs[i].tags[tag]));
+        }
+
+        /* Values are sorted like the server does */
+        offsets = g_list_sort (g_hash_table_get_keys (found), ario_server_cache_compare_offsets);
+        for (tmp = offsets; tmp; tmp = g_list_next (tmp)) {
+                value = ario_server_cache_string (GPOINTER_TO_UINT (tmp->data));
+                ario_server_list_builder_append (&values_builder, g_strdup (value ? value : ARIO_SERVER_UNKNOWN));
+        }
+        g_list_free (offsets);
+        g_hash_table_destroy (found);
+        g_array_free (constraints, TRUE);
+
+        *values = ario_server_list_builder_steal (&values_builder);
+
+        return TRUE;
+}
+
+gboolean
+ario_server_cache_get_albums (const ArioServerCriteria *criteria,
+                              GSList **albums)
+{
+        ARIO_LOG_FUNCTION_START;
+        GArray *constraints;
+        GHashTable *found;
+        GList *values, *tmp;
+        GSList *result = NULL;
+        const ArioServerCacheSong *song;
+        const gchar *value;
+        ArioServerAlbum *server_album;
+        guint32 i;
+
+        constraints = ario_server_cache_get_constraints (criteria);
+        if (!constraints)
+                return FALSE;
+
+        found = g_hash_table_new (g_direct_hash, g_direct_equal);
+        for (i = 0; i < cache_header->n_songs; ++i) {
+                song = &cache_songs[i];
+                if (!ario_server_cache_match (song, constraints)
+                    || g_hash_table_contains (found, GUINT_TO_POINTER (song->tags[ARIO_TAG_ALBUM])))
+                        continue;
+
+                /* First song of each album gives its artist, path and date */
+                server_album = (ArioServerAlbum *) g_malloc (sizeof (ArioServerAlbum));
+                value = ario_server_cache_string (song->tags[ARIO_TAG_ALBUM]);
+                server_album->album = g_strdup (value ? value : ARIO_SERVER_UNKNOWN);
+                value = ario_server_cache_string (song->tags[ARIO_TAG_ARTIST]);
+                server_album->artist = g_strdup (value ? value : ARIO_SERVER_UNKNOWN);
+                value = ario_server_cache_string (song->tags[ARIO_TAG_FILENAME]);
+                server_album->path = value ? g_path_get_dirname (value) : NULL;
+                server_album->date = g_strdup (ario_server_cache_string (song->tags[ARIO_TAG_DATE]));
+
+                g_hash_table_insert (found, GUINT_TO_POINTER (song->tags[ARIO_TAG_ALBUM]), server_album);
+        }
+
+        /* Albums order is not significant: prepend them */
+        values = g_hash_table_get_values (found);
+        for (tmp = values; tmp; tmp = g_list_next (tmp))
+                result = g_slist_prepend (result, tmp->data);
+        g_list_free (values);
+        g_hash_table_destroy (found);
+        g_array_free (constraints, TRUE);
+
+        *albums = result;
+
+        return TRUE;
+}
+
+static ArioServerSong *
+ario_server_cache_build_song (const ArioServerCacheSong *cache_song)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerSong *song;
+
+        song = (ArioServerSong *) g_malloc0 (sizeof (ArioServerSong));
+        song->file = g_strdup (ario_server_cache_string (cache_song->tags[ARIO_TAG_FILENAME]));
+        song->artist = (char *) ario_server_intern (ario_server_cache_string (cache_song->tags[ARIO_TAG_ARTIST]));
+        song->title = g_strdup (ario_server_cache_string (cache_song->tags[ARIO_TAG_TITLE]));
+        song->album = (char *) ario_server_intern (ario_server_cache_string (cache_song->tags[ARIO_TAG_ALBUM]));
+        song->album_artist = (char *) ario_server_intern (ario_server_cache_string (cache_song->tags[ARIO_TAG_ALBUM_ARTIST]));
+        song->track = g_strdup (ario_server_cache_string (cache_song->tags[ARIO_TAG_TRACK]));
+        song->name = g_strdup (ario_server_cache_string (cache_song->tags[ARIO_TAG_NAME]));
+        song->date = (char *) ario_server_intern (ario_server_cache_string (cache_song->tags[ARIO_TAG_DATE]));
+        song->genre = (char *) ario_server_intern (ario_server_cache_string (cache_song->tags[ARIO_TAG_GENRE]));
+        song->composer = (char *) ario_server_intern (ario_server_cache_string (cache_song->tags[ARIO_TAG_COMPOSER]));
+        song->performer = (char *) ario_server_intern (ario_server_cache_string (cache_song->tags[ARIO_TAG_PERFORMER]));
+        song->disc = g_strdup (ario_server_cache_string (cache_song->tags[ARIO_TAG_DISC]));
+        song->comment = g_strdup (ario_server_cache_string (cache_song->tags[ARIO_TAG_COMMENT]));
+        song->time = cache_song->time;
+
+        return song;
+}
+
+gboolean
+ario_server_cache_get_songs (const ArioServerCriteria *criteria,
+                             const gboolean exact,
+                             GSList **songs)
+{
+        ARIO_LOG_FUNCTION_START;
+        GArray *constraints;
+        ArioServerListBuilder songs_builder = { NULL, NULL };
+        guint32 i;
+
+        /* Approximate searches are left to the server */
+        if (!exact)
+                return FALSE;
+
+        constraints = ario_server_cache_get_constraints (criteria);
+        if (!constraints)
+                return FALSE;
+
+        for (i = 0; i < cache_header->n_songs; ++i) {
+                if (ario_server_cache_match (&cache_songs[i], constraints))
+                        ario_server_list_builder_append (&songs_builder, ario_server_cache_build_song (&cache_songs[i]));
+        }
+        g_array_free (constraints, TRUE);
+
+        *songs = ario_server_list_builder_steal (&songs_builder);
+
+        return TRUE;
+}
@@ -0,0 +1,57 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ARIO_SERVER_CACHE_H
+#define __ARIO_SERVER_CACHE_H
+
+#include "servers/ario-server.h"
+
+G_BEGIN_DECLS
+
+/**
+ * The library cache is a local copy of the server database stored in
+ * the configuration directory. It is valid as long as the database
+ * update time of the server does not change and answers browsing
+ * queries without contacting the server.
+ */
+
+/* Load the cache of current profile if it matches the database update
+ * time of stats, or rebuild it in background otherwise. The cache is
+ * disabled if the server does not give its database update time. */
+void                    ario_server_cache_update                      (const ArioServerStats *stats);
+
+/* Stop using the cache until next update */
+void                    ario_server_cache_close                       (void);
+
+/* Each function returns FALSE if the query can not be answered by
+ * the cache: the server must be queried instead */
+gboolean                ario_server_cache_list_tags                   (const ArioServerTag tag,
+                                                                       const ArioServerCriteria *criteria,
+                                                                       GSList **values);
+
+gboolean                ario_server_cache_get_albums                  (const ArioServerCriteria *criteria,
+                                                                       GSList **albums);
+
+gboolean                ario_server_cache_get_songs                   (const ArioServerCriteria *criteria,
+                                                                       const gboolean exact,
+                                                                       GSList **songs);
+
+G_END_DECLS
+
+#endif /* __ARIO_SERVER_CACHE_H */
@@ -128,6 +128,36 @@ dummy_pointer_int (gint64 playlist_id)
         return NULL;
 }
 
+static void
+ario_server_interface_start_stream (ArioServerStream *stream)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerFileList *files;
+        GSList *songs;
+        GSList *tmp;
+
+        /* Default behavior: retrieve everything at once and deliver it in batches */
+        if (stream->path) {
+                files = ario_server_list_files (stream->path, stream->recursive);
+                if (files) {
+                        for (tmp = files->directories; tmp; tmp = g_slist_next (tmp))
+                                ario_server_stream_push_directory (stream, tmp->data);
+                        for (tmp = files->songs; tmp; tmp = g_slist_next (tmp))
+                                ario_server_stream_push_song (stream, tmp->data);
+                        g_slist_free (files->directories);
+                        g_slist_free (files->songs);
+                        g_free (files);
+                }
+        } else {
+                songs = ario_server_get_songs (stream->criteria, stream->exact);
+                for (tmp = songs; tmp; tmp = g_slist_next (tmp))
+                        ario_server_stream_push_song (stream, tmp->data);
+                g_slist_free (songs);
+        }
+
+        ario_server_stream_finish (stream);
+}
+
 static void
 ario_server_interface_class_init (ArioServerInterfaceClass *klass)
 {
@@ -177,6 +207,8 @@ ario_server_interface_class_init (ArioServerInterfaceClass *klass)
         klass->get_stats = (ArioServerStats* (*) (void)) dummy_pointer_void;
         klass->get_songs_info = (GList* (*) (GSList *)) dummy_pointer_pointer;
         klass->list_files = (ArioServerFileList* (*) (const char *, const int)) dummy_pointer_pointer_int;
+        klass->start_stream = ario_server_interface_start_stream;
+        klass->enqueue = (gboolean (*) (ArioServerEnqueue *)) dummy_int_pointer;
 
         /* Object properties */
         g_object_class_install_property (object_class,
@@ -52,10 +52,13 @@ typedef struct
         guint updatingdb;
         int crossfade;
 
-        GSList *queue;
+        ArioServerListBuilder queue;
 
         gboolean connecting;
 
+        /* Number of queue commits sent in the background and not done yet */
+        gint committing;
+
         int signals_to_emit;
 } ArioServerInterface;
 
@@ -129,6 +132,11 @@ typedef struct
 
         ArioServerFileList*    (*list_files)                          (const char *path,
                                                                        const gboolean recursive);
+
+        void                (*start_stream)                           (ArioServerStream *stream);
+
+        /* Returns FALSE if the backend cannot add songs in the background */
+        gboolean            (*enqueue)                                (ArioServerEnqueue *enqueue);
 } ArioServerInterfaceClass;
 
 GType                   ario_server_interface_get_type                (void) G_GNUC_CONST;
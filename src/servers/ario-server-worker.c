@@ -0,0 +1,178 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "servers/ario-server-worker.h"
+#include "ario-debug.h"
+
+/* Servers close connections left unused for too long (60 seconds by
+ * default for MPD) */
+#define KEEPALIVE_TIMEOUT 30
+
+typedef struct
+{
+        ArioServerWorkerFunc func;
+        gpointer data;
+        GDestroyNotify destroy;
+
+        ArioServerWorkerCallback callback;
+        gpointer callback_data;
+        gpointer result;
+} ArioServerWorkerRequest;
+
+struct ArioServerWorker
+{
+        GAsyncQueue *requests;
+
+        ArioServerWorkerConnectFunc connect;
+        ArioServerWorkerCheckFunc check;
+        ArioServerWorkerCloseFunc close;
+        ArioServerWorkerFunc keepalive;
+};
+
+static gboolean
+ario_server_worker_complete (ArioServerWorkerRequest *request)
+{
+        ARIO_LOG_FUNCTION_START;
+        request->callback (request->result, request->callback_data);
+        g_free (request);
+
+        return FALSE;
+}
+
+static gpointer
+ario_server_worker_thread (ArioServerWorker *worker)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerWorkerRequest *request;
+        gpointer connection;
+
+        connection = worker->connect ();
+
+        while (TRUE) {
+                request = g_async_queue_timeout_pop (worker->requests,
+                                                     KEEPALIVE_TIMEOUT * G_USEC_PER_SEC);
+
+                /* Nothing to do for a while */
+                if (!request) {
+                        if (connection && worker->keepalive) {
+                                worker->keepalive (connection, NULL);
+                                if (!worker->check (connection)) {
+                                        worker->close (connection);
+                                        connection = NULL;
+                                }
+                        }
+                        continue;
+                }
+
+                /* A request without function stops the worker */
+                if (!request->func) {
+                        g_free (request);
+                        break;
+                }
+
+                /* Connect again after an error */
+                if (!connection)
+                        connection = worker->connect ();
+
+                if (connection) {
+                        request->result = request->func (connection, request->data);
+                        if (!worker->check (connection)) {
+                                worker->close (connection);
+                                connection = NULL;
+                        }
+                }
+
+                if (request->destroy)
+                        request->destroy (request->data);
+
+                /* Idle sources of the same priority are dispatched in
+                 * the order they are added, so callbacks keep the order
+                 * of the requests */
+                if (request->callback)
+                        g_idle_add ((GSourceFunc) ario_server_worker_complete, request);
+                else
+                        g_free (request);
+        }
+
+        if (connection)
+                worker->close (connection);
+
+        /* Nobody else refers to the worker once it is stopped */
+        g_async_queue_unref (worker->requests);
+        g_free (worker);
+
+        return NULL;
+}
+
+ArioServerWorker *
+ario_server_worker_new (const gchar *name,
+                        ArioServerWorkerConnectFunc connect,
+                        ArioServerWorkerCheckFunc check,
+                        ArioServerWorkerCloseFunc close,
+                        ArioServerWorkerFunc keepalive)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerWorker *worker;
+
+        worker = (ArioServerWorker *) g_malloc0 (sizeof (ArioServerWorker));
+        worker->connect = connect;
+        worker->check = check;
+        worker->close = close;
+        worker->keepalive = keepalive;
+        worker->requests = g_async_queue_new ();
+
+        g_thread_unref (g_thread_new (name,
+                                      (GThreadFunc) ario_server_worker_thread,
+                                      worker));
+
+        return worker;
+}
+
+void
+ario_server_worker_free (ArioServerWorker *worker)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (!worker)
+                return;
+
+        /* The thread runs the pending requests, then stops and frees
+         * the worker: the main loop never waits for the server */
+        g_async_queue_push (worker->requests, g_malloc0 (sizeof (ArioServerWorkerRequest)));
+}
+
+void
+ario_server_worker_push (ArioServerWorker *worker,
+                         ArioServerWorkerFunc func,
+                         gpointer data,
+                         GDestroyNotify destroy,
+                         ArioServerWorkerCallback callback,
+                         gpointer callback_data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerWorkerRequest *request;
+
+        request = (ArioServerWorkerRequest *) g_malloc0 (sizeof (ArioServerWorkerRequest));
+        request->func = func;
+        request->data = data;
+        request->destroy = destroy;
+        request->callback = callback;
+        request->callback_data = callback_data;
+
+        g_async_queue_push (worker->requests, request);
+}
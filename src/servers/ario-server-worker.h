@@ -0,0 +1,73 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ARIO_SERVER_WORKER_H
+#define __ARIO_SERVER_WORKER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * ArioServerWorker runs server commands in a dedicated thread with
+ * its own connection. Commands are executed in the order they are
+ * pushed and their completion callbacks are called in the same order
+ * from the main loop.
+ */
+typedef struct ArioServerWorker ArioServerWorker;
+
+/* Called in the worker thread to open its connection (NULL on error) */
+typedef gpointer        (*ArioServerWorkerConnectFunc)                (void);
+
+/* Called in the worker thread after each command: returns FALSE if
+ * the connection is broken and must be opened again */
+typedef gboolean        (*ArioServerWorkerCheckFunc)                  (gpointer connection);
+
+/* Called in the worker thread to close its connection */
+typedef void            (*ArioServerWorkerCloseFunc)                  (gpointer connection);
+
+/* Called in the worker thread to run a command, or to keep the
+ * connection alive when no command has been run for a while. The result is given to
+ * the completion callback, so it must be NULL if there is none */
+typedef gpointer        (*ArioServerWorkerFunc)                       (gpointer connection,
+                                                                       gpointer data);
+
+/* Called in the main loop when a command has been run */
+typedef void            (*ArioServerWorkerCallback)                   (gpointer result,
+                                                                       gpointer data);
+
+ArioServerWorker *      ario_server_worker_new                        (const gchar *name,
+                                                                       ArioServerWorkerConnectFunc connect,
+                                                                       ArioServerWorkerCheckFunc check,
+                                                                       ArioServerWorkerCloseFunc close,
+                                                                       ArioServerWorkerFunc keepalive);
+
+/* Does not wait: the thread stops once the pending requests are run */
+void                    ario_server_worker_free                       (ArioServerWorker *worker);
+
+void                    ario_server_worker_push                       (ArioServerWorker *worker,
+                                                                       ArioServerWorkerFunc func,
+                                                                       gpointer data,
+                                                                       GDestroyNotify destroy,
+                                                                       ArioServerWorkerCallback callback,
+                                                                       gpointer callback_data);
+
+G_END_DECLS
+
+#endif /* __ARIO_SERVER_WORKER_H */
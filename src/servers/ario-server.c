@@ -27,6 +27,7 @@
 #include <glib/gi18n.h>
 #include "lib/ario-conf.h"
 #include "servers/ario-mpd.h"
+#include "servers/ario-server-cache.h"
 #include "ario-util.h"
 #ifdef ENABLE_XMMS2
 #include "servers/ario-xmms.h"
@@ -37,6 +38,10 @@
 
 #define NORMAL_TIMEOUT 500
 #define LAZY_TIMEOUT 12000
+/* Number of results delivered at once by a stream */
+#define STREAM_BATCH_SIZE 100
+/* Additions of more songs than that are sent in the background */
+#define ENQUEUE_MIN_SONGS 1000
 
 static guint ario_server_signals[SERVER_LAST_SIGNAL] = { 0 };
 
@@ -63,6 +68,15 @@ G_DEFINE_TYPE (ArioServer, ario_server, G_TYPE_OBJECT)
         static ArioServer *instance = NULL;
         static ArioServerInterface *interface = NULL;
 
+/* Background additions, the first one is being sent by the backend */
+static GQueue enqueues = G_QUEUE_INIT;
+
+/* Playlist to clear once a cancelled addition has sent its last chunk */
+static gboolean clear_pending = FALSE;
+
+/* Backends show no dialog without user interface, like in tests */
+static gboolean headless = FALSE;
+
 static void
 ario_server_class_init (ArioServerClass *klass)
 {
@@ -191,12 +205,49 @@ ario_server_class_init (ArioServerClass *klass)
                               g_cclosure_marshal_VOID__VOID,
                               G_TYPE_NONE,
                               0);
+
+        ario_server_signals[SERVER_ENQUEUE_CHANGED] =
+                g_signal_new ("enqueue_changed",
+                              G_OBJECT_CLASS_TYPE (object_class),
+                              G_SIGNAL_RUN_LAST,
+                              G_STRUCT_OFFSET (ArioServerClass, enqueue_changed),
+                              NULL, NULL,
+                              g_cclosure_marshal_VOID__VOID,
+                              G_TYPE_NONE,
+                              0);
+}
+
+void
+ario_server_cache_check (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Make sure the library cache matches the server database */
+        if (ario_server_is_connected ())
+                ario_server_cache_update (ario_server_get_stats ());
+        else
+                ario_server_cache_close ();
+}
+
+static void
+ario_server_updatingdb_changed_cb (ArioServer *server,
+                                   gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Database may have changed at the end of an update */
+        if (!ario_server_get_updating ())
+                ario_server_cache_check ();
 }
 
 static void
 ario_server_init (ArioServer *server)
 {
         ARIO_LOG_FUNCTION_START;
+        /* Connected first so that the cache is checked before other
+         * handlers query the database */
+        g_signal_connect (server,
+                          "updatingdb_changed",
+                          G_CALLBACK (ario_server_updatingdb_changed_cb),
+                          NULL);
 }
 
 static void
@@ -269,16 +320,47 @@ ario_server_connect (void)
 
         /* Call virtual method */
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->connect ();
-        g_signal_emit (G_OBJECT (instance), ario_server_signals[SERVER_CONNECTIVITY_CHANGED], 0);
+
+        /* Backends connecting in the background call
+         * ario_server_connect_finished themselves */
+        if (!interface->connecting)
+                ario_server_connect_finished ();
         return FALSE;
 }
 
+void
+ario_server_set_headless (const gboolean value)
+{
+        ARIO_LOG_FUNCTION_START;
+        headless = value;
+}
+
+gboolean
+ario_server_is_headless (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        return headless;
+}
+
+void
+ario_server_connect_finished (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        interface->connecting = FALSE;
+        ario_server_cache_check ();
+        g_signal_emit (G_OBJECT (instance), ario_server_signals[SERVER_CONNECTIVITY_CHANGED], 0);
+}
+
 void
 ario_server_disconnect (void)
 {
         ARIO_LOG_FUNCTION_START;
+        ario_server_enqueue_cancel ();
+        clear_pending = FALSE;
+
         /* Call virtual method */
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->disconnect ();
+        ario_server_cache_close ();
         g_signal_emit (G_OBJECT (instance), ario_server_signals[SERVER_CONNECTIVITY_CHANGED], 0);
 }
 
@@ -294,6 +376,7 @@ void
 ario_server_shutdown (void)
 {
         ARIO_LOG_FUNCTION_START;
+        ario_server_cache_close ();
         g_object_unref (interface);
 }
 
@@ -320,6 +403,12 @@ ario_server_list_tags (const ArioServerTag tag,
                        const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
+        GSList *values;
+
+        /* Answer from the library cache when possible */
+        if (ario_server_cache_list_tags (tag, criteria, &values))
+                return values;
+
         /* Call virtual method */
         return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->list_tags (tag, criteria);
 }
@@ -328,6 +417,12 @@ GSList *
 ario_server_get_albums (const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
+        GSList *albums;
+
+        /* Answer from the library cache when possible */
+        if (ario_server_cache_get_albums (criteria, &albums))
+                return albums;
+
         /* Call virtual method */
         return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_albums (criteria);
 }
@@ -337,6 +432,12 @@ ario_server_get_songs (const ArioServerCriteria *criteria,
                        const gboolean exact)
 {
         ARIO_LOG_FUNCTION_START;
+        GSList *songs;
+
+        /* Answer from the library cache when possible */
+        if (ario_server_cache_get_songs (criteria, exact, &songs))
+                return songs;
+
         /* Call virtual method */
         return ARIO_SERVER_INTERFACE_GET_CLASS (interface)->get_songs (criteria, exact);
 }
@@ -518,6 +619,13 @@ ario_server_get_updating (void)
         return ario_server_is_connected () && interface->updatingdb;
 }
 
+gboolean
+ario_server_is_committing (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        return interface->committing > 0;
+}
+
 unsigned long
 ario_server_get_last_update (void)
 {
@@ -662,6 +770,16 @@ void
 ario_server_clear (void)
 {
         ARIO_LOG_FUNCTION_START;
+        /* Songs still being added would end up in the cleared playlist */
+        ario_server_enqueue_cancel ();
+
+        /* The chunk being sent must not be added after the clear: the
+         * playlist is cleared once it is sent */
+        if (!g_queue_is_empty (&enqueues)) {
+                clear_pending = TRUE;
+                return;
+        }
+
         /* Call virtual method */
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->clear ();
 }
@@ -682,9 +800,10 @@ ario_server_queue_add (const char *path)
         /* Append a queue action to list */
         ArioServerQueueAction *queue_action = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
         queue_action->type = ARIO_SERVER_ACTION_ADD;
-        queue_action->path = path;
+        /* Queue may be committed after the caller frees path */
+        queue_action->path = g_strdup (path);
 
-        interface->queue = g_slist_append (interface->queue, queue_action);
+        ario_server_list_builder_append (&interface->queue, queue_action);
 }
 
 void
@@ -695,7 +814,7 @@ ario_server_queue_delete_id (const int id)
         queue_action->type = ARIO_SERVER_ACTION_DELETE_ID;
         queue_action->id = id;
 
-        interface->queue = g_slist_append (interface->queue, queue_action);
+        ario_server_list_builder_append (&interface->queue, queue_action);
 }
 
 void
@@ -707,7 +826,7 @@ ario_server_queue_delete_pos (const int pos)
         queue_action->type = ARIO_SERVER_ACTION_DELETE_POS;
         queue_action->pos = pos;
 
-        interface->queue = g_slist_append (interface->queue, queue_action);
+        ario_server_list_builder_append (&interface->queue, queue_action);
 }
 
 void
@@ -721,7 +840,7 @@ ario_server_queue_move (const int old_pos,
         queue_action->old_pos = old_pos;
         queue_action->new_pos = new_pos;
 
-        interface->queue = g_slist_append (interface->queue, queue_action);
+        ario_server_list_builder_append (&interface->queue, queue_action);
 }
 
 void
@@ -735,7 +854,7 @@ ario_server_queue_moveid (const int id,
         queue_action->old_pos = id;
         queue_action->new_pos = pos;
 
-        interface->queue = g_slist_append (interface->queue, queue_action);
+        ario_server_list_builder_append (&interface->queue, queue_action);
 }
 
 void
@@ -746,6 +865,238 @@ ario_server_queue_commit (void)
         ARIO_SERVER_INTERFACE_GET_CLASS (interface)->queue_commit ();
 }
 
+void
+ario_server_queue_free (GSList *queue)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *tmp;
+        ArioServerQueueAction *queue_action;
+
+        for (tmp = queue; tmp; tmp = g_slist_next (tmp)) {
+                queue_action = tmp->data;
+                if (queue_action->type == ARIO_SERVER_ACTION_ADD)
+                        g_free (queue_action->path);
+                else if (queue_action->type == ARIO_SERVER_ACTION_ADD_AT)
+                        g_free (queue_action->uri);
+                g_free (queue_action);
+        }
+        g_slist_free (queue);
+}
+
+/* Find the row at position pos once some rows are deleted. tree is a
+ * Fenwick tree (1-based) counting the rows left */
+static gint
+ario_server_queue_find_row (const gint *tree,
+                            const gint size,
+                            const gint pos)
+{
+        gint row = 0, step = 1, remaining = pos + 1;
+
+        while (step * 2 <= size)
+                step *= 2;
+
+        for (; step; step /= 2) {
+                if (row + step <= size && tree[row + step] < remaining) {
+                        row += step;
+                        remaining -= tree[row];
+                }
+        }
+
+        return row;
+}
+
+static void
+ario_server_queue_append_range (ArioServerListBuilder *builder,
+                                const ArioServerActionType type,
+                                const gint start,
+                                const gint end,
+                                const gint to)
+{
+        ArioServerQueueAction *queue_action = (ArioServerQueueAction *) g_malloc (sizeof (ArioServerQueueAction));
+
+        /* Ranges of one row are sent as single row actions */
+        if (type == ARIO_SERVER_ACTION_DELETE_RANGE && end - start == 1) {
+                queue_action->type = ARIO_SERVER_ACTION_DELETE_POS;
+                queue_action->pos = start;
+        } else if (type == ARIO_SERVER_ACTION_MOVE_RANGE && end - start == 1) {
+                queue_action->type = ARIO_SERVER_ACTION_MOVE;
+                queue_action->old_pos = start;
+                queue_action->new_pos = to;
+        } else {
+                queue_action->type = type;
+                queue_action->start = start;
+                queue_action->end = end;
+                queue_action->to = to;
+        }
+
+        ario_server_list_builder_append (builder, queue_action);
+}
+
+/* Replace a run of deletions by position by deletions of ranges of
+ * rows. Returns the first action after the run */
+static GSList *
+ario_server_queue_optimize_deletions (GSList *run,
+                                      ArioServerListBuilder *builder,
+                                      gint *length)
+{
+        ArioServerQueueAction *queue_action;
+        GSList *tmp;
+        gint *tree;
+        guint8 *deleted;
+        gint size = 0, count = 0, row, end, i;
+
+        /* Rows deleted by the run are all before size */
+        for (tmp = run; tmp; tmp = g_slist_next (tmp)) {
+                queue_action = tmp->data;
+                if (queue_action->type != ARIO_SERVER_ACTION_DELETE_POS)
+                        break;
+                if (queue_action->pos >= 0)
+                        size = MAX (size, queue_action->pos + count + 1);
+                ++count;
+        }
+
+        tree = g_new (gint, size + 1);
+        for (i = 1; i <= size; ++i)
+                tree[i] = i & -i;
+        deleted = g_new0 (guint8, size);
+
+        /* Find the row each action deletes */
+        for (tmp = run; count; tmp = g_slist_next (tmp), --count) {
+                queue_action = tmp->data;
+                if (queue_action->pos >= 0) {
+                        row = ario_server_queue_find_row (tree, size, queue_action->pos);
+                        deleted[row] = TRUE;
+                        for (i = row + 1; i <= size; i += i & -i)
+                                --tree[i];
+                        if (*length > 0)
+                                --*length;
+                }
+                g_free (queue_action);
+        }
+
+        /* Delete the ranges starting from the end so that the positions
+         * of the other ranges do not change */
+        for (end = size; end > 0; --end) {
+                if (!deleted[end - 1])
+                        continue;
+                for (row = end - 1; row > 0 && deleted[row - 1]; --row);
+                ario_server_queue_append_range (builder, ARIO_SERVER_ACTION_DELETE_RANGE, row, end, 0);
+                end = row + 1;
+        }
+
+        g_free (tree);
+        g_free (deleted);
+
+        return tmp;
+}
+
+/* Merge a run of moves of rows next to each other in moves of ranges.
+ * Returns the first action after the run */
+static GSList *
+ario_server_queue_optimize_moves (GSList *run,
+                                  ArioServerListBuilder *builder)
+{
+        ArioServerQueueAction *queue_action;
+        GSList *tmp;
+        gint start = -1, end = -1, to = -1, x, y;
+
+        /* The range [start, end) has been moved to to. Rows next to it
+         * moved next to it again are added to the range */
+        for (tmp = run; tmp; tmp = g_slist_next (tmp)) {
+                queue_action = tmp->data;
+                if (queue_action->type != ARIO_SERVER_ACTION_MOVE)
+                        break;
+                x = queue_action->old_pos;
+                y = queue_action->new_pos;
+                g_free (queue_action);
+
+                if (x < 0 || x == y)
+                        continue;
+
+                if (start >= 0 && to < start && x == end - 1 && y == to) {
+                        /* Row before a range moved up */
+                        --start;
+                } else if (start >= 0 && to < start && x == end && y == to + end - start) {
+                        /* Row after a range moved up */
+                        ++end;
+                } else if (start >= 0 && to > start && x == start - 1 && y == to - 1) {
+                        /* Row before a range moved down */
+                        --start;
+                        --to;
+                } else if (start >= 0 && to > start && x == start && y == to + end - start - 1) {
+                        /* Row after a range moved down */
+                        ++end;
+                        --to;
+                } else {
+                        if (start >= 0)
+                                ario_server_queue_append_range (builder, ARIO_SERVER_ACTION_MOVE_RANGE, start, end, to);
+                        start = x;
+                        end = x + 1;
+                        to = y;
+                }
+        }
+
+        if (start >= 0)
+                ario_server_queue_append_range (builder, ARIO_SERVER_ACTION_MOVE_RANGE, start, end, to);
+
+        return tmp;
+}
+
+GSList *
+ario_server_queue_optimize (GSList *queue,
+                            gint length)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerListBuilder builder = { NULL, NULL };
+        ArioServerQueueAction *queue_action, *next;
+        char *path;
+        GSList *tmp = queue;
+
+        while (tmp) {
+                queue_action = tmp->data;
+
+                switch (queue_action->type) {
+                case ARIO_SERVER_ACTION_DELETE_POS:
+                        tmp = ario_server_queue_optimize_deletions (tmp, &builder, &length);
+                        continue;
+                case ARIO_SERVER_ACTION_MOVE:
+                        tmp = ario_server_queue_optimize_moves (tmp, &builder);
+                        continue;
+                case ARIO_SERVER_ACTION_ADD:
+                        /* A song moved right after being added at the end
+                         * is directly added at its position. The action
+                         * keeps owning path as uri */
+                        path = queue_action->path;
+                        next = g_slist_next (tmp) ? g_slist_next (tmp)->data : NULL;
+                        if (path && length >= 0
+                            && next && next->type == ARIO_SERVER_ACTION_MOVE
+                            && next->old_pos == length
+                            && next->new_pos >= 0 && next->new_pos <= length) {
+                                queue_action->type = ARIO_SERVER_ACTION_ADD_AT;
+                                queue_action->uri = path;
+                                queue_action->at = next->new_pos;
+                                tmp = g_slist_next (tmp);
+                                g_free (next);
+                        }
+                        if (path && length >= 0)
+                                ++length;
+                        break;
+                case ARIO_SERVER_ACTION_DELETE_ID:
+                        if (queue_action->id >= 0 && length > 0)
+                                --length;
+                        break;
+                default:
+                        break;
+                }
+
+                ario_server_list_builder_append (&builder, queue_action);
+                tmp = g_slist_next (tmp);
+        }
+        g_slist_free (queue);
+
+        return ario_server_list_builder_steal (&builder);
+}
+
 void
 ario_server_insert_at (const GSList *songs,
                        const gint pos)
@@ -901,16 +1252,231 @@ ario_server_song_get_tag (const ArioServerSong *song,
         }
 }
 
+static ArioServerEnqueue *
+ario_server_enqueue_new (const gint pos,
+                         const PlaylistAction action)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerEnqueue *enqueue;
+
+        enqueue = (ArioServerEnqueue *) g_malloc0 (sizeof (ArioServerEnqueue));
+        enqueue->pos = pos;
+        enqueue->play = (action == PLAYLIST_ADD_PLAY || action == PLAYLIST_REPLACE);
+        g_mutex_init (&enqueue->mutex);
+
+        /* Reference of the queue of additions */
+        enqueue->ref_count = 1;
+
+        return enqueue;
+}
+
+static void
+ario_server_enqueue_unref (ArioServerEnqueue *enqueue)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (!g_atomic_int_dec_and_test (&enqueue->ref_count))
+                return;
+
+        g_slist_foreach (enqueue->songs, (GFunc) g_free, NULL);
+        g_slist_free (enqueue->songs);
+        g_free (enqueue->dir);
+        g_slist_foreach (enqueue->criterias, (GFunc) ario_server_criteria_free, NULL);
+        g_slist_free (enqueue->criterias);
+        g_mutex_clear (&enqueue->mutex);
+        g_free (enqueue);
+}
+
+static gboolean
+ario_server_enqueue_start (ArioServerEnqueue *enqueue)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Songs are added at the end of the playlist as it is when they are sent */
+        if (enqueue->pos >= 0)
+                enqueue->play_pos = enqueue->pos + 1;
+        else
+                enqueue->play_pos = ario_server_get_current_playlist_length ();
+
+        /* The backend keeps a reference until it calls ario_server_enqueue_finish */
+        enqueue->running = TRUE;
+        g_atomic_int_inc (&enqueue->ref_count);
+
+        /* Call virtual method */
+        if (ARIO_SERVER_INTERFACE_GET_CLASS (interface)->enqueue (enqueue))
+                return TRUE;
+
+        enqueue->running = FALSE;
+        ario_server_enqueue_unref (enqueue);
+
+        return FALSE;
+}
+
+static void
+ario_server_enqueue_start_next (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerEnqueue *enqueue;
+
+        while ((enqueue = g_queue_peek_head (&enqueues))) {
+                if (ario_server_enqueue_start (enqueue))
+                        break;
+                g_queue_pop_head (&enqueues);
+                ario_server_enqueue_unref (enqueue);
+        }
+
+        g_signal_emit (G_OBJECT (instance), ario_server_signals[SERVER_ENQUEUE_CHANGED], 0);
+}
+
+static gboolean
+ario_server_enqueue_push (ArioServerEnqueue *enqueue)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Wait for the previous additions so that songs keep their order */
+        if (!g_queue_is_empty (&enqueues)) {
+                g_queue_push_tail (&enqueues, enqueue);
+                return TRUE;
+        }
+
+        if (!ario_server_enqueue_start (enqueue)) {
+                ario_server_enqueue_unref (enqueue);
+                return FALSE;
+        }
+
+        g_queue_push_tail (&enqueues, enqueue);
+        g_signal_emit (G_OBJECT (instance), ario_server_signals[SERVER_ENQUEUE_CHANGED], 0);
+
+        return TRUE;
+}
+
+static gboolean
+ario_server_enqueue_progress_cb (ArioServerEnqueue *enqueue)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_atomic_int_set (&enqueue->scheduled, 0);
+
+        if (g_queue_peek_head (&enqueues) == enqueue)
+                g_signal_emit (G_OBJECT (instance), ario_server_signals[SERVER_ENQUEUE_CHANGED], 0);
+
+        ario_server_enqueue_unref (enqueue);
+
+        return FALSE;
+}
+
+static gboolean
+ario_server_enqueue_finish_cb (ArioServerEnqueue *enqueue)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Cancelled additions have already been removed from the queue,
+         * unless they were being sent */
+        if (g_queue_peek_head (&enqueues) == enqueue) {
+                g_queue_pop_head (&enqueues);
+
+                if (ario_server_enqueue_is_cancelled (enqueue)) {
+                        if (clear_pending) {
+                                clear_pending = FALSE;
+                                ARIO_SERVER_INTERFACE_GET_CLASS (interface)->clear ();
+                        }
+                        ario_server_update_status ();
+                } else {
+                        ario_server_update_status ();
+
+                        /* Start playing if needed */
+                        if (enqueue->play)
+                                ario_server_do_play_pos (enqueue->play_pos);
+                }
+
+                ario_server_enqueue_unref (enqueue);
+                ario_server_enqueue_start_next ();
+        }
+
+        /* Release the backend reference */
+        ario_server_enqueue_unref (enqueue);
+
+        return FALSE;
+}
+
+gboolean
+ario_server_get_enqueue_progress (gint *done,
+                                  gint *total)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerEnqueue *enqueue = g_queue_peek_head (&enqueues);
+
+        if (!enqueue || ario_server_enqueue_is_cancelled (enqueue))
+                return FALSE;
+
+        *done = g_atomic_int_get (&enqueue->done);
+        *total = enqueue->total;
+
+        return TRUE;
+}
+
+void
+ario_server_enqueue_cancel (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerEnqueue *enqueue, *head;
+        gboolean running;
+
+        head = g_queue_peek_head (&enqueues);
+        if (!head)
+                return;
+
+        g_mutex_lock (&head->mutex);
+        running = head->running;
+        g_mutex_unlock (&head->mutex);
+
+        while ((enqueue = g_queue_pop_head (&enqueues))) {
+                g_atomic_int_set (&enqueue->cancelled, 1);
+                if (enqueue != head || !running)
+                        ario_server_enqueue_unref (enqueue);
+        }
+
+        /* The backend stops after the chunk being sent. The addition
+         * stays first, so that the following commands are sent after
+         * it, until ario_server_enqueue_finish_cb removes it */
+        if (running)
+                g_queue_push_head (&enqueues, head);
+
+        g_signal_emit (G_OBJECT (instance), ario_server_signals[SERVER_ENQUEUE_CHANGED], 0);
+}
+
+gboolean
+ario_server_enqueue_is_cancelled (ArioServerEnqueue *enqueue)
+{
+        return g_atomic_int_get (&enqueue->cancelled);
+}
+
 void
-ario_server_playlist_add_songs (const GSList *songs,
-                                const gint pos,
-                                const PlaylistAction action)
+ario_server_enqueue_progress (ArioServerEnqueue *enqueue,
+                              const gint done)
 {
         ARIO_LOG_FUNCTION_START;
-        const GSList *tmp;
-        int end;
-        int song_pos = pos;
+        g_atomic_int_add (&enqueue->done, done);
 
+        /* Only one notification is pending at a time */
+        if (g_atomic_int_compare_and_exchange (&enqueue->scheduled, 0, 1)) {
+                g_atomic_int_inc (&enqueue->ref_count);
+                g_idle_add ((GSourceFunc) ario_server_enqueue_progress_cb, enqueue);
+        }
+}
+
+void
+ario_server_enqueue_finish (ArioServerEnqueue *enqueue)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_mutex_lock (&enqueue->mutex);
+        enqueue->running = FALSE;
+        g_mutex_unlock (&enqueue->mutex);
+
+        /* The backend reference is released in the main loop */
+        g_idle_add ((GSourceFunc) ario_server_enqueue_finish_cb, enqueue);
+}
+
+static gint
+ario_server_playlist_prepare (const gint pos,
+                              const PlaylistAction action)
+{
+        ARIO_LOG_FUNCTION_START;
         /* Clear playlist if needed */
         if (action == PLAYLIST_REPLACE)  {
                 ario_server_clear ();
@@ -920,7 +1486,36 @@ ario_server_playlist_add_songs (const GSList *songs,
         if (action == PLAYLIST_ADD_AFTER_PLAYING
             && (interface->state == ARIO_STATE_PLAY
                 || interface->state == ARIO_STATE_PAUSE))  {
-                song_pos = ario_server_get_current_song()->pos;
+                return ario_server_get_current_song()->pos;
+        }
+
+        return pos;
+}
+
+static void
+ario_server_playlist_insert_songs (const GSList *songs,
+                                   const gint song_pos,
+                                   const PlaylistAction action)
+{
+        ARIO_LOG_FUNCTION_START;
+        const GSList *tmp;
+        ArioServerListBuilder enqueue_builder = { NULL, NULL };
+        ArioServerEnqueue *enqueue;
+        int end;
+
+        /* Send big additions in the background, and any addition made
+         * while one is in progress so that songs keep their order */
+        if (!g_queue_is_empty (&enqueues)
+            || g_slist_length ((GSList *) songs) >= ENQUEUE_MIN_SONGS) {
+                enqueue = ario_server_enqueue_new (song_pos, action);
+                for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
+                        ario_server_list_builder_append (&enqueue_builder, g_strdup (tmp->data));
+                        ++enqueue->total;
+                }
+                enqueue->songs = ario_server_list_builder_steal (&enqueue_builder);
+
+                if (ario_server_enqueue_push (enqueue))
+                        return;
         }
 
         end = ario_server_get_current_playlist_length ();
@@ -944,6 +1539,18 @@ ario_server_playlist_add_songs (const GSList *songs,
         }
 }
 
+void
+ario_server_playlist_add_songs (const GSList *songs,
+                                const gint pos,
+                                const PlaylistAction action)
+{
+        ARIO_LOG_FUNCTION_START;
+        int song_pos;
+
+        song_pos = ario_server_playlist_prepare (pos, action);
+        ario_server_playlist_insert_songs (songs, song_pos, action);
+}
+
 void
 ario_server_playlist_add_dir (const gchar *dir,
                               const gint pos,
@@ -953,7 +1560,20 @@ ario_server_playlist_add_dir (const gchar *dir,
         GSList *tmp;
         ArioServerFileList *files;
         ArioServerSong *song;
-        GSList *char_songs = NULL;
+        ArioServerListBuilder char_songs_builder = { NULL, NULL };
+        GSList *char_songs;
+        ArioServerEnqueue *enqueue;
+        int song_pos;
+
+        song_pos = ario_server_playlist_prepare (pos, action);
+
+        /* Let the server add the whole directory when it is appended */
+        if (song_pos < 0) {
+                enqueue = ario_server_enqueue_new (song_pos, action);
+                enqueue->dir = g_strdup (dir);
+                if (ario_server_enqueue_push (enqueue))
+                        return;
+        }
 
         /* List files in dir */
         files = ario_server_list_files (dir, TRUE);
@@ -962,11 +1582,12 @@ ario_server_playlist_add_dir (const gchar *dir,
         for (tmp = files->songs; tmp; tmp = g_slist_next (tmp)) {
                 song = tmp->data;
                 /* Append file to list */
-                char_songs = g_slist_append (char_songs, song->file);
+                ario_server_list_builder_append (&char_songs_builder, song->file);
         }
+        char_songs = ario_server_list_builder_steal (&char_songs_builder);
 
         /* Append all files to playlist */
-        ario_server_playlist_add_songs (char_songs, pos, action);
+        ario_server_playlist_insert_songs (char_songs, song_pos, action);
         g_slist_free (char_songs);
         ario_server_free_file_list (files);
 }
@@ -979,9 +1600,29 @@ ario_server_playlist_add_criterias (const GSList *criterias,
 {
         ARIO_LOG_FUNCTION_START;
         GSList *filenames = NULL, *tmp_filenames = NULL, *songs = NULL;
+        ArioServerListBuilder filenames_builder = { NULL, NULL };
+        ArioServerListBuilder criterias_builder = { NULL, NULL };
         const GSList *tmp_criteria, *tmp_songs;
         const ArioServerCriteria *criteria;
         ArioServerSong *server_song;
+        ArioServerEnqueue *enqueue;
+        int song_pos;
+
+        song_pos = ario_server_playlist_prepare (pos, action);
+
+        /* Let the server search and add the songs when all of them are appended */
+        if (song_pos < 0 && nb_entries <= 0) {
+                enqueue = ario_server_enqueue_new (song_pos, action);
+                for (tmp_criteria = criterias; tmp_criteria; tmp_criteria = g_slist_next (tmp_criteria)) {
+                        ario_server_list_builder_append (&criterias_builder,
+                                                         ario_server_criteria_copy (tmp_criteria->data));
+                        ++enqueue->total;
+                }
+                enqueue->criterias = ario_server_list_builder_steal (&criterias_builder);
+
+                if (ario_server_enqueue_push (enqueue))
+                        return;
+        }
 
         /* For each criteria :*/
         for (tmp_criteria = criterias; tmp_criteria; tmp_criteria = g_slist_next (tmp_criteria)) {
@@ -992,13 +1633,14 @@ ario_server_playlist_add_criterias (const GSList *criterias,
                 for (tmp_songs = songs; tmp_songs; tmp_songs = g_slist_next (tmp_songs)) {
                         /* Append song filename to list */
                         server_song = tmp_songs->data;
-                        filenames = g_slist_append (filenames, server_song->file);
+                        ario_server_list_builder_append (&filenames_builder, server_song->file);
                         server_song->file = NULL;
                 }
 
                 g_slist_foreach (songs, (GFunc) ario_server_free_song, NULL);
                 g_slist_free (songs);
         }
+        filenames = ario_server_list_builder_steal (&filenames_builder);
 
         /* Need to only add a limited number of songs */
         if (nb_entries > 0 && filenames) {
@@ -1011,9 +1653,9 @@ ario_server_playlist_add_criterias (const GSList *criterias,
         }
 
         /* Add songs to playlist */
-        ario_server_playlist_add_songs (filenames,
-                                        pos,
-                                        action);
+        ario_server_playlist_insert_songs (filenames,
+                                           song_pos,
+                                           action);
 
         g_slist_foreach (filenames, (GFunc) g_free, NULL);
         g_slist_free (filenames);
@@ -1034,15 +1676,17 @@ ario_server_playlist_append_server_songs (const GSList *songs,
 {
         ARIO_LOG_FUNCTION_START;
         const GSList *tmp;
-        GSList *char_songs = NULL;
+        ArioServerListBuilder char_songs_builder = { NULL, NULL };
+        GSList *char_songs;
         ArioServerSong *song;
 
         /* For each song */
         for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
                 /* Append song filename to list */
                 song = tmp->data;
-                char_songs = g_slist_append (char_songs, song->file);
+                ario_server_list_builder_append (&char_songs_builder, song->file);
         }
+        char_songs = ario_server_list_builder_steal (&char_songs_builder);
 
         /* Add songs to playlist */
         ario_server_playlist_add_songs (char_songs, -1, action);
@@ -1057,7 +1701,8 @@ ario_server_playlist_append_artists (const GSList *artists,
         ARIO_LOG_FUNCTION_START;
         ArioServerAtomicCriteria *atomic_criteria;
         ArioServerCriteria *criteria;
-        GSList *criterias = NULL;
+        ArioServerListBuilder criterias_builder = { NULL, NULL };
+        GSList *criterias;
         const GSList *tmp;
 
         /* For each artist */
@@ -1069,8 +1714,9 @@ ario_server_playlist_append_artists (const GSList *artists,
                 atomic_criteria->value = g_strdup (tmp->data);
 
                 criteria = g_slist_append (criteria, atomic_criteria);
-                criterias = g_slist_append (criterias, criteria);
+                ario_server_list_builder_append (&criterias_builder, criteria);
         }
+        criterias = ario_server_list_builder_steal (&criterias_builder);
 
         /* Add songs matching criteria to playlist */
         ario_server_playlist_append_criterias (criterias, action, nb_entries);
@@ -1098,22 +1744,27 @@ ario_server_playlist_append_criterias (const GSList *criterias,
         ario_server_playlist_add_criterias (criterias, -1, action, nb_entries);
 }
 
+const gchar *
+ario_server_intern (const gchar *value)
+{
+        /* Interned strings are never freed: only tags shared by many
+         * songs should be interned */
+        if (!value)
+                return NULL;
+
+        return g_intern_string (value);
+}
+
 void
 ario_server_free_song (ArioServerSong *song)
 {
         ARIO_LOG_FUNCTION_START;
         if (song) {
+                /* Interned tags are not freed */
                 g_free (song->file);
-                g_free (song->artist);
                 g_free (song->title);
-                g_free (song->album);
-                g_free (song->album_artist);
                 g_free (song->track);
                 g_free (song->name);
-                g_free (song->date);
-                g_free (song->genre);
-                g_free (song->composer);
-                g_free (song->performer);
                 g_free (song->disc);
                 g_free (song->comment);
                 g_free (song);
@@ -1130,3 +1781,240 @@ ario_server_free_output (ArioServerOutput *output)
         }
 }
 
+void
+ario_server_list_builder_append (ArioServerListBuilder *builder,
+                                 gpointer data)
+{
+        GSList *link;
+
+        /* Link the new element after the tail instead of walking the list */
+        link = g_slist_alloc ();
+        link->data = data;
+
+        if (builder->tail)
+                builder->tail->next = link;
+        else
+                builder->head = link;
+        builder->tail = link;
+}
+
+GSList *
+ario_server_list_builder_steal (ArioServerListBuilder *builder)
+{
+        GSList *list = builder->head;
+
+        /* Give the list to the caller and reset the builder */
+        builder->head = NULL;
+        builder->tail = NULL;
+
+        return list;
+}
+
+
+static ArioServerStream *
+ario_server_stream_new (ArioServerStreamFunc func,
+                        gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerStream *stream;
+
+        stream = (ArioServerStream *) g_malloc0 (sizeof (ArioServerStream));
+        stream->func = func;
+        stream->data = data;
+        stream->batches = g_async_queue_new_full ((GDestroyNotify) ario_server_free_file_list);
+
+        /* One reference for the backend and one for the consumer */
+        stream->ref_count = 2;
+
+        return stream;
+}
+
+static void
+ario_server_stream_unref (ArioServerStream *stream)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *list;
+
+        if (!g_atomic_int_dec_and_test (&stream->ref_count))
+                return;
+
+        ario_server_criteria_free (stream->criteria);
+        g_free (stream->path);
+
+        list = ario_server_list_builder_steal (&stream->directories);
+        g_slist_foreach (list, (GFunc) g_free, NULL);
+        g_slist_free (list);
+
+        list = ario_server_list_builder_steal (&stream->songs);
+        g_slist_foreach (list, (GFunc) ario_server_free_song, NULL);
+        g_slist_free (list);
+
+        g_async_queue_unref (stream->batches);
+        g_free (stream);
+}
+
+static gboolean
+ario_server_stream_dispatch (ArioServerStream *stream)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerFileList *batch;
+        gboolean finished;
+
+        g_atomic_int_set (&stream->scheduled, 0);
+
+        /* Read the flag before draining so that the last batches are never missed */
+        finished = g_atomic_int_get (&stream->finished);
+
+        /* Deliver every pending batch */
+        while ((batch = g_async_queue_try_pop (stream->batches))) {
+                if (!stream->done)
+                        stream->func (batch, FALSE, stream->data);
+                ario_server_free_file_list (batch);
+        }
+
+        /* Notify the end of the stream and release the consumer reference */
+        if (finished && !stream->done) {
+                stream->done = TRUE;
+                stream->func (NULL, TRUE, stream->data);
+                ario_server_stream_unref (stream);
+        }
+
+        ario_server_stream_unref (stream);
+
+        return FALSE;
+}
+
+static void
+ario_server_stream_schedule (ArioServerStream *stream)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Only one dispatch is pending at a time */
+        if (g_atomic_int_compare_and_exchange (&stream->scheduled, 0, 1)) {
+                g_atomic_int_inc (&stream->ref_count);
+                g_idle_add ((GSourceFunc) ario_server_stream_dispatch, stream);
+        }
+}
+
+static void
+ario_server_stream_flush (ArioServerStream *stream)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerFileList *batch;
+
+        if (!stream->count)
+                return;
+
+        batch = (ArioServerFileList *) g_malloc0 (sizeof (ArioServerFileList));
+        batch->directories = ario_server_list_builder_steal (&stream->directories);
+        batch->songs = ario_server_list_builder_steal (&stream->songs);
+        stream->count = 0;
+
+        g_async_queue_push (stream->batches, batch);
+        ario_server_stream_schedule (stream);
+}
+
+static void
+ario_server_stream_added (ArioServerStream *stream)
+{
+        /* Hand over a batch as soon as it is full */
+        if (++stream->count >= STREAM_BATCH_SIZE)
+                ario_server_stream_flush (stream);
+}
+
+ArioServerStream *
+ario_server_get_songs_stream (const ArioServerCriteria *criteria,
+                              const gboolean exact,
+                              ArioServerStreamFunc func,
+                              gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerStream *stream;
+
+        stream = ario_server_stream_new (func, data);
+        stream->criteria = ario_server_criteria_copy (criteria);
+        stream->exact = exact;
+
+        /* Call virtual method */
+        ARIO_SERVER_INTERFACE_GET_CLASS (interface)->start_stream (stream);
+
+        return stream;
+}
+
+ArioServerStream *
+ario_server_list_files_stream (const char *path,
+                               const gboolean recursive,
+                               ArioServerStreamFunc func,
+                               gpointer data)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerStream *stream;
+
+        stream = ario_server_stream_new (func, data);
+        stream->path = g_strdup (path);
+        stream->recursive = recursive;
+
+        /* Call virtual method */
+        ARIO_SERVER_INTERFACE_GET_CLASS (interface)->start_stream (stream);
+
+        return stream;
+}
+
+void
+ario_server_stream_cancel (ArioServerStream *stream)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (!stream || stream->done)
+                return;
+
+        /* The callback is never called again and the backend stops reading
+         * the response as soon as it sees the flag */
+        g_atomic_int_set (&stream->cancelled, 1);
+        stream->done = TRUE;
+        ario_server_stream_unref (stream);
+}
+
+gboolean
+ario_server_stream_is_cancelled (ArioServerStream *stream)
+{
+        return g_atomic_int_get (&stream->cancelled);
+}
+
+void
+ario_server_stream_push_song (ArioServerStream *stream,
+                              ArioServerSong *song)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (ario_server_stream_is_cancelled (stream)) {
+                ario_server_free_song (song);
+                return;
+        }
+
+        ario_server_list_builder_append (&stream->songs, song);
+        ario_server_stream_added (stream);
+}
+
+void
+ario_server_stream_push_directory (ArioServerStream *stream,
+                                   gchar *path)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (ario_server_stream_is_cancelled (stream)) {
+                g_free (path);
+                return;
+        }
+
+        ario_server_list_builder_append (&stream->directories, path);
+        ario_server_stream_added (stream);
+}
+
+void
+ario_server_stream_finish (ArioServerStream *stream)
+{
+        ARIO_LOG_FUNCTION_START;
+        ario_server_stream_flush (stream);
+        g_atomic_int_set (&stream->finished, 1);
+        ario_server_stream_schedule (stream);
+
+        /* Release the backend reference */
+        ario_server_stream_unref (stream);
+}
@@ -34,6 +34,9 @@ G_BEGIN_DECLS
 #define IS_ARIO_SERVER_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), ARIO_TYPE_SERVER))
 #define ARIO_SERVER_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), ARIO_TYPE_SERVER, ArioServerClass))
 
+/* artist, album, album_artist, date, genre, composer and performer are
+ * interned with ario_server_intern: they are shared between songs, must
+ * not be freed and can be compared as pointers */
 typedef struct {
         /* filename of song */
         char * file;
@@ -124,6 +127,7 @@ typedef struct
 {
         gchar *artist;
         gchar *album;
+        /* directory of album, maybe NULL if the server did not give it */
         gchar *path;
         gchar *date;
 } ArioServerAlbum;
@@ -142,6 +146,79 @@ typedef struct
 
 typedef GSList ArioServerCriteria; /* A criteria is a list of atomic criterias */
 
+typedef struct
+{
+        /* Tail is tracked so that results are built in linear time */
+        GSList *head;
+        GSList *tail;
+} ArioServerListBuilder;
+
+typedef struct ArioServerStream ArioServerStream;
+
+/* Called from the main loop for each batch of results. The batch is freed
+ * when the callback returns. On the last call, batch is NULL and finished
+ * is TRUE: the stream must not be used after that. */
+typedef void (*ArioServerStreamFunc) (ArioServerFileList *batch,
+                                      gboolean finished,
+                                      gpointer data);
+
+struct ArioServerStream
+{
+        /* Songs matching criteria, or content of path when it is set */
+        ArioServerCriteria *criteria;
+        gboolean exact;
+        gchar *path;
+        gboolean recursive;
+
+        ArioServerStreamFunc func;
+        gpointer data;
+
+        /* Results not yet flushed by the backend */
+        ArioServerListBuilder directories;
+        ArioServerListBuilder songs;
+        guint count;
+
+        /* Flushed batches waiting to be delivered in the main loop */
+        GAsyncQueue *batches;
+
+        gint ref_count;
+        gint scheduled;
+        gint finished;
+        gint cancelled;
+        gboolean done;
+};
+
+typedef struct ArioServerEnqueue ArioServerEnqueue;
+
+/* Songs added to the playlist in the background. The backend sends them
+ * in chunks from its own thread, calls ario_server_enqueue_progress after
+ * each chunk and ario_server_enqueue_finish once it is done or cancelled. */
+struct ArioServerEnqueue
+{
+        /* Filenames, a directory or a list of criterias to add: only one
+         * of them is set */
+        GSList *songs;
+        gchar *dir;
+        GSList *criterias;
+
+        /* Songs are inserted after pos, or appended if pos is negative */
+        gint pos;
+        gboolean play;
+        gint play_pos;
+
+        /* Number of songs, or of criterias when criterias is set */
+        gint total;
+        gint done;
+
+        /* Set while the backend is sending commands */
+        gboolean running;
+        GMutex mutex;
+
+        gint ref_count;
+        gint scheduled;
+        gint cancelled;
+};
+
 typedef enum
 {
         ArioServerMpd,
@@ -154,19 +231,32 @@ typedef enum
         ARIO_SERVER_ACTION_DELETE_ID,
         ARIO_SERVER_ACTION_DELETE_POS,
         ARIO_SERVER_ACTION_MOVE,
-        ARIO_SERVER_ACTION_MOVEID
+        ARIO_SERVER_ACTION_MOVEID,
+        /* Only produced by ario_server_queue_optimize */
+        ARIO_SERVER_ACTION_DELETE_RANGE,
+        ARIO_SERVER_ACTION_MOVE_RANGE,
+        ARIO_SERVER_ACTION_ADD_AT
 }ArioServerActionType;
 
 typedef struct ArioServerQueueAction {
         ArioServerActionType type;
         union {
-                const char *path;       // For ARIO_SERVER_ACTION_ADD
+                char *path;             // For ARIO_SERVER_ACTION_ADD
                 int id;                 // For ARIO_SERVER_ACTION_DELETE_ID
                 int pos;                // For ARIO_SERVER_ACTION_DELETE_POS
                 struct {                // For ARIO_SERVER_ACTION_MOVE and ARIO_SERVER_ACTION_MOVEID
                         int old_pos;
                         int new_pos;
                 };
+                struct {                // For ARIO_SERVER_ACTION_DELETE_RANGE and ARIO_SERVER_ACTION_MOVE_RANGE
+                        int start;
+                        int end;
+                        int to;
+                };
+                struct {                // For ARIO_SERVER_ACTION_ADD_AT
+                        char *uri;
+                        int at;
+                };
         };
 } ArioServerQueueAction;
 
@@ -184,6 +274,7 @@ enum
         SERVER_REPEAT_CHANGED,
         SERVER_UPDATINGDB_CHANGED,
         SERVER_STOREDPLAYLISTS_CHANGED,
+        SERVER_ENQUEUE_CHANGED,
         SERVER_LAST_SIGNAL
 };
 
@@ -245,6 +336,8 @@ typedef struct
         void (*updatingdb_changed)      (ArioServer *server);
 
         void (*storedplaylists_changed) (ArioServer *server);
+
+        void (*enqueue_changed)         (ArioServer *server);
 } ArioServerClass;
 G_MODULE_EXPORT
 GType                   ario_server_get_type                               (void) G_GNUC_CONST;
@@ -253,6 +346,14 @@ ArioServer *            ario_server_get_instance                           (void
 G_MODULE_EXPORT
 gboolean                ario_server_connect                                (void);
 G_MODULE_EXPORT
+void                    ario_server_set_headless                           (const gboolean value);
+/* TRUE if backends must not show any dialog */
+gboolean                ario_server_is_headless                            (void);
+/* Called by backends connecting in the background once they are done */
+void                    ario_server_connect_finished                       (void);
+/* Called by backends when the server reports a database change */
+void                    ario_server_cache_check                            (void);
+G_MODULE_EXPORT
 void                    ario_server_disconnect                             (void);
 G_MODULE_EXPORT
 void                    ario_server_reconnect                              (void);
@@ -314,6 +415,9 @@ G_MODULE_EXPORT
 gboolean                ario_server_get_current_repeat                     (void);
 G_MODULE_EXPORT
 gboolean                ario_server_get_updating                           (void);
+/* TRUE while queue changes are being sent to the server */
+G_MODULE_EXPORT
+gboolean                ario_server_is_committing                          (void);
 G_MODULE_EXPORT
 unsigned long           ario_server_get_last_update                        (void);
 G_MODULE_EXPORT
@@ -366,6 +470,12 @@ void                    ario_server_queue_moveid                           (cons
                                                                             const int pos);
 G_MODULE_EXPORT
 void                    ario_server_queue_commit                           (void);
+/* Free queue actions and the paths they own */
+void                    ario_server_queue_free                             (GSList *queue);
+/* Rewrite queue actions, starting on a playlist of length songs (-1 if
+ * unknown), in fewer actions using ranges. queue is freed */
+GSList *                ario_server_queue_optimize                         (GSList *queue,
+                                                                            gint length);
 G_MODULE_EXPORT
 void                    ario_server_insert_at                              (const GSList *songs,
                                                                             const gint pos);
@@ -428,8 +538,49 @@ void                    ario_server_playlist_append_criterias              (cons
                                                                             const PlaylistAction action,
                                                                             const gint nb_entries);
 G_MODULE_EXPORT
+const gchar *           ario_server_intern                                 (const gchar *value);
+G_MODULE_EXPORT
 void                    ario_server_free_song                              (ArioServerSong *song);
 G_MODULE_EXPORT
+void                    ario_server_list_builder_append                    (ArioServerListBuilder *builder,
+                                                                            gpointer data);
+G_MODULE_EXPORT
+GSList *                ario_server_list_builder_steal                     (ArioServerListBuilder *builder);
+G_MODULE_EXPORT
+ArioServerStream *      ario_server_get_songs_stream                       (const ArioServerCriteria *criteria,
+                                                                            const gboolean exact,
+                                                                            ArioServerStreamFunc func,
+                                                                            gpointer data);
+G_MODULE_EXPORT
+ArioServerStream *      ario_server_list_files_stream                      (const char *path,
+                                                                            const gboolean recursive,
+                                                                            ArioServerStreamFunc func,
+                                                                            gpointer data);
+G_MODULE_EXPORT
+void                    ario_server_stream_cancel                          (ArioServerStream *stream);
+G_MODULE_EXPORT
+gboolean                ario_server_stream_is_cancelled                    (ArioServerStream *stream);
+G_MODULE_EXPORT
+void                    ario_server_stream_push_song                       (ArioServerStream *stream,
+                                                                            ArioServerSong *song);
+G_MODULE_EXPORT
+void                    ario_server_stream_push_directory                  (ArioServerStream *stream,
+                                                                            gchar *path);
+G_MODULE_EXPORT
+void                    ario_server_stream_finish                          (ArioServerStream *stream);
+G_MODULE_EXPORT
+gboolean                ario_server_get_enqueue_progress                   (gint *done,
+                                                                            gint *total);
+G_MODULE_EXPORT
+void                    ario_server_enqueue_cancel                         (void);
+G_MODULE_EXPORT
+gboolean                ario_server_enqueue_is_cancelled                   (ArioServerEnqueue *enqueue);
+G_MODULE_EXPORT
+void                    ario_server_enqueue_progress                       (ArioServerEnqueue *enqueue,
+                                                                            const gint done);
+G_MODULE_EXPORT
+void                    ario_server_enqueue_finish                         (ArioServerEnqueue *enqueue);
+G_MODULE_EXPORT
 void                    ario_server_free_output                            (ArioServerOutput *output);
 
 G_END_DECLS
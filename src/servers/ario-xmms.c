@@ -103,6 +103,20 @@ struct ArioXmmsPrivate
 
         GSList *results;
         xmmsc_result_t *res;
+
+        /* Mirror of the active playlist kept up to date with the
+         * playlist broadcasts: medialib id of each position and version
+         * of the last change of each position */
+        gboolean mirror_valid;
+        gboolean reloading;
+        gchar *active_playlist;
+        GArray *ids;
+        GArray *versions;
+        gint64 version;
+        guint playlist_idle_id;
+
+        /* Medialib id -> ArioServerSong of the songs of the playlist */
+        GHashTable *songs;
 };
 
 char * ArioXmmsPattern[ARIO_TAG_COUNT] =
@@ -186,6 +200,10 @@ ario_xmms_init (ArioXmms *xmms)
 {
         ARIO_LOG_FUNCTION_START;
         xmms->priv = ario_xmms_get_instance_private (xmms);
+        xmms->priv->ids = g_array_new (FALSE, FALSE, sizeof (guint));
+        xmms->priv->versions = g_array_new (FALSE, FALSE, sizeof (gint64));
+        xmms->priv->songs = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                   NULL, (GDestroyNotify) ario_server_free_song);
 }
 
 static void
@@ -203,6 +221,13 @@ ario_xmms_finalize (GObject *object)
         if (xmms->priv->connection)
                 xmmsc_unref (xmms->priv->connection);
 
+        if (xmms->priv->playlist_idle_id)
+                g_source_remove (xmms->priv->playlist_idle_id);
+        g_free (xmms->priv->active_playlist);
+        g_array_free (xmms->priv->ids, TRUE);
+        g_array_free (xmms->priv->versions, TRUE);
+        g_hash_table_destroy (xmms->priv->songs);
+
         instance = NULL;
         G_OBJECT_CLASS (ario_xmms_parent_class)->finalize (object);
 }
@@ -220,11 +245,11 @@ ario_xmms_get_song_from_res (xmmsc_result_t *result)
 
         song = (ArioServerSong *) g_malloc0 (sizeof (ArioServerSong));
         xmmsc_result_get_dict_entry_string (result, "genre", &tmp);
-        song->genre = g_strdup (tmp);
+        song->genre = (char *) ario_server_intern (tmp);
         xmmsc_result_get_dict_entry_string (result, "artist", &tmp);
-        song->artist = g_strdup (tmp);
+        song->artist = (char *) ario_server_intern (tmp);
         xmmsc_result_get_dict_entry_string (result, "album", &tmp);
-        song->album = g_strdup (tmp);
+        song->album = (char *) ario_server_intern (tmp);
         xmmsc_result_get_dict_entry_string (result, "title", &tmp);
         song->title = g_strdup (tmp);
         xmmsc_result_get_dict_entry_string (result, "url", &tmp);
@@ -288,18 +313,201 @@ ario_xmms_get_instance (ArioServer *server)
         return instance;
 }
 
+static void
+ario_xmms_playlist_touch (ArioXmms *xmms,
+                          const guint start,
+                          const guint end)
+{
+        guint i;
+
+        /* Positions from start to end have changed in the current version */
+        for (i = start; i < end && i < xmms->priv->versions->len; ++i)
+                g_array_index (xmms->priv->versions, gint64, i) = xmms->priv->version;
+}
+
+static gboolean playlist_not_idle (xmmsc_result_t *not_used);
+
+static void
+playlist_reload_active_cb (xmmsc_result_t *res,
+                           ArioXmms *xmms)
+{
+        ARIO_LOG_FUNCTION_START;
+        const gchar *name;
+
+        /* Broadcasts about other playlists are ignored */
+        g_free (xmms->priv->active_playlist);
+        xmms->priv->active_playlist = NULL;
+        if (!xmmsc_result_iserror (res) && xmmsc_result_get_string (res, &name))
+                xmms->priv->active_playlist = g_strdup (name);
+}
+
+static void
+playlist_reload_cb (xmmsc_result_t *res,
+                    ArioXmms *xmms)
+{
+        ARIO_LOG_FUNCTION_START;
+        guint id;
+
+        xmms->priv->reloading = FALSE;
+        if (xmmsc_result_iserror (res)) {
+                ARIO_LOG_ERROR ("Transaction error : %s\n", xmmsc_result_get_error (res));
+                return;
+        }
+
+        g_array_set_size (xmms->priv->ids, 0);
+        for (; xmmsc_result_list_valid (res); xmmsc_result_list_next (res)) {
+                if (!xmmsc_result_get_uint (res, &id)) {
+                        ARIO_LOG_ERROR ("Broken result");
+                        continue;
+                }
+                g_array_append_val (xmms->priv->ids, id);
+        }
+
+        /* Every position has changed */
+        ++xmms->priv->version;
+        g_array_set_size (xmms->priv->versions, xmms->priv->ids->len);
+        ario_xmms_playlist_touch (xmms, 0, xmms->priv->ids->len);
+        xmms->priv->mirror_valid = TRUE;
+
+        if (!xmms->priv->playlist_idle_id)
+                xmms->priv->playlist_idle_id = g_idle_add ((GSourceFunc) playlist_not_idle, NULL);
+}
+
+static void
+ario_xmms_playlist_reload (ArioXmms *xmms)
+{
+        ARIO_LOG_FUNCTION_START;
+        xmmsc_result_t *res;
+
+        if (xmms->priv->reloading || !xmms->priv->async_connection)
+                return;
+        xmms->priv->reloading = TRUE;
+
+        /* The playlist is read on the connection receiving the broadcasts:
+         * the broadcasts received before the reply are already included
+         * in it and are ignored as the mirror is invalid until then */
+        res = xmmsc_playlist_current_active (xmms->priv->async_connection);
+        xmmsc_result_notifier_set (res, (xmmsc_result_notifier_t) playlist_reload_active_cb, xmms);
+        xmmsc_result_unref (res);
+
+        res = xmmsc_playlist_list_entries (xmms->priv->async_connection, NULL);
+        xmmsc_result_notifier_set (res, (xmmsc_result_notifier_t) playlist_reload_cb, xmms);
+        xmmsc_result_unref (res);
+}
+
+static void
+ario_xmms_playlist_apply (ArioXmms *xmms,
+                          xmmsc_result_t *res)
+{
+        ARIO_LOG_FUNCTION_START;
+        gint type, position = -1, newposition = -1;
+        guint id = 0, length = xmms->priv->ids->len;
+        const gchar *name = NULL;
+
+        /* The mirror is read again before being used */
+        if (!xmms->priv->mirror_valid)
+                return;
+
+        if (!res
+            || xmmsc_result_iserror (res)
+            || !xmmsc_result_get_dict_entry_int (res, "type", &type)) {
+                xmms->priv->mirror_valid = FALSE;
+                return;
+        }
+
+        if (xmmsc_result_get_dict_entry_string (res, "name", &name)
+            && name && xmms->priv->active_playlist
+            && strcmp (name, xmms->priv->active_playlist))
+                return;
+
+        xmmsc_result_get_dict_entry_int (res, "position", &position);
+        xmmsc_result_get_dict_entry_int (res, "newposition", &newposition);
+        xmmsc_result_get_dict_entry_uint (res, "id", &id);
+
+        ++xmms->priv->version;
+        switch (type) {
+        case XMMS_PLAYLIST_CHANGED_ADD:
+        case XMMS_PLAYLIST_CHANGED_INSERT:
+                if (type == XMMS_PLAYLIST_CHANGED_ADD && position < 0)
+                        position = length;
+                if (position < 0 || position > (gint) length) {
+                        xmms->priv->mirror_valid = FALSE;
+                        break;
+                }
+                g_array_insert_val (xmms->priv->ids, position, id);
+                g_array_set_size (xmms->priv->versions, length + 1);
+                ario_xmms_playlist_touch (xmms, position, length + 1);
+                break;
+        case XMMS_PLAYLIST_CHANGED_REMOVE:
+                if (position < 0 || position >= (gint) length) {
+                        xmms->priv->mirror_valid = FALSE;
+                        break;
+                }
+                g_array_remove_index (xmms->priv->ids, position);
+                g_array_set_size (xmms->priv->versions, length - 1);
+                ario_xmms_playlist_touch (xmms, position, length - 1);
+                break;
+        case XMMS_PLAYLIST_CHANGED_MOVE:
+                if (position < 0 || position >= (gint) length
+                    || newposition < 0 || newposition >= (gint) length) {
+                        xmms->priv->mirror_valid = FALSE;
+                        break;
+                }
+                id = g_array_index (xmms->priv->ids, guint, position);
+                g_array_remove_index (xmms->priv->ids, position);
+                g_array_insert_val (xmms->priv->ids, newposition, id);
+                ario_xmms_playlist_touch (xmms, MIN (position, newposition), MAX (position, newposition) + 1);
+                break;
+        case XMMS_PLAYLIST_CHANGED_CLEAR:
+                g_array_set_size (xmms->priv->ids, 0);
+                g_array_set_size (xmms->priv->versions, 0);
+                break;
+        default:
+                /* Shuffle, sort...: the whole playlist is read again */
+                xmms->priv->mirror_valid = FALSE;
+                break;
+        }
+}
+
 static gboolean
 playlist_not_idle (xmmsc_result_t *not_used)
 {
+        instance->priv->playlist_idle_id = 0;
+
+        if (!instance->priv->connection)
+                return FALSE;
+
+        /* Read the whole playlist again if a change could not be followed:
+         * views are notified once it is read */
+        if (!instance->priv->mirror_valid) {
+                ario_xmms_playlist_reload (instance);
+                return FALSE;
+        }
+
+        instance->parent.playlist_length = instance->priv->ids->len;
+        g_object_set (G_OBJECT (instance), "playlist_id", instance->priv->version, NULL);
         g_signal_emit_by_name (G_OBJECT (server_instance), "playlist_changed");
         return FALSE;
 }
 
 static void
-playlist_not (xmmsc_result_t *not_used,
+playlist_not (xmmsc_result_t *res,
               ArioXmms *xmms)
 {
-        g_idle_add ((GSourceFunc) playlist_not_idle, NULL);
+        /* The payload is only valid in the callback: apply it to the
+         * mirror right away and notify the changes once */
+        ario_xmms_playlist_apply (xmms, res);
+        if (!xmms->priv->playlist_idle_id)
+                xmms->priv->playlist_idle_id = g_idle_add ((GSourceFunc) playlist_not_idle, NULL);
+}
+
+static void
+playlist_loaded_not (xmmsc_result_t *res,
+                     ArioXmms *xmms)
+{
+        /* Another playlist is now the active one */
+        xmms->priv->mirror_valid = FALSE;
+        playlist_not (NULL, xmms);
 }
 
 static gboolean
@@ -508,6 +716,9 @@ ario_xmms_connect_to (ArioXmms *xmms,
         ARIO_XMMS_CALLBACK_SET (async_connection, xmmsc_broadcast_playlist_changed,
                                 (xmmsc_result_notifier_t) playlist_not, xmms);
 
+        ARIO_XMMS_CALLBACK_SET (async_connection, xmmsc_broadcast_playlist_loaded,
+                                (xmmsc_result_notifier_t) playlist_loaded_not, xmms);
+
         ARIO_XMMS_CALLBACK_SET (async_connection, xmmsc_broadcast_playback_status,
                                 (xmmsc_result_notifier_t) playback_status_not, xmms);
 
@@ -581,6 +792,12 @@ ario_xmms_disconnect (void)
         xmmsc_unref (instance->priv->connection);
         instance->priv->connection = NULL;
 
+        instance->priv->mirror_valid = FALSE;
+        instance->priv->reloading = FALSE;
+        g_array_set_size (instance->priv->ids, 0);
+        g_array_set_size (instance->priv->versions, 0);
+        g_hash_table_remove_all (instance->priv->songs);
+
         ario_server_interface_set_default (ARIO_SERVER_INTERFACE (instance));
         ario_server_interface_emit (ARIO_SERVER_INTERFACE (instance), server_instance);
 }
@@ -612,7 +829,7 @@ ario_xmms_list_tags (const ArioServerTag tag,
                      const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *tags = NULL;
+        ArioServerListBuilder tags_builder = { NULL, NULL };
         xmmsc_result_t *res;
         xmmsc_coll_t *coll;
         const char *properties[] = { ArioXmmsPattern[tag], NULL };
@@ -661,21 +878,21 @@ ario_xmms_list_tags (const ArioServerTag tag,
                 if (!char_tag)
                         char_tag = ARIO_SERVER_UNKNOWN;
 
-                tags = g_slist_append (tags, g_strdup (char_tag));
+                ario_server_list_builder_append (&tags_builder, g_strdup (char_tag));
         }
 
         g_free (pattern);
         xmmsc_coll_unref (coll);
         xmmsc_result_unref (res);
 
-        return tags;
+        return ario_server_list_builder_steal (&tags_builder);
 }
 
 static GSList *
 ario_xmms_get_albums (const ArioServerCriteria *criteria)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *albums = NULL;
+        ArioServerListBuilder albums_builder = { NULL, NULL };
         ArioServerAlbum *ario_xmms_album;
         xmmsc_result_t *res;
         xmmsc_coll_t *coll;
@@ -734,14 +951,14 @@ ario_xmms_get_albums (const ArioServerCriteria *criteria)
                 ario_xmms_album->artist = g_strdup (artist);
                 ario_xmms_album->album = g_strdup (album);
 
-                albums = g_slist_append (albums, ario_xmms_album);
+                ario_server_list_builder_append (&albums_builder, ario_xmms_album);
         }
 
         g_free (pattern);
         xmmsc_coll_unref(coll);
         xmmsc_result_unref (res);
 
-        return albums;
+        return ario_server_list_builder_steal (&albums_builder);
 }
 
 static GSList *
@@ -749,7 +966,7 @@ ario_xmms_get_songs (const ArioServerCriteria *criteria,
                      const gboolean exact)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *songs = NULL;
+        ArioServerListBuilder songs_builder = { NULL, NULL };
         xmmsc_result_t *res;
         xmmsc_coll_t *coll;
         const char *properties[] = { "tracknr", "title", "url", NULL };
@@ -795,21 +1012,21 @@ ario_xmms_get_songs (const ArioServerCriteria *criteria,
         ario_xmms_result_wait (res);
         for (; xmmsc_result_list_valid (res); xmmsc_result_list_next (res)) {
                 xmms_song = ario_xmms_get_song_from_res (res);
-                songs = g_slist_append (songs, xmms_song);
+                ario_server_list_builder_append (&songs_builder, xmms_song);
         }
 
         g_free (pattern);
         xmmsc_coll_unref(coll);
         xmmsc_result_unref (res);
 
-        return songs;
+        return ario_server_list_builder_steal (&songs_builder);
 }
 
 static GSList *
 ario_xmms_get_songs_from_playlist (char *playlist)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *songs = NULL;
+        ArioServerListBuilder songs_builder = { NULL, NULL };
         xmmsc_result_t *res;
         xmmsc_result_t *res2;
         guint i;
@@ -832,21 +1049,21 @@ ario_xmms_get_songs_from_playlist (char *playlist)
                 song->pos = pos;
                 ++pos;
                 xmmsc_result_unref (res2);
-                songs = g_slist_append (songs, song);
+                ario_server_list_builder_append (&songs_builder, song);
                 instance->priv->total_time += song->time;
         }
         instance->parent.playlist_length = pos;
 
         xmmsc_result_unref (res);
 
-        return songs;
+        return ario_server_list_builder_steal (&songs_builder);
 }
 
 static GSList *
 ario_xmms_get_playlists (void)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *playlists = NULL;
+        ArioServerListBuilder playlists_builder = { NULL, NULL };
         const gchar *playlist;
         xmmsc_result_t *res;
 
@@ -856,11 +1073,11 @@ ario_xmms_get_playlists (void)
         for (; xmmsc_result_list_valid (res); xmmsc_result_list_next (res)) {
                 xmmsc_result_get_string (res, &playlist);
                 if (playlist && *playlist != '_')
-                        playlists = g_slist_append (playlists, g_strdup (playlist));
+                        ario_server_list_builder_append (&playlists_builder, g_strdup (playlist));
         }
         xmmsc_result_unref (res);
 
-        return playlists;
+        return ario_server_list_builder_steal (&playlists_builder);
 }
 
 static gboolean
@@ -883,11 +1100,144 @@ ario_xmms_playlist_exists (const gchar *name)
         return FALSE;
 }
 
+static ArioServerSong *
+ario_xmms_copy_song (const ArioServerSong *song)
+{
+        ArioServerSong *copy;
+
+        copy = (ArioServerSong *) g_malloc (sizeof (ArioServerSong));
+        *copy = *song;
+
+        /* Interned tags are shared */
+        copy->file = g_strdup (song->file);
+        copy->title = g_strdup (song->title);
+        copy->track = g_strdup (song->track);
+        copy->name = g_strdup (song->name);
+        copy->disc = g_strdup (song->disc);
+        copy->comment = g_strdup (song->comment);
+
+        return copy;
+}
+
+static void
+ario_xmms_fetch_songs (GArray *ids)
+{
+        ARIO_LOG_FUNCTION_START;
+        xmmsc_result_t **results;
+        guint i, id;
+
+        /* Send every request before waiting for the first answer */
+        results = g_new (xmmsc_result_t *, ids->len);
+        for (i = 0; i < ids->len; ++i)
+                results[i] = xmmsc_medialib_get_info (instance->priv->connection,
+                                                      g_array_index (ids, guint, i));
+
+        for (i = 0; i < ids->len; ++i) {
+                id = g_array_index (ids, guint, i);
+                ario_xmms_result_wait (results[i]);
+                /* Failed lookups are tried again on the next changes */
+                if (!xmmsc_result_iserror (results[i]))
+                        g_hash_table_insert (instance->priv->songs, GUINT_TO_POINTER (id),
+                                             ario_xmms_get_song_from_res (results[i]));
+                xmmsc_result_unref (results[i]);
+        }
+        g_free (results);
+}
+
+static void
+ario_xmms_prune_songs (void)
+{
+        ARIO_LOG_FUNCTION_START;
+        GHashTable *songs;
+        gpointer key, song;
+        guint i;
+
+        /* Forget songs removed from the playlist once there are many of them */
+        if (g_hash_table_size (instance->priv->songs) <= 2 * instance->priv->ids->len + 128)
+                return;
+
+        songs = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                       NULL, (GDestroyNotify) ario_server_free_song);
+        for (i = 0; i < instance->priv->ids->len; ++i) {
+                key = GUINT_TO_POINTER (g_array_index (instance->priv->ids, guint, i));
+                song = g_hash_table_lookup (instance->priv->songs, key);
+                if (song) {
+                        g_hash_table_steal (instance->priv->songs, key);
+                        g_hash_table_insert (songs, key, song);
+                }
+        }
+        g_hash_table_destroy (instance->priv->songs);
+        instance->priv->songs = songs;
+}
+
 static GSList *
 ario_xmms_get_playlist_changes (gint64 playlist_id)
 {
         ARIO_LOG_FUNCTION_START;
-        return ario_xmms_get_songs_from_playlist (NULL);
+        ArioServerListBuilder songs_builder = { NULL, NULL };
+        GArray *missing;
+        GHashTable *requested;
+        ArioServerSong *song;
+        gpointer key;
+        gint64 version, published;
+        guint i;
+
+        /* check if there is a connection */
+        if (!instance->priv->connection)
+                return NULL;
+
+        /* Views are notified again once the playlist is read */
+        if (!instance->priv->mirror_valid) {
+                ario_xmms_playlist_reload (instance);
+                return NULL;
+        }
+
+        /* Only songs newly inserted in the playlist are looked up in the medialib */
+        missing = g_array_new (FALSE, FALSE, sizeof (guint));
+        requested = g_hash_table_new (g_direct_hash, g_direct_equal);
+        for (i = 0; i < instance->priv->ids->len; ++i) {
+                if (g_array_index (instance->priv->versions, gint64, i) <= playlist_id)
+                        continue;
+                key = GUINT_TO_POINTER (g_array_index (instance->priv->ids, guint, i));
+                if (!g_hash_table_contains (instance->priv->songs, key)
+                    && g_hash_table_add (requested, key))
+                        g_array_append_val (missing, g_array_index (instance->priv->ids, guint, i));
+        }
+        ario_xmms_fetch_songs (missing);
+        g_hash_table_destroy (requested);
+        g_array_free (missing, TRUE);
+
+        /* Return the songs of the positions changed since playlist_id */
+        instance->priv->total_time = 0;
+        published = instance->priv->version;
+        for (i = 0; i < instance->priv->ids->len; ++i) {
+                key = GUINT_TO_POINTER (g_array_index (instance->priv->ids, guint, i));
+                version = g_array_index (instance->priv->versions, gint64, i);
+                song = g_hash_table_lookup (instance->priv->songs, key);
+                if (song) {
+                        instance->priv->total_time += song->time;
+                        if (version <= playlist_id)
+                                continue;
+                        song = ario_xmms_copy_song (song);
+                } else {
+                        /* Keep the position of songs whose lookup failed and
+                         * publish an older playlist id so that they are part
+                         * of the next changes */
+                        song = (ArioServerSong *) g_malloc0 (sizeof (ArioServerSong));
+                        song->file = g_strdup ("");
+                        song->id = GPOINTER_TO_UINT (key);
+                        published = MIN (published, version - 1);
+                }
+                song->pos = i;
+                ario_server_list_builder_append (&songs_builder, song);
+        }
+        ario_xmms_prune_songs ();
+
+        instance->parent.playlist_length = instance->priv->ids->len;
+        if (instance->parent.playlist_id != published)
+                g_object_set (G_OBJECT (instance), "playlist_id", published, NULL);
+
+        return ario_server_list_builder_steal (&songs_builder);
 }
 
 static ArioServerSong *
@@ -1156,7 +1506,7 @@ static void
 ario_xmms_queue_commit (void)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *tmp;
+        GSList *tmp, *queue;
         ArioServerQueueAction *queue_action;
         xmmsc_result_t *res;
 
@@ -1164,7 +1514,7 @@ ario_xmms_queue_commit (void)
         if (!instance->priv->connection)
                 return;
 
-        for (tmp = instance->parent.queue; tmp; tmp = g_slist_next (tmp)) {
+        for (tmp = instance->parent.queue.head; tmp; tmp = g_slist_next (tmp)) {
                 queue_action = (ArioServerQueueAction *) tmp->data;
                 if (queue_action->type == ARIO_SERVER_ACTION_ADD) {
                         if (queue_action->path) {
@@ -1194,9 +1544,8 @@ ario_xmms_queue_commit (void)
 
         }
 
-        g_slist_foreach (instance->parent.queue, (GFunc) g_free, NULL);
-        g_slist_free (instance->parent.queue);
-        instance->parent.queue = NULL;
+        queue = ario_server_list_builder_steal (&instance->parent.queue);
+        ario_server_queue_free (queue);
 }
 
 static gchar *
@@ -1366,7 +1715,7 @@ ario_xmms_get_songs_info (GSList *paths)
                         ario_xmms_result_wait (res);
 
                         song = ario_xmms_get_song_from_res (res);
-                        songs = g_list_append (songs, song);
+                        songs = g_list_prepend (songs, song);
                 } else {
                         ARIO_LOG_ERROR ("Broken result or path not found");
                 }
@@ -1374,7 +1723,7 @@ ario_xmms_get_songs_info (GSList *paths)
                 g_free (path);
         }
 
-        return songs;
+        return g_list_reverse (songs);
 }
 
 /*
@@ -1406,6 +1755,8 @@ ario_xmms_list_files (const char *path,
         gchar *musicdir;
         gchar *full_path;
         ArioServerFileList *files;
+        ArioServerListBuilder directories = { NULL, NULL };
+        ArioServerListBuilder songs = { NULL, NULL };
         GFile *file;
 
         files = (ArioServerFileList *) g_malloc0 (sizeof (ArioServerFileList));
@@ -1444,7 +1795,7 @@ ario_xmms_list_files (const char *path,
                 decode_url = xmmsc_result_decode_url (res, r);
                 xmmsc_result_get_dict_entry_int (res, "isdir", &d);
                 if (d) {
-                        files->directories = g_slist_append (files->directories, g_strdup (decode_url + url_length));
+                        ario_server_list_builder_append (&directories, g_strdup (decode_url + url_length));
                 } else {
                         uint32_t id;
                         xmmsc_result_t *res2;
@@ -1455,7 +1806,7 @@ ario_xmms_list_files (const char *path,
                                 if (id > 0) {
                                         res3 = xmmsc_medialib_get_info (instance->priv->connection, id);
                                         ario_xmms_result_wait (res3);
-                                        files->songs = g_slist_append (files->songs, ario_xmms_get_song_from_res (res3));
+                                        ario_server_list_builder_append (&songs, ario_xmms_get_song_from_res (res3));
                                         xmmsc_result_unref (res3);
                                 }
                         } else {
@@ -1465,6 +1816,8 @@ ario_xmms_list_files (const char *path,
                 }
         }
         xmmsc_result_unref (res);
+        files->directories = ario_server_list_builder_steal (&directories);
+        files->songs = ario_server_list_builder_steal (&songs);
 
         return files;
 }
@@ -23,10 +23,10 @@
 #include <glib/gi18n.h>
 
 #include "ario-debug.h"
-#include "covers/ario-cover.h"
 #include "covers/ario-cover-handler.h"
-#include "covers/ario-cover-manager.h"
+#include "lib/ario-conf.h"
 #include "lib/gtk-builder-helpers.h"
+#include "preferences/ario-preferences.h"
 #include "servers/ario-server.h"
 
 static void ario_shell_coverdownloader_finalize (GObject *object);
@@ -35,25 +35,13 @@ static GObject * ario_shell_coverdownloader_constructor (GType type, guint n_con
 static gboolean ario_shell_coverdownloader_window_delete_cb (GtkWidget *window,
                                                              GdkEventAny *event,
                                                              ArioShellCoverdownloader *ario_shell_coverdownloader);
-static void ario_shell_coverdownloader_get_cover (ArioShellCoverdownloader *ario_shell_coverdownloader,
-                                                  const char *artist,
-                                                  const char *album,
-                                                  const char *path);
 static void ario_shell_coverdownloader_close_cb (GtkButton *button,
                                                  ArioShellCoverdownloader *ario_shell_coverdownloader);
 static void ario_shell_coverdownloader_cancel_cb (GtkButton *button,
                                                   ArioShellCoverdownloader *ario_shell_coverdownloader);
-static void ario_shell_coverdownloader_get_cover_from_album (ArioShellCoverdownloader *ario_shell_coverdownloader,
-                                                             const ArioServerAlbum *server_album,
-                                                             const ArioShellCoverdownloaderOperation operation);
 
 struct ArioShellCoverdownloaderPrivate
 {
-        int nb_covers;
-        int nb_covers_already_exist;
-        int nb_covers_found;
-        int nb_covers_not_found;
-
         gboolean cancelled;
 
         GtkWidget *progress_artist_label;
@@ -64,10 +52,9 @@ struct ArioShellCoverdownloaderPrivate
         GtkWidget *cancel_button;
         GtkWidget *close_button;
 
-        GSList *albums;
         ArioShellCoverdownloaderOperation operation;
 
-        GThread *thread;
+        ArioCoverDownloader *downloader;
 };
 
 static gboolean is_instantiated = FALSE;
@@ -106,13 +93,8 @@ ario_shell_coverdownloader_finalize (GObject *object)
 
         g_return_if_fail (ario_shell_coverdownloader->priv != NULL);
 
-        /* Wait for thread to finish */
-        if (ario_shell_coverdownloader->priv->thread)
-                g_thread_join (ario_shell_coverdownloader->priv->thread);
-
-        /* We free the list */
-        g_slist_foreach (ario_shell_coverdownloader->priv->albums, (GFunc) ario_server_free_album, NULL);
-        g_slist_free (ario_shell_coverdownloader->priv->albums);
+        /* Albums not searched yet are skipped */
+        ario_cover_downloader_free (ario_shell_coverdownloader->priv->downloader);
 
         is_instantiated = FALSE;
 
@@ -214,6 +196,7 @@ ario_shell_coverdownloader_close_cb (GtkButton *button,
         ARIO_LOG_FUNCTION_START;
         /* Close button pressed : we close and destroy the window */
         ario_shell_coverdownloader->priv->cancelled = TRUE;
+        ario_cover_downloader_cancel (ario_shell_coverdownloader->priv->downloader);
         gtk_widget_hide (GTK_WIDGET (ario_shell_coverdownloader));
         gtk_widget_destroy (GTK_WIDGET (ario_shell_coverdownloader));
 }
@@ -223,8 +206,9 @@ ario_shell_coverdownloader_cancel_cb (GtkButton *button,
                                       ArioShellCoverdownloader *ario_shell_coverdownloader)
 {
         ARIO_LOG_FUNCTION_START;
-        /* Cancel button pressed : we wait until the end of the current download and we stop the search */
+        /* Cancel button pressed : we wait until the end of the current downloads and we stop the search */
         ario_shell_coverdownloader->priv->cancelled = TRUE;
+        ario_cover_downloader_cancel (ario_shell_coverdownloader->priv->downloader);
 }
 
 static gboolean
@@ -236,6 +220,7 @@ ario_shell_coverdownloader_window_delete_cb (GtkWidget *window,
         if (!ario_shell_coverdownloader->priv->cancelled) {
                 /* Window destroyed for the first time : we wait until the end of the current download and we stop the search */
                 ario_shell_coverdownloader->priv->cancelled = TRUE;
+                ario_cover_downloader_cancel (ario_shell_coverdownloader->priv->downloader);
         } else {
                 /* Window destroyed for the second time : we close and destroy the window */
                 gtk_widget_hide (GTK_WIDGET (ario_shell_coverdownloader));
@@ -255,7 +240,7 @@ ario_shell_coverdownloader_refresh (gpointer data)
         return FALSE;
 }
 
-static gboolean
+static void
 ario_shell_coverdownloader_progress_start (ArioShellCoverdownloader *ario_shell_coverdownloader)
 {
         ARIO_LOG_FUNCTION_START;
@@ -272,48 +257,43 @@ ario_shell_coverdownloader_progress_start (ArioShellCoverdownloader *ario_shell_
 
         /* We refresh the window */
         ario_shell_coverdownloader_refresh (NULL);
-
-        return FALSE;
 }
 
-typedef struct
-{
-        ArioShellCoverdownloader *ario_shell_coverdownloader;
-        gchar *artist;
-        gchar *album;
-} ArioShellCoverdownloaderIdleData;
-
-static gboolean
-ario_shell_coverdownloader_progress_update (ArioShellCoverdownloaderIdleData *data)
+static void
+ario_shell_coverdownloader_progress_update (ArioCoverDownloader *downloader,
+                                            const gchar *artist,
+                                            const gchar *album,
+                                            ArioShellCoverdownloader *ario_shell_coverdownloader)
 {
         ARIO_LOG_FUNCTION_START;
+        gdouble nb_covers_done;
+
+        /* The progress is only shown when covers are searched */
+        if (ario_shell_coverdownloader->priv->operation != GET_COVERS)
+                return;
+
         /* We have already searched for nb_covers_done covers */
-        gdouble nb_covers_done = (data->ario_shell_coverdownloader->priv->nb_covers_found
-                                  + data->ario_shell_coverdownloader->priv->nb_covers_not_found
-                                  + data->ario_shell_coverdownloader->priv->nb_covers_already_exist);
+        nb_covers_done = (ario_cover_downloader_get_nb_found (downloader)
+                          + ario_cover_downloader_get_nb_not_found (downloader)
+                          + ario_cover_downloader_get_nb_already_exist (downloader));
 
         /* We update the progress bar */
-        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (data->ario_shell_coverdownloader->priv->progressbar),
-                                       nb_covers_done / data->ario_shell_coverdownloader->priv->nb_covers);
+        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (ario_shell_coverdownloader->priv->progressbar),
+                                       nb_covers_done / ario_cover_downloader_get_nb_covers (downloader));
 
         /* We update the artist and the album label */
-        gtk_label_set_text (GTK_LABEL (data->ario_shell_coverdownloader->priv->progress_artist_label), data->artist);
-        gtk_label_set_text (GTK_LABEL (data->ario_shell_coverdownloader->priv->progress_album_label), data->album);
+        gtk_label_set_text (GTK_LABEL (ario_shell_coverdownloader->priv->progress_artist_label), artist);
+        gtk_label_set_text (GTK_LABEL (ario_shell_coverdownloader->priv->progress_album_label), album);
 
         /* We refresh the window */
         ario_shell_coverdownloader_refresh (NULL);
-
-        g_free (data->artist);
-        g_free (data->album);
-        g_free (data);
-
-        return FALSE;
 }
 
-static gboolean
+static void
 ario_shell_coverdownloader_progress_end (ArioShellCoverdownloader *ario_shell_coverdownloader)
 {
         ARIO_LOG_FUNCTION_START;
+        ArioCoverDownloader *downloader = ario_shell_coverdownloader->priv->downloader;
         char *label_text;
 
         /* We only want the close button at the end, not the cancel button */
@@ -329,9 +309,9 @@ ario_shell_coverdownloader_progress_end (ArioShellCoverdownloader *ario_shell_co
 
         /* We show the numbers of covers found and not found */
         label_text = g_strdup_printf (_("%i covers found\n%i covers not found\n%i covers already exist"),
-                                      ario_shell_coverdownloader->priv->nb_covers_found,
-                                      ario_shell_coverdownloader->priv->nb_covers_not_found,
-                                      ario_shell_coverdownloader->priv->nb_covers_already_exist);
+                                      ario_cover_downloader_get_nb_found (downloader),
+                                      ario_cover_downloader_get_nb_not_found (downloader),
+                                      ario_cover_downloader_get_nb_already_exist (downloader));
 
         gtk_label_set_text (GTK_LABEL (ario_shell_coverdownloader->priv->progress_const_artist_label),
                             label_text);
@@ -339,8 +319,6 @@ ario_shell_coverdownloader_progress_end (ArioShellCoverdownloader *ario_shell_co
 
         gtk_widget_destroy (ario_shell_coverdownloader->priv->progress_hbox);
         gtk_widget_destroy (ario_shell_coverdownloader->priv->progress_artist_label);
-
-        return FALSE;
 }
 
 void
@@ -362,50 +340,19 @@ ario_shell_coverdownloader_get_covers (ArioShellCoverdownloader *ario_shell_cove
         g_slist_free (albums);
 }
 
-static gboolean
-ario_shell_coverdownloader_force_reload (gpointer data)
-{
-        ARIO_LOG_FUNCTION_START;
-        ario_cover_handler_force_reload();
-
-        return FALSE;
-}
-
-static gpointer
-ario_shell_coverdownloader_get_covers_from_albums_thread (ArioShellCoverdownloader *ario_shell_coverdownloader)
+static void
+ario_shell_coverdownloader_done (ArioCoverDownloader *downloader,
+                                 ArioShellCoverdownloader *ario_shell_coverdownloader)
 {
         ARIO_LOG_FUNCTION_START;
-        GSList *tmp;
-
-        if (!ario_shell_coverdownloader->priv->albums)
-                return NULL;
-
-        /* We show the window with the progress bar */
-        if (ario_shell_coverdownloader->priv->operation == GET_COVERS)
-                g_idle_add ((GSourceFunc) ario_shell_coverdownloader_progress_start, ario_shell_coverdownloader);
-
-        ario_shell_coverdownloader->priv->nb_covers = g_slist_length (ario_shell_coverdownloader->priv->albums);
-
-        /* While there are still covers to search */
-        for (tmp = ario_shell_coverdownloader->priv->albums; tmp; tmp = g_slist_next (tmp)) {
-                /* The user has pressed the "cancel button" or has closed the window : we stop the search */
-                if (ario_shell_coverdownloader->priv->cancelled)
-                        break;
-
-                /* We search for a new cover */
-                ario_shell_coverdownloader_get_cover_from_album (ario_shell_coverdownloader,
-                                                                 tmp->data,
-                                                                 ario_shell_coverdownloader->priv->operation);
-        }
         /* We change the window to show a close button and infos about the search */
         if (ario_shell_coverdownloader->priv->operation == GET_COVERS)
-                g_idle_add ((GSourceFunc) ario_shell_coverdownloader_progress_end, ario_shell_coverdownloader);
-        else
-                g_idle_add ((GSourceFunc) gtk_widget_destroy, ario_shell_coverdownloader);
+                ario_shell_coverdownloader_progress_end (ario_shell_coverdownloader);
 
-        g_idle_add ((GSourceFunc) ario_shell_coverdownloader_force_reload, NULL);
+        ario_cover_handler_force_reload ();
 
-        return NULL;
+        if (ario_shell_coverdownloader->priv->operation != GET_COVERS)
+                gtk_widget_destroy (GTK_WIDGET (ario_shell_coverdownloader));
 }
 
 void
@@ -414,113 +361,21 @@ ario_shell_coverdownloader_get_covers_from_albums (ArioShellCoverdownloader *ari
                                                    const ArioShellCoverdownloaderOperation operation)
 {
         ARIO_LOG_FUNCTION_START;
-        const GSList *tmp;
-
         if (!albums)
                 return;
 
-        /* Copy the list of albums */
-        ario_shell_coverdownloader->priv->albums = NULL;
-        for (tmp = albums; tmp; tmp = g_slist_next (tmp)) {
-                ario_shell_coverdownloader->priv->albums = g_slist_append (ario_shell_coverdownloader->priv->albums, ario_server_copy_album (tmp->data));
-        }
-
         ario_shell_coverdownloader->priv->operation = operation;
 
-        /* Launch thread for cover download */
-        ario_shell_coverdownloader->priv->thread = g_thread_new ("coverdl",
-                                                                 (GThreadFunc) ario_shell_coverdownloader_get_covers_from_albums_thread,
-                                                                 ario_shell_coverdownloader);
-}
-
-static void
-ario_shell_coverdownloader_get_cover_from_album (ArioShellCoverdownloader *ario_shell_coverdownloader,
-                                                 const ArioServerAlbum *server_album,
-                                                 const ArioShellCoverdownloaderOperation operation)
-{
-        ARIO_LOG_FUNCTION_START;
-        const gchar *artist;
-        const gchar *album;
-        const gchar *path;
-        ArioShellCoverdownloaderIdleData *data;
-
-        if (!server_album)
-                return;
-
-        artist = server_album->artist;
-        album = server_album->album;
-        path = server_album->path;
-
-        if (!album || !artist)
-                return;
-
-        switch (operation) {
-        case GET_COVERS:
-                /* We update the progress bar */
-                data = (ArioShellCoverdownloaderIdleData *) g_malloc0 (sizeof (ArioShellCoverdownloaderIdleData));
-
-                data->ario_shell_coverdownloader = ario_shell_coverdownloader;
-                data->artist = g_strdup (artist);
-                data->album = g_strdup (album);
-                g_idle_add ((GSourceFunc) ario_shell_coverdownloader_progress_update, data);
-
-                if (ario_cover_cover_exists (artist, album))
-                        /* The cover already exists, we do nothing */
-                        ++ario_shell_coverdownloader->priv->nb_covers_already_exist;
-                else
-                        /* We search for the cover */
-                        ario_shell_coverdownloader_get_cover (ario_shell_coverdownloader, artist, album, path);
-                break;
-
-        case REMOVE_COVERS:
-                /* We remove the cover from the ~/.config/ario/covers/ directory */
-                ario_cover_remove_cover (artist, album);
-                break;
-
-        default:
-                break;
-        }
-}
-
-static void
-ario_shell_coverdownloader_get_cover (ArioShellCoverdownloader *ario_shell_coverdownloader,
-                                      const char *artist,
-                                      const char *album,
-                                      const char *path)
-{
-        ARIO_LOG_FUNCTION_START;
-        GArray *size;
-        GSList *data = NULL;
-        gboolean ret;
-
-        size = g_array_new (TRUE, TRUE, sizeof (int));
-
-        /* If a cover is found, it is loaded in data(0) */
-        ret = ario_cover_manager_get_covers (ario_cover_manager_get_instance (),
-                                             artist,
-                                             album,
-                                             path,
-                                             &size,
-                                             &data,
-                                             GET_FIRST_COVER);
-
-        /* If the cover is not too big and not too small (blank image), we save it */
-        if (ret && ario_cover_size_is_valid (g_array_index (size, int, 0))) {
-                ret = ario_cover_save_cover (artist,
-                                             album,
-                                             g_slist_nth_data (data, 0),
-                                             g_array_index (size, int, 0),
-                                             OVERWRITE_MODE_SKIP);
-
-                if (ret)
-                        ++ario_shell_coverdownloader->priv->nb_covers_found;
-                else
-                        ++ario_shell_coverdownloader->priv->nb_covers_not_found;
-        } else {
-                ++ario_shell_coverdownloader->priv->nb_covers_not_found;
-        }
-
-        g_array_free (size, TRUE);
-        g_slist_foreach (data, (GFunc) g_free, NULL);
-        g_slist_free (data);
+        /* We show the window with the progress bar */
+        if (operation == GET_COVERS)
+                ario_shell_coverdownloader_progress_start (ario_shell_coverdownloader);
+
+        /* Launch the search in background */
+        ario_shell_coverdownloader->priv->downloader =
+                ario_cover_downloader_new (albums,
+                                           operation,
+                                           ario_conf_get_integer (PREF_COVER_DOWNLOAD_JOBS, PREF_COVER_DOWNLOAD_JOBS_DEFAULT),
+                                           (ArioCoverDownloaderProgressFunc) ario_shell_coverdownloader_progress_update,
+                                           (ArioCoverDownloaderDoneFunc) ario_shell_coverdownloader_done,
+                                           ario_shell_coverdownloader);
 }
@@ -22,6 +22,7 @@
 
 #include <glib.h>
 #include <gtk/gtk.h>
+#include "covers/ario-cover-downloader.h"
 
 G_BEGIN_DECLS
 
@@ -50,11 +51,7 @@ typedef struct
         GtkWindowClass parent_class;
 } ArioShellCoverdownloaderClass;
 
-typedef enum
-{
-        GET_COVERS,
-        REMOVE_COVERS
-} ArioShellCoverdownloaderOperation;
+typedef ArioCoverDownloaderOperation ArioShellCoverdownloaderOperation;
 
 GType           ario_shell_coverdownloader_get_type                     (void) G_GNUC_CONST;
 
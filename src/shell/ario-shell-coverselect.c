@@ -291,7 +291,8 @@ ario_shell_coverselect_new (ArioServerAlbum *server_album)
         /* Remember info about album */
         shell_coverselect->priv->file_artist = server_album->artist;
         shell_coverselect->priv->file_album = server_album->album;
-        shell_coverselect->priv->path = g_path_get_dirname (server_album->path);
+        if (server_album->path)
+                shell_coverselect->priv->path = g_path_get_dirname (server_album->path);
 
         /* Fill widgets with album data */
         ario_shell_coverselect_set_current_cover (shell_coverselect);
@@ -590,18 +591,17 @@ static void
 ario_shell_coverselect_set_current_cover (ArioShellCoverselect *shell_coverselect)
 {
         ARIO_LOG_FUNCTION_START;
-        GdkPixbuf *pixbuf;
-        gchar *ario_cover_path;
-
-        if (ario_cover_cover_exists (shell_coverselect->priv->file_artist, shell_coverselect->priv->file_album)) {
-                /* Get cover path */
-                ario_cover_path = ario_cover_make_cover_path (shell_coverselect->priv->file_artist,
-                                                              shell_coverselect->priv->file_album,
-                                                              NORMAL_COVER);
+        GdkPixbuf *pixbuf = NULL;
+
+        if (ario_cover_cover_exists (shell_coverselect->priv->file_artist, shell_coverselect->priv->file_album))
+                pixbuf = ario_cover_get_pixbuf (shell_coverselect->priv->file_artist,
+                                                shell_coverselect->priv->file_album,
+                                                NORMAL_COVER,
+                                                CURRENT_COVER_SIZE);
+
+        if (pixbuf) {
                 /* Display cover in cover widget */
                 gtk_widget_show_all (shell_coverselect->priv->current_cover);
-                pixbuf = gdk_pixbuf_new_from_file_at_size (ario_cover_path, CURRENT_COVER_SIZE, CURRENT_COVER_SIZE, NULL);
-                g_free (ario_cover_path);
                 gtk_image_set_from_pixbuf (GTK_IMAGE (shell_coverselect->priv->current_cover),
                                            pixbuf);
                 g_object_unref (pixbuf);
@@ -45,6 +45,8 @@ G_MODULE_EXPORT void ario_shell_similarartists_addall_cb (GtkButton *button,
 #define LASTFM_URI "http://ws.audioscrobbler.com/1.0/artist/%s/similar.xml"
 #define MAX_ARTISTS 10
 #define IMAGE_SIZE 120
+/* Similar artists are kept on disk for a week */
+#define LASTFM_CACHE_TTL (7 * 24 * 3600)
 
 /* Private attributes */
 struct ArioShellSimilarartistsPrivate
@@ -262,10 +264,10 @@ ario_shell_similarartists_get_similar_artists (const gchar *artist)
         g_free (keyword);
 
         /* Download XML file */
-        ario_util_download_file (xml_uri,
-                                 NULL, 0, NULL,
-                                 &xml_size,
-                                 &xml_data);
+        ario_util_download_file_cached (xml_uri,
+                                        LASTFM_CACHE_TTL,
+                                        &xml_size,
+                                        &xml_data);
         g_free (xml_uri);
         if (xml_size == 0) {
                 return NULL;
@@ -111,6 +111,28 @@ ario_shell_songinfos_can_edit_tags (void)
 #endif
 }
 
+#ifdef ENABLE_TAGLIB
+static void
+ario_shell_songinfos_set_song_tags (ArioServerSong *song,
+                                    TagLib_Tag *tag)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar year[16];
+
+        g_free (song->title);
+        song->title = g_strdup (taglib_tag_title (tag));
+        song->artist = (char *) ario_server_intern (taglib_tag_artist (tag));
+        song->album = (char *) ario_server_intern (taglib_tag_album (tag));
+        g_free (song->track);
+        song->track = g_strdup_printf ("%i", taglib_tag_track (tag));
+        g_snprintf (year, sizeof (year), "%i", taglib_tag_year (tag));
+        song->date = (char *) ario_server_intern (year);
+        song->genre = (char *) ario_server_intern (taglib_tag_genre (tag));
+        g_free (song->comment);
+        song->comment = g_strdup (taglib_tag_comment (tag));
+}
+#endif
+
 static void
 ario_shell_songinfos_fill_tags (ArioServerSong *song)
 {
@@ -133,20 +155,7 @@ ario_shell_songinfos_fill_tags (ArioServerSong *song)
                 tag = taglib_file_tag (file);
                 properties = taglib_file_audioproperties (file);
                 if (tag) {
-                        g_free (song->title);
-                        song->title = g_strdup (taglib_tag_title (tag));
-                        g_free (song->artist);
-                        song->artist = g_strdup (taglib_tag_artist (tag));
-                        g_free (song->album);
-                        song->album = g_strdup (taglib_tag_album (tag));
-                        g_free (song->track);
-                        song->track = g_strdup_printf ("%i", taglib_tag_track (tag));
-                        g_free (song->date);
-                        song->date = g_strdup_printf ("%i", taglib_tag_year (tag));
-                        g_free (song->genre);
-                        song->genre = g_strdup (taglib_tag_genre (tag));
-                        g_free (song->comment);
-                        song->comment = g_strdup (taglib_tag_comment (tag));
+                        ario_shell_songinfos_set_song_tags (song, tag);
                 }
 
                 if (properties)
@@ -419,20 +428,7 @@ ario_shell_songinfos_response_cb (GtkDialog *dial,
                         if (taglib_file_save (file)) {
                                 /* Update song values with 'real' tags from taglib */
                                 success = TRUE;
-                                g_free (song->title);
-                                song->title = g_strdup (taglib_tag_title (tag));
-                                g_free (song->artist);
-                                song->artist = g_strdup (taglib_tag_artist (tag));
-                                g_free (song->album);
-                                song->album = g_strdup (taglib_tag_album (tag));
-                                g_free (song->track);
-                                song->track = g_strdup_printf ("%i", taglib_tag_track (tag));
-                                g_free (song->date);
-                                song->date = g_strdup_printf ("%i", taglib_tag_year (tag));
-                                g_free (song->genre);
-                                song->genre = g_strdup (taglib_tag_genre (tag));
-                                g_free (song->comment);
-                                song->comment = g_strdup (taglib_tag_comment (tag));
+                                ario_shell_songinfos_set_song_tags (song, tag);
 
                                 /* Update server database */
                                 ario_server_update_db (song->file);
@@ -33,6 +33,7 @@
 
 #define SEARCH_DELAY 250
 
+static void ario_search_finalize (GObject *object);
 static void ario_search_connectivity_changed_cb (ArioServer *server,
                                                  ArioSearch *search);
 static void ario_search_entry_changed (GtkEntry *entry,
@@ -53,6 +54,8 @@ struct ArioSearchPrivate
         gboolean connected;
 
         guint event_id;
+
+        ArioServerStream *stream;
 };
 
 /* Actions */
@@ -94,8 +97,12 @@ static void
 ario_search_class_init (ArioSearchClass *klass)
 {
         ARIO_LOG_FUNCTION_START;
+        GObjectClass *object_class = G_OBJECT_CLASS (klass);
         ArioSourceClass *source_class = ARIO_SOURCE_CLASS (klass);
 
+        /* GObject virtual methods */
+        object_class->finalize = ario_search_finalize;
+
         /* Virtual ArioSource methods */
         source_class->get_id = ario_search_get_id;
         source_class->get_name = ario_search_get_name;
@@ -139,6 +146,28 @@ ario_search_init (ArioSearch *search)
                             TRUE, TRUE, 0);
 }
 
+static void
+ario_search_finalize (GObject *object)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioSearch *search;
+
+        g_return_if_fail (object != NULL);
+        g_return_if_fail (IS_ARIO_SEARCH (object));
+
+        search = ARIO_SEARCH (object);
+
+        g_return_if_fail (search->priv != NULL);
+
+        if (search->priv->event_id > 0)
+                g_source_remove (search->priv->event_id);
+
+        /* Stop receiving results of a running search */
+        ario_server_stream_cancel (search->priv->stream);
+
+        G_OBJECT_CLASS (ario_search_parent_class)->finalize (object);
+}
+
 GtkWidget *
 ario_search_new (void)
 {
@@ -203,17 +232,27 @@ ario_search_entry_clear (GtkEntry *entry,
         gtk_entry_set_text (GTK_ENTRY (search->priv->entry), "");
 }
 
+static void
+ario_search_stream_cb (ArioServerFileList *batch,
+                       gboolean finished,
+                       ArioSearch *search)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (finished) {
+                search->priv->stream = NULL;
+                return;
+        }
+
+        /* Add retrieved songs to song list */
+        ario_songlist_append_songs (ARIO_SONGLIST (search->priv->searchs), batch->songs);
+}
+
 static gboolean
 ario_search_do_search (ArioSearch *search)
 {
         ARIO_LOG_FUNCTION_START;
         ArioServerAtomicCriteria *atomic_criteria;
         GSList *criteria = NULL;
-        GSList *tmp;
-        GSList *songs;
-        ArioServerSong *song;
-        GtkTreeIter iter;
-        gchar *title;
         GtkListStore *liststore;
         int i, j;
         gchar **cmp_str;
@@ -222,6 +261,8 @@ ario_search_do_search (ArioSearch *search)
         gchar **items;
         gint len;
 
+        search->priv->event_id = 0;
+
         /* Split on spaces to have multiple filters */
         cmp_str = g_strsplit (gtk_entry_get_text (GTK_ENTRY (search->priv->entry)), " ", -1);
         if (!cmp_str)
@@ -279,6 +320,10 @@ ario_search_do_search (ArioSearch *search)
         }
         g_strfreev (cmp_str);
 
+        /* Abort the previous search if it is still running */
+        ario_server_stream_cancel (search->priv->stream);
+        search->priv->stream = NULL;
+
         /* Clear song list */
         liststore = ario_songlist_get_liststore (ARIO_SONGLIST (search->priv->searchs));
         gtk_list_store_clear (liststore);
@@ -286,28 +331,12 @@ ario_search_do_search (ArioSearch *search)
         if (!criteria)
                 return FALSE;
 
-        /* Get songs corresponding to criteria */
-        songs = ario_server_get_songs (criteria, FALSE);
-
-        g_slist_foreach (criteria, (GFunc) g_free, NULL);
-        g_slist_free (criteria);
-
-        /* For each retrieved song */
-        for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
-                song = tmp->data;
-
-                /* Add song to song list */
-                gtk_list_store_append (liststore, &iter);
-                title = ario_util_format_title (song);
-                gtk_list_store_set (liststore, &iter,
-                                    SONGS_TITLE_COLUMN, title,
-                                    SONGS_ARTIST_COLUMN, song->artist,
-                                    SONGS_ALBUM_COLUMN, song->album,
-                                    SONGS_FILENAME_COLUMN, song->file,
-                                    -1);
-        }
-        g_slist_foreach (songs, (GFunc) ario_server_free_song, NULL);
-        g_slist_free (songs);
+        /* Get songs corresponding to criteria, they are added to the list as they arrive */
+        search->priv->stream = ario_server_get_songs_stream (criteria, FALSE,
+                                                             (ArioServerStreamFunc) ario_search_stream_cb,
+                                                             search);
+
+        ario_server_criteria_free (criteria);
 
         return FALSE;
 }
@@ -35,12 +35,22 @@ static void ario_tree_albums_build_tree (ArioTree *parent_tree,
                                          GtkTreeView *treeview);
 static void ario_tree_albums_fill_tree (ArioTree *parent_tree);
 static GdkPixbuf* ario_tree_albums_get_dnd_pixbuf (ArioTree *tree);
-static void ario_tree_albums_cover_changed_cb (ArioCoverHandler *cover_handler,
-                                               ArioTreeAlbums *tree);
+static void ario_tree_albums_album_cover_changed_cb (ArioCoverHandler *cover_handler,
+                                                     const gchar *artist,
+                                                     const gchar *album,
+                                                     ArioTreeAlbums *tree);
 static void ario_tree_albums_album_sort_changed_cb (guint notification_id,
                                                     ArioTreeAlbums *tree);
 static void ario_tree_albums_covertree_visible_changed_cb (guint notification_id,
                                                            ArioTree *tree);
+static void ario_tree_albums_cover_thread (gpointer data,
+                                           gpointer userdata);
+static gboolean ario_tree_albums_covers_apply (ArioTreeAlbums *tree);
+
+/* Number of threads decoding covers */
+#define COVER_THREADS 2
+/* Maximum number of covers queued in the threads at the same time */
+#define COVER_MAX_JOBS 8
 
 struct ArioTreeAlbumsPrivate
 {
@@ -48,8 +58,50 @@ struct ArioTreeAlbumsPrivate
 
         guint covertree_notif;
         guint sort_notif;
+
+        /* Transparent picture shared by albums without cover */
+        GdkPixbuf *blank_cover;
+
+        /* Threads decoding covers of the tree */
+        GThreadPool *cover_pool;
+        /* Decoded covers waiting to be shown in the tree */
+        GAsyncQueue *cover_results;
+        gint cover_results_scheduled;
+        /* Incremented each time the tree is filled to drop outdated covers */
+        gint generation;
+
+        /* Covers not yet sent to the threads, in tree order */
+        GQueue cover_pending;
+        /* Row (GtkTreeIter user_data) -> pending cover */
+        GHashTable *cover_pending_rows;
+        guint cover_jobs;
 };
 
+/* Cover to decode for a row of the tree */
+typedef struct ArioTreeAlbumsCoverJob
+{
+        gint generation;
+        /* Iters of a GtkListStore persist as long as the row exists */
+        GtkTreeIter iter;
+
+        gchar *artist;
+        gchar *album;
+
+        /* Decoded cover, NULL if there is none */
+        GdkPixbuf *cover;
+
+        /* Link in cover_pending */
+        GList *link;
+} ArioTreeAlbumsCoverJob;
+
+/* Album whose cover has changed */
+typedef struct ArioTreeAlbumsCoverData
+{
+        ArioTreeAlbums *tree;
+        const gchar *artist;
+        const gchar *album;
+} ArioTreeAlbumsCoverData;
+
 /* Tree view columns */
 enum
 {
@@ -129,6 +181,40 @@ ario_tree_albums_init (ArioTreeAlbums *tree)
 {
         ARIO_LOG_FUNCTION_START;
         tree->priv = ario_tree_albums_get_instance_private (tree);
+        tree->priv->blank_cover = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, COVER_SIZE, COVER_SIZE);
+        gdk_pixbuf_fill (tree->priv->blank_cover, 0);
+
+        tree->priv->cover_pool = g_thread_pool_new ((GFunc) ario_tree_albums_cover_thread,
+                                                    tree,
+                                                    COVER_THREADS,
+                                                    FALSE,
+                                                    NULL);
+        tree->priv->cover_results = g_async_queue_new ();
+        g_queue_init (&tree->priv->cover_pending);
+        tree->priv->cover_pending_rows = g_hash_table_new (g_direct_hash, g_direct_equal);
+}
+
+static void
+ario_tree_albums_cover_job_free (ArioTreeAlbumsCoverJob *job)
+{
+        g_free (job->artist);
+        g_free (job->album);
+        if (job->cover)
+                g_object_unref (job->cover);
+        g_free (job);
+}
+
+static void
+ario_tree_albums_covers_cancel (ArioTreeAlbums *tree)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Covers already sent to the threads are dropped when they come back */
+        g_atomic_int_inc (&tree->priv->generation);
+
+        /* Forget covers not yet sent to the threads */
+        g_hash_table_remove_all (tree->priv->cover_pending_rows);
+        g_queue_foreach (&tree->priv->cover_pending, (GFunc) ario_tree_albums_cover_job_free, NULL);
+        g_queue_clear (&tree->priv->cover_pending);
 }
 
 static gboolean
@@ -159,6 +245,13 @@ ario_tree_albums_finalize (GObject *object)
         tree = ARIO_TREE_ALBUMS (object);
 
         g_return_if_fail (tree->priv != NULL);
+        /* Stop covers decoding: no job is running as each one holds a
+         * reference on the tree */
+        ario_tree_albums_covers_cancel (tree);
+        g_thread_pool_free (tree->priv->cover_pool, TRUE, TRUE);
+        g_async_queue_unref (tree->priv->cover_results);
+        g_hash_table_destroy (tree->priv->cover_pending_rows);
+
         /* Remove notificqtions */
         if (tree->priv->covertree_notif)
                 ario_conf_notification_remove (tree->priv->covertree_notif);
@@ -171,6 +264,8 @@ ario_tree_albums_finalize (GObject *object)
                                 (GtkTreeModelForeachFunc) ario_tree_albums_album_free,
                                 tree);
 
+        g_object_unref (tree->priv->blank_cover);
+
         G_OBJECT_CLASS (ario_tree_albums_parent_class)->finalize (object);
 }
 
@@ -228,7 +323,7 @@ ario_tree_albums_build_tree (ArioTree *parent_tree,
 
         /* Connect signal to update covers when they change */
         g_signal_connect_object (ario_cover_handler_get_instance (),
-                                 "cover_changed", G_CALLBACK (ario_tree_albums_cover_changed_cb),
+                                 "album_cover_changed", G_CALLBACK (ario_tree_albums_album_cover_changed_cb),
                                  tree, 0);
 
         tree->priv->covertree_notif = ario_conf_notification_add (PREF_COVER_TREE_HIDDEN,
@@ -259,54 +354,67 @@ get_selected_albums_foreach (GtkTreeModel *model,
         *albums = g_slist_append (*albums, server_album);
 }
 
+static GdkPixbuf *
+ario_tree_albums_get_cover (ArioTreeAlbums *tree,
+                            ArioServerAlbum *album)
+{
+        ARIO_LOG_FUNCTION_START;
+        GdkPixbuf *cover;
+
+        /* The small cover exists, we show it */
+        cover = ario_cover_get_pixbuf (album->artist, album->album, SMALL_COVER, COVER_SIZE);
+
+        /* There is no cover, we show a transparent picture */
+        if (!cover)
+                cover = g_object_ref (tree->priv->blank_cover);
+
+        return cover;
+}
+
 static gboolean
 ario_tree_albums_covers_update (GtkTreeModel *model,
                                 GtkTreePath *path,
                                 GtkTreeIter *iter,
-                                gpointer userdata)
+                                ArioTreeAlbumsCoverData *data)
 {
         ARIO_LOG_FUNCTION_START;
-        ArioTreeAlbums *tree = ARIO_TREE_ALBUMS (userdata);
         ArioServerAlbum *album;
-        gchar *cover_path;
         GdkPixbuf *cover;
 
-        g_return_val_if_fail (IS_ARIO_TREE_ALBUMS (tree), FALSE);
-
         gtk_tree_model_get (model, iter, ALBUM_ALBUM_COLUMN, &album, -1);
 
-        /* Get cover path */
-        cover_path = ario_cover_make_cover_path (album->artist, album->album, SMALL_COVER);
-
-        /* The small cover exists, we show it */
-        cover = gdk_pixbuf_new_from_file_at_size (cover_path, COVER_SIZE, COVER_SIZE, NULL);
-        g_free (cover_path);
-
-        if (!GDK_IS_PIXBUF (cover)) {
-                /* There is no cover, we show a transparent picture */
-                cover = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, COVER_SIZE, COVER_SIZE);
-                gdk_pixbuf_fill (cover, 0);
-        }
+        /* Only the rows of the changed album are updated */
+        if (ario_util_strcmp (album->artist, data->artist)
+            || ario_util_strcmp (album->album, data->album))
+                return FALSE;
 
         /* Set cover in tree */
-        gtk_list_store_set (tree->parent.model, iter,
+        cover = ario_tree_albums_get_cover (data->tree, album);
+        gtk_list_store_set (data->tree->parent.model, iter,
                             ALBUM_COVER_COLUMN, cover,
                             -1);
-
-        g_object_unref (G_OBJECT (cover));
+        g_object_unref (cover);
 
         return FALSE;
 }
 
 static void
-ario_tree_albums_cover_changed_cb (ArioCoverHandler *cover_handler,
-                                   ArioTreeAlbums *tree)
+ario_tree_albums_album_cover_changed_cb (ArioCoverHandler *cover_handler,
+                                         const gchar *artist,
+                                         const gchar *album,
+                                         ArioTreeAlbums *tree)
 {
         ARIO_LOG_FUNCTION_START;
-        /* Update all covers */
+        ArioTreeAlbumsCoverData data;
+
+        data.tree = tree;
+        data.artist = artist;
+        data.album = album;
+
+        /* Update covers of the album */
         gtk_tree_model_foreach (GTK_TREE_MODEL (tree->parent.model),
                                 (GtkTreeModelForeachFunc) ario_tree_albums_covers_update,
-                                tree);
+                                &data);
 }
 
 static void
@@ -322,6 +430,107 @@ ario_tree_albums_album_sort_changed_cb (guint notification_id,
                                          NULL);
 }
 
+static void
+ario_tree_albums_cover_thread (gpointer data,
+                               gpointer userdata)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioTreeAlbumsCoverJob *job = data;
+        ArioTreeAlbums *tree = userdata;
+
+        /* Do not decode covers of a tree that has been filled again */
+        if (job->generation == g_atomic_int_get (&tree->priv->generation))
+                job->cover = ario_cover_get_pixbuf (job->artist, job->album, SMALL_COVER, COVER_SIZE);
+
+        /* Decoded covers are shown by batches in main loop */
+        g_async_queue_push (tree->priv->cover_results, job);
+        if (g_atomic_int_compare_and_exchange (&tree->priv->cover_results_scheduled, FALSE, TRUE))
+                g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                                 (GSourceFunc) ario_tree_albums_covers_apply,
+                                 g_object_ref (tree),
+                                 (GDestroyNotify) g_object_unref);
+}
+
+static void
+ario_tree_albums_covers_push (ArioTreeAlbums *tree,
+                              ArioTreeAlbumsCoverJob *job)
+{
+        ARIO_LOG_FUNCTION_START;
+        g_hash_table_remove (tree->priv->cover_pending_rows, job->iter.user_data);
+        g_queue_delete_link (&tree->priv->cover_pending, job->link);
+        job->link = NULL;
+
+        /* Keep the tree alive until the cover comes back in main loop */
+        g_object_ref (tree);
+        ++tree->priv->cover_jobs;
+        g_thread_pool_push (tree->priv->cover_pool, job, NULL);
+}
+
+static void
+ario_tree_albums_covers_feed (ArioTreeAlbums *tree)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkTreeModel *model = GTK_TREE_MODEL (tree->parent.model);
+        GtkTreePath *start, *end;
+        GtkTreeIter iter;
+        ArioTreeAlbumsCoverJob *job;
+        gint i, last;
+        gboolean valid;
+
+        if (tree->priv->cover_jobs >= COVER_MAX_JOBS
+            || g_queue_is_empty (&tree->priv->cover_pending))
+                return;
+
+        /* Decode covers of the visible rows first */
+        if (gtk_tree_view_get_visible_range (GTK_TREE_VIEW (tree->parent.tree), &start, &end)) {
+                i = gtk_tree_path_get_indices (start)[0];
+                last = gtk_tree_path_get_indices (end)[0];
+                for (valid = gtk_tree_model_get_iter (model, &iter, start);
+                     valid && i <= last && tree->priv->cover_jobs < COVER_MAX_JOBS;
+                     valid = gtk_tree_model_iter_next (model, &iter), ++i) {
+                        job = g_hash_table_lookup (tree->priv->cover_pending_rows, iter.user_data);
+                        if (job)
+                                ario_tree_albums_covers_push (tree, job);
+                }
+                gtk_tree_path_free (start);
+                gtk_tree_path_free (end);
+        }
+
+        /* Then the other ones in tree order */
+        while (tree->priv->cover_jobs < COVER_MAX_JOBS
+               && (job = g_queue_peek_head (&tree->priv->cover_pending)))
+                ario_tree_albums_covers_push (tree, job);
+}
+
+static gboolean
+ario_tree_albums_covers_apply (ArioTreeAlbums *tree)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioTreeAlbumsCoverJob *job;
+
+        /* Jobs pushed from now on schedule a new batch */
+        g_atomic_int_set (&tree->priv->cover_results_scheduled, FALSE);
+
+        while ((job = g_async_queue_try_pop (tree->priv->cover_results))) {
+                --tree->priv->cover_jobs;
+
+                /* Rows of an outdated generation do not exist anymore */
+                if (job->cover
+                    && job->generation == tree->priv->generation)
+                        gtk_list_store_set (tree->parent.model, &job->iter,
+                                            ALBUM_COVER_COLUMN, job->cover,
+                                            -1);
+                ario_tree_albums_cover_job_free (job);
+                /* Idle source still holds a reference on the tree */
+                g_object_unref (tree);
+        }
+
+        /* Send next covers to the threads */
+        ario_tree_albums_covers_feed (tree);
+
+        return FALSE;
+}
+
 static void
 ario_tree_albums_add_next_albums (ArioTreeAlbums *tree,
                                   const GSList *albums,
@@ -331,29 +540,18 @@ ario_tree_albums_add_next_albums (ArioTreeAlbums *tree,
         const GSList *tmp;
         ArioServerAlbum *server_album;
         GtkTreeIter album_iter;
-        gchar *cover_path;
         gchar *album;
         gchar *album_date;
-        GdkPixbuf *cover;
+        ArioTreeAlbumsCoverJob *job;
+        gboolean covers_visible;
+
+        covers_visible = !ario_conf_get_boolean (PREF_COVER_TREE_HIDDEN, PREF_COVER_TREE_HIDDEN_DEFAULT);
 
         /* For each album */
         for (tmp = albums; tmp; tmp = g_slist_next (tmp)) {
                 server_album = tmp->data;
                 album_date = NULL;
 
-                /* Get cover path */
-                cover_path = ario_cover_make_cover_path (server_album->artist, server_album->album, SMALL_COVER);
-
-                /* The small cover exists, we show it */
-                cover = gdk_pixbuf_new_from_file_at_size (cover_path, COVER_SIZE, COVER_SIZE, NULL);
-                g_free (cover_path);
-
-                if (!GDK_IS_PIXBUF (cover)) {
-                        /* There is no cover, we show a transparent picture */
-                        cover = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, COVER_SIZE, COVER_SIZE);
-                        gdk_pixbuf_fill (cover, 0);
-                }
-
                 /* Display date if any */
                 if (server_album->date) {
                         album_date = g_strdup_printf ("%s (%s)", server_album->album, server_album->date);
@@ -369,10 +567,23 @@ ario_tree_albums_add_next_albums (ArioTreeAlbums *tree,
                                     ALBUM_CRITERIA_COLUMN, criteria,
                                     ALBUM_TEXT_COLUMN, album,
                                     ALBUM_ALBUM_COLUMN, server_album,
-                                    ALBUM_COVER_COLUMN, cover,
+                                    ALBUM_COVER_COLUMN, tree->priv->blank_cover,
                                     -1);
-                g_object_unref (cover);
                 g_free (album_date);
+
+                /* Cover is decoded later by the threads */
+                if (covers_visible
+                    && server_album->artist
+                    && server_album->album) {
+                        job = (ArioTreeAlbumsCoverJob *) g_malloc0 (sizeof (ArioTreeAlbumsCoverJob));
+                        job->generation = tree->priv->generation;
+                        job->iter = album_iter;
+                        job->artist = g_strdup (server_album->artist);
+                        job->album = g_strdup (server_album->album);
+                        g_queue_push_tail (&tree->priv->cover_pending, job);
+                        job->link = tree->priv->cover_pending.tail;
+                        g_hash_table_insert (tree->priv->cover_pending_rows, album_iter.user_data, job);
+                }
         }
 }
 
@@ -386,6 +597,9 @@ ario_tree_albums_fill_tree (ArioTree *parent_tree)
         g_return_if_fail (IS_ARIO_TREE_ALBUMS (parent_tree));
         tree = ARIO_TREE_ALBUMS (parent_tree);
 
+        /* Covers of previous rows are not needed anymore */
+        ario_tree_albums_covers_cancel (tree);
+
         /* Free tree data */
         gtk_tree_model_foreach (GTK_TREE_MODEL (tree->parent.model),
                                 (GtkTreeModelForeachFunc) ario_tree_albums_album_free,
@@ -401,6 +615,9 @@ ario_tree_albums_fill_tree (ArioTree *parent_tree)
                 ario_tree_albums_add_next_albums (tree, albums, tmp->data);
                 g_slist_free (albums);
         }
+
+        /* Start decoding covers */
+        ario_tree_albums_covers_feed (tree);
 }
 
 static GdkPixbuf*
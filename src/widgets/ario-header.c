@@ -29,6 +29,7 @@
 #include "covers/ario-cover-handler.h"
 #include "covers/ario-cover-handler.h"
 #include "shell/ario-shell-coverselect.h"
+#include "widgets/ario-playlist.h"
 #include "widgets/ario-volume.h"
 
 static GObject* ario_header_constructor (GType type, guint n_construct_properties,
@@ -50,6 +51,8 @@ static void ario_header_album_changed_cb (ArioServer *server,
                                           ArioHeader *header);
 static void ario_header_state_changed_cb (ArioServer *server,
                                           ArioHeader *header);
+static void ario_header_playlist_changed_cb (ArioServer *server,
+                                             ArioHeader *header);
 static void ario_header_cover_changed_cb (ArioCoverHandler *cover_handler,
                                           ArioHeader *header);
 static void ario_header_elapsed_changed_cb (ArioServer *server,
@@ -423,6 +426,10 @@ ario_header_new (void)
         g_signal_connect_object (server,
                                  "elapsed_changed", G_CALLBACK (ario_header_elapsed_changed_cb),
                                  header, 0);
+        /* After the playlist has updated its statistics */
+        g_signal_connect_object (server,
+                                 "playlist_changed", G_CALLBACK (ario_header_playlist_changed_cb),
+                                 header, G_CONNECT_AFTER);
         g_signal_connect_object (server,
                                  "consume_changed", G_CALLBACK (ario_header_consume_changed_cb),
                                  header, 0);
@@ -436,6 +443,31 @@ ario_header_new (void)
         return GTK_WIDGET (header);
 }
 
+static void
+ario_header_change_playlist_time (ArioHeader *header,
+                                  const int total_time)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistStats stats;
+        char *before, *after, *tmp;
+
+        /* Nothing is played */
+        if (total_time <= 0) {
+                gtk_widget_set_tooltip_text (header->priv->scale, NULL);
+                return;
+        }
+
+        /* Show the time of the playlist around the current song */
+        ario_playlist_get_stats (&stats);
+        before = ario_util_format_total_time (stats.time_before);
+        after = ario_util_format_total_time (stats.time_after);
+        tmp = g_strdup_printf (_("Playlist: %s before, %s after"), before, after);
+        gtk_widget_set_tooltip_text (header->priv->scale, tmp);
+        g_free (tmp);
+        g_free (after);
+        g_free (before);
+}
+
 static void
 ario_header_change_total_time (ArioHeader *header)
 {
@@ -475,6 +507,8 @@ ario_header_change_total_time (ArioHeader *header)
 
         /* Change slider higher value */
         gtk_adjustment_set_upper (header->priv->adjustment, total_time);
+
+        ario_header_change_playlist_time (header, total_time);
 }
 
 static void
@@ -582,6 +616,16 @@ ario_header_song_changed_cb (ArioServer *server,
         ario_header_change_total_time (header);
 }
 
+static void
+ario_header_playlist_changed_cb (ArioServer *server,
+                                 ArioHeader *header)
+{
+        ARIO_LOG_FUNCTION_START;
+        /* Synchronize playlist time */
+        ario_header_change_playlist_time (header,
+                                          (int) gtk_adjustment_get_upper (header->priv->adjustment));
+}
+
 static void
 ario_header_album_changed_cb (ArioServer *server,
                               ArioHeader *header)
@@ -0,0 +1,1163 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "widgets/ario-playlist-model.h"
+#include <string.h>
+#include <stdlib.h>
+
+#include "ario-util.h"
+#include "ario-debug.h"
+
+#define ARIO_PLAYLIST_MODEL_MIN_SIZE 256
+
+static void ario_playlist_model_tree_model_init (GtkTreeModelIface *iface);
+static void ario_playlist_model_sortable_init (GtkTreeSortableIface *iface);
+static void ario_playlist_model_finalize (GObject *object);
+
+struct ArioPlaylistModelPrivate
+{
+        gint stamp;
+
+        /* Number of rows and allocated size of each array */
+        gint length;
+        gint size;
+
+        /* One array per song field. Files and titles belong to the
+         * model, other strings are interned */
+        gchar **files;
+        gchar **titles;
+        const gchar **tracks;
+        const gchar **artists;
+        const gchar **albums;
+        const gchar **genres;
+        const gchar **dates;
+        const gchar **discs;
+        gint *ids;
+        gint *times;
+
+        /* Running sums of times: total time of the rows and time of
+         * the rows before stats_row, kept up to date on each change */
+        gint total_time;
+        gint stats_row;
+        gint time_before;
+
+        /* Row showing the 'playing' pixbuf */
+        gint playing;
+        GdkPixbuf *play_pixbuf;
+
+        gint sort_column_id;
+        GtkSortType order;
+
+        /* Filter: casefolded words that must all be found in the
+         * searched columns of a row (NULL if there is no filter) */
+        gchar **needles;
+        gsize *needle_lengths;
+        guint filter_columns;
+        /* Casefolded searched columns of each row, computed when the
+         * row is first filtered */
+        gchar **haystacks;
+        /* Result of the filter for each row */
+        guint8 *matches;
+        /* Interned value -> casefolded value */
+        GHashTable *folded_values;
+};
+
+/* Result of the filter for a row */
+enum
+{
+        MATCH_UNKNOWN,
+        MATCH_NO,
+        MATCH_YES
+};
+
+/* Data used to sort the rows */
+typedef struct
+{
+        /* Collation keys of string columns */
+        const gchar **keys;
+
+        /* Values of integer columns */
+        const gint *values;
+
+        GtkSortType order;
+} ArioPlaylistModelSortData;
+
+G_DEFINE_TYPE_WITH_CODE (ArioPlaylistModel, ario_playlist_model, G_TYPE_OBJECT,
+                         G_ADD_PRIVATE (ArioPlaylistModel)
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+                                                ario_playlist_model_tree_model_init)
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_SORTABLE,
+                                                ario_playlist_model_sortable_init))
+
+static void
+ario_playlist_model_class_init (ArioPlaylistModelClass *klass)
+{
+        ARIO_LOG_FUNCTION_START;
+        GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+        /* Virtual methods */
+        object_class->finalize = ario_playlist_model_finalize;
+}
+
+static void
+ario_playlist_model_init (ArioPlaylistModel *model)
+{
+        ARIO_LOG_FUNCTION_START;
+        model->priv = ario_playlist_model_get_instance_private (model);
+        model->priv->stamp = g_random_int ();
+        model->priv->playing = -1;
+        model->priv->sort_column_id = GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID;
+        model->priv->order = GTK_SORT_ASCENDING;
+}
+
+static void
+ario_playlist_model_free_row (ArioPlaylistModel *model,
+                              const gint row)
+{
+        g_free (model->priv->files[row]);
+        g_free (model->priv->titles[row]);
+        g_free (model->priv->haystacks[row]);
+        model->priv->haystacks[row] = NULL;
+        model->priv->matches[row] = MATCH_UNKNOWN;
+}
+
+static void
+ario_playlist_model_finalize (GObject *object)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistModel *model;
+        gint i;
+
+        g_return_if_fail (object != NULL);
+        g_return_if_fail (IS_ARIO_PLAYLIST_MODEL (object));
+
+        model = ARIO_PLAYLIST_MODEL (object);
+
+        g_return_if_fail (model->priv != NULL);
+
+        for (i = 0; i < model->priv->length; ++i)
+                ario_playlist_model_free_row (model, i);
+
+        g_free (model->priv->files);
+        g_free (model->priv->titles);
+        g_free (model->priv->tracks);
+        g_free (model->priv->artists);
+        g_free (model->priv->albums);
+        g_free (model->priv->genres);
+        g_free (model->priv->dates);
+        g_free (model->priv->discs);
+        g_free (model->priv->ids);
+        g_free (model->priv->times);
+        g_free (model->priv->haystacks);
+        g_free (model->priv->matches);
+
+        g_strfreev (model->priv->needles);
+        g_free (model->priv->needle_lengths);
+        if (model->priv->folded_values)
+                g_hash_table_destroy (model->priv->folded_values);
+
+        if (model->priv->play_pixbuf)
+                g_object_unref (model->priv->play_pixbuf);
+
+        G_OBJECT_CLASS (ario_playlist_model_parent_class)->finalize (object);
+}
+
+ArioPlaylistModel *
+ario_playlist_model_new (GdkPixbuf *play_pixbuf)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistModel *model;
+
+        model = g_object_new (TYPE_ARIO_PLAYLIST_MODEL, NULL);
+        if (play_pixbuf)
+                model->priv->play_pixbuf = g_object_ref (play_pixbuf);
+
+        return model;
+}
+
+static gboolean
+ario_playlist_model_iter_is_valid (ArioPlaylistModel *model,
+                                   GtkTreeIter *iter)
+{
+        return iter
+                && iter->stamp == model->priv->stamp
+                && GPOINTER_TO_INT (iter->user_data) < model->priv->length;
+}
+
+static void
+ario_playlist_model_set_iter (ArioPlaylistModel *model,
+                              GtkTreeIter *iter,
+                              const gint row)
+{
+        iter->stamp = model->priv->stamp;
+        iter->user_data = GINT_TO_POINTER (row);
+        iter->user_data2 = NULL;
+        iter->user_data3 = NULL;
+}
+
+static const gchar *
+ario_playlist_model_get_string (ArioPlaylistModel *model,
+                                const gint column,
+                                const gint row)
+{
+        switch (column) {
+        case TITLE_COLUMN:
+                return model->priv->titles[row];
+        case ARTIST_COLUMN:
+                return model->priv->artists[row];
+        case ALBUM_COLUMN:
+                return model->priv->albums[row] ? model->priv->albums[row] : ARIO_SERVER_UNKNOWN;
+        case FILE_COLUMN:
+                return model->priv->files[row];
+        case GENRE_COLUMN:
+                return model->priv->genres[row];
+        case DATE_COLUMN:
+                return model->priv->dates[row];
+        case DISC_COLUMN:
+                return model->priv->discs[row];
+        default:
+                return NULL;
+        }
+}
+
+static GtkTreeModelFlags
+ario_playlist_model_get_flags (GtkTreeModel *tree_model)
+{
+        return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+ario_playlist_model_get_n_columns (GtkTreeModel *tree_model)
+{
+        return N_COLUMN;
+}
+
+static GType
+ario_playlist_model_get_column_type (GtkTreeModel *tree_model,
+                                     gint index)
+{
+        switch (index) {
+        case PIXBUF_COLUMN:
+                return GDK_TYPE_PIXBUF;
+        case ID_COLUMN:
+        case TIME_COLUMN:
+                return G_TYPE_INT;
+        default:
+                return G_TYPE_STRING;
+        }
+}
+
+static gboolean
+ario_playlist_model_get_iter (GtkTreeModel *tree_model,
+                              GtkTreeIter *iter,
+                              GtkTreePath *path)
+{
+        ArioPlaylistModel *model = ARIO_PLAYLIST_MODEL (tree_model);
+        gint row;
+
+        if (gtk_tree_path_get_depth (path) != 1)
+                return FALSE;
+
+        row = gtk_tree_path_get_indices (path)[0];
+        if (row < 0 || row >= model->priv->length)
+                return FALSE;
+
+        ario_playlist_model_set_iter (model, iter, row);
+
+        return TRUE;
+}
+
+static GtkTreePath *
+ario_playlist_model_get_path (GtkTreeModel *tree_model,
+                              GtkTreeIter *iter)
+{
+        ArioPlaylistModel *model = ARIO_PLAYLIST_MODEL (tree_model);
+
+        g_return_val_if_fail (ario_playlist_model_iter_is_valid (model, iter), NULL);
+
+        return gtk_tree_path_new_from_indices (GPOINTER_TO_INT (iter->user_data), -1);
+}
+
+static void
+ario_playlist_model_get_value (GtkTreeModel *tree_model,
+                               GtkTreeIter *iter,
+                               gint column,
+                               GValue *value)
+{
+        ArioPlaylistModel *model = ARIO_PLAYLIST_MODEL (tree_model);
+        gchar buf[ARIO_MAX_TIME_SIZE];
+        gint row;
+
+        g_return_if_fail (ario_playlist_model_iter_is_valid (model, iter));
+
+        row = GPOINTER_TO_INT (iter->user_data);
+        g_value_init (value, ario_playlist_model_get_column_type (tree_model, column));
+
+        /* Cells are formatted here, only when they are displayed */
+        switch (column) {
+        case PIXBUF_COLUMN:
+                if (row == model->priv->playing)
+                        g_value_set_object (value, model->priv->play_pixbuf);
+                break;
+        case TRACK_COLUMN:
+                ario_util_format_track_buf (model->priv->tracks[row], buf, ARIO_MAX_TRACK_SIZE);
+                g_value_set_string (value, buf);
+                break;
+        case DURATION_COLUMN:
+                ario_util_format_time_buf (model->priv->times[row], buf, ARIO_MAX_TIME_SIZE);
+                g_value_set_string (value, buf);
+                break;
+        case TITLE_COLUMN:
+        case FILE_COLUMN:
+                g_value_set_string (value, ario_playlist_model_get_string (model, column, row));
+                break;
+        case ID_COLUMN:
+                g_value_set_int (value, model->priv->ids[row]);
+                break;
+        case TIME_COLUMN:
+                g_value_set_int (value, model->priv->times[row]);
+                break;
+        default:
+                /* Interned strings are never freed */
+                g_value_set_static_string (value, ario_playlist_model_get_string (model, column, row));
+                break;
+        }
+}
+
+static gboolean
+ario_playlist_model_iter_next (GtkTreeModel *tree_model,
+                               GtkTreeIter *iter)
+{
+        ArioPlaylistModel *model = ARIO_PLAYLIST_MODEL (tree_model);
+        gint row;
+
+        g_return_val_if_fail (ario_playlist_model_iter_is_valid (model, iter), FALSE);
+
+        row = GPOINTER_TO_INT (iter->user_data) + 1;
+        if (row >= model->priv->length) {
+                iter->stamp = 0;
+                return FALSE;
+        }
+        iter->user_data = GINT_TO_POINTER (row);
+
+        return TRUE;
+}
+
+static gboolean
+ario_playlist_model_iter_nth_child (GtkTreeModel *tree_model,
+                                    GtkTreeIter *iter,
+                                    GtkTreeIter *parent,
+                                    gint n)
+{
+        ArioPlaylistModel *model = ARIO_PLAYLIST_MODEL (tree_model);
+
+        /* Rows have no children */
+        if (parent || n < 0 || n >= model->priv->length) {
+                iter->stamp = 0;
+                return FALSE;
+        }
+
+        ario_playlist_model_set_iter (model, iter, n);
+
+        return TRUE;
+}
+
+static gboolean
+ario_playlist_model_iter_children (GtkTreeModel *tree_model,
+                                   GtkTreeIter *iter,
+                                   GtkTreeIter *parent)
+{
+        return ario_playlist_model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+static gboolean
+ario_playlist_model_iter_has_child (GtkTreeModel *tree_model,
+                                    GtkTreeIter *iter)
+{
+        return FALSE;
+}
+
+static gint
+ario_playlist_model_iter_n_children (GtkTreeModel *tree_model,
+                                     GtkTreeIter *iter)
+{
+        ArioPlaylistModel *model = ARIO_PLAYLIST_MODEL (tree_model);
+
+        if (iter)
+                return 0;
+
+        return model->priv->length;
+}
+
+static gboolean
+ario_playlist_model_iter_parent (GtkTreeModel *tree_model,
+                                 GtkTreeIter *iter,
+                                 GtkTreeIter *child)
+{
+        iter->stamp = 0;
+        return FALSE;
+}
+
+static void
+ario_playlist_model_tree_model_init (GtkTreeModelIface *iface)
+{
+        iface->get_flags = ario_playlist_model_get_flags;
+        iface->get_n_columns = ario_playlist_model_get_n_columns;
+        iface->get_column_type = ario_playlist_model_get_column_type;
+        iface->get_iter = ario_playlist_model_get_iter;
+        iface->get_path = ario_playlist_model_get_path;
+        iface->get_value = ario_playlist_model_get_value;
+        iface->iter_next = ario_playlist_model_iter_next;
+        iface->iter_children = ario_playlist_model_iter_children;
+        iface->iter_has_child = ario_playlist_model_iter_has_child;
+        iface->iter_n_children = ario_playlist_model_iter_n_children;
+        iface->iter_nth_child = ario_playlist_model_iter_nth_child;
+        iface->iter_parent = ario_playlist_model_iter_parent;
+}
+
+static gint
+ario_playlist_model_compare_rows (gconstpointer a,
+                                  gconstpointer b,
+                                  gpointer user_data)
+{
+        ArioPlaylistModelSortData *data = user_data;
+        gint row_a = *((const gint *) a);
+        gint row_b = *((const gint *) b);
+        gint ret;
+
+        if (data->values) {
+                ret = (data->values[row_a] > data->values[row_b]) - (data->values[row_a] < data->values[row_b]);
+        } else if (!data->keys[row_a] || !data->keys[row_b]) {
+                /* Empty values first */
+                ret = (data->keys[row_a] != NULL) - (data->keys[row_b] != NULL);
+        } else {
+                ret = strcmp (data->keys[row_a], data->keys[row_b]);
+        }
+
+        return data->order == GTK_SORT_DESCENDING ? -ret : ret;
+}
+
+static void
+ario_playlist_model_permute (gpointer array,
+                             const gsize element_size,
+                             const gint *new_order,
+                             const gint length)
+{
+        guchar *tmp;
+        gint i;
+
+        tmp = g_malloc (element_size * length);
+        for (i = 0; i < length; ++i)
+                memcpy (tmp + i * element_size,
+                        (guchar *) array + new_order[i] * element_size,
+                        element_size);
+        memcpy (array, tmp, element_size * length);
+        g_free (tmp);
+}
+
+static void
+ario_playlist_model_sort (ArioPlaylistModel *model)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistModelSortData data;
+        GHashTable *collate_keys = NULL;
+        const gchar *value;
+        gchar *key;
+        gint *new_order, *tracks = NULL;
+        GtkTreePath *path;
+        gint i, length = model->priv->length;
+
+        /* The default order is the order of the playlist on the server:
+         * there is nothing to sort */
+        if (model->priv->sort_column_id < 0 || length < 2)
+                return;
+
+        data.keys = NULL;
+        data.values = NULL;
+        data.order = model->priv->order;
+
+        switch (model->priv->sort_column_id) {
+        case TRACK_COLUMN:
+                tracks = g_new (gint, length);
+                for (i = 0; i < length; ++i)
+                        tracks[i] = model->priv->tracks[i] ? atoi (model->priv->tracks[i]) : 0;
+                data.values = tracks;
+                break;
+        case DURATION_COLUMN:
+        case TIME_COLUMN:
+                data.values = model->priv->times;
+                break;
+        case ID_COLUMN:
+                data.values = model->priv->ids;
+                break;
+        case PIXBUF_COLUMN:
+                return;
+        default:
+                /* Compute each collation key only once: interned values
+                 * are shared by many rows */
+                collate_keys = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+                data.keys = g_new (const gchar *, length);
+                for (i = 0; i < length; ++i) {
+                        value = ario_playlist_model_get_string (model, model->priv->sort_column_id, i);
+                        if (!value) {
+                                data.keys[i] = NULL;
+                                continue;
+                        }
+                        key = g_hash_table_lookup (collate_keys, value);
+                        if (!key) {
+                                key = g_utf8_collate_key (value, -1);
+                                g_hash_table_insert (collate_keys, (gpointer) value, key);
+                        }
+                        data.keys[i] = key;
+                }
+                break;
+        }
+
+        new_order = g_new (gint, length);
+        for (i = 0; i < length; ++i)
+                new_order[i] = i;
+
+        /* Stable sort */
+        g_qsort_with_data (new_order, length, sizeof (gint),
+                           ario_playlist_model_compare_rows, &data);
+
+        g_free (tracks);
+        g_free ((gpointer) data.keys);
+        if (collate_keys)
+                g_hash_table_destroy (collate_keys);
+
+        /* Move every field of the rows */
+        ario_playlist_model_permute (model->priv->files, sizeof (gchar *), new_order, length);
+        ario_playlist_model_permute (model->priv->titles, sizeof (gchar *), new_order, length);
+        ario_playlist_model_permute (model->priv->tracks, sizeof (gchar *), new_order, length);
+        ario_playlist_model_permute (model->priv->artists, sizeof (gchar *), new_order, length);
+        ario_playlist_model_permute (model->priv->albums, sizeof (gchar *), new_order, length);
+        ario_playlist_model_permute (model->priv->genres, sizeof (gchar *), new_order, length);
+        ario_playlist_model_permute (model->priv->dates, sizeof (gchar *), new_order, length);
+        ario_playlist_model_permute (model->priv->discs, sizeof (gchar *), new_order, length);
+        ario_playlist_model_permute (model->priv->ids, sizeof (gint), new_order, length);
+        ario_playlist_model_permute (model->priv->times, sizeof (gint), new_order, length);
+        ario_playlist_model_permute (model->priv->haystacks, sizeof (gchar *), new_order, length);
+        ario_playlist_model_permute (model->priv->matches, sizeof (guint8), new_order, length);
+
+        /* The 'playing' pixbuf follows its row */
+        for (i = 0; i < length; ++i) {
+                if (new_order[i] == model->priv->playing) {
+                        model->priv->playing = i;
+                        break;
+                }
+        }
+
+        /* Rows before stats_row are not the same anymore */
+        model->priv->stats_row = 0;
+        model->priv->time_before = 0;
+
+        ++model->priv->stamp;
+        path = gtk_tree_path_new ();
+        gtk_tree_model_rows_reordered (GTK_TREE_MODEL (model), path, NULL, new_order);
+        gtk_tree_path_free (path);
+
+        g_free (new_order);
+}
+
+static gboolean
+ario_playlist_model_get_sort_column_id (GtkTreeSortable *sortable,
+                                        gint *sort_column_id,
+                                        GtkSortType *order)
+{
+        ArioPlaylistModel *model = ARIO_PLAYLIST_MODEL (sortable);
+
+        if (sort_column_id)
+                *sort_column_id = model->priv->sort_column_id;
+        if (order)
+                *order = model->priv->order;
+
+        return model->priv->sort_column_id != GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID
+                && model->priv->sort_column_id != GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID;
+}
+
+static void
+ario_playlist_model_set_sort_column_id (GtkTreeSortable *sortable,
+                                        gint sort_column_id,
+                                        GtkSortType order)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioPlaylistModel *model = ARIO_PLAYLIST_MODEL (sortable);
+
+        if (model->priv->sort_column_id == sort_column_id
+            && model->priv->order == order)
+                return;
+
+        model->priv->sort_column_id = sort_column_id;
+        model->priv->order = order;
+
+        gtk_tree_sortable_sort_column_changed (sortable);
+
+        ario_playlist_model_sort (model);
+}
+
+static gboolean
+ario_playlist_model_has_default_sort_func (GtkTreeSortable *sortable)
+{
+        /* The default sort keeps the playlist order */
+        return TRUE;
+}
+
+static void
+ario_playlist_model_sortable_init (GtkTreeSortableIface *iface)
+{
+        iface->get_sort_column_id = ario_playlist_model_get_sort_column_id;
+        iface->set_sort_column_id = ario_playlist_model_set_sort_column_id;
+        iface->has_default_sort_func = ario_playlist_model_has_default_sort_func;
+}
+
+static void
+ario_playlist_model_grow (ArioPlaylistModel *model)
+{
+        ARIO_LOG_FUNCTION_START;
+        gint size = MAX (ARIO_PLAYLIST_MODEL_MIN_SIZE, 2 * model->priv->size);
+
+        model->priv->files = g_renew (gchar *, model->priv->files, size);
+        model->priv->titles = g_renew (gchar *, model->priv->titles, size);
+        model->priv->tracks = g_renew (const gchar *, model->priv->tracks, size);
+        model->priv->artists = g_renew (const gchar *, model->priv->artists, size);
+        model->priv->albums = g_renew (const gchar *, model->priv->albums, size);
+        model->priv->genres = g_renew (const gchar *, model->priv->genres, size);
+        model->priv->dates = g_renew (const gchar *, model->priv->dates, size);
+        model->priv->discs = g_renew (const gchar *, model->priv->discs, size);
+        model->priv->ids = g_renew (gint, model->priv->ids, size);
+        model->priv->times = g_renew (gint, model->priv->times, size);
+        model->priv->haystacks = g_renew (gchar *, model->priv->haystacks, size);
+        model->priv->matches = g_renew (guint8, model->priv->matches, size);
+        model->priv->size = size;
+}
+
+void
+ario_playlist_model_set_song (ArioPlaylistModel *model,
+                              ArioServerSong *song)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkTreeIter iter;
+        GtkTreePath *path;
+        gint row;
+        gboolean insert;
+
+        insert = (song->pos < 0 || song->pos >= model->priv->length);
+        if (insert) {
+                if (model->priv->length == model->priv->size)
+                        ario_playlist_model_grow (model);
+                row = model->priv->length;
+                model->priv->haystacks[row] = NULL;
+                model->priv->matches[row] = MATCH_UNKNOWN;
+        } else {
+                row = song->pos;
+                ario_playlist_model_free_row (model, row);
+                model->priv->total_time -= model->priv->times[row];
+                if (row < model->priv->stats_row)
+                        model->priv->time_before -= model->priv->times[row];
+        }
+
+        /* Only the title is formatted in advance as it is also used
+         * to filter the playlist */
+        model->priv->titles[row] = g_strdup (ario_util_format_title (song));
+        model->priv->files[row] = g_strdup (song->file);
+        model->priv->tracks[row] = ario_server_intern (song->track);
+        model->priv->artists[row] = song->artist;
+        model->priv->albums[row] = song->album;
+        model->priv->genres[row] = song->genre;
+        model->priv->dates[row] = song->date;
+        model->priv->discs[row] = ario_server_intern (song->disc);
+        model->priv->ids[row] = song->id;
+        model->priv->times[row] = song->time;
+
+        model->priv->total_time += song->time;
+        if (row < model->priv->stats_row)
+                model->priv->time_before += song->time;
+
+        if (insert)
+                ++model->priv->length;
+
+        ario_playlist_model_set_iter (model, &iter, row);
+        path = gtk_tree_path_new_from_indices (row, -1);
+        if (insert)
+                gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+        else
+                gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+        gtk_tree_path_free (path);
+}
+
+void
+ario_playlist_model_truncate (ArioPlaylistModel *model,
+                              const gint length)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkTreePath *path;
+
+        if (length >= model->priv->length)
+                return;
+
+        if (model->priv->playing >= length)
+                model->priv->playing = -1;
+
+        /* Remove rows starting from the end */
+        path = gtk_tree_path_new_from_indices (model->priv->length, -1);
+        while (model->priv->length > MAX (length, 0)) {
+                --model->priv->length;
+                ario_playlist_model_free_row (model, model->priv->length);
+                model->priv->total_time -= model->priv->times[model->priv->length];
+                if (model->priv->length < model->priv->stats_row) {
+                        model->priv->time_before -= model->priv->times[model->priv->length];
+                        model->priv->stats_row = model->priv->length;
+                }
+                gtk_tree_path_prev (path);
+                gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+        }
+        gtk_tree_path_free (path);
+
+        ++model->priv->stamp;
+}
+
+static void
+ario_playlist_model_shift (ArioPlaylistModel *model,
+                           const gint dest,
+                           const gint src,
+                           const gint n)
+{
+        if (n <= 0 || dest == src)
+                return;
+
+        /* Move n rows without copying their strings */
+        memmove (model->priv->files + dest, model->priv->files + src, n * sizeof (gchar *));
+        memmove (model->priv->titles + dest, model->priv->titles + src, n * sizeof (gchar *));
+        memmove (model->priv->tracks + dest, model->priv->tracks + src, n * sizeof (gchar *));
+        memmove (model->priv->artists + dest, model->priv->artists + src, n * sizeof (gchar *));
+        memmove (model->priv->albums + dest, model->priv->albums + src, n * sizeof (gchar *));
+        memmove (model->priv->genres + dest, model->priv->genres + src, n * sizeof (gchar *));
+        memmove (model->priv->dates + dest, model->priv->dates + src, n * sizeof (gchar *));
+        memmove (model->priv->discs + dest, model->priv->discs + src, n * sizeof (gchar *));
+        memmove (model->priv->ids + dest, model->priv->ids + src, n * sizeof (gint));
+        memmove (model->priv->times + dest, model->priv->times + src, n * sizeof (gint));
+        memmove (model->priv->haystacks + dest, model->priv->haystacks + src, n * sizeof (gchar *));
+        memmove (model->priv->matches + dest, model->priv->matches + src, n * sizeof (guint8));
+}
+
+static void
+ario_playlist_model_rows_changed_from (ArioPlaylistModel *model,
+                                       const gint row)
+{
+        /* Running sums of the rows before stats_row are not valid anymore */
+        if (row < model->priv->stats_row) {
+                model->priv->stats_row = 0;
+                model->priv->time_before = 0;
+        }
+
+        ++model->priv->stamp;
+}
+
+void
+ario_playlist_model_remove_rows (ArioPlaylistModel *model,
+                                 const gint *rows,
+                                 const gint n_rows)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkTreePath *path;
+        gint i, dest, end;
+        gint playing = model->priv->playing;
+
+        if (n_rows <= 0)
+                return;
+
+        for (i = 0; i < n_rows; ++i) {
+                ario_playlist_model_free_row (model, rows[i]);
+                model->priv->total_time -= model->priv->times[rows[i]];
+
+                /* The 'playing' pixbuf follows its row */
+                if (rows[i] == model->priv->playing)
+                        playing = -1;
+                else if (rows[i] < model->priv->playing && playing >= 0)
+                        --playing;
+        }
+        model->priv->playing = playing;
+
+        /* Move each run of kept rows once */
+        dest = rows[0];
+        for (i = 0; i < n_rows; ++i) {
+                end = (i + 1 < n_rows) ? rows[i + 1] : model->priv->length;
+                ario_playlist_model_shift (model, dest, rows[i] + 1, end - rows[i] - 1);
+                dest += end - rows[i] - 1;
+        }
+
+        ario_playlist_model_rows_changed_from (model, rows[0]);
+
+        /* Notify the removals starting from the end so that the paths
+         * of the other removed rows stay valid */
+        for (i = n_rows - 1; i >= 0; --i) {
+                --model->priv->length;
+                path = gtk_tree_path_new_from_indices (rows[i], -1);
+                gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+                gtk_tree_path_free (path);
+        }
+}
+
+void
+ario_playlist_model_move_row (ArioPlaylistModel *model,
+                              const gint from,
+                              const gint to)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkTreeIter iter;
+        GtkTreePath *path;
+        gint spare;
+
+        if (from == to
+            || from < 0 || from >= model->priv->length
+            || to < 0 || to >= model->priv->length)
+                return;
+
+        /* Keep the moved row in the spare row after the last one */
+        if (model->priv->length == model->priv->size)
+                ario_playlist_model_grow (model);
+        spare = model->priv->length;
+
+        ario_playlist_model_shift (model, spare, from, 1);
+        if (from < to)
+                ario_playlist_model_shift (model, from, from + 1, to - from);
+        else
+                ario_playlist_model_shift (model, to + 1, to, from - to);
+        ario_playlist_model_shift (model, to, spare, 1);
+
+        /* The 'playing' pixbuf follows its row */
+        if (model->priv->playing == from)
+                model->priv->playing = to;
+        else if (from < model->priv->playing && model->priv->playing <= to)
+                --model->priv->playing;
+        else if (to <= model->priv->playing && model->priv->playing < from)
+                ++model->priv->playing;
+
+        ario_playlist_model_rows_changed_from (model, MIN (from, to));
+
+        /* Notify the move as a removal followed by an insertion */
+        --model->priv->length;
+        path = gtk_tree_path_new_from_indices (from, -1);
+        gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+        gtk_tree_path_free (path);
+
+        ++model->priv->length;
+        ario_playlist_model_set_iter (model, &iter, to);
+        path = gtk_tree_path_new_from_indices (to, -1);
+        gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+        gtk_tree_path_free (path);
+}
+
+void
+ario_playlist_model_copy_row (ArioPlaylistModel *model,
+                              const gint from,
+                              const gint to)
+{
+        ARIO_LOG_FUNCTION_START;
+        GtkTreeIter iter;
+        GtkTreePath *path;
+        gint src;
+
+        if (from < 0 || from >= model->priv->length
+            || to < 0 || to > model->priv->length)
+                return;
+
+        if (model->priv->length == model->priv->size)
+                ario_playlist_model_grow (model);
+
+        /* Make room for the new row */
+        ario_playlist_model_shift (model, to + 1, to, model->priv->length - to);
+        src = (from >= to) ? from + 1 : from;
+
+        model->priv->files[to] = g_strdup (model->priv->files[src]);
+        model->priv->titles[to] = g_strdup (model->priv->titles[src]);
+        model->priv->tracks[to] = model->priv->tracks[src];
+        model->priv->artists[to] = model->priv->artists[src];
+        model->priv->albums[to] = model->priv->albums[src];
+        model->priv->genres[to] = model->priv->genres[src];
+        model->priv->dates[to] = model->priv->dates[src];
+        model->priv->discs[to] = model->priv->discs[src];
+        /* The server gives its id to the new song */
+        model->priv->ids[to] = -1;
+        model->priv->times[to] = model->priv->times[src];
+        model->priv->haystacks[to] = NULL;
+        model->priv->matches[to] = MATCH_UNKNOWN;
+
+        model->priv->total_time += model->priv->times[to];
+        if (model->priv->playing >= to)
+                ++model->priv->playing;
+        ++model->priv->length;
+
+        ario_playlist_model_rows_changed_from (model, to);
+
+        ario_playlist_model_set_iter (model, &iter, to);
+        path = gtk_tree_path_new_from_indices (to, -1);
+        gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+        gtk_tree_path_free (path);
+}
+
+static void
+ario_playlist_model_row_changed (ArioPlaylistModel *model,
+                                 const gint row)
+{
+        GtkTreeIter iter;
+        GtkTreePath *path;
+
+        ario_playlist_model_set_iter (model, &iter, row);
+        path = gtk_tree_path_new_from_indices (row, -1);
+        gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+        gtk_tree_path_free (path);
+}
+
+gboolean
+ario_playlist_model_set_playing (ArioPlaylistModel *model,
+                                 const gint pos)
+{
+        ARIO_LOG_FUNCTION_START;
+        gint previous = model->priv->playing;
+
+        if (pos >= model->priv->length)
+                return FALSE;
+
+        model->priv->playing = pos;
+
+        /* Only the two rows whose pixbuf changed are redrawn */
+        if (previous >= 0 && previous != pos)
+                ario_playlist_model_row_changed (model, previous);
+        if (pos >= 0 && previous != pos)
+                ario_playlist_model_row_changed (model, pos);
+
+        return TRUE;
+}
+
+gint
+ario_playlist_model_get_total_time (ArioPlaylistModel *model)
+{
+        ARIO_LOG_FUNCTION_START;
+        return model->priv->total_time;
+}
+
+void
+ario_playlist_model_get_stats (ArioPlaylistModel *model,
+                               const gint pos,
+                               ArioPlaylistStats *stats)
+{
+        ARIO_LOG_FUNCTION_START;
+        stats->length = model->priv->length;
+        stats->total_time = model->priv->total_time;
+
+        if (pos < 0 || pos >= model->priv->length) {
+                stats->time_before = 0;
+                stats->time_after = 0;
+                return;
+        }
+
+        /* Move the running sum to the current row: the current song
+         * usually moves by one row at a time */
+        while (model->priv->stats_row < pos) {
+                model->priv->time_before += model->priv->times[model->priv->stats_row];
+                ++model->priv->stats_row;
+        }
+        while (model->priv->stats_row > pos) {
+                --model->priv->stats_row;
+                model->priv->time_before -= model->priv->times[model->priv->stats_row];
+        }
+
+        stats->time_before = model->priv->time_before;
+        stats->time_after = model->priv->total_time - model->priv->time_before - model->priv->times[pos];
+}
+
+static const gchar *
+ario_playlist_model_fold_interned (ArioPlaylistModel *model,
+                                   const gchar *value)
+{
+        gchar *folded;
+
+        /* Interned values are shared by many rows: fold each one only once */
+        folded = g_hash_table_lookup (model->priv->folded_values, value);
+        if (!folded) {
+                folded = ario_util_casefold (value);
+                g_hash_table_insert (model->priv->folded_values, (gpointer) value, folded);
+        }
+
+        return folded;
+}
+
+static gchar *
+ario_playlist_model_make_haystack (ArioPlaylistModel *model,
+                                   const gint row)
+{
+        GString *haystack;
+        const gchar *value;
+        gchar *folded;
+        gint column;
+
+        haystack = g_string_new (NULL);
+        for (column = 0; column < N_COLUMN; ++column) {
+                if (!(model->priv->filter_columns & (1 << column)))
+                        continue;
+
+                value = ario_playlist_model_get_string (model, column, row);
+                if (!value)
+                        continue;
+
+                /* Columns are separated by a character that can not be
+                 * part of a needle */
+                if (column == TITLE_COLUMN || column == FILE_COLUMN) {
+                        folded = ario_util_casefold (value);
+                        g_string_append (haystack, folded);
+                        g_free (folded);
+                } else {
+                        g_string_append (haystack, ario_playlist_model_fold_interned (model, value));
+                }
+                g_string_append_c (haystack, '\n');
+        }
+
+        return g_string_free (haystack, FALSE);
+}
+
+static gboolean
+ario_playlist_model_filter_narrows (gchar **old_needles,
+                                    gchar **needles)
+{
+        gint i, j;
+        gboolean found;
+
+        /* A row matching the new filter also matches the old one if each
+         * old needle is contained in one of the new needles */
+        for (i = 0; old_needles[i]; ++i) {
+                found = FALSE;
+                for (j = 0; needles[j] && !found; ++j)
+                        found = (strstr (needles[j], old_needles[i]) != NULL);
+                if (!found)
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+void
+ario_playlist_model_set_filter (ArioPlaylistModel *model,
+                                const gchar *text,
+                                const guint columns)
+{
+        ARIO_LOG_FUNCTION_START;
+        gchar **words;
+        gchar **needles = NULL;
+        GPtrArray *array;
+        gboolean narrows;
+        gint i;
+
+        /* Compile the filter: one casefolded needle per word */
+        if (text) {
+                words = g_strsplit (text, " ", -1);
+                array = g_ptr_array_new ();
+                for (i = 0; words[i]; ++i) {
+                        if (*words[i])
+                                g_ptr_array_add (array, ario_util_casefold (words[i]));
+                }
+                g_strfreev (words);
+
+                if (array->len > 0) {
+                        g_ptr_array_add (array, NULL);
+                        needles = (gchar **) g_ptr_array_free (array, FALSE);
+                } else {
+                        g_ptr_array_free (array, TRUE);
+                }
+        }
+
+        if (!needles) {
+                /* No more filter: free the haystacks */
+                for (i = 0; i < model->priv->length; ++i) {
+                        g_free (model->priv->haystacks[i]);
+                        model->priv->haystacks[i] = NULL;
+                        model->priv->matches[i] = MATCH_UNKNOWN;
+                }
+                if (model->priv->folded_values) {
+                        g_hash_table_destroy (model->priv->folded_values);
+                        model->priv->folded_values = NULL;
+                }
+        } else {
+                if (!model->priv->folded_values)
+                        model->priv->folded_values = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+                narrows = model->priv->needles
+                        && model->priv->filter_columns == columns
+                        && ario_playlist_model_filter_narrows (model->priv->needles, needles);
+
+                for (i = 0; i < model->priv->length; ++i) {
+                        /* Searched columns have changed */
+                        if (model->priv->filter_columns != columns) {
+                                g_free (model->priv->haystacks[i]);
+                                model->priv->haystacks[i] = NULL;
+                        }
+
+                        /* When the user keeps typing, rows that did not
+                         * match the previous filter are not checked again */
+                        if (!narrows || model->priv->matches[i] != MATCH_NO)
+                                model->priv->matches[i] = MATCH_UNKNOWN;
+                }
+        }
+
+        g_strfreev (model->priv->needles);
+        g_free (model->priv->needle_lengths);
+        model->priv->needles = needles;
+        model->priv->needle_lengths = NULL;
+        if (needles) {
+                model->priv->needle_lengths = g_new (gsize, g_strv_length (needles));
+                for (i = 0; needles[i]; ++i)
+                        model->priv->needle_lengths[i] = strlen (needles[i]);
+        }
+        model->priv->filter_columns = columns;
+}
+
+gboolean
+ario_playlist_model_row_matches (ArioPlaylistModel *model,
+                                 GtkTreeIter *iter)
+{
+        gint row, i;
+        gboolean match = TRUE;
+        const gchar *haystack;
+        gsize haystack_len;
+
+        if (!model->priv->needles)
+                return TRUE;
+
+        g_return_val_if_fail (ario_playlist_model_iter_is_valid (model, iter), FALSE);
+        row = GPOINTER_TO_INT (iter->user_data);
+
+        if (model->priv->matches[row] != MATCH_UNKNOWN)
+                return model->priv->matches[row] == MATCH_YES;
+
+        if (!model->priv->haystacks[row])
+                model->priv->haystacks[row] = ario_playlist_model_make_haystack (model, row);
+
+        /* The row must contain all the needles */
+        haystack = model->priv->haystacks[row];
+        haystack_len = strlen (haystack);
+        for (i = 0; model->priv->needles[i] && match; ++i)
+                match = (ario_util_strstr_folded (haystack, haystack_len,
+                                                  model->priv->needles[i],
+                                                  model->priv->needle_lengths[i]) != NULL);
+
+        model->priv->matches[row] = match ? MATCH_YES : MATCH_NO;
+
+        return match;
+}
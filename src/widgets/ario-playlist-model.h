@@ -0,0 +1,140 @@
+/*
+ *  Copyright (C) 2005 Marc Pavot <marc.pavot@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ARIO_PLAYLIST_MODEL_H
+#define __ARIO_PLAYLIST_MODEL_H
+
+#include <gtk/gtk.h>
+#include "servers/ario-server.h"
+
+G_BEGIN_DECLS
+
+#define TYPE_ARIO_PLAYLIST_MODEL         (ario_playlist_model_get_type ())
+#define ARIO_PLAYLIST_MODEL(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), TYPE_ARIO_PLAYLIST_MODEL, ArioPlaylistModel))
+#define ARIO_PLAYLIST_MODEL_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), TYPE_ARIO_PLAYLIST_MODEL, ArioPlaylistModelClass))
+#define IS_ARIO_PLAYLIST_MODEL(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), TYPE_ARIO_PLAYLIST_MODEL))
+#define IS_ARIO_PLAYLIST_MODEL_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), TYPE_ARIO_PLAYLIST_MODEL))
+#define ARIO_PLAYLIST_MODEL_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), TYPE_ARIO_PLAYLIST_MODEL, ArioPlaylistModelClass))
+
+/* Columns of the playlist model */
+enum
+{
+        PIXBUF_COLUMN,
+        TRACK_COLUMN,
+        TITLE_COLUMN,
+        ARTIST_COLUMN,
+        ALBUM_COLUMN,
+        DURATION_COLUMN,
+        FILE_COLUMN,
+        GENRE_COLUMN,
+        DATE_COLUMN,
+        DISC_COLUMN,
+        ID_COLUMN,
+        TIME_COLUMN,
+        N_COLUMN
+};
+
+typedef struct ArioPlaylistModelPrivate ArioPlaylistModelPrivate;
+
+/* Statistics of the playlist. Times are in seconds and time_before and
+ * time_after do not include the current song (they are 0 if there is
+ * no current song) */
+typedef struct
+{
+        gint length;
+        gint total_time;
+        gint time_before;
+        gint time_after;
+} ArioPlaylistStats;
+
+/*
+ * ArioPlaylistModel is a sortable list model holding the songs of
+ * the current playlist. Each song field is stored in its own array,
+ * tags are interned and cells are only formatted when they are
+ * displayed.
+ */
+typedef struct
+{
+        GObject parent;
+
+        ArioPlaylistModelPrivate *priv;
+} ArioPlaylistModel;
+
+typedef struct
+{
+        GObjectClass parent;
+} ArioPlaylistModelClass;
+
+GType                   ario_playlist_model_get_type            (void) G_GNUC_CONST;
+
+ArioPlaylistModel *     ario_playlist_model_new                 (GdkPixbuf *play_pixbuf);
+
+/* Update the row at song->pos, or append a row if song->pos is past
+ * the end of the model */
+void                    ario_playlist_model_set_song            (ArioPlaylistModel *model,
+                                                                 ArioServerSong *song);
+
+/* Remove all rows after the length first rows */
+void                    ario_playlist_model_truncate            (ArioPlaylistModel *model,
+                                                                 const gint length);
+
+/* Remove n_rows rows, given in increasing order, in one pass */
+void                    ario_playlist_model_remove_rows         (ArioPlaylistModel *model,
+                                                                 const gint *rows,
+                                                                 const gint n_rows);
+
+/* Move row from so that it ends at row to, like the move command of
+ * the server */
+void                    ario_playlist_model_move_row            (ArioPlaylistModel *model,
+                                                                 const gint from,
+                                                                 const gint to);
+
+/* Insert a copy of row from at row to. The new row has no id until
+ * the server playlist is synchronized */
+void                    ario_playlist_model_copy_row            (ArioPlaylistModel *model,
+                                                                 const gint from,
+                                                                 const gint to);
+
+/* Show the 'playing' pixbuf on row pos only (-1 for no row). Returns
+ * FALSE if the row does not exist */
+gboolean                ario_playlist_model_set_playing         (ArioPlaylistModel *model,
+                                                                 const gint pos);
+
+gint                    ario_playlist_model_get_total_time      (ArioPlaylistModel *model);
+
+/* Statistics are maintained while rows change: getting them does not
+ * go through the model. pos is the row of the current song (-1 if
+ * there is none) */
+void                    ario_playlist_model_get_stats           (ArioPlaylistModel *model,
+                                                                 const gint pos,
+                                                                 ArioPlaylistStats *stats);
+
+/* Filter rows on text, split in words that must all be found in one
+ * of the columns of mask columns (1 << column). text may be NULL to
+ * remove the filter */
+void                    ario_playlist_model_set_filter          (ArioPlaylistModel *model,
+                                                                 const gchar *text,
+                                                                 const guint columns);
+
+gboolean                ario_playlist_model_row_matches         (ArioPlaylistModel *model,
+                                                                 GtkTreeIter *iter);
+
+G_END_DECLS
+
+#endif /* __ARIO_PLAYLIST_MODEL_H */
@@ -33,6 +33,7 @@
 #include "shell/ario-shell-songinfos.h"
 #include "sources/ario-source-manager.h"
 #include "widgets/ario-dnd-tree.h"
+#include "widgets/ario-playlist-model.h"
 
 typedef struct ArioPlaylistColumn ArioPlaylistColumn;
 
@@ -109,7 +110,7 @@ static ArioPlaylist *instance = NULL;
 struct ArioPlaylistPrivate
 {
         GtkWidget *tree;
-        GtkListStore *model;
+        ArioPlaylistModel *model;
         GtkTreeSelection *selection;
         GtkTreeModelFilter *filter;
 
@@ -123,6 +124,13 @@ struct ArioPlaylistPrivate
         int playlist_length;
         gint pos;
 
+        /* Rows changed locally before the server confirms the changes:
+         * rows from dirty_start to dirty_end may differ from the server
+         * playlist at version playlist_id */
+        gboolean dirty;
+        gint dirty_start;
+        gint dirty_end;
+
         GdkPixbuf *play_pixbuf;
 
         GtkWidget *menu;
@@ -145,24 +153,6 @@ enum
         PROP_0,
 };
 
-/* Treeview columns */
-enum
-{
-        PIXBUF_COLUMN,
-        TRACK_COLUMN,
-        TITLE_COLUMN,
-        ARTIST_COLUMN,
-        ALBUM_COLUMN,
-        DURATION_COLUMN,
-        FILE_COLUMN,
-        GENRE_COLUMN,
-        DATE_COLUMN,
-        DISC_COLUMN,
-        ID_COLUMN,
-        TIME_COLUMN,
-        N_COLUMN
-};
-
 /*
  * ArioPlaylistColumn is used to initialise a column in the
  * playlist treeview and defines various column properties
@@ -367,83 +357,38 @@ ario_playlist_reorder_columns (void)
         }
 }
 
-static gint
-ario_playlist_no_sort (G_GNUC_UNUSED GtkTreeModel *model,
-                       G_GNUC_UNUSED GtkTreeIter *a,
-                       G_GNUC_UNUSED GtkTreeIter *b,
-                       G_GNUC_UNUSED gpointer user_data)
-{
-        /* Default sort always return 0 */
-        return 0;
-}
-
 static gboolean
 ario_playlist_filter_func (GtkTreeModel *model,
                            GtkTreeIter  *iter,
                            ArioPlaylist *playlist)
 {
-        ARIO_LOG_FUNCTION_START;
-        gchar *title, *artist, *album, *genre;
-        gboolean visible = TRUE, filter;
-        int i;
-        gchar **cmp_str;
-
         /* There is no filter if the search box is empty */
         if (!playlist->priv->search_text || *playlist->priv->search_text == '\0')
                 return TRUE;
 
-        /* Split on spaces to have multiple filters */
-        cmp_str = g_strsplit (playlist->priv->search_text, " ", -1);
-        if (!cmp_str)
-                return TRUE;
-
-        /* Get data needed to filter */
-        gtk_tree_model_get (model, iter,
-                            TITLE_COLUMN, &title,
-                            ARTIST_COLUMN, &artist,
-                            ALBUM_COLUMN, &album,
-                            GENRE_COLUMN, &genre,
-                            -1);
-
-        /* Loop on every filter */
-        for (i = 0; cmp_str[i] && visible; ++i) {
-                if (g_utf8_collate (cmp_str[i], ""))
-                {
-                        /* By default the row doesn't match the filter */
-                        filter = FALSE;
-
-                        /* The row match the filter if one of the visible column contains
-                         * the filter */
-                        if (title
-                            && ario_conf_get_boolean (PREF_TITLE_COLUMN_VISIBLE, PREF_TITLE_COLUMN_VISIBLE_DEFAULT)
-                            && ario_util_stristr (title, cmp_str[i])) {
-                                filter = TRUE;
-                        } else if (artist
-                                   && ario_conf_get_boolean (PREF_ARTIST_COLUMN_VISIBLE, PREF_ARTIST_COLUMN_VISIBLE_DEFAULT)
-                                   && ario_util_stristr (artist, cmp_str[i])) {
-                                filter = TRUE;
-                        } else if (album
-                                   && ario_conf_get_boolean (PREF_ALBUM_COLUMN_VISIBLE, PREF_ALBUM_COLUMN_VISIBLE_DEFAULT)
-                                   && ario_util_stristr (album, cmp_str[i])) {
-                                filter = TRUE;
-                        } else if (genre
-                                   && ario_conf_get_boolean (PREF_GENRE_COLUMN_VISIBLE, PREF_GENRE_COLUMN_VISIBLE_DEFAULT)
-                                   && ario_util_stristr (genre, cmp_str[i])) {
-                                filter = TRUE;
-                        }
-
-                        /* The row must match all the filters to be shown */
-                        visible &= filter;
-                }
-        }
-
-        g_strfreev (cmp_str);
-        g_free (title);
-        g_free (artist);
-        g_free (album);
-        g_free (genre);
+        return ario_playlist_model_row_matches (ARIO_PLAYLIST_MODEL (model), iter);
+}
 
-        return visible;
+static void
+ario_playlist_update_filter (ArioPlaylist *playlist)
+{
+        ARIO_LOG_FUNCTION_START;
+        guint columns = 0;
+
+        /* The row matches a word if one of the visible columns contains it */
+        if (ario_conf_get_boolean (PREF_TITLE_COLUMN_VISIBLE, PREF_TITLE_COLUMN_VISIBLE_DEFAULT))
+                columns |= 1 << TITLE_COLUMN;
+        if (ario_conf_get_boolean (PREF_ARTIST_COLUMN_VISIBLE, PREF_ARTIST_COLUMN_VISIBLE_DEFAULT))
+                columns |= 1 << ARTIST_COLUMN;
+        if (ario_conf_get_boolean (PREF_ALBUM_COLUMN_VISIBLE, PREF_ALBUM_COLUMN_VISIBLE_DEFAULT))
+                columns |= 1 << ALBUM_COLUMN;
+        if (ario_conf_get_boolean (PREF_GENRE_COLUMN_VISIBLE, PREF_GENRE_COLUMN_VISIBLE_DEFAULT))
+                columns |= 1 << GENRE_COLUMN;
+
+        /* The filter is compiled once for all rows */
+        ario_playlist_model_set_filter (playlist->priv->model,
+                                        playlist->priv->search_text,
+                                        columns);
 }
 
 static void
@@ -458,6 +403,7 @@ ario_playlist_search_close (GtkButton *button,
                                  GTK_TREE_MODEL (playlist->priv->model));
         gtk_tree_view_set_headers_clickable (GTK_TREE_VIEW (playlist->priv->tree), TRUE);
         playlist->priv->in_search = FALSE;
+        ario_playlist_model_set_filter (playlist->priv->model, NULL, 0);
 
         /* Stop handling drag & drop differently */
         if (playlist->priv->dnd_handler) {
@@ -481,6 +427,7 @@ ario_playlist_search_entry_changed (GtkEntry *entry,
                 gtk_widget_grab_focus (playlist->priv->tree);
         } else {
                 /* Refilter all rows if filter has changed */
+                ario_playlist_update_filter (playlist);
                 gtk_tree_model_filter_refilter (playlist->priv->filter);
         }
 }
@@ -541,19 +488,7 @@ ario_playlist_init (ArioPlaylist *playlist)
         ario_playlist_reorder_columns ();
 
         /* Create tree model */
-        playlist->priv->model = gtk_list_store_new (N_COLUMN,
-                                                    GDK_TYPE_PIXBUF,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_STRING,
-                                                    G_TYPE_INT,
-                                                    G_TYPE_INT);
+        playlist->priv->model = ario_playlist_model_new (playlist->priv->play_pixbuf);
 
         /* Create the filter used when the search box is activated */
         playlist->priv->filter = GTK_TREE_MODEL_FILTER (gtk_tree_model_filter_new (GTK_TREE_MODEL (playlist->priv->model), NULL));
@@ -565,9 +500,6 @@ ario_playlist_init (ArioPlaylist *playlist)
         /* Set various treeview properties */
         gtk_tree_view_set_model (GTK_TREE_VIEW (playlist->priv->tree),
                                  GTK_TREE_MODEL (playlist->priv->model));
-        gtk_tree_sortable_set_default_sort_func (GTK_TREE_SORTABLE (playlist->priv->model),
-                                                 ario_playlist_no_sort,
-                                                 NULL, NULL);
         gtk_tree_view_set_enable_search (GTK_TREE_VIEW (playlist->priv->tree), FALSE);
         playlist->priv->selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (playlist->priv->tree));
         gtk_tree_selection_set_mode (playlist->priv->selection,
@@ -719,6 +651,8 @@ ario_playlist_finalize (GObject *object)
 
         g_return_if_fail (playlist->priv != NULL);
         g_object_unref (playlist->priv->play_pixbuf);
+        g_object_unref (playlist->priv->filter);
+        g_object_unref (playlist->priv->model);
 
         G_OBJECT_CLASS (ario_playlist_parent_class)->finalize (object);
 }
@@ -733,8 +667,6 @@ ario_playlist_sync_song (void)
         ARIO_LOG_FUNCTION_START;
         int state = ario_server_get_current_state ();
         ArioServerSong *song = ario_server_get_current_song ();
-        GtkTreePath *path;
-        GtkTreeIter iter;
 
         /* If we are still playing and the song has not changed we don't do anything */
         if (song
@@ -753,113 +685,104 @@ ario_playlist_sync_song (void)
 
         /* Remove the 'playing' icon from previous song */
         if (instance->priv->pos >= 0) {
-                path = gtk_tree_path_new_from_indices (instance->priv->pos, -1);
-                if (gtk_tree_model_get_iter (GTK_TREE_MODEL (instance->priv->model), &iter, path)) {
-                        gtk_list_store_set (instance->priv->model, &iter,
-                                            PIXBUF_COLUMN, NULL,
-                                            -1);
-                        instance->priv->pos = -1;
-                }
-                gtk_tree_path_free (path);
+                ario_playlist_model_set_playing (instance->priv->model, -1);
+                instance->priv->pos = -1;
         }
 
         /* Add 'playing' icon to new song */
         if (song
             && state != ARIO_STATE_UNKNOWN
             && state != ARIO_STATE_STOP) {
-                path = gtk_tree_path_new_from_indices (song->pos, -1);
-                if (gtk_tree_model_get_iter (GTK_TREE_MODEL (instance->priv->model), &iter, path)) {
-                        gtk_list_store_set (instance->priv->model, &iter,
-                                            PIXBUF_COLUMN, instance->priv->play_pixbuf,
-                                            -1);
+                if (ario_playlist_model_set_playing (instance->priv->model, song->pos))
                         instance->priv->pos = song->pos;
-                }
-                gtk_tree_path_free (path);
         }
 }
 
+static void
+ario_playlist_set_dirty (const gint start,
+                         const gint end)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (!instance->priv->dirty) {
+                instance->priv->dirty = TRUE;
+                instance->priv->dirty_start = start;
+                instance->priv->dirty_end = end;
+        } else {
+                instance->priv->dirty_start = MIN (instance->priv->dirty_start, start);
+                instance->priv->dirty_end = MAX (instance->priv->dirty_end, end);
+        }
+}
+
+static gboolean
+ario_playlist_changes_cover (GSList *songs,
+                             const gint start,
+                             const gint end)
+{
+        ARIO_LOG_FUNCTION_START;
+        GSList *tmp;
+        ArioServerSong *song;
+        gint covered = 0;
+
+        /* Positions are unique in the changes */
+        for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
+                song = tmp->data;
+                if (song->pos >= start && song->pos < end)
+                        ++covered;
+        }
+
+        return covered >= end - start;
+}
+
 static void
 ario_playlist_changed_cb (ArioServer *server,
                           ArioPlaylist *playlist)
 {
         ARIO_LOG_FUNCTION_START;
-        gint old_length;
-        GtkTreeIter iter;
-        gchar track[ARIO_MAX_TRACK_SIZE];
-        gchar time[ARIO_MAX_TIME_SIZE];
-        gchar *title;
         GSList *songs, *tmp;
-        ArioServerSong *song;
-        gboolean need_set;
-        GtkTreePath *path;
 
         /* Clear the playlist if ario is not connected to the server */
         if (!ario_server_is_connected ()) {
                 playlist->priv->playlist_length = 0;
                 playlist->priv->playlist_id = -1;
-                gtk_list_store_clear (playlist->priv->model);
+                playlist->priv->dirty = FALSE;
+                ario_playlist_model_truncate (playlist->priv->model, 0);
                 return;
         }
 
+        /* Local changes are reconciled once the server has them all */
+        if (playlist->priv->dirty && ario_server_is_committing ())
+                return;
+
         /* Get changes on server */
         songs = ario_server_get_playlist_changes (playlist->priv->playlist_id);
         playlist->priv->playlist_id = ario_server_get_current_playlist_id ();
+        playlist->priv->playlist_length = ario_server_get_current_playlist_length ();
 
-        old_length = playlist->priv->playlist_length;
-
-        /* For each change in playlist */
-        for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
-                song = tmp->data;
-                need_set = FALSE;
-                /* Decide whether to update or to add */
-                if (song->pos < old_length) {
-                        /* Update */
-                        path = gtk_tree_path_new_from_indices (song->pos, -1);
-                        if (gtk_tree_model_get_iter (GTK_TREE_MODEL (playlist->priv->model), &iter, path)) {
-                                need_set = TRUE;
-                        }
-                        gtk_tree_path_free (path);
-                } else {
-                        /* Add */
-                        gtk_list_store_append (playlist->priv->model, &iter);
-                        need_set = TRUE;
-                }
-                if (need_set) {
-                        /* Set appropriate data in playlist row */
-                        ario_util_format_time_buf (song->time, time, ARIO_MAX_TIME_SIZE);
-                        ario_util_format_track_buf (song->track, track, ARIO_MAX_TRACK_SIZE);
-                        title = ario_util_format_title (song);
-                        gtk_list_store_set (playlist->priv->model, &iter,
-                                            TRACK_COLUMN, track,
-                                            TITLE_COLUMN, title,
-                                            ARTIST_COLUMN, song->artist,
-                                            ALBUM_COLUMN, song->album ? song->album : ARIO_SERVER_UNKNOWN,
-                                            DURATION_COLUMN, time,
-                                            FILE_COLUMN, song->file,
-                                            GENRE_COLUMN, song->genre,
-                                            DATE_COLUMN, song->date,
-                                            ID_COLUMN, song->id,
-                                            TIME_COLUMN, song->time,
-                                            DISC_COLUMN, song->disc,
-                                            -1);
+        /* Rows changed locally are right if the server reports a change
+         * for each of them. Otherwise the changes failed or conflicted
+         * with another client: roll back to the full server playlist */
+        if (playlist->priv->dirty) {
+                playlist->priv->dirty = FALSE;
+                if (!ario_playlist_changes_cover (songs,
+                                                  playlist->priv->dirty_start,
+                                                  MIN (playlist->priv->dirty_end, playlist->priv->playlist_length))) {
+                        g_slist_foreach (songs, (GFunc) ario_server_free_song, NULL);
+                        g_slist_free (songs);
+                        songs = ario_server_get_playlist_changes (-1);
                 }
         }
 
+        /* Update or add each changed song: rows are formatted when
+         * they are displayed */
+        for (tmp = songs; tmp; tmp = g_slist_next (tmp))
+                ario_playlist_model_set_song (playlist->priv->model, tmp->data);
+
         g_slist_foreach (songs, (GFunc) ario_server_free_song, NULL);
         g_slist_free (songs);
 
-        playlist->priv->playlist_length = ario_server_get_current_playlist_length ();
-
         /* Remove rows at the end of playlist if playlist size has decreased */
-        if (playlist->priv->playlist_length < old_length) {
-                path = gtk_tree_path_new_from_indices (playlist->priv->playlist_length, -1);
-
-                if (gtk_tree_model_get_iter (GTK_TREE_MODEL (playlist->priv->model), &iter, path)) {
-                        while (gtk_list_store_remove (playlist->priv->model, &iter)) { }
-                }
-
-                gtk_tree_path_free (path);
-        }
+        ario_playlist_model_truncate (playlist->priv->model,
+                                      playlist->priv->playlist_length);
 
         /* Synchronize 'playing' pixbuf in playlist */
         ario_playlist_sync_song ();
@@ -1110,8 +1033,11 @@ ario_playlist_move_rows (const int x, const int y)
                 if (pos > indice[0])
                         --pos;
 
-                /* Move the song */
+                /* Move the song on the server and in the playlist
+                 * without waiting for the server */
                 ario_server_queue_move (indice[0] + offset, pos);
+                ario_playlist_model_move_row (instance->priv->model, indice[0] + offset, pos);
+                ario_playlist_set_dirty (MIN (indice[0] + offset, pos), MAX (indice[0] + offset, pos) + 1);
 
                 /* Adjust offset to take the move into account */
                 if (pos < indice[0])
@@ -1137,11 +1063,12 @@ ario_playlist_copy_rows (const int x, const int y)
         GtkTreeViewDropPosition drop_pos;
         gint pos;
         gint *indice;
-        GList *list;
+        GList *list, *tmp;
         GSList *songs = NULL;
         GtkTreeModel *model = GTK_TREE_MODEL (instance->priv->model);
         GtkTreeIter iter;
         gchar *filename;
+        gint row, inserted = 0;
 
         /* Get drop location */
         gtk_tree_view_get_dest_row_at_pos (GTK_TREE_VIEW (instance->priv->tree), x, y, &path, &drop_pos);
@@ -1167,12 +1094,29 @@ ario_playlist_copy_rows (const int x, const int y)
         gtk_tree_selection_unselect_all (instance->priv->selection);
 
         /* For each selected row (starting from the end) */
-        for (; list; list = g_list_next (list)) {
+        for (tmp = list; tmp; tmp = g_list_next (tmp)) {
                 /* Get start pos */
-                gtk_tree_model_get_iter (model, &iter, (GtkTreePath *) list->data);
+                gtk_tree_model_get_iter (model, &iter, (GtkTreePath *) tmp->data);
                 gtk_tree_model_get (model, &iter, FILE_COLUMN, &filename, -1);
                 songs = g_slist_append (songs, filename);
         }
+        /* Insert the copies in the playlist without waiting for the
+         * server, before the server can notify its own changes */
+        for (tmp = list; tmp; tmp = g_list_next (tmp)) {
+                row = ario_playlist_get_indice ((GtkTreePath *) tmp->data);
+                if (row < 0)
+                        continue;
+                /* Rows after the drop position have been moved down */
+                if (row >= pos)
+                        row += inserted;
+                ario_playlist_model_copy_row (instance->priv->model, row, pos + inserted);
+                ++inserted;
+        }
+        if (inserted) {
+                instance->priv->playlist_length += inserted;
+                ario_playlist_set_dirty (pos, instance->priv->playlist_length);
+        }
+
         /* Insert songs in playlist */
         ario_server_insert_at (songs, pos - 1);
 
@@ -1396,34 +1340,51 @@ static void
 ario_playlist_selection_remove_foreach (GtkTreeModel *model,
                                         GtkTreePath *path,
                                         GtkTreeIter *iter,
-                                        guint *deleted)
+                                        GArray *rows)
 {
         ARIO_LOG_FUNCTION_START;
         gint indice = ario_playlist_get_indice (path);
 
         if (indice >= 0) {
                 /* Remove song from playlist on server */
-                ario_server_queue_delete_pos (indice - *deleted);
-                ++(*deleted);
+                ario_server_queue_delete_pos (indice - rows->len);
+                g_array_append_val (rows, indice);
         }
 }
 
+static void
+ario_playlist_remove_rows (GArray *rows)
+{
+        ARIO_LOG_FUNCTION_START;
+        if (!rows->len)
+                return;
+
+        /* Remove the rows without waiting for the server */
+        ario_playlist_set_dirty (g_array_index (rows, gint, 0), instance->priv->playlist_length);
+        ario_playlist_model_remove_rows (instance->priv->model, (const gint *) rows->data, rows->len);
+        instance->priv->playlist_length -= rows->len;
+}
+
 static void
 ario_playlist_remove (void)
 {
         ARIO_LOG_FUNCTION_START;
-        guint deleted = 0;
+        GArray *rows = g_array_new (FALSE, FALSE, sizeof (gint));
 
         /* Delete every selected song */
         gtk_tree_selection_selected_foreach (instance->priv->selection,
                                              (GtkTreeSelectionForeachFunc) ario_playlist_selection_remove_foreach,
-                                             &deleted);
-
-        /* Commit song deletions */
-        ario_server_queue_commit ();
+                                             rows);
 
         /* Unselect all rows */
         gtk_tree_selection_unselect_all (instance->priv->selection);
+
+        /* Remove the rows before the server notifies the deletions */
+        ario_playlist_remove_rows (rows);
+        g_array_free (rows, TRUE);
+
+        /* Commit song deletions */
+        ario_server_queue_commit ();
 }
 
 static void
@@ -1438,9 +1399,18 @@ ario_playlist_cmd_remove (GSimpleAction *action,
 typedef struct ArioPlaylistCropData
 {
         gint kept;
-        gint deleted;
+        GArray *deleted;
 } ArioPlaylistCropData;
 
+static void
+ario_playlist_crop_delete (ArioPlaylistCropData *data)
+{
+        gint row = data->kept + data->deleted->len;
+
+        ario_server_queue_delete_pos (data->kept);
+        g_array_append_val (data->deleted, row);
+}
+
 static void
 ario_playlist_selection_crop_foreach (GtkTreeModel *model,
                                       GtkTreePath *path,
@@ -1452,10 +1422,8 @@ ario_playlist_selection_crop_foreach (GtkTreeModel *model,
 
         if (indice >= 0) {
                 /* Remove all rows between the last kept row and the current row */
-                while (data->deleted + data->kept < indice) {
-                        ario_server_queue_delete_pos (data->kept);
-                        ++data->deleted;
-                }
+                while (data->kept + (gint) data->deleted->len < indice)
+                        ario_playlist_crop_delete (data);
 
                 /* Keep the current row */
                 ++data->kept;
@@ -1471,7 +1439,7 @@ ario_playlist_cmd_crop (GSimpleAction *action,
         ArioPlaylistCropData crop_data;
 
         crop_data.kept = 0;
-        crop_data.deleted = 0;
+        crop_data.deleted = g_array_new (FALSE, FALSE, sizeof (gint));
 
         /* Call ario_playlist_selection_crop_foreach, for each selected row */
         gtk_tree_selection_selected_foreach (instance->priv->selection,
@@ -1479,16 +1447,18 @@ ario_playlist_cmd_crop (GSimpleAction *action,
                                              &crop_data);
 
         /* Delete all songs after the last selected one */
-        while (crop_data.deleted + crop_data.kept < instance->priv->playlist_length) {
-                ario_server_queue_delete_pos (crop_data.kept);
-                ++crop_data.deleted;
-        }
-
-        /* Commit song deletions */
-        ario_server_queue_commit ();
+        while (crop_data.kept + (gint) crop_data.deleted->len < instance->priv->playlist_length)
+                ario_playlist_crop_delete (&crop_data);
 
         /* Unselect all rows */
         gtk_tree_selection_unselect_all (instance->priv->selection);
+
+        /* Remove the rows before the server notifies the deletions */
+        ario_playlist_remove_rows (crop_data.deleted);
+        g_array_free (crop_data.deleted, TRUE);
+
+        /* Commit song deletions */
+        ario_server_queue_commit ();
 }
 
 static void
@@ -1722,33 +1692,39 @@ ario_playlist_column_visible_changed_cb (guint notification_id,
         /* Called when user changes column visibility in preferences */
         gtk_tree_view_column_set_visible (ario_column->column,
                                           ario_conf_get_integer (ario_column->pref_is_visible, ario_column->default_is_visible));
-}
-
-static gboolean
-ario_playlist_get_total_time_foreach (GtkTreeModel *model,
-                                      GtkTreePath *p,
-                                      GtkTreeIter *iter,
-                                      int *total_time)
-{
-        gint time;
 
-        gtk_tree_model_get (model, iter, TIME_COLUMN, &time, -1);
-        *total_time += time;
-
-        return FALSE;
+        /* Searched columns have changed */
+        if (instance->priv->in_search
+            && instance->priv->search_text
+            && *instance->priv->search_text) {
+                ario_playlist_update_filter (instance);
+                gtk_tree_model_filter_refilter (instance->priv->filter);
+        }
 }
 
 gint
 ario_playlist_get_total_time (void)
 {
         ARIO_LOG_FUNCTION_START;
-        int total_time = 0;
+        /* Total time is updated when the playlist changes */
+        return ario_playlist_model_get_total_time (instance->priv->model);
+}
+
+void
+ario_playlist_get_stats (ArioPlaylistStats *stats)
+{
+        ARIO_LOG_FUNCTION_START;
+        ArioServerSong *song;
 
-        /* Compute total time by adding all song times */
-        gtk_tree_model_foreach (GTK_TREE_MODEL (instance->priv->model),
-                                (GtkTreeModelForeachFunc) ario_playlist_get_total_time_foreach,
-                                &total_time);
+        if (!instance) {
+                memset (stats, 0, sizeof (ArioPlaylistStats));
+                return;
+        }
 
-        return total_time;
+        /* The current song is taken from the server: the playing row
+         * may not be updated yet when the song changes */
+        song = ario_server_get_current_song ();
+        ario_playlist_model_get_stats (instance->priv->model,
+                                       song ? song->pos : -1,
+                                       stats);
 }
-
@@ -22,6 +22,7 @@
 
 #include <gtk/gtk.h>
 #include "sources/ario-source.h"
+#include "widgets/ario-playlist-model.h"
 
 G_BEGIN_DECLS
 
@@ -59,6 +60,9 @@ void            ario_playlist_shutdown          (void);
 
 gint            ario_playlist_get_total_time    (void);
 
+/* Length and times of the playlist, without going through its rows */
+void            ario_playlist_get_stats         (ArioPlaylistStats *stats);
+
 G_END_DECLS
 
 #endif /* __ARIO_PLAYLIST_H */
@@ -388,3 +388,27 @@ ario_songlist_get_selection (ArioSonglist *songlist)
         ARIO_LOG_FUNCTION_START;
         return songlist->priv->selection;
 }
+
+void
+ario_songlist_append_songs (ArioSonglist *songlist,
+                            const GSList *songs)
+{
+        ARIO_LOG_FUNCTION_START;
+        const GSList *tmp;
+        ArioServerSong *song;
+        GtkTreeIter iter;
+
+        /* For each song */
+        for (tmp = songs; tmp; tmp = g_slist_next (tmp)) {
+                song = tmp->data;
+
+                /* Append song to songs list */
+                gtk_list_store_append (songlist->priv->model, &iter);
+                gtk_list_store_set (songlist->priv->model, &iter,
+                                    SONGS_TITLE_COLUMN, ario_util_format_title (song),
+                                    SONGS_ARTIST_COLUMN, song->artist,
+                                    SONGS_ALBUM_COLUMN, song->album,
+                                    SONGS_FILENAME_COLUMN, song->file,
+                                    -1);
+        }
+}
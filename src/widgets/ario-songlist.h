@@ -70,6 +70,9 @@ GtkListStore*           ario_songlist_get_liststore             (ArioSonglist *s
 G_MODULE_EXPORT
 GtkTreeSelection*       ario_songlist_get_selection             (ArioSonglist *songlist);
 G_MODULE_EXPORT
+void                    ario_songlist_append_songs              (ArioSonglist *songlist,
+                                                                 const GSList *songs);
+G_MODULE_EXPORT
 void                    ario_songlist_cmd_add_songlists         (GSimpleAction *action,
                                                                  GVariant *parameter,
                                                                  gpointer data);
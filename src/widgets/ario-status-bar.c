@@ -21,6 +21,7 @@
 #include "widgets/ario-status-bar.h"
 #include <glib/gi18n.h>
 #include "servers/ario-server.h"
+#include "widgets/ario-playlist.h"
 #include "ario-util.h"
 #include "ario-debug.h"
 
@@ -69,6 +70,10 @@ ario_status_bar_new (void)
                                  "updatingdb_changed",
                                  G_CALLBACK (ario_status_bar_playlist_changed_cb),
                                  status_bar, 0);
+        g_signal_connect_object (server,
+                                 "enqueue_changed",
+                                 G_CALLBACK (ario_status_bar_playlist_changed_cb),
+                                 status_bar, 0);
         return GTK_WIDGET (status_bar);
 }
 
@@ -79,18 +84,16 @@ ario_status_bar_playlist_changed_cb (ArioServer *server,
         ARIO_LOG_FUNCTION_START;
         gchar *msg, *tmp;
         gchar *formated_total_time;
-        int playlist_length;
-        int playlist_total_time;
-
-        /* Get number of items in playlist */
-        playlist_length = ario_server_get_current_playlist_length ();
+        ArioPlaylistStats stats;
+        int enqueue_done, enqueue_total;
 
-        /* Get formated playlist total time */
-        playlist_total_time = ario_server_get_current_playlist_total_time ();
-        formated_total_time = ario_util_format_total_time (playlist_total_time);
+        /* Get number of items and total time of the playlist, kept up
+         * to date by the playlist */
+        ario_playlist_get_stats (&stats);
+        formated_total_time = ario_util_format_total_time (stats.total_time);
 
         /* Format status bar message */
-        msg = g_strdup_printf ("%d %s - %s", playlist_length, _("Songs"), formated_total_time);
+        msg = g_strdup_printf ("%d %s - %s", stats.length, _("Songs"), formated_total_time);
         g_free (formated_total_time);
 
         if (ario_server_get_updating ()) {
@@ -99,6 +102,16 @@ ario_status_bar_playlist_changed_cb (ArioServer *server,
                 msg = tmp;
         }
 
+        /* Show the progress of songs added in the background */
+        if (ario_server_get_enqueue_progress (&enqueue_done, &enqueue_total)) {
+                if (enqueue_total > 0)
+                        tmp = g_strdup_printf ("%s - %s (%d/%d)", msg, _("Adding songs..."), enqueue_done, enqueue_total);
+                else
+                        tmp = g_strdup_printf ("%s - %s", msg, _("Adding songs..."));
+                g_free (msg);
+                msg = tmp;
+        }
+
         /* Change status bar message */
         gtk_statusbar_pop (GTK_STATUSBAR(status_bar), status_bar->priv->playlist_context_id);
         gtk_statusbar_push (GTK_STATUSBAR (status_bar), status_bar->priv->playlist_context_id, msg);